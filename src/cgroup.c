@@ -0,0 +1,478 @@
+/*
+ * qperf - run tests in a cgroup.
+ * Measure socket and RDMA performance.
+ *
+ * Copyright (c) 2002-2009 Johann George.  All rights reserved.
+ * Copyright (c) 2006-2009 QLogic Corporation.  All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <mntent.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include "qperf.h"
+
+
+/*
+ * Throttling counters from cpu.stat.
+ */
+typedef struct CPU_STAT {
+    uint64_t    periods;                /* Enforcement periods */
+    uint64_t    throttled;              /* Periods we were throttled in */
+    uint64_t    throttled_us;           /* Time throttled in us */
+} CPU_STAT;
+
+
+/*
+ * Function prototypes.
+ */
+static void     cgroup_controllers(void);
+static void     cgroup_lock(void);
+static int      cgroup_mount(char *path, int len);
+static int      cgroup_others(void);
+static int      cgroup_read(CPU_STAT *cs);
+static int      cgroup_self(char *path, int len);
+static void     cgroup_unlock(void);
+static void     cgroup_write(char *file, char *value);
+static int      file_write(char *path, char *value);
+static uint64_t stat_field(char *buf, char *name);
+
+
+/*
+ * Global variables.
+ */
+char           *CgroupParent;
+
+
+/*
+ * Static variables.
+ */
+static char     CgroupBase[PATH_MAX/4];
+static char     CgroupDir[PATH_MAX/2];
+static char     CgroupHome[PATH_MAX/2];
+static int      CgroupFD = -1;
+static int      CgroupLock = -1;
+static CPU_STAT CgroupStart;
+static char    *CgroupCtls[3] = { "cpu", "cpuset", "memory" };
+
+
+/*
+ * If any cgroup limits were requested, create a cgroup v2 child with them and
+ * move ourselves into it.  A cgroup with controllers enabled for its children
+ * may not itself contain processes, so ours is created next to the cgroup we
+ * are in, under its parent, or under the one given by --cgroup_dir, which
+ * might be a subtree delegated to us.  Any threads we start later are created
+ * in it.  Cgroups left behind by a qperf that was killed are removed first.
+ */
+void
+cgroup_enter(void)
+{
+    char *p;
+    char mnt[PATH_MAX/8];
+    char self[PATH_MAX/8];
+    char path[PATH_MAX];
+    char buf[STRSIZE];
+    static int registered;
+
+    if (!Req.cgroup_cpu[0] && !Req.cgroup_cpuset[0] && !Req.cgroup_mem[0])
+        return;
+    if (!cgroup_mount(mnt, sizeof(mnt)))
+        error(0, "cannot find a cgroup v2 hierarchy");
+    if (!cgroup_self(self, sizeof(self)))
+        error(0, "cannot find our cgroup");
+    snprintf(CgroupHome, sizeof(CgroupHome), "%s%s", mnt, self);
+    if (CgroupParent)
+        snprintf(CgroupBase, sizeof(CgroupBase), "%s%s%s", mnt,
+                            CgroupParent[0] == '/' ? "" : "/", CgroupParent);
+    else {
+        if ((p = strrchr(self, '/')) != 0)
+            *p = '\0';
+        snprintf(CgroupBase, sizeof(CgroupBase), "%s%s", mnt, self);
+    }
+    cgroup_lock();
+    cgroup_others();
+    snprintf(CgroupDir, sizeof(CgroupDir), "%s/qperf.%d", CgroupBase, getpid());
+    if (mkdir(CgroupDir, 0755) < 0 && errno != EEXIST) {
+        CgroupDir[0] = '\0';
+        error(SYS, "failed to create cgroup qperf.%d in %s; try --cgroup_dir",
+                                                        getpid(), CgroupBase);
+    }
+    if (!registered++)
+        atexit(cgroup_leave);
+
+    cgroup_controllers();
+    cgroup_unlock();
+    if (Req.cgroup_cpuset[0])
+        cgroup_write("cpuset.cpus", Req.cgroup_cpuset);
+    if (Req.cgroup_cpu[0]) {
+        snprintf(buf, sizeof(buf), "%s", Req.cgroup_cpu);
+        if ((p = strchr(buf, '/')) != 0)
+            *p = ' ';
+        cgroup_write("cpu.max", buf);
+    }
+    if (Req.cgroup_mem[0])
+        cgroup_write("memory.max", Req.cgroup_mem);
+    snprintf(buf, sizeof(buf), "%d", getpid());
+    cgroup_write("cgroup.procs", buf);
+
+    snprintf(path, sizeof(path), "%s/cpu.stat", CgroupDir);
+    CgroupFD = open(path, O_RDONLY);
+    debug("running in cgroup %s", CgroupDir);
+}
+
+
+/*
+ * Move back to the cgroup we came from and remove the one we created.  If no
+ * other qperf is left in the parent, the controllers that any qperf enabled
+ * there are disabled again; those that were already on are left as found.
+ */
+void
+cgroup_leave(void)
+{
+    int i;
+    char buf[PATH_MAX];
+    char pid[32];
+
+    if (!CgroupDir[0]) {
+        cgroup_unlock();
+        return;
+    }
+    cgroup_lock();
+    if (CgroupFD >= 0) {
+        close(CgroupFD);
+        CgroupFD = -1;
+    }
+    snprintf(buf, sizeof(buf), "%s/cgroup.procs", CgroupHome);
+    snprintf(pid, sizeof(pid), "%d", getpid());
+    file_write(buf, pid);
+    if (rmdir(CgroupDir) < 0)
+        debug("failed to remove cgroup %s: %s", CgroupDir, strerror(errno));
+    CgroupDir[0] = '\0';
+
+    if (cgroup_others()) {
+        cgroup_unlock();
+        return;
+    }
+    for (i = 0; i < cardof(CgroupCtls); ++i) {
+        char ctl[32];
+        char mark[PATH_MAX];
+
+        snprintf(mark, sizeof(mark), "%s/qperf.%s", CgroupBase, CgroupCtls[i]);
+        if (rmdir(mark) < 0)
+            continue;
+        snprintf(buf, sizeof(buf), "%s/cgroup.subtree_control", CgroupBase);
+        snprintf(ctl, sizeof(ctl), "-%s", CgroupCtls[i]);
+        if (!file_write(buf, ctl))
+            debug("failed to disable %s controller in %s: %s",
+                                CgroupCtls[i], CgroupBase, strerror(errno));
+    }
+    cgroup_unlock();
+}
+
+
+/*
+ * Enable the controllers we need for the children of the parent cgroup.  For
+ * each one that was not already on, we create an empty cgroup qperf.<name> in
+ * the parent as a marker.  The markers outlive us, so whichever qperf leaves
+ * last knows which controllers were enabled by a qperf rather than found on,
+ * even if the one that enabled them left first.
+ */
+static void
+cgroup_controllers(void)
+{
+    int i;
+    int n = 0;
+    int fd;
+    char ctl[PATH_MAX];
+    char buf[STRSIZE];
+    char have[STRSIZE+2] = " ";
+    char *want[3] = {
+        Req.cgroup_cpu[0]    ? CgroupCtls[0] : 0,
+        Req.cgroup_cpuset[0] ? CgroupCtls[1] : 0,
+        Req.cgroup_mem[0]    ? CgroupCtls[2] : 0,
+    };
+
+    snprintf(ctl, sizeof(ctl), "%s/cgroup.subtree_control", CgroupBase);
+    fd = open(ctl, O_RDONLY);
+    if (fd >= 0) {
+        n = read(fd, buf, sizeof(buf)-1);
+        close(fd);
+    }
+    if (n < 0)
+        n = 0;
+    buf[n] = '\0';
+    buf[strcspn(buf, "\n")] = '\0';
+    strcat(strcat(have, buf), " ");
+
+    for (i = 0; i < cardof(want); ++i) {
+        char name[32];
+        char add[32];
+        char mark[PATH_MAX];
+
+        if (!want[i])
+            continue;
+        snprintf(name, sizeof(name), " %s ", want[i]);
+        if (strstr(have, name))
+            continue;
+        snprintf(add, sizeof(add), "+%s", want[i]);
+        if (!file_write(ctl, add))
+            error(SYS, "failed to enable %s controller in %s", want[i],
+                                                                CgroupBase);
+        snprintf(mark, sizeof(mark), "%s/qperf.%s", CgroupBase, want[i]);
+        if (mkdir(mark, 0755) < 0 && errno != EEXIST)
+            debug("failed to create cgroup %s: %s", mark, strerror(errno));
+    }
+}
+
+
+/*
+ * Serialize against other qperfs entering or leaving the same parent so that
+ * one cannot disable a controller just as another finds it on and relies on
+ * it.  The lock is dropped when we exit, even if we die holding it.
+ */
+static void
+cgroup_lock(void)
+{
+    if (CgroupLock >= 0)
+        return;
+    CgroupLock = open(CgroupBase, O_RDONLY | O_DIRECTORY);
+    if (CgroupLock < 0)
+        return;
+    if (flock(CgroupLock, LOCK_EX) < 0) {
+        debug("failed to lock %s: %s", CgroupBase, strerror(errno));
+        cgroup_unlock();
+    }
+}
+
+
+/*
+ * Release the lock on the parent cgroup.
+ */
+static void
+cgroup_unlock(void)
+{
+    if (CgroupLock < 0)
+        return;
+    close(CgroupLock);
+    CgroupLock = -1;
+}
+
+
+/*
+ * Remove the cgroups of qperfs that no longer exist from the parent and
+ * return how many other qperfs have one there.  A qperf killed with SIGKILL,
+ * such as a prefork worker whose server died, cannot remove its own.  Only
+ * empty cgroups can be removed, so we never remove one that is in use.
+ */
+static int
+cgroup_others(void)
+{
+    int n = 0;
+    struct dirent *d;
+    DIR *dir = opendir(CgroupBase);
+
+    if (!dir)
+        return 0;
+    while ((d = readdir(dir)) != 0) {
+        char path[PATH_MAX];
+        int pid;
+
+        if (sscanf(d->d_name, "qperf.%d", &pid) != 1 || pid == getpid())
+            continue;
+        snprintf(path, sizeof(path), "%s/%s", CgroupBase, d->d_name);
+        if (kill(pid, 0) < 0 && errno == ESRCH && rmdir(path) == 0)
+            debug("removed stale cgroup %s", path);
+        else
+            ++n;
+    }
+    closedir(dir);
+    return n;
+}
+
+
+/*
+ * Note the throttling counters at the start of the test.
+ */
+void
+cgroup_start(void)
+{
+    if (!cgroup_read(&CgroupStart))
+        memset(&CgroupStart, 0, sizeof(CgroupStart));
+}
+
+
+/*
+ * Note how much we were throttled during the test.  This is called from
+ * set_finished and so may be in a signal handler.
+ */
+void
+cgroup_stop(void)
+{
+    CPU_STAT cs;
+
+    if (!cgroup_read(&cs))
+        return;
+    LStat.cg_periods = cs.periods - CgroupStart.periods;
+    LStat.cg_throttled = cs.throttled - CgroupStart.throttled;
+    LStat.cg_throttled_us = cs.throttled_us - CgroupStart.throttled_us;
+}
+
+
+/*
+ * Read the throttling counters of our cgroup.  Return 1 on success.
+ */
+static int
+cgroup_read(CPU_STAT *cs)
+{
+    char buf[512];
+    int n;
+
+    if (CgroupFD < 0)
+        return 0;
+    n = pread(CgroupFD, buf, sizeof(buf)-1, 0);
+    if (n <= 0)
+        return 0;
+    buf[n] = '\0';
+    cs->periods = stat_field(buf, "nr_periods");
+    cs->throttled = stat_field(buf, "nr_throttled");
+    cs->throttled_us = stat_field(buf, "throttled_usec");
+    return 1;
+}
+
+
+/*
+ * Find where the cgroup v2 hierarchy is mounted.  Return 1 on success.
+ */
+static int
+cgroup_mount(char *path, int len)
+{
+    struct mntent *m;
+    int found = 0;
+    FILE *fp = setmntent("/proc/self/mounts", "r");
+
+    if (!fp)
+        return 0;
+    while (!found && (m = getmntent(fp)) != 0) {
+        if (streq(m->mnt_type, "cgroup2")) {
+            snprintf(path, len, "%s", m->mnt_dir);
+            found = 1;
+        }
+    }
+    endmntent(fp);
+    return found;
+}
+
+
+/*
+ * Find the cgroup v2 path we are in relative to the top of the hierarchy.
+ * Return 1 on success and 0 if it cannot be found or does not fit.
+ */
+static int
+cgroup_self(char *path, int len)
+{
+    char line[PATH_MAX/4];
+    int found = 0;
+    FILE *fp = fopen("/proc/self/cgroup", "r");
+
+    if (!fp)
+        return 0;
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, "0::", 3) != 0)
+            continue;
+        line[strcspn(line, "\n")] = '\0';
+        found = snprintf(path, len, "%s",
+                         streq(&line[3], "/") ? "" : &line[3]) < len;
+        break;
+    }
+    fclose(fp);
+    return found;
+}
+
+
+/*
+ * Write a value to a control file of our cgroup.
+ */
+static void
+cgroup_write(char *file, char *value)
+{
+    char path[PATH_MAX];
+
+    snprintf(path, sizeof(path), "%s/%s", CgroupDir, file);
+    if (!file_write(path, value))
+        error(SYS, "failed to set %s of cgroup to %s", file, value);
+}
+
+
+/*
+ * Write a value to a file.  Return 1 on success.
+ */
+static int
+file_write(char *path, char *value)
+{
+    int n;
+    int len = strlen(value);
+    int fd = open(path, O_WRONLY);
+
+    if (fd < 0)
+        return 0;
+    n = write(fd, value, len);
+    close(fd);
+    return n == len;
+}
+
+
+/*
+ * Return the value of a field in the contents of a flat keyed file such as
+ * cpu.stat or 0 if it is not there.
+ */
+static uint64_t
+stat_field(char *buf, char *name)
+{
+    int n = strlen(name);
+    char *p = buf;
+
+    while (p) {
+        if (strncmp(p, name, n) == 0 && p[n] == ' ')
+            return strtoull(&p[n+1], 0, 10);
+        p = strchr(p, '\n');
+        if (p)
+            ++p;
+    }
+    return 0;
+}
@@ -0,0 +1,281 @@
+/*
+ * qperf - compress messages.
+ * Measure socket and RDMA performance.
+ *
+ * Copyright (c) 2002-2009 Johann George.  All rights reserved.
+ * Copyright (c) 2006-2009 QLogic Corporation.  All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#define _GNU_SOURCE
+#include <string.h>
+#ifdef HAVE_LIBLZ4
+#include <lz4.h>
+#endif
+#ifdef HAVE_LIBZSTD
+#include <zstd.h>
+#endif
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+#include "qperf.h"
+
+
+/*
+ * Configurable parameters.
+ */
+#define FILL_BLOCK  256                 /* Block of the compressible payload */
+
+
+/*
+ * Compression algorithms.
+ */
+typedef enum {
+    C_NONE,
+    C_LZ4,
+    C_ZSTD,
+    C_ZLIB
+} CODEC;
+
+
+/*
+ * Static variables.
+ */
+static CODEC      Codec;
+#ifdef HAVE_LIBZSTD
+static ZSTD_CCtx *ZstdC;
+static ZSTD_DCtx *ZstdD;
+#endif
+#ifdef HAVE_LIBZ
+static z_stream   ZlibC;
+static z_stream   ZlibD;
+#endif
+
+
+/*
+ * Set up the algorithm requested with --compress, making sure that we were
+ * built with it.  Contexts are set up once so that compressing a message does
+ * not allocate memory.
+ */
+void
+compress_init(void)
+{
+    char *alg = Req.compress;
+
+    Codec = C_NONE;
+    if (!alg[0])
+        return;
+    if (Req.compress_pct > 100)
+        error(0, "compressibility must be at most 100 percent");
+    if (streq(alg, "lz4")) {
+#ifdef HAVE_LIBLZ4
+        Codec = C_LZ4;
+#endif
+    } else if (streq(alg, "zstd")) {
+#ifdef HAVE_LIBZSTD
+        ZstdC = ZSTD_createCCtx();
+        ZstdD = ZSTD_createDCtx();
+        if (!ZstdC || !ZstdD)
+            error(0, "failed to create zstd contexts");
+        Codec = C_ZSTD;
+#endif
+    } else if (streq(alg, "zlib")) {
+#ifdef HAVE_LIBZ
+        int level = Req.compress_level ? Req.compress_level
+                                       : Z_DEFAULT_COMPRESSION;
+
+        memset(&ZlibC, 0, sizeof(ZlibC));
+        memset(&ZlibD, 0, sizeof(ZlibD));
+        if (deflateInit(&ZlibC, level) != Z_OK || inflateInit(&ZlibD) != Z_OK)
+            error(0, "failed to initialize zlib");
+        Codec = C_ZLIB;
+#endif
+    } else
+        error(0, "compression must be lz4, zstd or zlib: %s given", alg);
+    if (Codec == C_NONE)
+        error(0, "qperf was built without %s", alg);
+}
+
+
+/*
+ * Free the compression contexts.
+ */
+void
+compress_end(void)
+{
+#ifdef HAVE_LIBZSTD
+    if (Codec == C_ZSTD) {
+        ZSTD_freeCCtx(ZstdC);
+        ZSTD_freeDCtx(ZstdD);
+    }
+#endif
+#ifdef HAVE_LIBZ
+    if (Codec == C_ZLIB) {
+        deflateEnd(&ZlibC);
+        inflateEnd(&ZlibD);
+    }
+#endif
+    Codec = C_NONE;
+}
+
+
+/*
+ * Return the largest a message of len bytes can be after compression.
+ */
+int
+compress_bound(int len)
+{
+    switch (Codec) {
+#ifdef HAVE_LIBLZ4
+    case C_LZ4:
+        return LZ4_compressBound(len);
+#endif
+#ifdef HAVE_LIBZSTD
+    case C_ZSTD:
+        return ZSTD_compressBound(len);
+#endif
+#ifdef HAVE_LIBZ
+    case C_ZLIB:
+        return deflateBound(&ZlibC, len);
+#endif
+    default:
+        return len;
+    }
+}
+
+
+/*
+ * Compress len bytes from src into dst which holds dlen bytes.  Return the
+ * compressed size or -1 on failure.  For lz4, the level is the acceleration.
+ */
+int
+compress_data(void *dst, int dlen, void *src, int len)
+{
+    switch (Codec) {
+#ifdef HAVE_LIBLZ4
+    case C_LZ4: {
+        int n = LZ4_compress_fast(src, dst, len, dlen,
+                                  Req.compress_level ? Req.compress_level : 1);
+
+        return n > 0 ? n : -1;
+    }
+#endif
+#ifdef HAVE_LIBZSTD
+    case C_ZSTD: {
+        size_t n = ZSTD_compressCCtx(ZstdC, dst, dlen, src, len,
+                                     Req.compress_level);
+
+        return ZSTD_isError(n) ? -1 : (int)n;
+    }
+#endif
+#ifdef HAVE_LIBZ
+    case C_ZLIB: {
+        int n;
+
+        ZlibC.next_in = src;
+        ZlibC.avail_in = len;
+        ZlibC.next_out = dst;
+        ZlibC.avail_out = dlen;
+        n = deflate(&ZlibC, Z_FINISH) == Z_STREAM_END ? dlen-ZlibC.avail_out
+                                                      : -1;
+        deflateReset(&ZlibC);
+        return n;
+    }
+#endif
+    default:
+        return -1;
+    }
+}
+
+
+/*
+ * Decompress len bytes from src into dst which holds dlen bytes.  Return the
+ * decompressed size or -1 on failure.
+ */
+int
+decompress_data(void *dst, int dlen, void *src, int len)
+{
+    switch (Codec) {
+#ifdef HAVE_LIBLZ4
+    case C_LZ4: {
+        int n = LZ4_decompress_safe(src, dst, len, dlen);
+
+        return n >= 0 ? n : -1;
+    }
+#endif
+#ifdef HAVE_LIBZSTD
+    case C_ZSTD: {
+        size_t n = ZSTD_decompressDCtx(ZstdD, dst, dlen, src, len);
+
+        return ZSTD_isError(n) ? -1 : (int)n;
+    }
+#endif
+#ifdef HAVE_LIBZ
+    case C_ZLIB: {
+        int n;
+
+        ZlibD.next_in = src;
+        ZlibD.avail_in = len;
+        ZlibD.next_out = dst;
+        ZlibD.avail_out = dlen;
+        n = inflate(&ZlibD, Z_FINISH) == Z_STREAM_END ? dlen-ZlibD.avail_out
+                                                      : -1;
+        inflateReset(&ZlibD);
+        return n;
+    }
+#endif
+    default:
+        return -1;
+    }
+}
+
+
+/*
+ * Fill a buffer with data that an ideal compressor could shrink by
+ * --compress_pct percent.  That percentage of each block is zeros and the
+ * rest is pseudo random.
+ */
+void
+compress_fill(void *buf, int len)
+{
+    int i;
+    uint8_t *p = buf;
+    uint64_t x = 0x9E3779B97F4A7C15ULL;
+    int random = FILL_BLOCK * (100 - Req.compress_pct) / 100;
+
+    for (i = 0; i < len; ++i) {
+        if (i % FILL_BLOCK < random) {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            p[i] = x;
+        } else
+            p[i] = 0;
+    }
+}
@@ -0,0 +1,498 @@
+/*
+ * qperf - fault injection.
+ * Measure socket and RDMA performance.
+ *
+ * Copyright (c) 2002-2009 Johann George.  All rights reserved.
+ * Copyright (c) 2006-2009 QLogic Corporation.  All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/wait.h>
+#include "qperf.h"
+
+
+/*
+ * Configurable parameters.
+ */
+#define FAULT_TICK  1000000             /* Nanoseconds between checks */
+#define FAULT_WIN   10                  /* Ticks over which rate is taken */
+#define FAULT_PCNT  90                  /* Percent of rate that is recovery */
+
+
+/*
+ * Function prototypes.
+ */
+static void     fault_clear(void);
+static int      fault_inject(int on);
+static void     fault_killed(void);
+static void    *fault_monitor(void *arg);
+static uint64_t fault_progress(void);
+static void     fault_signal(int signo);
+static void     if_check(void);
+static void     qdisc_check(void);
+static int      tc_netem(int on);
+static int      tc_run(char **argv, char *out, int len);
+static uint64_t tcp_retrans(void);
+
+
+/*
+ * Global variables.
+ */
+long        FaultAt = -1;
+long        FaultLen;
+long        FaultLoss = 100;
+char       *FaultDev;
+char       *FaultKind;
+FAULT_RES   FaultRes;
+
+
+/*
+ * Static variables.
+ */
+static char      FaultIf[STRSIZE];
+static int       FaultMigrate;
+static long      FaultWhen;
+static pthread_t FaultThread;
+static uint64_t  FaultRetrans;
+static int       FaultFDs[RAILS_MAX];
+static int       FaultFDN;
+static volatile int FaultNetem;
+static volatile sig_atomic_t FaultSig;
+static struct sigaction FaultOldAct[3];
+static int       FaultSigs[3] = { SIGHUP, SIGINT, SIGTERM };
+
+
+/*
+ * Start watching the test and arrange for the fault to be injected.  We only
+ * inject faults on the client.  By default, the fault is in the middle of the
+ * test.  A path migration is instantaneous and so needs no length.  A loss
+ * fault replaces the root queueing discipline of the interface, so it must be
+ * named with --fault_dev and may only have the default one, which deleting
+ * ours brings back.  Should we exit or be killed by a signal while the fault
+ * is in place, we remove it first.  The signal handler only notes the signal;
+ * the monitor or fault_stop removes the fault and then lets it take its
+ * course.
+ */
+void
+fault_start(void)
+{
+    int i;
+    sigset_t all;
+    sigset_t old;
+    static int registered;
+
+    memset(&FaultRes, 0, sizeof(FaultRes));
+    FaultMigrate = FaultKind && streq(FaultKind, "migrate");
+    if ((!FaultLen && !FaultMigrate) || !is_client())
+        return;
+    FaultWhen = FaultAt;
+    if (FaultWhen < 0)
+        FaultWhen = (Req.time * 1000L - FaultLen) / 2;
+    if (FaultWhen + FaultLen >= Req.time * 1000L)
+        error(0, "fault must end before the test does");
+    if (!FaultMigrate) {
+        if (FaultLoss < 1 || FaultLoss > 100)
+            error(0, "fault loss must be between 1 and 100 percent");
+        if (!FaultDev)
+            error(0, "a loss fault needs --fault_dev; "
+                     "use an interface only the test uses such as a veth");
+        snprintf(FaultIf, sizeof(FaultIf), "%s", FaultDev);
+        if_check();
+        qdisc_check();
+        if (!registered) {
+            atexit(fault_clear);
+            registered = 1;
+        }
+        FaultSig = 0;
+        for (i = 0; i < cardof(FaultSigs); ++i) {
+            struct sigaction act ={ .sa_handler = fault_signal };
+
+            sigaction(FaultSigs[i], 0, &FaultOldAct[i]);
+            if (FaultOldAct[i].sa_handler != SIG_IGN)
+                sigaction(FaultSigs[i], &act, 0);
+        }
+    }
+
+    FaultRes.on = 1;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+    errno = pthread_create(&FaultThread, 0, fault_monitor, 0);
+    pthread_sigmask(SIG_SETMASK, &old, 0);
+    if (errno)
+        error(SYS, "failed to create fault thread");
+}
+
+
+/*
+ * Stop watching the test and make sure the fault is gone.
+ */
+void
+fault_stop(void)
+{
+    int i;
+
+    if (!FaultRes.on)
+        return;
+    fault_clear();
+    if (!FaultMigrate) {
+        if (FaultSig)
+            fault_killed();
+        for (i = 0; i < cardof(FaultSigs); ++i)
+            sigaction(FaultSigs[i], &FaultOldAct[i], 0);
+    }
+    if (FaultRes.state < 0) {
+        if (FaultMigrate)
+            error(RET, "failed to migrate path; "
+                       "use --alt_port with an RC or UC test");
+        else
+            error(RET, "failed to inject fault on %s", FaultIf);
+    }
+    FaultRes.retrans = tcp_retrans() - FaultRetrans;
+    FaultRes.errors = LStat.s.no_errs + LStat.r.no_errs;
+    FaultFDN = 0;
+}
+
+
+/*
+ * Note the TCP sockets of the test whose retransmissions are counted.
+ */
+void
+fault_sockets(int *fds, int n)
+{
+    if (n > RAILS_MAX)
+        n = RAILS_MAX;
+    memcpy(FaultFDs, fds, n * sizeof(*fds));
+    FaultFDN = n;
+}
+
+
+/*
+ * Stop the monitor and remove the fault if it is in place.  Besides
+ * fault_stop, this is called when we exit.
+ */
+static void
+fault_clear(void)
+{
+    if (FaultRes.on) {
+        FaultRes.on = 0;
+        pthread_join(FaultThread, 0);
+    }
+    if (FaultNetem)
+        tc_netem(0);
+}
+
+
+/*
+ * We were sent a signal that would kill us while we might have a fault in
+ * place.  Removing it is not safe in a signal handler, so we just note the
+ * signal for the monitor, which checks every tick, or fault_stop.
+ */
+static void
+fault_signal(int signo)
+{
+    FaultSig = signo;
+}
+
+
+/*
+ * Remove the fault after fault_signal noted a signal and then send the
+ * signal again with the action it had before we started, letting it take its
+ * course.
+ */
+static void
+fault_killed(void)
+{
+    int i;
+    int signo = FaultSig;
+
+    if (FaultNetem)
+        tc_netem(0);
+    for (i = 0; i < cardof(FaultSigs); ++i)
+        sigaction(FaultSigs[i], &FaultOldAct[i], 0);
+    FaultSig = 0;
+    kill(getpid(), signo);
+}
+
+
+/*
+ * Watch the progress of the test, injecting and removing the fault when it is
+ * time.  Recovery is when the rate over the last few ticks gets back to 90%
+ * of the rate before the fault.  The longest time without progress from the
+ * start of the fault to recovery bounds the worst latency seen.
+ */
+static void *
+fault_monitor(void *arg)
+{
+    int n = 0;
+    uint64_t win[FAULT_WIN];
+    uint64_t start = get_nsecs();
+    uint64_t at = start + FaultWhen * 1000000ULL;
+    uint64_t end = at + FaultLen * 1000000ULL;
+    uint64_t last = fault_progress();
+    uint64_t moved = start;
+    double base = 0;
+    struct timespec tick ={ 0, FAULT_TICK };
+
+    FaultRetrans = tcp_retrans();
+    while (FaultRes.on && !Finished) {
+        uint64_t now;
+        uint64_t prog;
+
+        nanosleep(&tick, 0);
+        if (FaultSig) {
+            fault_killed();
+            break;
+        }
+        now = get_nsecs();
+        prog = fault_progress();
+        if (prog != last) {
+            if (FaultRes.state >= 1 && !FaultRes.recovered &&
+                now - moved > FaultRes.stall)
+                FaultRes.stall = now - moved;
+            last = prog;
+            moved = now;
+        }
+        win[n++ % FAULT_WIN] = prog;
+
+        if (FaultRes.state == 0 && now >= at) {
+            base = (double)prog / (now - start);
+            moved = now;
+            FaultRes.at = test_nsecs();
+            FaultRes.state = fault_inject(1) ? 1 : -1;
+            debug("fault injected");
+        } else if (FaultRes.state == 1 && now >= end) {
+            fault_inject(0);
+            FaultRes.state = 2;
+            n = 0;
+            debug("fault removed");
+        } else if (FaultRes.state == 2 && !FaultRes.recovered &&
+                   n >= FAULT_WIN) {
+            double rate = (double)(prog - win[n % FAULT_WIN]) /
+                                  ((FAULT_WIN-1) * FAULT_TICK);
+
+            if (rate * 100 >= base * FAULT_PCNT) {
+                FaultRes.recovered = 1;
+                FaultRes.recovery = now - end;
+            }
+        }
+    }
+    if (FaultRes.state >= 1 && !FaultRes.recovered &&
+        get_nsecs() - moved > FaultRes.stall)
+        FaultRes.stall = get_nsecs() - moved;
+    return 0;
+}
+
+
+/*
+ * Inject the fault or remove it.  Return 1 on success.  Removing a path
+ * migration is a no-op; the path stays migrated.
+ */
+static int
+fault_inject(int on)
+{
+    if (!FaultMigrate)
+        return tc_netem(on);
+    if (!on)
+        return 1;
+#ifdef RDMA
+    return rd_migrate();
+#else
+    return 0;
+#endif
+}
+
+
+/*
+ * Return how far the test has got: the bytes we have sent and received.
+ */
+static uint64_t
+fault_progress(void)
+{
+    return __atomic_load_n(&LStat.s.no_bytes, __ATOMIC_RELAXED) +
+           __atomic_load_n(&LStat.r.no_bytes, __ATOMIC_RELAXED);
+}
+
+
+/*
+ * Make sure that FaultIf names an interface.  It is handed to tc, so we also
+ * insist that it is made only of the characters interface names use.
+ */
+static void
+if_check(void)
+{
+    char *p;
+
+    for (p = FaultIf; *p; ++p)
+        if (!isalnum((unsigned char)*p) && !strchr("_.:-", *p))
+            error(0, "bad interface name: %s", FaultIf);
+    if (FaultIf[0] == '-' || !if_nametoindex(FaultIf))
+        error(0, "no such interface: %s", FaultIf);
+}
+
+
+/*
+ * Make sure that the interface only has the queueing discipline the kernel
+ * gave it, whose handle is 0.  One that was set up by hand would be lost when
+ * we replace it.
+ */
+static void
+qdisc_check(void)
+{
+    int n = 0;
+    char kind[32];
+    char handle[32];
+    char line[256];
+    char *argv[] ={ "tc", "qdisc", "show", "dev", FaultIf, "root", 0 };
+
+    tc_run(argv, line, sizeof(line));
+    if (line[0])
+        n = sscanf(line, "qdisc %31s %31s", kind, handle);
+    if (n != 2)
+        error(0, "cannot get queueing discipline of %s", FaultIf);
+    if (!streq(handle, "0:"))
+        error(0, "%s has a %s queueing discipline that a fault would replace",
+                                                            FaultIf, kind);
+}
+
+
+/*
+ * Put a netem queueing discipline that drops packets on the interface or
+ * remove it, bringing back the default one.  Return 1 on success.  FaultNetem
+ * is set before the netem is added so that a signal arriving while tc runs
+ * still removes it.
+ */
+static int
+tc_netem(int on)
+{
+    int ok;
+    char loss[32];
+    char *add[] ={
+        "tc", "qdisc", "replace", "dev", FaultIf, "root", "netem", "loss",
+        loss, 0
+    };
+    char *del[] ={ "tc", "qdisc", "del", "dev", FaultIf, "root", 0 };
+
+    snprintf(loss, sizeof(loss), "%ld%%", FaultLoss);
+    if (on)
+        FaultNetem = 1;
+    ok = tc_run(on ? add : del, 0, 0);
+    if ((on && !ok) || (!on && ok))
+        FaultNetem = 0;
+    return ok;
+}
+
+
+/*
+ * Run tc with the arguments in argv, without a shell so that nothing in them
+ * is interpreted.  If out is given, the first line tc prints is put there.
+ * Return 1 if tc succeeded.
+ */
+static int
+tc_run(char **argv, char *out, int len)
+{
+    int fds[2];
+    int status;
+    pid_t pid;
+
+    if (out) {
+        out[0] = '\0';
+        if (pipe(fds) < 0)
+            return 0;
+    }
+    pid = fork();
+    if (pid == 0) {
+        int null = open("/dev/null", O_RDWR);
+
+        dup2(out ? fds[1] : null, 1);
+        dup2(null, 2);
+        if (out) {
+            close(fds[0]);
+            close(fds[1]);
+        }
+        execvp(argv[0], argv);
+        _exit(127);
+    }
+    if (out) {
+        FILE *fp;
+        char line[256];
+
+        close(fds[1]);
+        fp = fdopen(fds[0], "r");
+        if (!fp)
+            close(fds[0]);
+        else {
+            if (!fgets(out, len, fp))
+                out[0] = '\0';
+            while (fgets(line, sizeof(line), fp))
+                ;
+            fclose(fp);
+        }
+    }
+    if (pid < 0)
+        return 0;
+    while (waitpid(pid, &status, 0) < 0)
+        if (errno != EINTR)
+            return 0;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+
+/*
+ * Return the number of segments the TCP sockets of the test have
+ * retransmitted.
+ */
+static uint64_t
+tcp_retrans(void)
+{
+    int i;
+    uint64_t n = 0;
+
+    for (i = 0; i < FaultFDN; ++i) {
+        struct tcp_info info;
+        socklen_t len = sizeof(info);
+
+        if (getsockopt(FaultFDs[i], IPPROTO_TCP, TCP_INFO, &info, &len) == 0)
+            n += info.tcpi_total_retrans;
+    }
+    return n;
+}
@@ -0,0 +1,1282 @@
+/*
+ * This was generated from help.txt.  Do not modify directly.
+ *
+ * Copyright (c) 2002-2009 Johann George.  All rights reserved.
+ * Copyright (c) 2006-2009 QLogic Corporation.  All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+char *Usage[] ={
+    "main",
+        "Synopsis\n"
+        "    qperf\n"
+        "    qperf SERVERNODE [OPTIONS] TESTS\n"
+        "\n"
+        "Description\n"
+        "    qperf measures bandwidth and latency between two nodes.  It can w"
+            "ork\n"
+        "    over TCP/IP as well as the RDMA transports.  On one of the nodes,"
+            " qperf\n"
+        "    is typically run with no arguments designating it the server node"
+            ".  One\n"
+        "    may then run qperf on a client node to obtain measurements such a"
+            "s\n"
+        "    bandwidth, latency and cpu utilization.\n"
+        "\n"
+        "    In its most basic form, qperf is run on one node in server mode b"
+            "y\n"
+        "    invoking it with no arguments.  On the other node, it is run with"
+            " two\n"
+        "    arguments: the name of the server node followed by the name of th"
+            "e\n"
+        "    test.  A list of tests can be found in the section, TESTS.  A var"
+            "iety\n"
+        "    of options may also be specified.\n"
+        "\n"
+        "    One can get more detailed information on qperf by using the --hel"
+            "p\n"
+        "    option.  Below are examples of using the --help option:\n"
+        "\n"
+        "        qperf --help examples       Some examples of using qperf\n"
+        "        qperf --help opts           Summary of options\n"
+        "        qperf --help options        Description of options\n"
+        "        qperf --help tests          Short summary and description of "
+            "tests\n"
+        "        qperf --help TESTNAME       More information on test TESTNAME"
+            "\n",
+    "author",
+        "Written by Johann George.\n",
+    "bugs",
+        "None of the RDMA tests are available if qperf is compiled without the"
+            " RDMA\n"
+        "libraries.  None of the XRC tests are available if qperf is compiled"
+            "\n"
+        "without the XRC extensions.  The -f option is not yet implemented in "
+            "many\n"
+        "of the tests.\n",
+    "categories",
+        "To get help on a particular category, you may type:\n"
+        "    qperf --help CATEGORY\n"
+        "where CATEGORY might be one of the following:\n"
+        "    categories          This current list being displayed\n"
+        "    examples            Some examples\n"
+        "    options             A long list of options\n"
+        "    opts                A short description of the options\n"
+        "    tests               A list and description of the various tests\n"
+        "or one of the following tests:\n"
+        "    conf\n"
+        "    quit\n"
+        "    rds_bw\n"
+        "    rds_lat\n"
+        "    sctp_bw\n"
+        "    sctp_lat\n"
+        "    sdp_bw\n"
+        "    sdp_lat\n"
+        "    tcp_bw\n"
+        "    tcp_lat\n"
+        "    tcp_qos\n"
+        "    udp_bw\n"
+        "    udp_lat\n"
+        "    xdp_bw\n"
+        "    xdp_lat\n",
+    "examples",
+        "In these examples, we first run qperf on a node called myserver in se"
+            "rver\n"
+        "mode by invoking it with no arguments.  In all the subsequent example"
+            "s, we\n"
+        "run qperf on another node and connect to the server which we assume h"
+            "as a\n"
+        "hostname of myserver.\n"
+        "    * To run a TCP bandwidth and latency test:\n"
+        "        qperf myserver tcp_bw tcp_lat\n"
+        "    * To run a SDP bandwidth test for 10 seconds:\n"
+        "        qperf myserver -t 10 sdp_bw\n"
+        "    * To run a UDP latency test and then cause the server to terminat"
+            "e:\n"
+        "        qperf myserver udp_lat quit\n"
+        "    * To measure the RDMA UD latency and bandwidth:\n"
+        "        qperf myserver ud_lat ud_bw\n"
+        "    * To measure RDMA UC bi-directional bandwidth:\n"
+        "        qperf myserver rc_bi_bw\n"
+        "    * To get a range of TCP latencies with a message size from 1 to 6"
+            "4K\n"
+        "        qperf myserver -oo msg_size:1:64K:*2 -vu tcp_lat\n",
+    "opts",
+        "--access_recv OnOff (-ar)           Turn on/off accessing received da"
+            "ta\n"
+        "  -ar1                              Cause received data to be accesse"
+            "d\n"
+        "--alt_port Port (-ap)               Set alternate path port\n"
+        "  --loc_alt_port Port (-lap)        Set local alternate path port\n"
+        "  --rem_alt_port Port (-rap)        Set remote alternate path port\n"
+        "--breakdown OnOff (-bd)             Break latency into stages\n"
+        "  -bd1                              Break latency into stages\n"
+        "--cgroup_cpu Max (-cgc)             Run in a cgroup with cpu.max Max"
+            "\n"
+        "  --loc_cgroup_cpu Max (-lcgc)      Set local cgroup cpu.max\n"
+        "  --rem_cgroup_cpu Max (-rcgc)      Set remote cgroup cpu.max\n"
+        "--cgroup_cpuset CPUs (-cgs)         Run in a cgroup limited to CPUs\n"
+        "  --loc_cgroup_cpuset CPUs (-lcgs)  Set local cgroup cpuset.cpus\n"
+        "  --rem_cgroup_cpuset CPUs (-rcgs)  Set remote cgroup cpuset.cpus\n"
+        "--cgroup_mem Size (-cgm)            Run in a cgroup with memory.max S"
+            "ize\n"
+        "  --loc_cgroup_mem Size (-lcgm)     Set local cgroup memory.max\n"
+        "  --rem_cgroup_mem Size (-rcgm)     Set remote cgroup memory.max\n"
+        "--cold_cache OnOff (-cc)            Flush caches before each message"
+            "\n"
+        "  -cc1                              Flush caches before each message"
+            "\n"
+        "--compress Alg (-z)                 Compress messages with Alg\n"
+        "--compress_level N (-zl)            Set compression level to N\n"
+        "--compress_pct Pct (-zp)            Make data sent Pct percent compre"
+            "ssible\n"
+        "--cpu_affinity PN (-ca)             Set processor affinity\n"
+        "  --loc_cpu_affinity PN (-lca)      Set local processor affinity\n"
+        "  --rem_cpu_affinity PN (-rca)      Set remote processor affinity\n"
+        "--fault_at Ms (-fa)                 Inject the fault Ms into the test"
+            "\n"
+        "--fault_dev Dev (-fd)               Inject the fault on interface Dev"
+            "\n"
+        "--fault_kind Kind (-fk)             Inject a loss or migrate fault\n"
+        "--fault_len Ms (-fl)                Drop packets for Ms during the te"
+            "st\n"
+        "--fault_loss Pct (-fp)              Drop Pct percent of packets in fa"
+            "ult\n"
+        "--flip OnOff (-f)                   Flip on/off sender and receiver\n"
+        "  -f1                               Flip (on) sender and receiver\n"
+        "--heatmap File (-hm)                Write latency heatmap to File\n"
+        "--heatmap_bin Ms (-hmb)             Set heatmap interval\n"
+        "--help Topic (-h)                   Get more information on a topic\n"
+        "--host Node (-H)                    Identify server node\n"
+        "--id Device:Port (-i)               Set RDMA device and port\n"
+        "  --loc_id Device:Port (-li)        Set local RDMA device and port\n"
+        "  --rem_id Device:Port (-ri)        Set remote RDMA device and port\n"
+        "--listen_port Port (-lp)            Set server listen port\n"
+        "--low_latency Level (-ll)           Apply a low latency profile\n"
+        "  --loc_low_latency Level (-lll)    Apply local low latency profile\n"
+        "  --rem_low_latency Level (-rll)    Apply remote low latency profile"
+            "\n"
+        "--loop Var:Init:Last:Incr (-oo)     Sequence through values\n"
+        "--msg_size Size (-m)                Set message size\n"
+        "--mtu_size Size (-mt)               Set MTU size (RDMA only)\n"
+        "--no_msgs Count (-n)                Send Count messages\n"
+        "--cq_poll OnOff                     Set polling mode on/off\n"
+        "  --loc_cq_poll OnOff (-lcp)        Set local polling mode on/off\n"
+        "  --rem_cq_poll OnOff (-rcp)        Set remote polling mode on/off\n"
+        "  -cp1                              Turn polling mode on\n"
+        "  -lcp1                             Turn local polling mode on\n"
+        "  -rcp1                             Turn remote polling mode on\n"
+        "--ip_port Port (-ip)                Set TCP port used for tests\n"
+        "--pipeline N (-pl)                  Hand received messages to N worke"
+            "rs\n"
+        "  --loc_pipeline N (-lpl)           Set local pipeline workers\n"
+        "  --rem_pipeline N (-rpl)           Set remote pipeline workers\n"
+        "--pipeline_mode Mode (-plm)         Set ring and wakeup of the pipeli"
+            "ne\n"
+        "--precision Digits (-e)             Set precision reported\n"
+        "--prefork N (-pf)                   Keep N server workers ready\n"
+        "--profile OnOff (-pr)               Sample call stacks during the tes"
+            "t\n"
+        "    --loc_profile OnOff (-lpr)      Sample call stacks on local node"
+            "\n"
+        "    --rem_profile OnOff (-rpr)      Sample call stacks on remote node"
+            "\n"
+        "  -pr1                              Turn profiling on\n"
+        "--profile_file File (-prf)          Write folded call stacks to File"
+            "\n"
+        "--qos_dscp DSCP (-qd)               Set DSCP of the QoS probe\n"
+        "--qos_priority Prio (-qp)           Set socket priority of the QoS pr"
+            "obe\n"
+        "--rails List (-rl)                  Stripe streams across rails in Li"
+            "st\n"
+        "--rd_atomic Max (-nr)               Set RDMA read/atomic count\n"
+        "    --loc_rd_atomic Max (-lnr)      Set local RDMA read/atomic count"
+            "\n"
+        "    --rem_rd_atomic Max (-rnr)      Set remote RDMA read/atomic count"
+            "\n"
+        "--sample_file File (-sf)            Record per message samples in Fil"
+            "e\n"
+        "--samples N (-sa)                   Record at most N samples per node"
+            "\n"
+        "  --loc_samples N (-lsa)            Record at most N local samples\n"
+        "  --rem_samples N (-rsa)            Record at most N remote samples\n"
+        "--service_dist Dist (-svd)          Set server service time distribut"
+            "ion\n"
+        "--service_file File (-svf)          Take server service times from Fi"
+            "le\n"
+        "--service_level SL (-sl)            Set service level\n"
+        "  --service_level SL (-lsl)         Set local service level\n"
+        "  --service_level SL (-rsl)         Set remote service level\n"
+        "--service_time Time (-svt)          Delay each server reply by Time\n"
+        "--service_touch Size (-svm)         Touch Size bytes per server reply"
+            "\n"
+        "--sock_buf_size Size (-sb)          Set socket buffer size\n"
+        "  --loc_sock_buf_size Size (-lsb)   Set local socket buffer size\n"
+        "  --rem_sock_buf_size Size (-rsb)   Set remote socket buffer size\n"
+        "--src_path_bits num (-sp)           Set source path bits\n"
+        "  --loc_src_path_bits num (-lsp)    Set local source path bits\n"
+        "  --rem_src_path_bits num (-rsp)    Set remote source path bits\n"
+        "--static_rate (-sr)                 Set IB static rate\n"
+        "  --loc_static_rate (-lsr)          Set local IB static rate\n"
+        "  --rem_static_rate (-rsr)          Set remote IB static rate\n"
+        "--time Time (-t)                    Set test duration\n"
+        "--timeout Time (-to)                Set timeout\n"
+        "  --loc_timeout Time (-lto)         Set local timeout\n"
+        "  --rem_timeout Time (-rto)         Set remote timeout\n"
+        "--ud_cqs N (-uc)                    Wait on N UD CQs with epoll\n"
+        "--ud_dests N (-ud)                  Send UD messages to N destination"
+            "s\n"
+        "--ud_random OnOff (-ur)             Pick UD destinations at random\n"
+        "  -ur1                              Pick UD destinations at random\n"
+        "--unify_nodes (-un)                 Unify nodes\n"
+        "--unify_units (-uu)                 Unify units\n"
+        "--use_bits_per_sec (-ub)            Use bits/sec rather than bytes/se"
+            "c\n"
+        "--use_cm OnOff (-cm)                Use RDMA Connection Manager or no"
+            "t\n"
+        "  -cm1                              Use RDMA Connection Manager\n"
+        "--verbose (-v)                      Verbose; turn on all of -v[cstu]"
+            "\n"
+        "  --verbose_conf (-vc)              Show configuration information\n"
+        "  --verbose_stat (-vs)              Show statistical information\n"
+        "  --verbose_time (-vt)              Show timing information\n"
+        "  --verbose_used (-vu)              Show information on parameters\n"
+        "  --verbose_more (-vv)              More verbose; turn on all of -v[C"
+            "STU]\n"
+        "  --verbose_more_conf (-vvc)        Show more configuration informati"
+            "on\n"
+        "  --verbose_more_stat (-vvs)        Show more statistical information"
+            "\n"
+        "  --verbose_more_time (-vvt)        Show more timing information\n"
+        "  --verbose_more_used (-vvu)        Show more information on paramete"
+            "rs\n"
+        "--version (-V)                      Print out version\n"
+        "--wait_server Time (-ws)            Set time to wait for server\n"
+        "--xdp_mode Mode (-xm)               Use AF_XDP in skb, copy or zc mod"
+            "e\n"
+        "  --loc_xdp_mode Mode (-lxm)        Set local AF_XDP mode\n"
+        "  --rem_xdp_mode Mode (-rxm)        Set remote AF_XDP mode\n"
+        "--zerocopy_recv OnOff (-zr)         Map received TCP pages or not\n"
+        "  -zr1                              Map received TCP pages\n",
+    "options",
+        "--access_recv OnOff (-ar)\n"
+        "      If OnOff is non-zero, data is accessed once received.  Otherwis"
+            "e,\n"
+        "      data is ignored.  By default, OnOff is 0.  This can help to mim"
+            "ic\n"
+        "      some applications.\n"
+        "  -ar1\n"
+        "      Cause received data to be accessed.\n"
+        "--alt_port Port (-ap)\n"
+        "      Set alternate path port. This enables automatic path failover."
+            "\n"
+        "  --loc_alt_port Port (-lap)\n"
+        "      Set local alternate path port. This enables automatic path fail"
+            "over.\n"
+        "  --rem_alt_port Port (-rap)\n"
+        "      Set remote alternate path port. This enables automatic path fai"
+            "lover.\n"
+        "--breakdown OnOff (-bd)\n"
+        "      In the tcp_lat and udp_lat tests, break the round trip of each"
+            "\n"
+        "      message into stages.  If qperf may open the kernel tracepoints "
+            "for\n"
+        "      system calls, packets and scheduling through perf, which normal"
+            "ly\n"
+        "      needs root and tracefs mounted, the stages on each node are the"
+            "\n"
+        "      time crossing into and out of the kernel (syscall), from the se"
+            "nd\n"
+        "      call to the packet being handed to the driver (send_stack), fro"
+            "m\n"
+        "      the packet being handed to the stack to the receive call return"
+            "ing\n"
+        "      less any wakeup (recv_stack) and from being woken to running\n"
+        "      (wakeup).  Otherwise kernel software timestamps are used, which"
+            "\n"
+        "      split the send side into the time to reach the queueing discipl"
+            "ine\n"
+        "      (send_stack) and from there to the driver (send_qdisc) and coun"
+            "t\n"
+        "      the wakeup in recv_stack.  For the server, the time to reply is"
+            "\n"
+        "      shown too.  What is left is shown as network and includes the\n"
+        "      drivers, loopback and the wire.  The mean of each stage is show"
+            "n;\n"
+        "      -vvt adds the median and 99th percentile.  Either way, reading "
+            "the\n"
+        "      stages adds work to each round trip.\n"
+        "  -bd1\n"
+        "      Break latency into stages.\n"
+        "--cgroup_cpu Max (-cgc)\n"
+        "      Run the test in a cgroup v2 child whose CPU quota, cpu.max, is "
+            "Max.\n"
+        "      Max is Quota/Period in microseconds, such as 50000/100000 for h"
+            "alf a\n"
+        "      processor, or max.  qperf creates the cgroup at the top of the"
+            "\n"
+        "      hierarchy, moves itself into it for the test and removes it\n"
+        "      afterwards, which needs privileges.  The CFS periods in which t"
+            "he\n"
+        "      node was throttled are shown as throttled_periods and the time "
+            "it\n"
+        "      spent throttled as throttled_time.  -vs also shows all the peri"
+            "ods\n"
+        "      it ran in as cfs_periods.\n"
+        "  --loc_cgroup_cpu Max (-lcgc)\n"
+        "      Set local cgroup cpu.max to Max.\n"
+        "  --rem_cgroup_cpu Max (-rcgc)\n"
+        "      Set remote cgroup cpu.max to Max.\n"
+        "--cgroup_cpuset CPUs (-cgs)\n"
+        "      Run the test in a cgroup v2 child whose cpuset.cpus is CPUs, su"
+            "ch as\n"
+        "      0-3 or 2,4.\n"
+        "  --loc_cgroup_cpuset CPUs (-lcgs)\n"
+        "      Set local cgroup cpuset.cpus to CPUs.\n"
+        "  --rem_cgroup_cpuset CPUs (-rcgs)\n"
+        "      Set remote cgroup cpuset.cpus to CPUs.\n"
+        "--cgroup_mem Size (-cgm)\n"
+        "      Run the test in a cgroup v2 child whose memory.max is Size, suc"
+            "h as\n"
+        "      512M.\n"
+        "  --loc_cgroup_mem Size (-lcgm)\n"
+        "      Set local cgroup memory.max to Size.\n"
+        "  --rem_cgroup_mem Size (-rcgm)\n"
+        "      Set remote cgroup memory.max to Size.\n"
+        "--cold_cache OnOff (-cc)\n"
+        "      In latency tests, evict the message buffer from the processor c"
+            "aches\n"
+        "      before each send and receive so that the latency reflects cold "
+            "data\n"
+        "      rather than data that is already cached.  Cache lines are flush"
+            "ed\n"
+        "      with clflush on x86 and dc civac on ARM64; on other processors "
+            "a\n"
+        "      large buffer is read to evict the caches.  The time spent flush"
+            "ing\n"
+        "      is measured on both sides and excluded from the latency; its me"
+            "an\n"
+        "      per message is shown as flush_time.  To compare cold and warm\n"
+        "      latency in one run, use --loop cold_cache:0:1:1.\n"
+        "  -cc1\n"
+        "      Flush caches before each send and receive.\n"
+        "--compress Alg (-z)\n"
+        "      In the stream bandwidth tests, such as tcp_bw, compress each me"
+            "ssage\n"
+        "      with Alg before sending it and decompress it on receipt.  Alg i"
+            "s\n"
+        "      lz4, zstd or zlib; which are available depends on the libraries"
+            "\n"
+        "      found when qperf was built.  bw is then the bandwidth of the da"
+            "ta\n"
+        "      before compression; the bandwidth on the wire is shown as wire_"
+            "bw\n"
+        "      and the ratio of the two as compress_ratio.  The CPU cost per G"
+            "B of\n"
+        "      data before compression is shown for each side as send_cost and"
+            "\n"
+        "      recv_cost.  Comparing the cost with that of the same test witho"
+            "ut\n"
+        "      --compress gives the link speed at which compression pays off."
+            "\n"
+        "--compress_level N (-zl)\n"
+        "      Set the compression level to N.  For lz4, it is the acceleratio"
+            "n;\n"
+        "      higher is faster and compresses less.  The default, 0, uses the"
+            "\n"
+        "      default level of the algorithm.\n"
+        "--compress_pct Pct (-zp)\n"
+        "      Send data that could be compressed by about Pct percent: in eac"
+            "h\n"
+        "      256 byte block, Pct percent of the bytes are zero and the rest "
+            "are\n"
+        "      random.  The default is 50.\n"
+        "--cpu_affinity PN (-ca)\n"
+        "      Set cpu affinity to PN.  CPUs are numbered sequentially from 0."
+            "  If\n"
+        "      PN is \"any\", any cpu is allowed otherwise the cpu is limited "
+            "to the\n"
+        "      one specified.  If PN is \"auto\", qperf chooses a cpu itself: "
+            "one on\n"
+        "      the same NUMA node as the NIC used by the test (the RDMA device"
+            " for\n"
+        "      RDMA tests, the interface routing to the other node otherwise) "
+            "that\n"
+        "      does not service the NIC's interrupts and, if possible, does no"
+            "t\n"
+        "      share a core with one that does.  The choice is shown as\n"
+        "      auto_affinity.\n"
+        "  --loc_cpu_affinity PN (-lca)\n"
+        "      Set local processor affinity to PN.\n"
+        "  --rem_cpu_affinity PN (-rca)\n"
+        "      Set remote processor affinity to PN.\n"
+        "--fault_at Ms (-fa)\n"
+        "      Inject the fault set by --fault_len Ms milliseconds into the te"
+            "st.\n"
+        "      By default, it is in the middle of the test.\n"
+        "--fault_dev Dev (-fd)\n"
+        "      Inject the fault on interface Dev.  By default, it is the inter"
+            "face\n"
+        "      that carries the test.\n"
+        "--fault_kind Kind (-fk)\n"
+        "      Set the kind of fault.  loss (the default) drops packets as set"
+            " by\n"
+        "      --fault_len.  migrate forces an RDMA connection onto the altern"
+            "ate\n"
+        "      path set by --alt_port to measure what Automatic Path Migration"
+            "\n"
+        "      costs; it needs an RC or UC test and no --fault_len.  Along wit"
+            "h\n"
+        "      fault_recovery, fault_stall and fault_errors, the client report"
+            "s\n"
+        "      how long after the migration each side saw the path migrated ev"
+            "ent\n"
+        "      as loc_path_mig and rem_path_mig.  The remote time is only as\n"
+        "      accurate as the synchronization at the start of the test.  In\n"
+        "      latency tests, the worst latency from the fault until recovery "
+            "is\n"
+        "      shown as fault_lat_max for either kind of fault.\n"
+        "--fault_len Ms (-fl)\n"
+        "      Disrupt the test for Ms milliseconds by having the client put a"
+            "\n"
+        "      netem queueing discipline that drops packets on its interface w"
+            "ith\n"
+        "      tc.  This needs privileges and the fault must end before the te"
+            "st\n"
+        "      does.  The client reports the time from the end of the fault un"
+            "til\n"
+        "      the rate of the test is back to 90% of what it was before the f"
+            "ault\n"
+        "      as fault_recovery, the longest time during the fault and recove"
+            "ry\n"
+        "      in which no data moved as fault_stall, which bounds the worst\n"
+        "      latency seen, the TCP segments the host retransmitted during th"
+            "e\n"
+        "      test as fault_retrans and the errors the test saw as fault_erro"
+            "rs.\n"
+        "      Traffic that bypasses the kernel, such as RDMA, is not affected"
+            ".\n"
+        "--fault_loss Pct (-fp)\n"
+        "      Drop Pct percent of packets during the fault instead of all of"
+            "\n"
+        "      them.  A partial loss causes a storm of TCP retransmissions rat"
+            "her\n"
+        "      than an outage.\n"
+        "--flip OnOff (-f)\n"
+        "      If non-zero, cause sender and receiver to play opposite roles."
+            "\n"
+        "  -f1\n"
+        "      Cause sender and receiver to play opposite roles.\n"
+        "--heatmap File (-hm)\n"
+        "      For the latency tests, write a histogram of the round trip late"
+            "ncy\n"
+        "      of the messages sent in each interval of the test to File, so t"
+            "hat\n"
+        "      periodic stalls show up as stripes when it is plotted.  File is"
+            " a\n"
+        "      gnuplot nonuniform matrix: the first row is the number of bucke"
+            "ts\n"
+        "      followed by the lowest latency in ns of each bucket, with four"
+            "\n"
+        "      buckets to each power of two from 64 ns, and each following row"
+            " is\n"
+        "      the start of an interval in ms followed by the number of messag"
+            "es in\n"
+        "      each bucket.  It can be plotted with\n"
+        "          plot 'File' nonuniform matrix using 2:1:3 with image\n"
+        "      A %s in File is replaced by the name of the test.\n"
+        "--heatmap_bin Ms (-hmb)\n"
+        "      Set the heatmap interval to Ms milliseconds.  The default is 10"
+            "0.\n"
+        "--help Topic (-h)\n"
+        "      Print out information about Topic.  To see the list of topics, "
+            "type\n"
+        "          qperf --help\n"
+        "--host Host (-H)\n"
+        "      Run test between the current node and the qperf running on node"
+            " Host.\n"
+        "      This can also be specified as the first non-option argument.\n"
+        "--id Device:Port (-i)\n"
+        "      Use RDMA Device and Port.\n"
+        "  --loc_id Device:Port (-li)\n"
+        "      Use local RDMA Device and Port.\n"
+        "  --rem_id Device:Port (-ri)\n"
+        "      Use remote RDMA Device and Port.\n"
+        "--listen_port Port (-lp)\n"
+        "      Set the port we listen on to ListenPort.  This must be set to t"
+            "he\n"
+        "      same port on both the server and client machines.  The default "
+            "value\n"
+        "      is 19765.\n"
+        "--low_latency Level (-ll)\n"
+        "      Run the test under a low latency profile.  At level 1, the cpu "
+            "DMA\n"
+        "      latency is held at 0 (via /dev/cpu_dma_latency) to keep process"
+            "ors\n"
+        "      out of deep sleep states, the test runs with SCHED_FIFO schedul"
+            "ing\n"
+        "      and its memory is locked and prefaulted.  Level 2 also disables"
+            "\n"
+        "      transparent huge pages.  These usually require root privileges;"
+            "\n"
+        "      controls that cannot be applied produce a warning and the ones "
+            "that\n"
+        "      were applied are shown as loc_low_latency and rem_low_latency. "
+            " When\n"
+        "      polling, ensure the client and server are not on the same cpu."
+            "\n"
+        "  --loc_low_latency Level (-lll)\n"
+        "      Apply a low latency profile locally.\n"
+        "  --rem_low_latency Level (-rll)\n"
+        "      Apply a low latency profile remotely.\n"
+        "--loop Var:Init:Last:Incr (-oo)\n"
+        "    Run a test multiple times sequencing through a series of values. "
+            " Var\n"
+        "    is the loop variable; Init is the initial value; Last is the valu"
+            "e it\n"
+        "    must not exceed and Incr is the increment.  It is useful to set t"
+            "he\n"
+        "    --verbose_used (-vu) option in conjunction with this option.\n"
+        "--msg_size Size (-m)\n"
+        "      Set the message size to Size.  The default value varies by test"
+            ".  It\n"
+        "      is assumed that the value is specified in bytes however, a trai"
+            "ling\n"
+        "      kib or K, mib or M, or gib or G indicates that the size is bein"
+            "g\n"
+        "      specified in kibibytes, mebibytes or gibibytes respectively whi"
+            "le a\n"
+        "      trailing kb or k, mb or m, or gb or g indicates kilobytes, mega"
+            "bytes\n"
+        "      or gigabytes respectively.\n"
+        "--mtu_size Size (-mt)\n"
+        "      Set the MTU size.  Only relevant to the RDMA UC/RC tests.  Unit"
+            "s are\n"
+        "      specified in the same manner as the --msg_size option.\n"
+        "--no_msgs N (-n)\n"
+        "    Set test duration by number of messages sent instead of time.\n"
+        "--cq_poll OnOff (-cp)\n"
+        "      Turn polling mode on or off.  This is only relevant to the RDMA"
+            " tests\n"
+        "      and determines whether they poll or wait on the completion queu"
+            "es.\n"
+        "      If OnOff is 0, they wait; otherwise they poll.\n"
+        "  --loc_cq_poll OnOff (-lcp)\n"
+        "      Locally turn polling mode on or off.\n"
+        "  --rem_cq_poll OnOff (-rcp)\n"
+        "      Remotely turn polling mode on or off.\n"
+        "  -cp1\n"
+        "      Turn polling mode on.\n"
+        "  -lcp1\n"
+        "      Turn local polling mode on.\n"
+        "  -rcp1\n"
+        "      Turn remote polling mode on.\n"
+        "--ip_port Port (-ip)\n"
+        "      Use Port to run the socket tests.  This is different from\n"
+        "      --listen_port which is used for synchronization.  This is only"
+            "\n"
+        "      relevant for the socket tests and refers to the TCP/UDP/SDP/RDS"
+            "/SCTP\n"
+        "      port that the test is run on.\n"
+        "--pipeline N (-pl)\n"
+        "      Have the receiver of a bandwidth test hand each message to one "
+            "of N\n"
+        "      worker threads instead of processing it itself.  The receive th"
+            "read\n"
+        "      receives into a slot of a lock-free ring and the worker that ta"
+            "kes\n"
+        "      the message from the ring frees the slot, touching the data fir"
+            "st\n"
+        "      if --access_recv is set.  Workers are pinned to the processors"
+            "\n"
+        "      following the receive thread.  The receiver reports the mean an"
+            "d\n"
+        "      maximum handoff latency, the time from a message being placed i"
+            "n a\n"
+        "      ring to a worker taking it, the rate at which the workers could"
+            "\n"
+        "      have taken messages had they never waited, and the number of ti"
+            "mes\n"
+        "      the receive thread had to wait for a free slot.  This is releva"
+            "nt\n"
+        "      to the socket, RDS and RDMA send/receive bandwidth tests.\n"
+        "  --loc_pipeline N (-lpl)\n"
+        "      Set the number of local pipeline workers.\n"
+        "  --rem_pipeline N (-rpl)\n"
+        "      Set the number of remote pipeline workers.\n"
+        "--pipeline_mode Mode (-plm)\n"
+        "      Set how the pipeline hands off messages.  Mode is a comma separ"
+            "ated\n"
+        "      list of a ring, spsc (the default) to give each worker its own "
+            "ring\n"
+        "      filled in turn or shared for one ring from which the workers ta"
+            "ke\n"
+        "      messages with a compare and swap, and a wakeup, spin (the defau"
+            "lt)\n"
+        "      for idle workers to poll or futex for them to sleep after a sho"
+            "rt\n"
+        "      spin and be woken by the receive thread.\n"
+        "--precision Digits (-e)\n"
+        "      Set the number of significant digits that are used to report re"
+            "sults.\n"
+        "--prefork N (-pf)\n"
+        "      This is a server option.  Keep a pool of N worker processes tha"
+            "t have\n"
+        "      already been forked and have faulted in their memory, waiting f"
+            "or\n"
+        "      requests.  This removes the fork and page fault costs from the "
+            "start\n"
+        "      of each test.  Each worker serves one request and is then repla"
+            "ced.\n"
+        "      As with the default, requests are served one at a time; the oth"
+            "er\n"
+        "      workers wait their turn.  With --debug, the time from receiving"
+            " a\n"
+        "      request to being ready to run the test is shown.\n"
+        "--profile OnOff (-pr)\n"
+        "      Sample the call stacks of qperf on each node about 5000 times a"
+            "\n"
+        "      second while the test is running, using a CPU clock perf event."
+            "\n"
+        "      Kernel frames are included if the kernel allows it.  The five\n"
+        "      functions in which each node spent the most time are shown as\n"
+        "      loc_profile_1 through loc_profile_5 and rem_profile_1 through\n"
+        "      rem_profile_5 along with the percentage of samples they were\n"
+        "      seen in.  The worker threads of --pipeline are sampled too.  Th"
+            "e\n"
+        "      samples are collected every 100 ms; any the kernel still had to"
+            "\n"
+        "      drop are counted in loc_profile_lost and rem_profile_lost.  Use"
+            "r\n"
+        "      stacks are only complete if qperf and the libraries it uses are"
+            "\n"
+        "      built with frame pointers.\n"
+        "  --loc_profile OnOff (-lpr)\n"
+        "      Turn local profiling on or off.\n"
+        "  --rem_profile OnOff (-rpr)\n"
+        "      Turn remote profiling on or off.\n"
+        "  -pr1\n"
+        "      Turn profiling on.\n"
+        "--profile_file File (-prf)\n"
+        "      Write the call stacks sampled with --profile to File in folded"
+            "\n"
+        "      format, one stack per line with frames separated by semicolons"
+            "\n"
+        "      followed by a count, as used by flame graph tools.  The first\n"
+        "      frame is client or server.  If File contains %s, it is replaced"
+            "\n"
+        "      by the test name.\n"
+        "--qos_dscp DSCP (-qd)\n"
+        "      Mark the QoS probe of tcp_qos with the differentiated services "
+            "code\n"
+        "      point DSCP, between 0 and 63.  46 is expedited forwarding.\n"
+        "--qos_priority Prio (-qp)\n"
+        "      Set the socket priority of the QoS probe of tcp_qos to Prio.  T"
+            "his\n"
+        "      selects the band or class of the queueing discipline on the sen"
+            "ding\n"
+        "      host.  Priorities above 6 need the CAP_NET_ADMIN capability.\n"
+        "--rails List (-rl)\n"
+        "      Make the socket tests connect over the rails in List, a comma\n"
+        "      separated list of up to 8 paths of the form Local/Remote.  Loca"
+            "l is\n"
+        "      the address or interface to send from and Remote the address of"
+            " the\n"
+        "      server on that path.  Either may be omitted.  An address is bou"
+            "nd\n"
+        "      to and an interface is bound to with SO_BINDTODEVICE, which nee"
+            "ds\n"
+        "      privileges.  The stream bandwidth tests open one connection per"
+            " rail\n"
+        "      and keep them all busy, reporting the bandwidth of each rail as"
+            "\n"
+        "      rail0_bw, rail1_bw and so on as well as the total.  List a rail"
+            " more\n"
+        "      than once to run several streams over it.  The other socket tes"
+            "ts\n"
+        "      only use the first rail.\n"
+        "--rd_atomic Max (-nr)\n"
+        "      Set the number of in-flight operations that can be handled for "
+            "a RDMA\n"
+        "      read or atomic operation to Max.  This is only relevant to the "
+            "RDMA\n"
+        "      Read and Atomic tests.\n"
+        "  --loc_rd_atomic Max (-lnr)\n"
+        "      Set local read/atomic count.\n"
+        "  --rem_rd_atomic Max (-rnr)\n"
+        "      Set remote read/atomic count.\n"
+        "--sample_file File (-sf)\n"
+        "      Record a sample of every message of the latency tests in File. "
+            " Each\n"
+        "      node records into a memory mapped file that is allocated before"
+            " the\n"
+        "      test so that recording is only a few stores; after the test, th"
+            "e\n"
+        "      server's samples are sent to the client and merged with its own"
+            ".  A\n"
+        "      %s in File is replaced by the name of the test.  The file, in t"
+            "he\n"
+        "      byte order of the client, is a 96 byte header followed by 24 by"
+            "te\n"
+        "      samples:\n"
+        "          char     magic[8];     \"qperfsmp\"\n"
+        "          uint32_t version;      1\n"
+        "          uint32_t size;         24, the size of a sample\n"
+        "          uint64_t count[2];     number of client and server samples"
+            "\n"
+        "          char     test[64];     test name\n"
+        "      and for each sample, in order of time:\n"
+        "          uint64_t time;         ns from the start of the test\n"
+        "          uint32_t latency;      ns\n"
+        "          uint32_t size;         bytes\n"
+        "          uint32_t status;       0, errno or work completion status\n"
+        "          uint32_t node;         0 for client, 1 for server\n"
+        "      On the client, a sample runs from sending a message to receivin"
+            "g the\n"
+        "      reply; on the server, from receiving a message to sending the r"
+            "eply.\n"
+        "      Each node measures time from its own start of the test, so the "
+            "two\n"
+        "      differ by up to the time taken to synchronize.\n"
+        "--samples N (-sa)\n"
+        "      Record at most N samples on each node.  The default is 1000000 "
+            "when\n"
+        "      --sample_file is given.\n"
+        "  --loc_samples N (-lsa)\n"
+        "      Record at most N local samples.\n"
+        "  --rem_samples N (-rsa)\n"
+        "      Record at most N remote samples.\n"
+        "--service_dist Dist (-svd)\n"
+        "      Set the distribution of the service times set with --service_ti"
+            "me.\n"
+        "      Dist is fixed (the default), exp for an exponential distributio"
+            "n\n"
+        "      with a mean of --service_time, or bimodal:Pct:Time to take Time"
+            "\n"
+        "      instead of --service_time for Pct percent of the requests.  Thi"
+            "s is\n"
+        "      only used on the server.\n"
+        "--service_file File (-svf)\n"
+        "      Read service times from File, one per line with an optional ns,"
+            "\n"
+        "      us, ms or s suffix, and draw the service time of each request f"
+            "rom\n"
+        "      their distribution.  The times are sent to the server as 64\n"
+        "      quantiles.\n"
+        "--service_level SL (-sl)\n"
+        "      Set RDMA service level to SL.  This is only used by the RDMA te"
+            "sts.\n"
+        "      The service level must be between 0 and 15.  The default servic"
+            "e\n"
+        "      level is 0.\n"
+        "  --loc_service_level SL (-lsl)\n"
+        "      Set local service level.\n"
+        "  --rem_service_level SL (-rsl)\n"
+        "      Set remote service level.\n"
+        "--service_time Time (-svt)\n"
+        "      Have the server spend Time on each request of a latency test be"
+            "fore\n"
+        "      it replies.  Time is in nanoseconds unless followed by us, ms o"
+            "r s.\n"
+        "      This emulates an application and lets the latency tests show ho"
+            "w\n"
+        "      the transport behaves when the server is not simply echoing.  T"
+            "he\n"
+        "      server spins rather than sleeps so that the time is accurate.\n"
+        "--service_touch Size (-svm)\n"
+        "      Have the server read and write Size bytes of a private buffer o"
+            "n\n"
+        "      each request to emulate the cache footprint of an application. "
+            " The\n"
+        "      time spent touching counts towards --service_time.\n"
+        "--sock_buf_size Size (-sb)\n"
+        "      Set the socket buffer size.  This is only relevant to the socke"
+            "t\n"
+        "      tests.\n"
+        "  --loc_sock_buf_size Size (-lsb)\n"
+        "      Set local socket buffer size.\n"
+        "  --rem_sock_buf_size Size (-rsb)\n"
+        "      Set remote socket buffer size.\n"
+        "--src_path_bits N (-sp)\n"
+        "      Set source path bits. If the LMC is not zero, this will cause t"
+            "he\n"
+        "      connection to use a LID with the low order LMC bits set to N.\n"
+        "  --loc_src_path_bits N (-lsp)\n"
+        "      Set local source path bits.\n"
+        "  --rem_src_path_bits N (-rsp)\n"
+        "      Set remote source path bits.\n"
+        "--static_rate Rate (-sr)\n"
+        "      Force InfiniBand static rate.  Rate can be one of: 2.5, 5, 10, "
+            "20,\n"
+        "      30, 40, 60, 80, 120, 1xSDR (2.5 Gbps), 1xDDR (5 Gbps), 1xQDR (1"
+            "0\n"
+        "      Gbps), 4xSDR (2.5 Gbps), 4xDDR (5 Gbps), 4xQDR (10 Gbps), 8xSDR"
+            " (2.5\n"
+        "      Gbps), 8xDDR (5 Gbps), 8xQDR (10 Gbps).\n"
+        "  --loc_static_rate (-lsr)\n"
+        "      Force local InfiniBand static rate\n"
+        "  --rem_static_rate (-rsr)\n"
+        "      Force remote InfiniBand static rate\n"
+        "--time Time (-t)\n"
+        "      Set test duration to Time.  Specified in seconds however a trai"
+            "ling\n"
+        "      m, h or d indicates that the time is specified in minutes, hour"
+            "s or\n"
+        "      days respectively.\n"
+        "--timeout Time (-to)\n"
+        "      Set timeout to Time.  This is the timeout used for various thin"
+            "gs\n"
+        "      such as exchanging messages.  The default is 5 seconds.\n"
+        "  --loc_timeout Time (-lto)\n"
+        "      Set local timeout to Time.  This may be used on the server to s"
+            "et\n"
+        "      the timeout when initially exchanging data with each client.\n"
+        "      However, as soon as we receive the client's parameters, the cli"
+            "ent's\n"
+        "      remote timeout will override this parameter.\n"
+        "  --rem_timeout Time (-rto)\n"
+        "      Set remote timeout to Time.\n"
+        "--ud_cqs N (-uc)\n"
+        "      Spread the server's UD destinations over N completion queues, e"
+            "ach\n"
+        "      with its own completion channel, and have the server wait on al"
+            "l\n"
+        "      of them from one thread using epoll.  Each CQ with an event is"
+            "\n"
+        "      re-armed and drained before waiting again.  The number of\n"
+        "      destinations defaults to N and may not be fewer.  The number of"
+            " CQ\n"
+        "      events handled per wakeup is shown with the message rate.  With"
+            "\n"
+        "      --cq_poll, the CQs are simply polled in turn.  Used by ud_bw an"
+            "d\n"
+        "      ud_lat.\n"
+        "--ud_dests N (-ud)\n"
+        "      Send UD messages to N destinations rather than one.  The server"
+            "\n"
+        "      creates N UD QPs sharing one receive queue and the client creat"
+            "es\n"
+        "      an address handle for each and sends to them in turn.  The numb"
+            "er\n"
+        "      of destinations and the time taken to create each address handl"
+            "e\n"
+        "      are shown with the message rate.  Used by ud_bw and ud_lat.\n"
+        "--ud_random OnOff (-ur)\n"
+        "      If OnOff is non-zero, send to the --ud_dests destinations in a"
+            "\n"
+        "      random order rather than in turn.\n"
+        "  -ur1\n"
+        "      Send to the --ud_dests destinations in a random order.\n"
+        "--unify_nodes (-un)\n"
+        "      Unify the nodes.  Describe them in terms of local and remote ra"
+            "ther\n"
+        "      than send and receive.\n"
+        "--unify_units (-uu)\n"
+        "      Unify the units that results are shown in.  Uses the lowest com"
+            "mon\n"
+        "      denominator.  Helpful for scripts.\n"
+        "--use_bits_per_sec (-ub)\n"
+        "      Use bits/sec rather than bytes/sec when displaying networking s"
+            "peed.\n"
+        "--use_cm OnOff (-cm)\n"
+        "      Use the RDMA Connection Manager (CM) if OnOff is non-zero.  It "
+            "is\n"
+        "      necessary to use the CM for iWARP devices.  The default is to\n"
+        "      establish the connection without using the CM.  This only works"
+            " for\n"
+        "      the tests that use the RC transport.\n"
+        "  -cm1\n"
+        "      Use RDMA Connection Manager.\n"
+        "--verbose (-v)\n"
+        "      Provide more detailed output.  Turns on -vc, -vs, -vt and -vu."
+            "\n"
+        "  --verbose_conf (-vc)\n"
+        "      Provide information on configuration.\n"
+        "  --verbose_stat (-vs)\n"
+        "      Provide information on statistics.  For the bandwidth tests, th"
+            "is\n"
+        "      includes the speed of the link (from ethtool or the RDMA port) "
+            "and\n"
+        "      the most it can carry after the per packet protocol overhead fo"
+            "r\n"
+        "      the MTU.  When the link speed is known, link_util, the bandwidt"
+            "h as\n"
+        "      a percentage of the link speed, is always shown.  Tests that se"
+            "nd\n"
+        "      in both directions are measured against twice the link speed.\n"
+        "  --verbose_time (-vt)\n"
+        "      Provide information on timing.  This includes the cpu cost per "
+            "GB\n"
+        "      and per message and, where RAPL energy counters can be read (us"
+            "ually\n"
+        "      as root), the power drawn by each node and the energy used per "
+            "GB\n"
+        "      and per message.\n"
+        "      Energy is measured for whole processor packages and DRAM, so it"
+            "\n"
+        "      includes anything else running on the node and is counted twice"
+            "\n"
+        "      when the client and server run on the same node.\n"
+        "  --verbose_used (-vu)\n"
+        "      Provide information on parameters used.\n"
+        "  --verbose_more (-vv)\n"
+        "      Provide even more detailed output.  Turns on -vvc, -vvs, -vvt a"
+            "nd\n"
+        "      -vvu.\n"
+        "  --verbose_more_conf (-vvc)\n"
+        "      Provide more information on configuration.\n"
+        "  --verbose_more_stat (-vvs)\n"
+        "      Provide more information on statistics.\n"
+        "  --verbose_more_time (-vvt)\n"
+        "      Provide more information on timing.\n"
+        "  --verbose_more_used (-vvu)\n"
+        "      Provide more information on parameters used.\n"
+        "--version (-V)\n"
+        "      The current version of qperf is printed.\n"
+        "--wait_server Time (-ws)\n"
+        "      If the server is not ready, continue to try connecting for Time"
+            "\n"
+        "      seconds before giving up.  The default is 5 seconds.\n"
+        "--xdp_mode Mode (-xm)\n"
+        "      Set the mode the xdp_bw and xdp_lat tests use AF_XDP in.  skb u"
+            "ses\n"
+        "      generic XDP, which works on any interface including veth, and\n"
+        "      copies frames.  copy uses the driver's XDP support but still\n"
+        "      copies frames into the UMEM.  zc uses AF_XDP zero-copy, which n"
+            "eeds\n"
+        "      driver support.  The default is to try zc, then copy and then s"
+            "kb.\n"
+        "      The mode each node ended up in is shown as xdp_mode.\n"
+        "  --loc_xdp_mode Mode (-lxm)\n"
+        "      Set local AF_XDP mode to Mode.\n"
+        "  --rem_xdp_mode Mode (-rxm)\n"
+        "      Set remote AF_XDP mode to Mode.\n"
+        "--zerocopy_recv OnOff (-zr)\n"
+        "      In tcp_bw, if OnOff is non-zero, the server receives with\n"
+        "      TCP_ZEROCOPY_RECEIVE: the kernel maps the pages holding the dat"
+            "a\n"
+        "      into qperf rather than copying them, and qperf releases them on"
+            "ce\n"
+        "      done.  Only data filling whole pages can be mapped; the rest is"
+            "\n"
+        "      copied.  With -v, the percentage of the data that was mapped is"
+            "\n"
+        "      shown as zerocopy along with recv_cost, the CPU cost per GB, to"
+            "\n"
+        "      compare with a run that copies.  If the kernel refuses, qperf\n"
+        "      copies instead and zerocopy shows why.  Pages line up best with"
+            " a\n"
+        "      large msg_size that is a multiple of the page size.\n"
+        "  -zr1\n"
+        "      Map received TCP pages.\n",
+    "tests",
+        "Miscellaneous\n"
+        "    conf                    Show configuration\n"
+        "    quit                    Cause the server to quit\n"
+        "Socket Based\n"
+        "    rds_bw                  RDS streaming one way bandwidth\n"
+        "    rds_lat                 RDS one way latency\n"
+        "    sctp_bw                 SCTP streaming one way bandwidth\n"
+        "    sctp_lat                SCTP one way latency\n"
+        "    sdp_bw                  SDP streaming one way bandwidth\n"
+        "    sdp_lat                 SDP one way latency\n"
+        "    tcp_bw                  TCP streaming one way bandwidth\n"
+        "    tcp_lat                 TCP one way latency\n"
+        "    tcp_qos                 TCP latency under load with QoS\n"
+        "    udp_bw                  UDP streaming one way bandwidth\n"
+        "    udp_lat                 UDP one way latency\n"
+        "    xdp_bw                  AF_XDP one way packet rate\n"
+        "    xdp_lat                 AF_XDP one way latency\n",
+    "conf",
+        "Purpose\n"
+        "    Show configuration\n"
+        "Common Options\n"
+        "    None\n"
+        "Description\n"
+        "    Shows the node name, CPUs and OS of both nodes being used.\n",
+    "quit",
+        "Purpose\n"
+        "    Quit\n"
+        "Common Options\n"
+        "    None\n"
+        "Description\n"
+        "    Causes the server to quit.\n",
+    "rds_bw",
+        "Purpose\n"
+        "    RDS streaming one way bandwidth\n"
+        "Common Options\n"
+        "    --access_recv OnOff (-ar)   Access received data\n"
+        "    --cpu_affinity PN (-ca)     Set processor affinity\n"
+        "    --msg_size Size (-m)        Set message size\n"
+        "    --sock_buf_size Size (-sb)  Set socket buffer size\n"
+        "    --time (-t)                 Set test duration\n"
+        "Other Options\n"
+        "    --listen_port, --ip_port, --timeout\n"
+        "Display Options\n"
+        "    --precision, --unify_nodes, --unify_units, --use_bits_per_sec,\n"
+        "    --verbose\n"
+        "Description\n"
+        "    The client repeatedly sends messages to the server while the serv"
+            "er\n"
+        "    notes how many were received.\n",
+    "rds_lat",
+        "Purpose\n"
+        "    RDS one way latency\n"
+        "Common Options\n"
+        "    --cpu_affinity PN (-ca)     Set processor affinity\n"
+        "    --msg_size Size (-m)        Set message size\n"
+        "    --sock_buf_size Size (-sb)  Set socket buffer size\n"
+        "    --time (-t)                 Set test duration\n"
+        "Other Options\n"
+        "    --listen_port, --ip_port, --timeout\n"
+        "Display Options\n"
+        "    --precision, --unify_nodes, --unify_units, --verbose\n"
+        "Description\n"
+        "    A ping pong latency test where the server and client exchange mes"
+            "sages\n"
+        "    repeatedly using RDS sockets.\n",
+    "sctp_bw",
+        "Purpose\n"
+        "    SCTP streaming one way bandwidth\n"
+        "Common Options\n"
+        "    --access_recv OnOff (-ar)   Access received data\n"
+        "    --cpu_affinity PN (-ca)     Set processor affinity\n"
+        "    --msg_size Size (-m)        Set message size\n"
+        "    --sock_buf_size Size (-sb)  Set socket buffer size\n"
+        "    --time (-t)                 Set test duration\n"
+        "Other Options\n"
+        "    --listen_port, --ip_port, --timeout\n"
+        "Display Options\n"
+        "    --precision, --unify_nodes, --unify_units, --use_bits_per_sec,\n"
+        "    --verbose\n"
+        "Description\n"
+        "    The client repeatedly sends messages to the server while the serv"
+            "er\n"
+        "    notes how many were received.\n",
+    "sctp_lat",
+        "Purpose\n"
+        "    SCTP one way latency\n"
+        "Common Options\n"
+        "    --cpu_affinity PN (-ca)     Set processor affinity\n"
+        "    --msg_size Size (-m)        Set message size\n"
+        "    --sock_buf_size Size (-sb)  Set socket buffer size\n"
+        "    --time (-t)                 Set test duration\n"
+        "Other Options\n"
+        "    --listen_port, --ip_port, --timeout\n"
+        "Display Options\n"
+        "    --precision, --unify_nodes, --unify_units, --verbose\n"
+        "Description\n"
+        "    A ping pong latency test where the server and client exchange mes"
+            "sages\n"
+        "    repeatedly using STCP sockets.\n",
+    "sdp_bw",
+        "Purpose\n"
+        "    SDP streaming one way bandwidth\n"
+        "Common Options\n"
+        "    --access_recv OnOff (-ar)   Access received data\n"
+        "    --cpu_affinity PN (-ca)     Set processor affinity\n"
+        "    --msg_size Size (-m)        Set message size\n"
+        "    --sock_buf_size Size (-sb)  Set socket buffer size\n"
+        "    --time (-t)                 Set test duration\n"
+        "Other Options\n"
+        "    --listen_port, --ip_port, --timeout\n"
+        "Display Options\n"
+        "    --precision, --unify_nodes, --unify_units, --use_bits_per_sec,\n"
+        "    --verbose\n"
+        "Description\n"
+        "    The client repeatedly sends messages to the server while the serv"
+            "er\n"
+        "    notes how many were received.\n",
+    "sdp_lat",
+        "Purpose\n"
+        "    SDP one way latency\n"
+        "Common Options\n"
+        "    --cpu_affinity PN (-ca)     Set processor affinity\n"
+        "    --msg_size Size (-m)        Set message size\n"
+        "    --sock_buf_size Size (-sb)  Set socket buffer size\n"
+        "    --time (-t)                 Set test duration\n"
+        "Other Options\n"
+        "    --listen_port, --ip_port, --timeout\n"
+        "Display Options\n"
+        "    --precision, --unify_nodes, --unify_units, --verbose\n"
+        "Description\n"
+        "    A ping pong latency test where the server and client exchange mes"
+            "sages\n"
+        "    repeatedly using SDP sockets.\n",
+    "tcp_bw",
+        "Purpose\n"
+        "    TCP streaming one way bandwidth\n"
+        "Common Options\n"
+        "    --access_recv OnOff (-ar)   Access received data\n"
+        "    --cpu_affinity PN (-ca)     Set processor affinity\n"
+        "    --msg_size Size (-m)        Set message size\n"
+        "    --sock_buf_size Size (-sb)  Set socket buffer size\n"
+        "    --time (-t)                 Set test duration\n"
+        "Other Options\n"
+        "    --listen_port, --ip_port, --timeout\n"
+        "Display Options\n"
+        "    --precision, --unify_nodes, --unify_units, --use_bits_per_sec,\n"
+        "    --verbose\n"
+        "Description\n"
+        "    The client repeatedly sends messages to the server while the serv"
+            "er\n"
+        "    notes how many were received.\n",
+    "tcp_lat",
+        "Purpose\n"
+        "    TCP one way latency\n"
+        "Common Options\n"
+        "    --cpu_affinity PN (-ca)     Set processor affinity\n"
+        "    --msg_size Size (-m)        Set message size\n"
+        "    --sock_buf_size Size (-sb)  Set socket buffer size\n"
+        "    --time (-t)                 Set test duration\n"
+        "Other Options\n"
+        "    --listen_port, --ip_port, --timeout\n"
+        "Display Options\n"
+        "    --precision, --unify_nodes, --unify_units, --verbose\n"
+        "Description\n"
+        "    A ping pong latency test where the server and client exchange mes"
+            "sages\n"
+        "    repeatedly using TCP sockets.\n",
+    "tcp_qos",
+        "Purpose\n"
+        "    TCP latency under load with QoS\n"
+        "Common Options\n"
+        "    --cpu_affinity PN (-ca)     Set processor affinity\n"
+        "    --msg_size Size (-m)        Set probe message size\n"
+        "    --qos_dscp DSCP (-qd)       Set DSCP of the QoS probe\n"
+        "    --qos_priority Prio (-qp)   Set socket priority of the QoS probe"
+            "\n"
+        "    --sock_buf_size Size (-sb)  Set socket buffer size\n"
+        "    --time (-t)                 Set test duration\n"
+        "Other Options\n"
+        "    --listen_port, --ip_port, --timeout\n"
+        "Display Options\n"
+        "    --precision, --unify_nodes, --unify_units, --use_bits_per_sec,\n"
+        "    --verbose\n"
+        "Description\n"
+        "    The client sends a bulk TCP stream to the server while two probes"
+            "\n"
+        "    take turns exchanging messages with it over their own TCP\n"
+        "    connections.  The first probe is in the same class as the bulk\n"
+        "    stream; the second is marked with --qos_dscp and --qos_priority o"
+            "n\n"
+        "    both nodes.  The round trip of each is reported along with the bu"
+            "lk\n"
+        "    bandwidth, showing whether the network and the queueing disciplin"
+            "es\n"
+        "    keep the marked traffic from queueing behind the bulk stream.\n",
+    "udp_bw",
+        "Purpose\n"
+        "    UDP streaming one way bandwidth\n"
+        "Common Options\n"
+        "    --access_recv OnOff (-ar)   Access received data\n"
+        "    --cpu_affinity PN (-ca)     Set processor affinity\n"
+        "    --msg_size Size (-m)        Set message size\n"
+        "    --sock_buf_size Size (-sb)  Set socket buffer size\n"
+        "    --time (-t)                 Set test duration\n"
+        "Other Options\n"
+        "    --listen_port, --ip_port, --timeout\n"
+        "Display Options\n"
+        "    --precision, --unify_nodes, --unify_units, --use_bits_per_sec,\n"
+        "    --verbose\n"
+        "Description\n"
+        "    The client repeatedly sends messages to the server while the serv"
+            "er\n"
+        "    notes how many were received.\n",
+    "udp_lat",
+        "Purpose\n"
+        "    UDP one way latency\n"
+        "Common Options\n"
+        "    --cpu_affinity PN (-ca)     Set processor affinity\n"
+        "    --msg_size Size (-m)        Set message size\n"
+        "    --sock_buf_size Size (-sb)  Set socket buffer size\n"
+        "    --time (-t)                 Set test duration\n"
+        "Other Options\n"
+        "    --listen_port, --ip_port, --timeout\n"
+        "Display Options\n"
+        "    --precision, --unify_nodes, --unify_units, --verbose\n"
+        "Description\n"
+        "    A ping pong latency test where the server and client exchange mes"
+            "sages\n"
+        "    repeatedly using UDP sockets.\n",
+    "xdp_bw",
+        "Purpose\n"
+        "    AF_XDP one way packet rate\n"
+        "Common Options\n"
+        "    --access_recv OnOff (-ar)   Access received data\n"
+        "    --cpu_affinity PN (-ca)     Set processor affinity\n"
+        "    --msg_size Size (-m)        Set message size\n"
+        "    --time (-t)                 Set test duration\n"
+        "    --xdp_mode Mode (-xm)       Set AF_XDP mode\n"
+        "Other Options\n"
+        "    --listen_port, --ip_port, --timeout\n"
+        "Display Options\n"
+        "    --precision, --unify_nodes, --unify_units, --verbose\n"
+        "Description\n"
+        "    The client sends UDP packets from an AF_XDP socket in batches whi"
+            "le\n"
+        "    the server receives them on an AF_XDP socket, to which an XDP\n"
+        "    program redirects the test's UDP port; other traffic goes on to t"
+            "he\n"
+        "    kernel.  Both sockets use queue 0 of the interface that routes to"
+            "\n"
+        "    the other node, so on a multi-queue NIC the test traffic must be"
+            "\n"
+        "    steered to queue 0.  The two nodes cannot share an interface, so "
+            "to\n"
+        "    run both on one machine, use the two ends of a veth pair with one"
+            " of\n"
+        "    them in another network namespace.  The nodes need an IPv4 addres"
+            "s\n"
+        "    and must be run as root.  The default message size is 64 bytes.  "
+            "The packet rate is\n"
+        "    shown along with the CPU cost per message, send_msg_cost and\n"
+        "    recv_msg_cost, which udp_bw with the same --msg_size shows with -"
+            "vt\n"
+        "    for comparison.\n",
+    "xdp_lat",
+        "Purpose\n"
+        "    AF_XDP one way latency\n"
+        "Common Options\n"
+        "    --cpu_affinity PN (-ca)     Set processor affinity\n"
+        "    --msg_size Size (-m)        Set message size\n"
+        "    --time (-t)                 Set test duration\n"
+        "    --xdp_mode Mode (-xm)       Set AF_XDP mode\n"
+        "Other Options\n"
+        "    --listen_port, --ip_port, --timeout\n"
+        "Display Options\n"
+        "    --precision, --unify_nodes, --unify_units, --verbose\n"
+        "Description\n"
+        "    A ping pong latency test where the server and client exchange UDP"
+            "\n"
+        "    packets repeatedly using AF_XDP sockets, each with an XDP program"
+            "\n"
+        "    redirecting its UDP port to it.  Compare with udp_lat.\n",
+    0,
+};
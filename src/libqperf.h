@@ -0,0 +1,108 @@
+/*
+ * qperf - library interface.
+ *
+ * Copyright (c) 2002-2009 Johann George.  All rights reserved.
+ * Copyright (c) 2006-2009 QLogic Corporation.  All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef LIBQPERF_H
+#define LIBQPERF_H
+#include <stdint.h>
+
+
+/*
+ * Parameters.
+ */
+#define QPERF_BUCKETS 96                /* Buckets in a latency histogram */
+
+
+/*
+ * The results of one node.  Times are in seconds and cpu usage is a fraction
+ * of a cpu.
+ */
+typedef struct QPERF_NODE {
+    double      time_real;              /* Real (elapsed) time */
+    double      time_cpu;               /* Cpu time */
+    double      cpu_total;              /* Cpu time as a fraction of a cpu */
+    double      cpu_user;               /* User time */
+    double      cpu_intr;               /* Interrupt time */
+    double      cpu_idle;               /* Idle time */
+    double      cpu_kernel;             /* Kernel time */
+    double      cpu_io_wait;            /* IO wait time */
+    double      watts_pkg;              /* Package power in watts */
+    double      watts_dram;             /* DRAM power in watts */
+    uint64_t    send_bytes;             /* Bytes sent */
+    uint64_t    send_msgs;              /* Messages sent */
+    uint64_t    send_errs;              /* Send errors */
+    uint64_t    recv_bytes;             /* Bytes received */
+    uint64_t    recv_msgs;              /* Messages received */
+    uint64_t    recv_errs;              /* Receive errors */
+} QPERF_NODE;
+
+
+/*
+ * The results of a test.  Rates are per second, costs are in seconds of cpu
+ * and latencies in seconds.  The histogram counts the round trip latency of
+ * each message of a latency test; bucket b starts at qperf_bucket(b) ns.
+ */
+typedef struct QPERF_RESULT {
+    QPERF_NODE  loc;                    /* Local results */
+    QPERF_NODE  rem;                    /* Remote results */
+    double      send_bw;                /* Send bandwidth in bytes */
+    double      recv_bw;                /* Receive bandwidth in bytes */
+    double      msg_rate;               /* Messaging rate */
+    double      send_cost;              /* Send cost per GB */
+    double      recv_cost;              /* Receive cost per GB */
+    double      send_msg_cost;          /* Send cost per message */
+    double      recv_msg_cost;          /* Receive cost per message */
+    double      latency;                /* Latency */
+    double      flush_time;             /* Flush time excluded from latency */
+    double      energy_gb;              /* Energy in joules per GB */
+    double      energy_msg;             /* Energy in joules per message */
+    double      link_rate;              /* Link rate in bytes/sec */
+    double      link_max_bw;            /* Link rate less protocol overhead */
+    double      link_util;              /* Bandwidth as fraction of link rate */
+    double      link_max_util;          /* Bandwidth as fraction of max_bw */
+    uint32_t    hist[QPERF_BUCKETS];    /* Latency histogram */
+} QPERF_RESULT;
+
+
+/*
+ * Library functions.  Those returning int return 0 on success and -1 on
+ * failure, in which case qperf_error returns the reason.
+ */
+uint64_t    qperf_bucket(int bucket);
+char       *qperf_error(void);
+int         qperf_init(void);
+void        qperf_reset(void);
+int         qperf_run(char *server, char *test, QPERF_RESULT *result);
+int         qperf_set(char *option, char *value);
+
+#endif /* LIBQPERF_H */
@@ -0,0 +1,432 @@
+/*
+ * qperf - receive pipeline.
+ * Measure socket and RDMA performance.
+ *
+ * Copyright (c) 2002-2009 Johann George.  All rights reserved.
+ * Copyright (c) 2006-2009 QLogic Corporation.  All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "qperf.h"
+
+
+/*
+ * Configurable parameters.
+ */
+#define PIPE_DEPTH  256                 /* Slots in a ring; a power of 2 */
+#define PIPE_MIN    4                   /* Fewest slots we shrink a ring to */
+#define PIPE_MEM    (64*1024*1024)      /* Total bytes of slot buffers */
+#define PIPE_SPIN   1000                /* Polls before a worker sleeps */
+#define PIPE_WORKERS 64                 /* Maximum number of workers */
+
+
+/*
+ * A slot in a ring.  The sequence number says who owns it: if it is the
+ * position being written, the receive thread; if it is one more, a worker.
+ * A worker hands it back by advancing it a lap.
+ */
+typedef struct SLOT {
+    uint32_t    seq;                    /* Sequence number; a futex word */
+    uint32_t    len;                    /* Length of message */
+    uint64_t    time;                   /* Time it was handed off */
+    void       *data;                   /* Message */
+    void       *buf;                    /* Buffer owned by the slot */
+} __attribute__((aligned(64))) SLOT;
+
+
+/*
+ * A ring.  The producer and consumer positions are kept on separate cache
+ * lines so that only the slots move between processors.
+ */
+typedef struct RING {
+    SLOT       *slots;                  /* Slots */
+    uint32_t    head __attribute__((aligned(64)));  /* Next to write */
+    uint32_t    tail __attribute__((aligned(64)));  /* Next to read */
+    uint32_t    sleepers __attribute__((aligned(64)));  /* Workers asleep */
+} RING;
+
+
+/*
+ * A worker.
+ */
+typedef struct WORKER {
+    pthread_t   thread;                 /* Thread */
+    RING       *ring;                   /* Ring it reads from */
+    int         cpu;                    /* Processor it is pinned to */
+    uint64_t    msgs;                   /* Messages handled */
+    uint64_t    lat_sum;                /* Total handoff latency */
+    uint64_t    lat_max;                /* Maximum handoff latency */
+    uint64_t    idle;                   /* Time spent waiting */
+} __attribute__((aligned(64))) WORKER;
+
+
+/*
+ * Function prototypes.
+ */
+static int      futex(uint32_t *addr, int op, uint32_t val);
+static int      next_cpu(cpu_set_t *set, int cpu);
+static void    *pipe_worker(void *arg);
+static SLOT    *ring_claim(WORKER *w, uint32_t *posp);
+static void     ring_init(RING *ring);
+
+
+/*
+ * Static variables.
+ */
+static int      PipeDepth;
+static int      PipeFutex;
+static int      PipeN;
+static int      PipeNext;
+static int      PipeShared;
+static RING    *PipeRings;
+static uint64_t PipeStalls;
+static uint64_t PipeStart;
+static volatile int PipeStop;
+static WORKER  *PipeWorkers;
+
+
+/*
+ * Start the workers.  In spsc mode, each worker has its own ring which the
+ * receive thread fills in turn; in shared mode, the workers take messages from
+ * a single ring.  Workers are pinned to the processors following the one we
+ * are on and block signals so that the test timer interrupts the receive
+ * thread.
+ */
+void
+pipeline_init(void)
+{
+    int i;
+    int cpu;
+    int nrings;
+    char *p;
+    cpu_set_t set;
+    sigset_t all;
+    sigset_t old;
+
+    if (!Req.pipeline)
+        return;
+    PipeN = Req.pipeline;
+    if (PipeN > PIPE_WORKERS)
+        error(0, "at most %d pipeline workers are supported", PIPE_WORKERS);
+
+    PipeShared = 0;
+    PipeFutex = 0;
+    for (p = Req.pipeline_mode; *p; ) {
+        int n = strcspn(p, ",");
+
+        if (n == 4 && strncmp(p, "spsc", n) == 0)
+            PipeShared = 0;
+        else if (n == 6 && strncmp(p, "shared", n) == 0)
+            PipeShared = 1;
+        else if (n == 4 && strncmp(p, "spin", n) == 0)
+            PipeFutex = 0;
+        else if (n == 5 && strncmp(p, "futex", n) == 0)
+            PipeFutex = 1;
+        else
+            error(0, "bad pipeline mode: %s", Req.pipeline_mode);
+        p += n;
+        if (*p)
+            p++;
+    }
+
+    nrings = PipeShared ? 1 : PipeN;
+    PipeDepth = PIPE_DEPTH;
+    while (PipeDepth > PIPE_MIN &&
+           (long)nrings * PipeDepth * Req.msg_size > PIPE_MEM)
+        PipeDepth /= 2;
+    if (posix_memalign((void **)&PipeRings, 64, nrings * sizeof(RING)))
+        error(0, "out of space");
+    for (i = 0; i < nrings; ++i)
+        ring_init(&PipeRings[i]);
+    if (posix_memalign((void **)&PipeWorkers, 64, PipeN * sizeof(WORKER)))
+        error(0, "out of space");
+    memset(PipeWorkers, 0, PipeN * sizeof(WORKER));
+
+    PipeStop = 0;
+    PipeNext = 0;
+    PipeStalls = 0;
+    PipeStart = get_nsecs();
+    if (sched_getaffinity(0, sizeof(set), &set) < 0)
+        error(SYS, "sched_getaffinity failed");
+    cpu = sched_getcpu();
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+    for (i = 0; i < PipeN; ++i) {
+        WORKER *w = &PipeWorkers[i];
+
+        cpu = next_cpu(&set, cpu);
+        w->cpu = cpu;
+        w->ring = &PipeRings[PipeShared ? 0 : i];
+        errno = pthread_create(&w->thread, 0, pipe_worker, w);
+        if (errno)
+            error(SYS, "failed to create pipeline worker");
+    }
+    pthread_sigmask(SIG_SETMASK, &old, 0);
+    debug("started %d pipeline workers with %d slots per ring",
+          PipeN, PipeDepth);
+}
+
+
+/*
+ * Set up a ring.  Each slot owns a message sized buffer; pipeline_init picks
+ * PipeDepth so that all rings together stay within PIPE_MEM unless even
+ * PIPE_MIN slots of that size would not fit.
+ */
+static void
+ring_init(RING *ring)
+{
+    int i;
+    char *bufs = qmalloc((long)PipeDepth * Req.msg_size);
+
+    memset(ring, 0, sizeof(*ring));
+    if (posix_memalign((void **)&ring->slots, 64, PipeDepth * sizeof(SLOT)))
+        error(0, "out of space");
+    memset(ring->slots, 0, PipeDepth * sizeof(SLOT));
+    for (i = 0; i < PipeDepth; ++i) {
+        ring->slots[i].seq = i;
+        ring->slots[i].buf = bufs + (long)i * Req.msg_size;
+    }
+}
+
+
+/*
+ * Return the processor after cpu that we are allowed to run on.
+ */
+static int
+next_cpu(cpu_set_t *set, int cpu)
+{
+    int i;
+
+    for (i = 1; i <= CPU_SETSIZE; ++i) {
+        int c = (cpu + i) % CPU_SETSIZE;
+
+        if (CPU_ISSET(c, set))
+            return c;
+    }
+    return cpu;
+}
+
+
+/*
+ * Return a buffer to receive the next message into, waiting for a worker to
+ * free one if the ring is full.
+ */
+void *
+pipeline_buf(void)
+{
+    RING *ring = &PipeRings[PipeShared ? 0 : PipeNext];
+    uint32_t pos = ring->head;
+    SLOT *slot = &ring->slots[pos & (PipeDepth-1)];
+
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos) {
+        PipeStalls++;
+        while (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos)
+            if (Finished)
+                break;
+    }
+    return slot->buf;
+}
+
+
+/*
+ * Hand a message to the workers.  It is either in the buffer returned by
+ * pipeline_buf or, as with RDMA, somewhere else.
+ */
+void
+pipeline_push(void *data, int len)
+{
+    RING *ring = &PipeRings[PipeShared ? 0 : PipeNext];
+    uint32_t pos = ring->head;
+    SLOT *slot = &ring->slots[pos & (PipeDepth-1)];
+
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos) {
+        pipeline_buf();
+        if (Finished)
+            return;
+    }
+    slot->data = data;
+    slot->len = len;
+    slot->time = get_nsecs();
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_SEQ_CST);
+    ring->head = pos + 1;
+    if (__atomic_load_n(&ring->sleepers, __ATOMIC_SEQ_CST))
+        futex(&slot->seq, FUTEX_WAKE_PRIVATE, INT_MAX);
+    if (!PipeShared && ++PipeNext == PipeN)
+        PipeNext = 0;
+}
+
+
+/*
+ * Stop the workers and note what they measured in LStat.
+ */
+void
+pipeline_stop(void)
+{
+    int i;
+    int j;
+    uint64_t msgs = 0;
+    uint64_t lat_sum = 0;
+    uint64_t lat_max = 0;
+    double rate = 0;
+    uint64_t time = get_nsecs() - PipeStart;
+
+    if (!PipeN)
+        return;
+    PipeStop = 1;
+    for (i = 0; i < (PipeShared ? 1 : PipeN); ++i)
+        for (j = 0; j < PipeDepth; ++j)
+            futex(&PipeRings[i].slots[j].seq, FUTEX_WAKE_PRIVATE, INT_MAX);
+    for (i = 0; i < PipeN; ++i) {
+        WORKER *w = &PipeWorkers[i];
+
+        pthread_join(w->thread, 0);
+        msgs += w->msgs;
+        lat_sum += w->lat_sum;
+        if (w->lat_max > lat_max)
+            lat_max = w->lat_max;
+        if (w->msgs && time > w->idle)
+            rate += w->msgs * 1E9 / (time - w->idle);
+    }
+    LStat.pipe_msgs = msgs;
+    LStat.pipe_stalls = PipeStalls;
+    LStat.pipe_lat_avg = msgs ? lat_sum / msgs : 0;
+    LStat.pipe_lat_max = lat_max;
+    LStat.pipe_rate = rate;
+
+    for (i = 0; i < (PipeShared ? 1 : PipeN); ++i) {
+        free(PipeRings[i].slots[0].buf);
+        free(PipeRings[i].slots);
+    }
+    free(PipeRings);
+    free(PipeWorkers);
+    PipeRings = 0;
+    PipeWorkers = 0;
+    PipeN = 0;
+}
+
+
+/*
+ * A worker.  The time it waits for messages is subtracted from the test time
+ * to give the rate it could have sustained.
+ */
+static void *
+pipe_worker(void *arg)
+{
+    WORKER *w = arg;
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(w->cpu, &set);
+    sched_setaffinity(0, sizeof(set), &set);
+    profile_thread();
+    for (;;) {
+        uint32_t pos;
+        uint64_t now;
+        uint64_t lat;
+        SLOT *slot = ring_claim(w, &pos);
+
+        if (!slot)
+            break;
+        now = get_nsecs();
+        lat = now > slot->time ? now - slot->time : 0;
+        w->lat_sum += lat;
+        if (lat > w->lat_max)
+            w->lat_max = lat;
+        w->msgs++;
+        if (Req.access_recv)
+            touch_data(slot->data, slot->len);
+        __atomic_store_n(&slot->seq, pos + PipeDepth, __ATOMIC_RELEASE);
+    }
+    return 0;
+}
+
+
+/*
+ * Take the next message from the ring of a worker, waiting for one to arrive.
+ * Return 0 if we are stopping.  In shared mode, workers race for a message
+ * with a compare and swap.  A worker only sleeps on a slot that the receive
+ * thread has yet to fill.
+ */
+static SLOT *
+ring_claim(WORKER *w, uint32_t *posp)
+{
+    int spin = 0;
+    uint64_t wait = 0;
+    RING *ring = w->ring;
+
+    for (;;) {
+        uint32_t pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+        SLOT *slot = &ring->slots[pos & (PipeDepth-1)];
+        uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+
+        if (seq == pos + 1) {
+            if (!PipeShared)
+                __atomic_store_n(&ring->tail, pos + 1, __ATOMIC_RELAXED);
+            else if (!__atomic_compare_exchange_n(&ring->tail, &pos, pos + 1,
+                                0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                continue;
+            if (wait)
+                w->idle += get_nsecs() - wait;
+            *posp = pos;
+            return slot;
+        }
+        if (PipeStop)
+            return 0;
+        if (!wait)
+            wait = get_nsecs();
+        if (!PipeFutex || seq != pos || ++spin < PIPE_SPIN)
+            continue;
+        __atomic_add_fetch(&ring->sleepers, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&slot->seq, __ATOMIC_SEQ_CST) == pos && !PipeStop)
+            futex(&slot->seq, FUTEX_WAIT_PRIVATE, pos);
+        __atomic_sub_fetch(&ring->sleepers, 1, __ATOMIC_SEQ_CST);
+        spin = 0;
+    }
+}
+
+
+/*
+ * Wait on or wake a futex.
+ */
+static int
+futex(uint32_t *addr, int op, uint32_t val)
+{
+    return syscall(SYS_futex, addr, op, val, 0, 0, 0);
+}
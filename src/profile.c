@@ -0,0 +1,859 @@
+/*
+ * qperf - sampling profiler.
+ * Measure socket and RDMA performance.
+ *
+ * Copyright (c) 2002-2009 Johann George.  All rights reserved.
+ * Copyright (c) 2006-2009 QLogic Corporation.  All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <link.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "qperf.h"
+
+
+/*
+ * Configurable parameters.
+ */
+#define PROF_FREQ   4999                /* Samples per second */
+#define PROF_PAGES  512                 /* Pages in each ring buffer */
+#define PROF_DEPTH  64                  /* Maximum frames in a stack */
+#define PROF_STACK  4096                /* Maximum length of a folded stack */
+#define PROF_DRAIN  100                 /* Milliseconds between drains */
+#define PROF_THREADS 64                 /* Maximum threads sampled */
+
+
+/*
+ * A symbol.
+ */
+typedef struct SYM {
+    uint64_t    addr;                   /* Address */
+    uint64_t    size;                   /* Size or 0 if not known */
+    char       *name;                   /* Name */
+} SYM;
+
+
+/*
+ * A table of symbols sorted by address.
+ */
+typedef struct SYMTAB {
+    int         loaded;                 /* We have tried to load it */
+    int         n;                      /* Number of symbols */
+    SYM        *syms;                   /* Symbols */
+} SYMTAB;
+
+
+/*
+ * The counter and ring buffer sampling one thread.
+ */
+typedef struct PROF {
+    int         fd;                     /* Counter */
+    void       *map;                    /* Ring buffer */
+} PROF;
+
+
+/*
+ * A distinct call chain and the number of samples with it.  The chain is as
+ * given by perf and includes the context markers.
+ */
+typedef struct CHAIN {
+    uint64_t   *ips;                    /* Addresses */
+    uint32_t    nr;                     /* Number of addresses */
+    uint32_t    count;                  /* Samples */
+    uint32_t    hash;                   /* Hash of the addresses */
+} CHAIN;
+
+
+/*
+ * A symbol and the number of samples in it.
+ */
+typedef struct TOP {
+    char       *name;                   /* Symbol */
+    uint32_t    count;                  /* Samples */
+} TOP;
+
+
+/*
+ * Function prototypes.
+ */
+static void     chain_add(uint64_t *ips, uint32_t nr);
+static void     drain(PROF *prof);
+static void    *drainer(void *arg);
+static int      exe_base(struct dl_phdr_info *info, size_t size, void *data);
+static char    *fold(void);
+static void     load_exe(SYMTAB *tab);
+static void     load_kernel(SYMTAB *tab);
+static int      perf_open(int kernel);
+static void     set_top(int node, char *text);
+static int      stack_cmp(const void *a, const void *b);
+static void     sym_add(SYMTAB *tab, uint64_t addr, uint64_t size, char *name);
+static int      sym_cmp(const void *a, const void *b);
+static SYM     *sym_find(SYMTAB *tab, uint64_t addr);
+static void     sym_name(uint64_t ip, int kernel, char *buf, int len);
+static int      top_cmp(const void *a, const void *b);
+
+
+/*
+ * Static variables.
+ */
+static uint32_t ChainMax;
+static uint32_t ChainN;
+static CHAIN   *Chains;
+static uint64_t ExeBase;
+static SYMTAB   ExeSyms;
+static SYMTAB   KernelSyms;
+static uint64_t Lost[2];
+static pthread_t ProfDrainer;
+static int      ProfDraining;
+static size_t   ProfLen;
+static pthread_mutex_t ProfLock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t ProfLost;
+static int      ProfN;
+static volatile int ProfOn;
+static volatile int ProfQuit;
+static PROF     Profs[PROF_THREADS];
+static char     Top[2][PROFILE_TOP][STRSIZE+16];
+
+
+/*
+ * Get ready to sample the call stacks of our threads.  The counters are
+ * enabled only while a test is timed.  A thread drains their ring buffers
+ * every PROF_DRAIN ms into a table of distinct call chains so that a long
+ * test does not overflow them.
+ */
+void
+profile_init(void)
+{
+    sigset_t all;
+    sigset_t old;
+
+    memset(Top, 0, sizeof(Top));
+    memset(Lost, 0, sizeof(Lost));
+    ProfN = 0;
+    ProfOn = 0;
+    ProfLost = 0;
+    if (!Req.profile)
+        return;
+    ProfLen = (PROF_PAGES+1) * sysconf(_SC_PAGESIZE);
+    ProfQuit = 0;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+    errno = pthread_create(&ProfDrainer, 0, drainer, 0);
+    pthread_sigmask(SIG_SETMASK, &old, 0);
+    if (errno) {
+        error(SYS|RET, "cannot start profile drainer");
+        return;
+    }
+    ProfDraining = 1;
+    profile_thread();
+}
+
+
+/*
+ * Start sampling the calling thread.  Each thread that does work for the test
+ * calls this so that it shows up in the profile.  If we may not sample the
+ * kernel, we sample user space only.
+ */
+void
+profile_thread(void)
+{
+    int fd;
+    void *map;
+
+    if (!ProfDraining)
+        return;
+    fd = perf_open(1);
+    if (fd < 0)
+        fd = perf_open(0);
+    if (fd < 0) {
+        error(SYS|RET, "cannot open profiling counter");
+        return;
+    }
+    map = mmap(0, ProfLen, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        error(SYS|RET, "cannot map profiling buffer");
+        close(fd);
+        return;
+    }
+
+    pthread_mutex_lock(&ProfLock);
+    if (ProfN == PROF_THREADS) {
+        pthread_mutex_unlock(&ProfLock);
+        munmap(map, ProfLen);
+        close(fd);
+        return;
+    }
+    Profs[ProfN].fd = fd;
+    Profs[ProfN].map = map;
+    ProfN++;
+    if (ProfOn)
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    pthread_mutex_unlock(&ProfLock);
+}
+
+
+/*
+ * Drain the ring buffers every PROF_DRAIN ms until told to quit.
+ */
+static void *
+drainer(void *arg)
+{
+    while (!ProfQuit) {
+        int i;
+
+        usleep(PROF_DRAIN * 1000);
+        pthread_mutex_lock(&ProfLock);
+        for (i = 0; i < ProfN; ++i)
+            drain(&Profs[i]);
+        pthread_mutex_unlock(&ProfLock);
+    }
+    return 0;
+}
+
+
+/*
+ * Move the samples in a ring buffer to the table of call chains and count
+ * those that the kernel lost because the buffer was full.
+ */
+static void
+drain(PROF *prof)
+{
+    uint64_t head;
+    uint64_t tail;
+    struct perf_event_mmap_page *page = prof->map;
+    long pagesize = sysconf(_SC_PAGESIZE);
+    uint8_t *data = (uint8_t *)prof->map + pagesize;
+    uint64_t size = ProfLen - pagesize;
+
+    head = page->data_head;
+    __sync_synchronize();
+    for (tail = page->data_tail; tail < head;) {
+        uint64_t rec[PROF_DEPTH+16];
+        struct perf_event_header *hdr = (void *)rec;
+        uint64_t *body = (uint64_t *)(hdr + 1);
+        uint64_t off = tail % size;
+        int rlen;
+
+        memcpy(hdr, &data[off], sizeof(*hdr));
+        rlen = hdr->size;
+        if (!rlen)
+            break;
+        tail += rlen;
+        if (rlen > sizeof(rec))
+            continue;
+        if (off + rlen <= size)
+            memcpy(rec, &data[off], rlen);
+        else {
+            memcpy(rec, &data[off], size-off);
+            memcpy((uint8_t *)rec + size-off, data, rlen - (size-off));
+        }
+
+        if (hdr->type == PERF_RECORD_LOST)
+            ProfLost += body[1];
+        else if (hdr->type == PERF_RECORD_SAMPLE && body[0] <= PROF_DEPTH+8)
+            chain_add(&body[1], body[0]);
+    }
+    __sync_synchronize();
+    page->data_tail = head;
+}
+
+
+/*
+ * Count a sample with a call chain, adding the chain to the table if it is
+ * new.  The table is open addressed and kept at most half full.
+ */
+static void
+chain_add(uint64_t *ips, uint32_t nr)
+{
+    uint32_t i;
+    uint32_t hash = 2166136261U;
+
+    for (i = 0; i < nr; ++i) {
+        hash ^= ips[i] ^ (ips[i] >> 32);
+        hash *= 16777619U;
+    }
+
+    if (2 * (ChainN+1) > ChainMax) {
+        uint32_t max = ChainMax ? 2*ChainMax : 1024;
+        CHAIN *chains = qmalloc(max * sizeof(*chains));
+
+        memset(chains, 0, max * sizeof(*chains));
+        for (i = 0; i < ChainMax; ++i) {
+            uint32_t j = Chains[i].hash & (max-1);
+
+            if (!Chains[i].ips)
+                continue;
+            while (chains[j].ips)
+                j = (j+1) & (max-1);
+            chains[j] = Chains[i];
+        }
+        free(Chains);
+        Chains = chains;
+        ChainMax = max;
+    }
+
+    for (i = hash & (ChainMax-1); Chains[i].ips; i = (i+1) & (ChainMax-1)) {
+        CHAIN *c = &Chains[i];
+
+        if (c->hash == hash && c->nr == nr &&
+            memcmp(c->ips, ips, nr * sizeof(*ips)) == 0) {
+            c->count++;
+            return;
+        }
+    }
+    Chains[i].ips = qmalloc((nr ? nr : 1) * sizeof(*ips));
+    memcpy(Chains[i].ips, ips, nr * sizeof(*ips));
+    Chains[i].nr = nr;
+    Chains[i].count = 1;
+    Chains[i].hash = hash;
+    ChainN++;
+}
+
+
+/*
+ * Open a counter that samples call chains based on our cpu time.
+ */
+static int
+perf_open(int kernel)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_SOFTWARE;
+    attr.config = PERF_COUNT_SW_TASK_CLOCK;
+    attr.freq = 1;
+    attr.sample_freq = PROF_FREQ;
+    attr.sample_type = PERF_SAMPLE_CALLCHAIN;
+    attr.sample_max_stack = PROF_DEPTH;
+    attr.disabled = 1;
+    attr.exclude_hv = 1;
+    attr.exclude_kernel = !kernel;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+
+/*
+ * Start sampling.
+ */
+void
+profile_start(void)
+{
+    int i;
+
+    ProfOn = 1;
+    for (i = 0; i < ProfN; ++i)
+        ioctl(Profs[i].fd, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+
+/*
+ * Stop sampling.  This may be called from a signal handler.
+ */
+void
+profile_stop(void)
+{
+    int i;
+
+    ProfOn = 0;
+    for (i = 0; i < ProfN; ++i)
+        ioctl(Profs[i].fd, PERF_EVENT_IOC_DISABLE, 0);
+}
+
+
+/*
+ * Send our folded stacks to the client.
+ */
+void
+profile_send(void)
+{
+    uint8_t head[12];
+    char *text;
+    int len;
+
+    if (!Req.profile)
+        return;
+    text = fold();
+    len = text ? strlen(text) : 0;
+    enc_init(head);
+    enc_int(len, 4);
+    enc_int(Lost[0], 8);
+    send_mesg(head, sizeof(head), "profile size");
+    if (len)
+        send_mesg(text, len, "profile");
+    free(text);
+}
+
+
+/*
+ * Receive the folded stacks of the server if it was profiling, note the
+ * symbols with the most samples on each node and, if file is set, write the
+ * stacks of both nodes to it with the node as the root of each stack.
+ */
+void
+profile_recv(int remote, char *file)
+{
+    int i;
+    char *text[2];
+    char *nodes[] ={ "client", "server" };
+
+    text[0] = fold();
+    text[1] = 0;
+    if (remote) {
+        uint8_t head[12];
+        int len;
+
+        recv_mesg(head, sizeof(head), "profile size");
+        dec_init(head);
+        len = dec_int(4);
+        Lost[1] = dec_int(8);
+        if (len) {
+            text[1] = qmalloc(len+1);
+            recv_mesg(text[1], len, "profile");
+            text[1][len] = '\0';
+        }
+    }
+    set_top(0, text[0]);
+    set_top(1, text[1]);
+
+    if (file && (text[0] || text[1])) {
+        FILE *fp = fopen(file, "w");
+
+        if (!fp)
+            error(SYS|RET, "cannot create %s", file);
+        for (i = 0; fp && i < 2; ++i) {
+            char *p = text[i];
+
+            while (p && *p) {
+                char *e = strchr(p, '\n');
+
+                fprintf(fp, "%s;%.*s\n", nodes[i], (int)(e-p), p);
+                p = e+1;
+            }
+        }
+        if (fp && fclose(fp) != SUCCESS0)
+            error(SYS|RET, "cannot write %s", file);
+    }
+    free(text[0]);
+    free(text[1]);
+}
+
+
+/*
+ * Return the number of samples a node lost because a ring buffer filled.
+ */
+uint64_t
+profile_lost(int node)
+{
+    return Lost[node];
+}
+
+
+/*
+ * Return a description of the symbol of a node with the ith most samples or 0
+ * if there is none.
+ */
+char *
+profile_top(int node, int i)
+{
+    return Top[node][i][0] ? Top[node][i] : 0;
+}
+
+
+/*
+ * Stop sampling, drain what is left in the ring buffers and fold the call
+ * chains into lines of the form "root;...;leaf count" sorted by stack.  Return
+ * 0 if there are none.
+ */
+static char *
+fold(void)
+{
+    int i;
+    int n = 0;
+    char *text;
+    size_t len = 0;
+    TOP *stacks;
+
+    if (!ProfDraining)
+        return 0;
+    ProfQuit = 1;
+    pthread_join(ProfDrainer, 0);
+    ProfDraining = 0;
+    for (i = 0; i < ProfN; ++i) {
+        drain(&Profs[i]);
+        munmap(Profs[i].map, ProfLen);
+        close(Profs[i].fd);
+    }
+    ProfN = 0;
+    Lost[0] = ProfLost;
+    if (ProfLost)
+        debug("profiler lost %llu samples", (unsigned long long)ProfLost);
+    if (!ChainN)
+        return 0;
+
+    stacks = qmalloc(ChainN * sizeof(*stacks));
+    for (i = 0; i < ChainMax; ++i) {
+        int j;
+        int m = 0;
+        int b = 0;
+        int kernel = 0;
+        char buf[PROF_STACK];
+        char *names[PROF_DEPTH+16];
+        CHAIN *c = &Chains[i];
+
+        if (!c->ips)
+            continue;
+        for (j = 0; j < c->nr && m < cardof(names); ++j) {
+            uint64_t ip = c->ips[j];
+            char name[STRSIZE];
+
+            if (ip >= PERF_CONTEXT_MAX) {
+                kernel = (ip == PERF_CONTEXT_KERNEL);
+                continue;
+            }
+            sym_name(ip, kernel, name, sizeof(name));
+            names[m++] = strdup(name);
+        }
+        while (m--) {
+            b += snprintf(&buf[b], sizeof(buf)-b, "%s%s",
+                          b ? ";" : "", names[m]);
+            if (b >= sizeof(buf))
+                b = sizeof(buf)-1;
+            free(names[m]);
+        }
+        stacks[n].name = strdup(buf);
+        stacks[n++].count = c->count;
+        free(c->ips);
+    }
+    free(Chains);
+    Chains = 0;
+    ChainMax = 0;
+    ChainN = 0;
+
+    qsort(stacks, n, sizeof(*stacks), stack_cmp);
+    for (i = 0; i < n; ++i)
+        len += strlen(stacks[i].name) + 12;
+    text = qmalloc(len+1);
+    len = 0;
+    for (i = 0; i < n;) {
+        int j = i;
+        uint32_t count = 0;
+
+        while (j < n && streq(stacks[j].name, stacks[i].name))
+            count += stacks[j++].count;
+        len += sprintf(&text[len], "%s %u\n", stacks[i].name, count);
+        while (i < j)
+            free(stacks[i++].name);
+    }
+    free(stacks);
+    return text;
+}
+
+
+/*
+ * Note the symbols at the leaf of the most samples in some folded stacks.
+ */
+static void
+set_top(int node, char *text)
+{
+    int i;
+    int n = 0;
+    int max = 0;
+    TOP *tops = 0;
+    uint64_t total = 0;
+    char *p = text;
+
+    while (p && *p) {
+        char *e = strchr(p, '\n');
+        char *c = e;
+        char *l;
+        uint32_t count;
+
+        while (c > p && *c != ' ')
+            --c;
+        count = strtoul(c+1, 0, 10);
+        *c = '\0';
+        l = strrchr(p, ';');
+        l = l ? l+1 : p;
+        for (i = 0; i < n; ++i)
+            if (streq(tops[i].name, l))
+                break;
+        if (i == n) {
+            if (n == max) {
+                max = max ? 2*max : 256;
+                tops = realloc(tops, max * sizeof(*tops));
+                if (!tops)
+                    error(0, "out of space");
+            }
+            tops[n].name = strdup(l);
+            tops[n++].count = 0;
+        }
+        tops[i].count += count;
+        total += count;
+        *c = ' ';
+        p = e+1;
+    }
+
+    qsort(tops, n, sizeof(*tops), top_cmp);
+    for (i = 0; i < n; ++i) {
+        if (i < PROFILE_TOP)
+            snprintf(Top[node][i], sizeof(Top[node][i]), "%.1f%% %.*s",
+                     100.0 * tops[i].count / total, STRSIZE, tops[i].name);
+        free(tops[i].name);
+    }
+    free(tops);
+}
+
+
+/*
+ * Compare two folded stacks.
+ */
+static int
+stack_cmp(const void *a, const void *b)
+{
+    return strcmp(((TOP *)a)->name, ((TOP *)b)->name);
+}
+
+
+/*
+ * Compare two symbols by the number of samples, most first.
+ */
+static int
+top_cmp(const void *a, const void *b)
+{
+    const TOP *x = a;
+    const TOP *y = b;
+
+    return (x->count < y->count) - (x->count > y->count);
+}
+
+
+/*
+ * Find the name of the function containing an address.  Kernel addresses are
+ * looked up in /proc/kallsyms.  User addresses are looked up in the symbol
+ * table of qperf and then in the dynamic symbols of shared libraries.  If we
+ * cannot find a name, we use that of the object it is in.
+ */
+static void
+sym_name(uint64_t ip, int kernel, char *buf, int len)
+{
+    SYM *sym;
+    Dl_info info;
+
+    if (kernel) {
+        if (!KernelSyms.loaded)
+            load_kernel(&KernelSyms);
+        sym = sym_find(&KernelSyms, ip);
+        snprintf(buf, len, "%s", sym ? sym->name : "[kernel]");
+        return;
+    }
+    if (!ExeSyms.loaded)
+        load_exe(&ExeSyms);
+    sym = sym_find(&ExeSyms, ip);
+    if (sym)
+        snprintf(buf, len, "%s", sym->name);
+    else if (!dladdr((void *)(uintptr_t)ip, &info) || !info.dli_fname)
+        snprintf(buf, len, "[unknown]");
+    else if (info.dli_sname)
+        snprintf(buf, len, "%s", info.dli_sname);
+    else {
+        char *p = strrchr(info.dli_fname, '/');
+        snprintf(buf, len, "[%s]", p ? p+1 : info.dli_fname);
+    }
+}
+
+
+/*
+ * Load the kernel text symbols.  If addresses are hidden from us, they all
+ * read as 0 and we leave the table empty.
+ */
+static void
+load_kernel(SYMTAB *tab)
+{
+    char line[BUFSIZ];
+    FILE *fp = fopen("/proc/kallsyms", "r");
+
+    tab->loaded = 1;
+    if (!fp)
+        return;
+    while (fgets(line, sizeof(line), fp)) {
+        unsigned long long addr;
+        char type;
+        char name[STRSIZE*2];
+
+        if (sscanf(line, "%llx %c %127s", &addr, &type, name) != 3)
+            continue;
+        if (type != 't' && type != 'T')
+            continue;
+        if (!addr)
+            break;
+        sym_add(tab, addr, 0, strdup(name));
+    }
+    fclose(fp);
+    qsort(tab->syms, tab->n, sizeof(*tab->syms), sym_cmp);
+}
+
+
+/*
+ * Load the function symbols of qperf itself, which are not in the dynamic
+ * symbol table.  If qperf has been stripped, there are none.
+ */
+static void
+load_exe(SYMTAB *tab)
+{
+    int i;
+    int fd;
+    struct stat st;
+    uint8_t *elf;
+    ElfW(Ehdr) *ehdr;
+    ElfW(Shdr) *shdr;
+
+    tab->loaded = 1;
+    dl_iterate_phdr(exe_base, 0);
+    fd = open("/proc/self/exe", O_RDONLY);
+    if (fd < 0)
+        return;
+    if (fstat(fd, &st) < 0 || st.st_size < sizeof(*ehdr)) {
+        close(fd);
+        return;
+    }
+    elf = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (elf == MAP_FAILED)
+        return;
+    ehdr = (void *)elf;
+    if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0 ||
+        ehdr->e_shoff + ehdr->e_shnum * sizeof(*shdr) > st.st_size)
+        return;
+    shdr = (void *)(elf + ehdr->e_shoff);
+    for (i = 0; i < ehdr->e_shnum; ++i) {
+        ElfW(Sym) *sym;
+        ElfW(Sym) *end;
+        char *str;
+
+        if (shdr[i].sh_type != SHT_SYMTAB || shdr[i].sh_link >= ehdr->e_shnum)
+            continue;
+        sym = (void *)(elf + shdr[i].sh_offset);
+        end = (void *)(elf + shdr[i].sh_offset + shdr[i].sh_size);
+        str = (char *)elf + shdr[shdr[i].sh_link].sh_offset;
+        for (; sym < end; ++sym) {
+            if (ELF64_ST_TYPE(sym->st_info) != STT_FUNC ||
+                !sym->st_value || !sym->st_size)
+                continue;
+            sym_add(tab, ExeBase + sym->st_value, sym->st_size,
+                    str + sym->st_name);
+        }
+    }
+    qsort(tab->syms, tab->n, sizeof(*tab->syms), sym_cmp);
+}
+
+
+/*
+ * Note the address at which qperf itself is loaded.  It is the first object
+ * that dl_iterate_phdr reports.
+ */
+static int
+exe_base(struct dl_phdr_info *info, size_t size, void *data)
+{
+    ExeBase = info->dlpi_addr;
+    return 1;
+}
+
+
+/*
+ * Add a symbol to a table.
+ */
+static void
+sym_add(SYMTAB *tab, uint64_t addr, uint64_t size, char *name)
+{
+    if (tab->n % 1024 == 0) {
+        tab->syms = realloc(tab->syms, (tab->n + 1024) * sizeof(*tab->syms));
+        if (!tab->syms)
+            error(0, "out of space");
+    }
+    tab->syms[tab->n].addr = addr;
+    tab->syms[tab->n].size = size;
+    tab->syms[tab->n].name = name;
+    tab->n++;
+}
+
+
+/*
+ * Compare two symbols by address.
+ */
+static int
+sym_cmp(const void *a, const void *b)
+{
+    const SYM *x = a;
+    const SYM *y = b;
+
+    return (x->addr > y->addr) - (x->addr < y->addr);
+}
+
+
+/*
+ * Find the symbol containing an address.  Symbols without a size extend to
+ * the next symbol.
+ */
+static SYM *
+sym_find(SYMTAB *tab, uint64_t addr)
+{
+    int lo = 0;
+    int hi = tab->n - 1;
+    SYM *sym;
+
+    if (!tab->n || addr < tab->syms[0].addr)
+        return 0;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+
+        if (tab->syms[mid].addr <= addr)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    sym = &tab->syms[lo];
+    if (sym->size && addr >= sym->addr + sym->size)
+        return 0;
+    return sym;
+}
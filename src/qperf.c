@@ -39,19 +39,27 @@
 #include <fcntl.h>
 #include <netdb.h>
 #include <sched.h>
+#include <dirent.h>
+#include <ifaddrs.h>
+#include <limits.h>
+#include <math.h>
 #include <stdio.h>
+#include <setjmp.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/wait.h>
 #include <sys/ioctl.h>
+#include <sys/prctl.h>
 #include <sys/times.h>
 #include <sys/select.h>
 #include <sys/utsname.h>
 #include "qperf.h"
+#include "libqperf.h"
 
 
 /*
@@ -61,21 +69,51 @@
  * VER_MAJ is reserved for major changes.
  */
 #define VER_MAJ 0                       /* Major version */
-#define VER_MIN 4                       /* Minor version */
-#define VER_INC 11                       /* Incremental version */
+#define VER_MIN 26                      /* Minor version */
+#define VER_INC 0                       /* Incremental version */
 #define LISTENQ 5                       /* Size of listen queue */
 #define BUFSIZE 1024                    /* Size of buffers */
+#define PREFAULT_SIZE (8*1024*1024)     /* Heap prefaulted by server workers */
+#define FIFO_PRIORITY 1                 /* SCHED_FIFO priority for --low_latency */
+#define ENERGY_MAX    16                /* Maximum energy counters */
+#define SAMPLE_MAGIC  "qperfsmp"        /* Sample file magic number */
+#define SAMPLE_VER    1                 /* Sample file version */
+#define SAMPLE_WIRE   20                /* Encoded size of a sample */
+#define HEAT_BUCKETS  QPERF_BUCKETS     /* Latency buckets in a heatmap row */
+#define HEAT_ROWS     64                /* Heatmap rows allocated at a time */
 
 
 /*
  * Default parameter values.
  */
 #define DEF_TIME        2               /* Test duration */
+#define DEF_SAMPLES     1000000         /* Samples with --sample_file */
+#define DEF_HEAT_BIN    100             /* Heatmap interval in ms */
 #define DEF_TIMEOUT     5               /* Timeout */
 #define DEF_PRECISION   3               /* Precision displayed */
 #define DEF_LISTEN_PORT 19765           /* Listen port */
 
 
+/*
+ * Value of Req.affinity that requests automatic placement.
+ */
+#define AFFINITY_AUTO   0xffffffff
+
+
+/*
+ * Low latency controls, as recorded in STAT.low_latency.
+ */
+#define LL_DMA_LATENCY  1               /* /dev/cpu_dma_latency held at 0 */
+#define LL_FIFO         2               /* SCHED_FIFO scheduling */
+#define LL_MLOCK        4               /* Memory locked and prefaulted */
+#define LL_NO_THP       8               /* Transparent huge pages disabled */
+
+
+#ifndef PR_SET_THP_DISABLE
+#define PR_SET_THP_DISABLE 41
+#endif
+
+
 /*
  * Option list.
  */
@@ -114,6 +152,15 @@ typedef struct PAR_INFO {
 } PAR_INFO;
 
 
+/*
+ * A variable that options set, whose default qperf_reset brings back.
+ */
+typedef struct OPT_VAR {
+    void       *ptr;                    /* Variable */
+    size_t      size;                   /* Size */
+} OPT_VAR;
+
+
 /*
  * Parameter name association.
  */
@@ -155,6 +202,52 @@ typedef struct SHOW {
 } SHOW;
 
 
+/*
+ * An energy counter.  These come from RAPL through powercap or from the
+ * amd_energy hwmon driver and count microjoules.
+ */
+typedef struct ENERGY {
+    int         fd;                     /* File descriptor of counter */
+    int         dram;                   /* Counter is for DRAM */
+    uint64_t    range;                  /* Counter wraps at this value */
+    uint64_t    start;                  /* Value at start of test */
+} ENERGY;
+
+
+/*
+ * Header of a sample file.  It is followed by count[0] client samples and
+ * count[1] server samples merged in order of time.
+ */
+typedef struct SAMPLE_HDR {
+    char        magic[8];               /* SAMPLE_MAGIC */
+    uint32_t    version;                /* SAMPLE_VER */
+    uint32_t    size;                   /* Size of a SAMPLE */
+    uint64_t    count[2];               /* Samples from client and server */
+    char        test[STRSIZE];          /* Test name */
+} SAMPLE_HDR;
+
+
+/*
+ * What a child running a test for the library sends back to qperf_run.
+ */
+typedef struct LIB_REPLY {
+    int             status;             /* 0 or -1 if the test failed */
+    char            error[256];         /* Last error or warning */
+    QPERF_RESULT    result;             /* Results of the test */
+} LIB_REPLY;
+
+
+/*
+ * Service time distributions.
+ */
+typedef enum {
+    SD_FIXED,
+    SD_EXP,
+    SD_BIMODAL,
+    SD_EMPIRICAL
+} SERVICE_DIST;
+
+
 /*
  * Configuration information.
  */
@@ -171,37 +264,68 @@ typedef struct CONF {
  */
 static void      add_ustat(USTAT *l, USTAT *r);
 static long      arg_long(char ***argvp);
+static long      arg_nsec(char ***argvp);
 static long      arg_size(char ***argvp);
 static char     *arg_strn(char ***argvp);
 static long      arg_time(char ***argvp);
 static void      calc_node(RESN *resn, STAT *stat);
 static void      calc_results(void);
 static void      client(TEST *test);
+static void      cpu_list(char *s, cpu_set_t *set);
+static void      cpu_mask(char *s, cpu_set_t *set);
 static int       cmpsub(char *s2, char *s1);
 static char     *commify(char *data);
+#ifndef LIBQPERF
 static void      dec_req_data(REQ *host);
 static void      dec_req_version(REQ *host);
+#endif
 static void      dec_stat(STAT *host);
 static void      dec_ustat(USTAT *host);
+#ifndef LIBQPERF
 static void      do_args(char *args[]);
 static void      do_loop(LOOP *loop, TEST *test);
+#endif
 static void      do_option(OPTION *option, char ***argvp);
 static void      enc_req(REQ *host);
 static void      enc_stat(STAT *host);
 static void      enc_ustat(USTAT *host);
+static void      energy_add(char *dir, char *file, int dram, uint64_t range);
+static void      energy_end(void);
+static void      energy_init(void);
+static int       energy_read(ENERGY *e, uint64_t *value);
+static void      energy_start(void);
 static TEST     *find_test(char *name);
 static OPTION   *find_option(char *name);
 static void      get_conf(CONF *conf);
 static void      get_cpu(CONF *conf);
 static void      get_times(CLOCK timex[T_N]);
+static void      heat_add(uint64_t time, uint64_t latency);
+static int       heat_bucket(uint64_t latency);
+static uint64_t  heat_floor(int bucket);
+static void      heat_init(void);
+static void      heat_write(void);
 static void      initialize(void);
+static void      lib_child(int fd, char *server, TEST *test);
+static void      lib_enter(sigjmp_buf *jump);
+static int       lib_fail(void);
+static void      lib_leave(void);
+static int       lib_read(int fd, void *ptr, int len);
+static void      lib_result(QPERF_RESULT *result);
+static void      lib_result_node(QPERF_NODE *node, RESN *resn, STAT *stat);
+static void      lib_write(int fd, void *ptr, int len);
 static void      init_lstat(void);
+static void      irq_cpus(char *irq, cpu_set_t *set);
+static int       is_rdma_test(void);
 static char     *loop_arg(char **pp);
 static int       nice_1024(char *pref, char *name, long long value);
+static int       nic_device(char *path, int len, char *name);
+static void      nic_irqs(char *path, cpu_set_t *set);
+static void      opt_save(void);
 static PAR_INFO *par_info(PAR_INDEX index);
 static PAR_INFO *par_set(char *name, PAR_INDEX index);
 static int       par_isset(PAR_INDEX index);
 static void      parse_loop(char ***argvp);
+static double    path_mig_delay(uint64_t when);
 static void      place_any(char *pref, char *name, char *unit, char *data,
                            char *altn);
 static void      place_show(void);
@@ -212,40 +336,85 @@ static void      run_client_conf(void);
 static void      run_client_quit(void);
 static void      run_server_conf(void);
 static void      run_server_quit(void);
+static int       same_addr(SA *a, SA *b);
+static void      sample_init(void);
+static void      sample_merge(void);
+static void      sample_send(void);
+#ifndef LIBQPERF
 static void      server(void);
 static void      server_listen(void);
+static void      server_prefork(void);
 static int       server_recv_request(void);
+static void      server_request(void);
+static void      server_worker(void);
+#endif
+static int       service_cmp(const void *a, const void *b);
+#ifndef LIBQPERF
+static void      service_init(void);
+#endif
+static void      service_load(char *file);
+static uint64_t  service_next(void);
+static uint64_t  service_rand(void);
 static void      set_affinity(void);
+static void      set_affinity_auto(void);
+static void      set_low_latency(void);
 static void      set_signals(void);
+static void      show_affinity(char *pref, STAT *stat);
+static void      show_cgroup(char *pref, REQ *req, STAT *stat);
+static void      show_compress(void);
 static void      show_debug(void);
+static void      show_low_latency(char *pref, uint32_t level, STAT *stat);
+static void      show_pipeline(char *pref, STAT *stat);
+static void      show_fault(void);
 static void      show_info(MEASURE measure);
+static void      show_profile(void);
+static void      show_qos(void);
+static void      show_rails(void);
 static void      show_rest(void);
+static void      show_stages(void);
+static void      show_ud_cqs(void);
+static void      show_ud_dests(void);
 static void      show_used(void);
+static void      show_zerocopy(char *pref, REQ *req, STAT *stat);
 static void      sig_alrm(int signo, siginfo_t *siginfo, void *ucontext);
 static void      sig_quit(int signo, siginfo_t *siginfo, void *ucontext);
 static void      sig_urg(int signo, siginfo_t *siginfo, void *ucontext);
 static char     *skip_colon(char *s);
+static void      stage_calc(void);
 static void      start_test_timer(int seconds);
+static long      str_nsec(char *str, char *arg);
 static long      str_size(char *arg, char *str);
 static void      strncopy(char *d, char *s, int n);
+static void      test_path(char *path, int len, char *file);
 static char     *two_args(char ***argvp);
 static int       verbose(int type, double value);
+#ifndef LIBQPERF
 static void      version_error(void);
+#endif
+static void      view_affinity(int type, char *pref, char *name, uint32_t value);
 static void      view_band(int type, char *pref, char *name, double value);
 static void      view_cost(int type, char *pref, char *name, double value);
 static void      view_cpus(int type, char *pref, char *name, double value);
+static void      view_energy_gb(int type, char *pref, char *name,
+                                double value);
+static void      view_energy_msg(int type, char *pref, char *name,
+                                 double value);
 static void      view_rate(int type, char *pref, char *name, double value);
 static void      view_long(int type, char *pref, char *name, long long value);
+static void      view_pcnt(int type, char *pref, char *name, double value);
 static void      view_size(int type, char *pref, char *name, long long value);
 static void      view_strn(int type, char *pref, char *name, char *value);
 static void      view_time(int type, char *pref, char *name, double value);
+static void      view_watt(int type, char *pref, char *name, double value);
 
 
 /*
  * Configurable variables.
  */
+static int  HeatBin         = DEF_HEAT_BIN;
 static int  ListenPort      = DEF_LISTEN_PORT;
 static int  Precision       = DEF_PRECISION;
+static int  Prefork         = 0;
 static int  ServerWait      = DEF_TIMEOUT;
 static int  UseBitsPerSec   = 0;
 
@@ -255,10 +424,47 @@ static int  UseBitsPerSec   = 0;
  */
 static REQ      RReq;
 static STAT     IStat;
+static int      DmaLatencyFD = -1;
+static ENERGY   Energy[ENERGY_MAX];
+static int      EnergyN;
+static uint32_t *Heat;
+static char    *HeatFile;
+static int      HeatRows;
+static int      HeatUsed;
+static uint32_t *LatHist;
+static char     LibError[256];
+static sigjmp_buf *LibJump;
+#ifndef LIBQPERF
 static int      ListenFD;
+#endif
 static LOOP    *Loops;
+static char    *OptSaved;
+#ifndef LIBQPERF
+static int      PreforkFD = -1;
+#endif
 static int      ProcStatFD;
+static char    *ProfileFile;
+#ifndef LIBQPERF
+static double   ReqTime;
+#endif
 static STAT     RStat;
+static uint64_t SampleBase;
+static int      SampleFD = -1;
+static char    *SampleFile;
+static size_t   SampleLen;
+static void    *SampleMap;
+static uint32_t SampleMax;
+static uint32_t SampleN;
+static SAMPLE  *Samples;
+static uint32_t ServiceAlt;
+static char    *ServiceBuf;
+static SERVICE_DIST ServiceDist;
+static int      ServiceOn;
+static uint32_t ServicePct;
+static uint64_t ServiceSeed;
+static uint32_t StageHist[S_N][HEAT_BUCKETS];
+static uint64_t StageSum[S_N];
+static uint32_t StageMsgs[S_N];
 static int      ShowIndex;
 static SHOW     ShowTable[256];
 static int      UnifyUnits;
@@ -276,11 +482,13 @@ RES          Res;
 REQ          Req;
 STAT         LStat;
 char        *TestName;
+char        *Rails;
 char        *ServerName;
 SS           ServerAddr;
 int          ServerAddrLen;
 int          RemoteFD;
 int          Debug;
+int          Library;
 volatile int Finished;
 
 
@@ -292,20 +500,44 @@ PAR_NAME ParName[] ={
     { "access_recv",    L_ACCESS_RECV,    R_ACCESS_RECV   },
     { "affinity",       L_AFFINITY,       R_AFFINITY      },
     { "alt_port",       L_ALT_PORT,       R_ALT_PORT      },
+    { "breakdown",      L_BREAKDOWN,      R_BREAKDOWN     },
+    { "cgroup_cpu",     L_CGROUP_CPU,     R_CGROUP_CPU    },
+    { "cgroup_cpuset",  L_CGROUP_CPUSET,  R_CGROUP_CPUSET },
+    { "cgroup_mem",     L_CGROUP_MEM,     R_CGROUP_MEM    },
+    { "cold_cache",     L_COLD_CACHE,     R_COLD_CACHE    },
+    { "compress",       L_COMPRESS,       R_COMPRESS      },
+    { "compress_level", L_COMPRESS_LEVEL, R_COMPRESS_LEVEL },
+    { "compress_pct",   L_COMPRESS_PCT,   R_COMPRESS_PCT  },
     { "flip",           L_FLIP,           R_FLIP          },
     { "id",             L_ID,             R_ID            },
+    { "low_latency",    L_LOW_LATENCY,    R_LOW_LATENCY   },
     { "msg_size",       L_MSG_SIZE,       R_MSG_SIZE      },
     { "mtu_size",       L_MTU_SIZE,       R_MTU_SIZE      },
     { "no_msgs",        L_NO_MSGS,        R_NO_MSGS       },
+    { "pipeline",       L_PIPELINE,       R_PIPELINE      },
+    { "pipeline_mode",  L_PIPELINE_MODE,  R_PIPELINE_MODE },
     { "poll_mode",      L_POLL_MODE,      R_POLL_MODE     },
     { "port",           L_PORT,           R_PORT          },
+    { "profile",        L_PROFILE,        R_PROFILE       },
+    { "qos_dscp",       L_QOS_DSCP,       R_QOS_DSCP      },
+    { "qos_priority",   L_QOS_PRIORITY,   R_QOS_PRIORITY  },
+    { "rails",          L_RAILS,          R_RAILS         },
     { "rd_atomic",      L_RD_ATOMIC,      R_RD_ATOMIC     },
+    { "samples",        L_SAMPLES,        R_SAMPLES       },
+    { "service_dist",   L_SERVICE_DIST,   R_SERVICE_DIST  },
+    { "service_time",   L_SERVICE_TIME,   R_SERVICE_TIME  },
+    { "service_touch",  L_SERVICE_TOUCH,  R_SERVICE_TOUCH },
     { "service_level",  L_SL,             R_SL            },
     { "sock_buf_size",  L_SOCK_BUF_SIZE,  R_SOCK_BUF_SIZE },
     { "src_path_bits",  L_SRC_PATH_BITS,  R_SRC_PATH_BITS },
     { "time",           L_TIME,           R_TIME          },
     { "timeout",        L_TIMEOUT,        R_TIMEOUT       },
+    { "ud_cqs",         L_UD_CQS,         R_UD_CQS        },
+    { "ud_dests",       L_UD_DESTS,       R_UD_DESTS      },
+    { "ud_random",      L_UD_RANDOM,      R_UD_RANDOM     },
     { "use_cm",         L_USE_CM,         R_USE_CM        },
+    { "xdp_mode",       L_XDP_MODE,       R_XDP_MODE      },
+    { "zerocopy_recv",  L_ZEROCOPY_RECV,  R_ZEROCOPY_RECV },
 };
 
 
@@ -317,26 +549,64 @@ PAR_INFO ParInfo[P_N] ={
     { P_NULL,                                       },
     { L_ACCESS_RECV,    'l',  &Req.access_recv      },
     { R_ACCESS_RECV,    'l',  &RReq.access_recv     },
-    { L_AFFINITY,       'l',  &Req.affinity         },
-    { R_AFFINITY,       'l',  &RReq.affinity        },
+    { L_AFFINITY,       'a',  &Req.affinity         },
+    { R_AFFINITY,       'a',  &RReq.affinity        },
     { L_ALT_PORT,       'l',  &Req.alt_port         },
     { R_ALT_PORT,       'l',  &RReq.alt_port        },
+    { L_BREAKDOWN,      'l',  &Req.breakdown        },
+    { R_BREAKDOWN,      'l',  &RReq.breakdown       },
+    { L_CGROUP_CPU,     'p',  &Req.cgroup_cpu       },
+    { R_CGROUP_CPU,     'p',  &RReq.cgroup_cpu      },
+    { L_CGROUP_CPUSET,  'p',  &Req.cgroup_cpuset    },
+    { R_CGROUP_CPUSET,  'p',  &RReq.cgroup_cpuset   },
+    { L_CGROUP_MEM,     'p',  &Req.cgroup_mem       },
+    { R_CGROUP_MEM,     'p',  &RReq.cgroup_mem      },
+    { L_COLD_CACHE,     'l',  &Req.cold_cache       },
+    { R_COLD_CACHE,     'l',  &RReq.cold_cache      },
+    { L_COMPRESS,       'p',  &Req.compress         },
+    { R_COMPRESS,       'p',  &RReq.compress        },
+    { L_COMPRESS_LEVEL, 'l',  &Req.compress_level   },
+    { R_COMPRESS_LEVEL, 'l',  &RReq.compress_level  },
+    { L_COMPRESS_PCT,   'l',  &Req.compress_pct     },
+    { R_COMPRESS_PCT,   'l',  &RReq.compress_pct    },
     { L_FLIP,           'l',  &Req.flip             },
     { R_FLIP,           'l',  &RReq.flip            },
     { L_ID,             'p',  &Req.id               },
     { R_ID,             'p',  &RReq.id              },
+    { L_LOW_LATENCY,    'l',  &Req.low_latency      },
+    { R_LOW_LATENCY,    'l',  &RReq.low_latency     },
     { L_MSG_SIZE,       's',  &Req.msg_size         },
     { R_MSG_SIZE,       's',  &RReq.msg_size        },
     { L_MTU_SIZE,       's',  &Req.mtu_size         },
     { R_MTU_SIZE,       's',  &RReq.mtu_size        },
     { L_NO_MSGS,        'l',  &Req.no_msgs          },
     { R_NO_MSGS,        'l',  &RReq.no_msgs         },
+    { L_PIPELINE,       'l',  &Req.pipeline         },
+    { R_PIPELINE,       'l',  &RReq.pipeline        },
+    { L_PIPELINE_MODE,  'p',  &Req.pipeline_mode    },
+    { R_PIPELINE_MODE,  'p',  &RReq.pipeline_mode   },
     { L_POLL_MODE,      'l',  &Req.poll_mode        },
     { R_POLL_MODE,      'l',  &RReq.poll_mode       },
     { L_PORT,           'l',  &Req.port             },
     { R_PORT,           'l',  &RReq.port            },
+    { L_PROFILE,        'l',  &Req.profile          },
+    { R_PROFILE,        'l',  &RReq.profile         },
+    { L_QOS_DSCP,       'l',  &Req.qos_dscp         },
+    { R_QOS_DSCP,       'l',  &RReq.qos_dscp        },
+    { L_QOS_PRIORITY,   'l',  &Req.qos_priority     },
+    { R_QOS_PRIORITY,   'l',  &RReq.qos_priority    },
+    { L_RAILS,          'l',  &Req.rails            },
+    { R_RAILS,          'l',  &RReq.rails           },
     { L_RD_ATOMIC,      'l',  &Req.rd_atomic        },
     { R_RD_ATOMIC,      'l',  &RReq.rd_atomic       },
+    { L_SAMPLES,        'l',  &Req.samples          },
+    { R_SAMPLES,        'l',  &RReq.samples         },
+    { L_SERVICE_DIST,   'p',  &Req.service_dist     },
+    { R_SERVICE_DIST,   'p',  &RReq.service_dist    },
+    { L_SERVICE_TIME,   'l',  &Req.service_time     },
+    { R_SERVICE_TIME,   'l',  &RReq.service_time    },
+    { L_SERVICE_TOUCH,  's',  &Req.service_touch    },
+    { R_SERVICE_TOUCH,  's',  &RReq.service_touch   },
     { L_SL,             'l',  &Req.sl               },
     { R_SL,             'l',  &RReq.sl              },
     { L_SOCK_BUF_SIZE,  's',  &Req.sock_buf_size    },
@@ -349,8 +619,18 @@ PAR_INFO ParInfo[P_N] ={
     { R_TIME,           't',  &RReq.time            },
     { L_TIMEOUT,        't',  &Req.timeout          },
     { R_TIMEOUT,        't',  &RReq.timeout         },
+    { L_UD_CQS,         'l',  &Req.ud_cqs           },
+    { R_UD_CQS,         'l',  &RReq.ud_cqs          },
+    { L_UD_DESTS,       'l',  &Req.ud_dests         },
+    { R_UD_DESTS,       'l',  &RReq.ud_dests        },
+    { L_UD_RANDOM,      'l',  &Req.ud_random        },
+    { R_UD_RANDOM,      'l',  &RReq.ud_random       },
     { L_USE_CM,         'l',  &Req.use_cm           },
     { R_USE_CM,         'l',  &RReq.use_cm          },
+    { L_XDP_MODE,       'p',  &Req.xdp_mode         },
+    { R_XDP_MODE,       'p',  &RReq.xdp_mode        },
+    { L_ZEROCOPY_RECV,  'l',  &Req.zerocopy_recv    },
+    { R_ZEROCOPY_RECV,  'l',  &RReq.zerocopy_recv   },
 };
 
 
@@ -431,17 +711,63 @@ OPTION Options[] ={
     {   "-lap",               "int",   L_ALT_PORT,                      },
     {  "--rem_alt_port",      "int",   R_ALT_PORT                       },
     {   "-rap",               "int",   R_ALT_PORT                       },
-    { "--cpu_affinity",       "int",   L_AFFINITY,      R_AFFINITY      },
-    {   "-ca",                "int",   L_AFFINITY,      R_AFFINITY      },
-    {  "--loc_cpu_affinity",  "int",   L_AFFINITY,                      },
-    {   "-lca",               "int",   L_AFFINITY,                      },
-    {  "--rem_cpu_affinity",  "int",   R_AFFINITY                       },
-    {   "-rca",               "int",   R_AFFINITY                       },
+    { "--breakdown",          "int",   L_BREAKDOWN,     R_BREAKDOWN     },
+    {   "-bd",                "int",   L_BREAKDOWN,     R_BREAKDOWN     },
+    {   "-bd1",               "set1",  L_BREAKDOWN,     R_BREAKDOWN     },
+    { "--cgroup_cpu",         "str",   L_CGROUP_CPU,    R_CGROUP_CPU    },
+    {   "-cgc",               "str",   L_CGROUP_CPU,    R_CGROUP_CPU    },
+    {  "--loc_cgroup_cpu",    "str",   L_CGROUP_CPU,                    },
+    {   "-lcgc",              "str",   L_CGROUP_CPU,                    },
+    {  "--rem_cgroup_cpu",    "str",   R_CGROUP_CPU                     },
+    {   "-rcgc",              "str",   R_CGROUP_CPU                     },
+    { "--cgroup_cpuset",      "str",   L_CGROUP_CPUSET, R_CGROUP_CPUSET },
+    {   "-cgs",               "str",   L_CGROUP_CPUSET, R_CGROUP_CPUSET },
+    {  "--loc_cgroup_cpuset", "str",   L_CGROUP_CPUSET,                 },
+    {   "-lcgs",              "str",   L_CGROUP_CPUSET,                 },
+    {  "--rem_cgroup_cpuset", "str",   R_CGROUP_CPUSET                  },
+    {   "-rcgs",              "str",   R_CGROUP_CPUSET                  },
+    { "--cgroup_dir",         "Scgd",                                   },
+    {   "-cgd",               "Scgd",                                   },
+    { "--cgroup_mem",         "str",   L_CGROUP_MEM,    R_CGROUP_MEM    },
+    {   "-cgm",               "str",   L_CGROUP_MEM,    R_CGROUP_MEM    },
+    {  "--loc_cgroup_mem",    "str",   L_CGROUP_MEM,                    },
+    {   "-lcgm",              "str",   L_CGROUP_MEM,                    },
+    {  "--rem_cgroup_mem",    "str",   R_CGROUP_MEM                     },
+    {   "-rcgm",              "str",   R_CGROUP_MEM                     },
+    { "--cold_cache",         "int",   L_COLD_CACHE,    R_COLD_CACHE    },
+    {   "-cc",                "int",   L_COLD_CACHE,    R_COLD_CACHE    },
+    {   "-cc1",               "set1",  L_COLD_CACHE,    R_COLD_CACHE    },
+    { "--compress",           "str",   L_COMPRESS,      R_COMPRESS      },
+    {   "-z",                 "str",   L_COMPRESS,      R_COMPRESS      },
+    { "--compress_level",     "int",   L_COMPRESS_LEVEL, R_COMPRESS_LEVEL },
+    {   "-zl",                "int",   L_COMPRESS_LEVEL, R_COMPRESS_LEVEL },
+    { "--compress_pct",       "int",   L_COMPRESS_PCT,  R_COMPRESS_PCT  },
+    {   "-zp",                "int",   L_COMPRESS_PCT,  R_COMPRESS_PCT  },
+    { "--cpu_affinity",       "affinity", L_AFFINITY,   R_AFFINITY      },
+    {   "-ca",                "affinity", L_AFFINITY,   R_AFFINITY      },
+    {  "--loc_cpu_affinity",  "affinity", L_AFFINITY,                   },
+    {   "-lca",               "affinity", L_AFFINITY,                   },
+    {  "--rem_cpu_affinity",  "affinity", R_AFFINITY                    },
+    {   "-rca",               "affinity", R_AFFINITY                    },
     { "--debug",              "Sdebug",                                 },
     {   "-D",                 "Sdebug",                                 },
+    { "--fault_at",           "fa",                                     },
+    {   "-fa",                "fa",                                     },
+    { "--fault_dev",          "fd",                                     },
+    {   "-fd",                "fd",                                     },
+    { "--fault_kind",         "fk",                                     },
+    {   "-fk",                "fk",                                     },
+    { "--fault_len",          "fl",                                     },
+    {   "-fl",                "fl",                                     },
+    { "--fault_loss",         "fp",                                     },
+    {   "-fp",                "fp",                                     },
     { "--flip",               "int",   L_FLIP,          R_FLIP          },
     {   "-f",                 "int",   L_FLIP,          R_FLIP          },
     {   "-f1",                "set1",  L_FLIP,          R_FLIP          },
+    { "--heatmap",            "hm",                                     },
+    {   "-hm",                "hm",                                     },
+    { "--heatmap_bin",        "hmb",                                    },
+    {   "-hmb",               "hmb",                                    },
     { "--help",               "help"                                    }, 
     {   "-h",                 "help"                                    }, 
     { "--host",               "host",                                   },
@@ -454,6 +780,12 @@ OPTION Options[] ={
     {   "-ri",                "str",   R_ID                             },
     { "--listen_port",        "Slp",                                    },
     {   "-lp",                "Slp",                                    },
+    { "--low_latency",        "int",   L_LOW_LATENCY,   R_LOW_LATENCY   },
+    {   "-ll",                "int",   L_LOW_LATENCY,   R_LOW_LATENCY   },
+    {  "--loc_low_latency",   "int",   L_LOW_LATENCY                    },
+    {   "-lll",               "int",   L_LOW_LATENCY                    },
+    {  "--rem_low_latency",   "int",   R_LOW_LATENCY                    },
+    {   "-rll",               "int",   R_LOW_LATENCY                    },
     { "--loop",               "loop",                                   },
     {   "-oo",                "loop",                                   },
     { "--msg_size",           "size",  L_MSG_SIZE,      R_MSG_SIZE      },
@@ -462,6 +794,14 @@ OPTION Options[] ={
     {   "-mt",                "size",  L_MTU_SIZE,      R_MTU_SIZE      },
     { "--no_msgs",            "int",   L_NO_MSGS,       R_NO_MSGS       },
     {   "-n",                 "int",   L_NO_MSGS,       R_NO_MSGS       },
+    { "--pipeline",           "int",   L_PIPELINE,      R_PIPELINE      },
+    {   "-pl",                "int",   L_PIPELINE,      R_PIPELINE      },
+    {  "--loc_pipeline",      "int",   L_PIPELINE                       },
+    {   "-lpl",               "int",   L_PIPELINE                       },
+    {  "--rem_pipeline",      "int",   R_PIPELINE                       },
+    {   "-rpl",               "int",   R_PIPELINE                       },
+    { "--pipeline_mode",      "str",   L_PIPELINE_MODE, R_PIPELINE_MODE },
+    {   "-plm",               "str",   L_PIPELINE_MODE, R_PIPELINE_MODE },
     { "--cq_poll",            "int",   L_POLL_MODE,     R_POLL_MODE     },
     {  "-cp",                 "int",   L_POLL_MODE,     R_POLL_MODE     },
     {   "-cp1",               "set1",  L_POLL_MODE,     R_POLL_MODE     },
@@ -475,18 +815,51 @@ OPTION Options[] ={
     {   "-ip",                "int",   L_PORT,          R_PORT          },
     { "--precision",          "precision",                              },
     {   "-e",                 "precision",                              },
+    { "--prefork",            "Spf",                                    },
+    {   "-pf",                "Spf",                                    },
+    { "--profile",            "int",   L_PROFILE,       R_PROFILE       },
+    {   "-pr",                "int",   L_PROFILE,       R_PROFILE       },
+    {   "-pr1",               "set1",  L_PROFILE,       R_PROFILE       },
+    {  "--loc_profile",       "int",   L_PROFILE                        },
+    {   "-lpr",               "int",   L_PROFILE                        },
+    {  "--rem_profile",       "int",   R_PROFILE                        },
+    {   "-rpr",               "int",   R_PROFILE                        },
+    { "--profile_file",       "prf",                                    },
+    {   "-prf",               "prf",                                    },
+    { "--qos_dscp",           "int",   L_QOS_DSCP,      R_QOS_DSCP      },
+    {   "-qd",                "int",   L_QOS_DSCP,      R_QOS_DSCP      },
+    { "--qos_priority",       "int",   L_QOS_PRIORITY,  R_QOS_PRIORITY  },
+    {   "-qp",                "int",   L_QOS_PRIORITY,  R_QOS_PRIORITY  },
+    { "--rails",              "rails",                                  },
+    {   "-rl",                "rails",                                  },
     { "--rd_atomic",          "int",   L_RD_ATOMIC,     R_RD_ATOMIC     },
     {   "-nr",                "int",   L_RD_ATOMIC,     R_RD_ATOMIC     },
     {  "--loc_rd_atomic",     "int",   L_RD_ATOMIC,                     },
     {   "-lnr",               "int",   L_RD_ATOMIC,                     },
     {  "--rem_rd_atomic",     "int",   R_RD_ATOMIC                      },
     {   "-rnr",               "int",   R_RD_ATOMIC                      },
+    { "--sample_file",        "sf",                                     },
+    {   "-sf",                "sf",                                     },
+    { "--samples",            "int",   L_SAMPLES,       R_SAMPLES       },
+    {   "-sa",                "int",   L_SAMPLES,       R_SAMPLES       },
+    {  "--loc_samples",       "int",   L_SAMPLES                        },
+    {   "-lsa",               "int",   L_SAMPLES                        },
+    {  "--rem_samples",       "int",   R_SAMPLES                        },
+    {   "-rsa",               "int",   R_SAMPLES                        },
+    { "--service_dist",       "str",   R_SERVICE_DIST                   },
+    {   "-svd",               "str",   R_SERVICE_DIST                   },
+    { "--service_file",       "svf",                                    },
+    {   "-svf",               "svf",                                    },
     { "--service_level",      "sl",    L_SL,            R_SL            },
     {   "-sl",                "sl",    L_SL,            R_SL            },
     {  "--loc_service_level", "sl",    L_SL                             },
     {   "-lsl",               "sl",    L_SL                             },
     {  "--rem_service_level", "sl",    R_SL                             },
     {   "-rsl",               "sl",    R_SL                             },
+    { "--service_time",       "nsec",  R_SERVICE_TIME                   },
+    {   "-svt",               "nsec",  R_SERVICE_TIME                   },
+    { "--service_touch",      "size",  R_SERVICE_TOUCH                  },
+    {   "-svm",               "size",  R_SERVICE_TOUCH                  },
     { "--sock_buf_size",      "size",  L_SOCK_BUF_SIZE, R_SOCK_BUF_SIZE },
     {   "-sb",                "size",  L_SOCK_BUF_SIZE, R_SOCK_BUF_SIZE },
     {  "--loc_sock_buf_size", "size",  L_SOCK_BUF_SIZE                  },
@@ -513,6 +886,13 @@ OPTION Options[] ={
     {   "-lto",               "Stime", L_TIMEOUT                        },
     {  "--rem_timeout",       "time",  R_TIMEOUT                        },
     {   "-rto",               "time",  R_TIMEOUT                        },
+    { "--ud_cqs",             "int",   L_UD_CQS,        R_UD_CQS        },
+    {   "-uc",                "int",   L_UD_CQS,        R_UD_CQS        },
+    { "--ud_dests",           "int",   L_UD_DESTS,      R_UD_DESTS      },
+    {   "-ud",                "int",   L_UD_DESTS,      R_UD_DESTS      },
+    { "--ud_random",          "int",   L_UD_RANDOM,     R_UD_RANDOM     },
+    {   "-ur",                "int",   L_UD_RANDOM,     R_UD_RANDOM     },
+    {   "-ur1",               "set1",  L_UD_RANDOM,     R_UD_RANDOM     },
     { "--unify_nodes",        "un",                                     },
     {   "-un",                "un",                                     },
     { "--unify_units",        "uu",                                     },
@@ -546,6 +926,51 @@ OPTION Options[] ={
     {   "-V",                 "version",                                },
     { "--wait_server",        "wait",                                   },
     {   "-ws",                "wait",                                   },
+    { "--xdp_mode",           "str",   L_XDP_MODE,      R_XDP_MODE      },
+    {   "-xm",                "str",   L_XDP_MODE,      R_XDP_MODE      },
+    {  "--loc_xdp_mode",      "str",   L_XDP_MODE,                      },
+    {   "-lxm",               "str",   L_XDP_MODE,                      },
+    {  "--rem_xdp_mode",      "str",   R_XDP_MODE                       },
+    {   "-rxm",               "str",   R_XDP_MODE                       },
+    { "--zerocopy_recv",      "int",   L_ZEROCOPY_RECV, R_ZEROCOPY_RECV },
+    {   "-zr",                "int",   L_ZEROCOPY_RECV, R_ZEROCOPY_RECV },
+    {   "-zr1",               "set1",  L_ZEROCOPY_RECV, R_ZEROCOPY_RECV },
+};
+
+
+/*
+ * Every variable that an option may set.  Qperf_init saves what they hold and
+ * qperf_reset puts it back.
+ */
+#define optvar(v) { &v, sizeof(v) }
+OPT_VAR OptVars[] ={
+    optvar(CgroupParent),
+    optvar(Debug),
+    optvar(FaultAt),
+    optvar(FaultDev),
+    optvar(FaultKind),
+    optvar(FaultLen),
+    optvar(FaultLoss),
+    optvar(HeatBin),
+    optvar(HeatFile),
+    optvar(ListenPort),
+    optvar(ParInfo),
+    optvar(Precision),
+    optvar(Prefork),
+    optvar(ProfileFile),
+    optvar(Rails),
+    optvar(Req),
+    optvar(RReq),
+    optvar(SampleFile),
+    optvar(ServerName),
+    optvar(ServerWait),
+    optvar(UnifyNodes),
+    optvar(UnifyUnits),
+    optvar(UseBitsPerSec),
+    optvar(VerboseConf),
+    optvar(VerboseStat),
+    optvar(VerboseTime),
+    optvar(VerboseUsed),
 };
 
 
@@ -564,14 +989,18 @@ TEST Tests[] ={
     test(sdp_lat),
     test(tcp_bw),
     test(tcp_lat),
+    test(tcp_qos),
     test(udp_bw),
     test(udp_lat),
+    test(xdp_bw),
+    test(xdp_lat),
 #ifdef RDMA
     test(rc_bi_bw),
     test(rc_bw),
     test(rc_compare_swap_mr),
     test(rc_fetch_add_mr),
     test(rc_lat),
+    test(rc_qos),
     test(rc_rdma_read_bw),
     test(rc_rdma_read_lat),
     test(rc_rdma_write_bw),
@@ -597,6 +1026,7 @@ TEST Tests[] ={
 };
 
 
+#ifndef LIBQPERF
 int
 main(int argc, char *argv[])
 {
@@ -605,6 +1035,353 @@ main(int argc, char *argv[])
     do_args(&argv[1]);
     return 0;
 }
+#endif
+
+
+/*
+ * Initialize qperf for use as a library.  Nothing is printed and errors return
+ * to the caller rather than exiting.  Each test is run in a child process so
+ * that the signals, scheduling, cgroup, threads, sockets and memory it uses
+ * are never those of the caller.
+ */
+int
+qperf_init(void)
+{
+    sigjmp_buf jump;
+
+    if (Library)
+        return 0;
+    Library = 1;
+    if (sigsetjmp(jump, 1)) {
+        lib_fail();
+        Library = 0;
+        return -1;
+    }
+    lib_enter(&jump);
+    initialize();
+    opt_save();
+    lib_leave();
+    return 0;
+}
+
+
+/*
+ * Set an option as it would be given on the command line; value is ignored
+ * for options that do not take one.  Strings are not copied and must remain
+ * valid while they are in use.  Options persist across tests until
+ * qperf_reset is called.
+ */
+int
+qperf_set(char *name, char *value)
+{
+    OPTION *option;
+    sigjmp_buf jump;
+    char *args[3] = { name, value, 0 };
+    char **argv = args;
+
+    if (sigsetjmp(jump, 1))
+        return lib_fail();
+    lib_enter(&jump);
+    option = find_option(name);
+    if (!option)
+        error(0, "%s: bad option", name);
+    if (streq(option->type, "help") || streq(option->type, "loop") ||
+        streq(option->type, "Spf") || streq(option->type, "version"))
+        error(0, "%s: not supported by the library", name);
+    do_option(option, &argv);
+    lib_leave();
+    return 0;
+}
+
+
+/*
+ * Reset all options to the defaults they had when qperf_init was called.
+ */
+void
+qperf_reset(void)
+{
+    int i;
+    char *p = OptSaved;
+
+    if (!p)
+        return;
+    for (i = 0; i < cardof(OptVars); ++i) {
+        memcpy(OptVars[i].ptr, p, OptVars[i].size);
+        p += OptVars[i].size;
+    }
+}
+
+
+/*
+ * Save the defaults of the variables options set for qperf_reset.
+ */
+static void
+opt_save(void)
+{
+    int i;
+    char *p;
+    size_t n = 0;
+
+    for (i = 0; i < cardof(OptVars); ++i)
+        n += OptVars[i].size;
+    p = OptSaved = qmalloc(n);
+    for (i = 0; i < cardof(OptVars); ++i) {
+        memcpy(p, OptVars[i].ptr, OptVars[i].size);
+        p += OptVars[i].size;
+    }
+}
+
+
+/*
+ * Run a test against a server and return its results.  The test is run by a
+ * child which sends back its results, or why it failed, through a pipe.  The
+ * quit test would exit the caller's process and is not allowed.
+ */
+int
+qperf_run(char *server, char *name, QPERF_RESULT *result)
+{
+    int n;
+    int pfd[2];
+    pid_t pid;
+    TEST *test;
+    LIB_REPLY reply;
+    sigjmp_buf jump;
+
+    memset(result, 0, sizeof(*result));
+    if (sigsetjmp(jump, 1))
+        return lib_fail();
+    lib_enter(&jump);
+    if (streq(name, "quit"))
+        error(0, "%s: not supported by the library", name);
+    test = find_test(name);
+    if (!test)
+        error(0, "%s: bad test", name);
+    if (pipe(pfd) < 0)
+        error(SYS, "pipe failed");
+    pid = fork();
+    if (pid < 0) {
+        close(pfd[0]);
+        close(pfd[1]);
+        error(SYS, "fork failed");
+    }
+    if (pid == 0) {
+        close(pfd[0]);
+        lib_child(pfd[1], server, test);
+    }
+    close(pfd[1]);
+    n = lib_read(pfd[0], &reply, sizeof(reply));
+    close(pfd[0]);
+    while (waitpid(pid, 0, 0) < 0 && errno == EINTR)
+        ;
+    if (n != sizeof(reply))
+        error(0, "%s: test process failed", name);
+    memcpy(LibError, reply.error, sizeof(LibError));
+    *result = reply.result;
+    lib_leave();
+    return reply.status;
+}
+
+
+/*
+ * Return the lowest latency in ns counted by a bucket of a result histogram.
+ */
+uint64_t
+qperf_bucket(int bucket)
+{
+    return heat_floor(bucket);
+}
+
+
+/*
+ * Return the last error or warning.
+ */
+char *
+qperf_error(void)
+{
+    return LibError;
+}
+
+
+/*
+ * Start a library call.  Errors jump back to the caller.
+ */
+static void
+lib_enter(sigjmp_buf *jump)
+{
+    LibError[0] = '\0';
+    LibJump = jump;
+}
+
+
+/*
+ * End a library call.
+ */
+static void
+lib_leave(void)
+{
+    LibJump = 0;
+    LatHist = 0;
+}
+
+
+/*
+ * Clean up after an error in a library call.
+ */
+static int
+lib_fail(void)
+{
+    lib_leave();
+    return -1;
+}
+
+
+/*
+ * Run a test in the child created by qperf_run and send the reply to our
+ * parent.  Everything the test set up goes away when we exit except for a
+ * fault still in place and the cgroup we may have created, so if the test
+ * fails, we remove those ourselves.
+ */
+static void
+lib_child(int fd, char *server, TEST *test)
+{
+    sigjmp_buf jump;
+    LIB_REPLY reply;
+
+    memset(&reply, 0, sizeof(reply));
+    reply.status = -1;
+    if (sigsetjmp(jump, 1)) {
+        LibJump = 0;
+        fault_stop();
+        cgroup_leave();
+    } else {
+        lib_enter(&jump);
+        set_signals();
+        ServerName = server;
+        LatHist = reply.result.hist;
+        client(test);
+        lib_result(&reply.result);
+        reply.status = 0;
+    }
+    memcpy(reply.error, LibError, sizeof(reply.error));
+    lib_write(fd, &reply, sizeof(reply));
+    _exit(0);
+}
+
+
+/*
+ * Read from the pipe to our child until we have len bytes or it is closed.
+ */
+static int
+lib_read(int fd, void *ptr, int len)
+{
+    int n = 0;
+
+    while (n < len) {
+        int c = read(fd, (char *)ptr + n, len - n);
+
+        if (c < 0 && errno == EINTR)
+            continue;
+        if (c <= 0)
+            break;
+        n += c;
+    }
+    return n;
+}
+
+
+/*
+ * Write to the pipe to our parent.
+ */
+static void
+lib_write(int fd, void *ptr, int len)
+{
+    int n = 0;
+
+    while (n < len) {
+        int c = write(fd, (char *)ptr + n, len - n);
+
+        if (c < 0 && errno == EINTR)
+            continue;
+        if (c <= 0)
+            break;
+        n += c;
+    }
+}
+
+
+/*
+ * Copy the results of a test to those returned by the library.
+ */
+static void
+lib_result(QPERF_RESULT *result)
+{
+    lib_result_node(&result->loc, &Res.l, &LStat);
+    lib_result_node(&result->rem, &Res.r, &RStat);
+    result->send_bw = Res.send_bw;
+    result->recv_bw = Res.recv_bw;
+    result->msg_rate = Res.msg_rate;
+    result->send_cost = Res.send_cost;
+    result->recv_cost = Res.recv_cost;
+    result->send_msg_cost = Res.send_msg_cost;
+    result->recv_msg_cost = Res.recv_msg_cost;
+    result->latency = Res.latency;
+    result->flush_time = Res.flush_time;
+    result->energy_gb = Res.energy_gb;
+    result->energy_msg = Res.energy_msg;
+    result->link_rate = Res.link_rate;
+    result->link_max_bw = Res.link_max_bw;
+    result->link_util = Res.link_util;
+    result->link_max_util = Res.link_max_util;
+}
+
+
+/*
+ * Copy the results of one node to those returned by the library.
+ */
+static void
+lib_result_node(QPERF_NODE *node, RESN *resn, STAT *stat)
+{
+    node->time_real = resn->time_real;
+    node->time_cpu = resn->time_cpu;
+    node->cpu_total = resn->cpu_total;
+    node->cpu_user = resn->cpu_user;
+    node->cpu_intr = resn->cpu_intr;
+    node->cpu_idle = resn->cpu_idle;
+    node->cpu_kernel = resn->cpu_kernel;
+    node->cpu_io_wait = resn->cpu_io_wait;
+    node->watts_pkg = resn->watts_pkg;
+    node->watts_dram = resn->watts_dram;
+    node->send_bytes = stat->s.no_bytes;
+    node->send_msgs = stat->s.no_msgs;
+    node->send_errs = stat->s.no_errs;
+    node->recv_bytes = stat->r.no_bytes;
+    node->recv_msgs = stat->r.no_msgs;
+    node->recv_errs = stat->r.no_errs;
+}
+
+
+/*
+ * Called by die when used as a library.
+ */
+void
+lib_die(void)
+{
+    if (LibJump)
+        siglongjmp(*LibJump, 1);
+}
+
+
+/*
+ * Called by error when used as a library to save an error message.
+ */
+void
+lib_error(char *mesg, int len)
+{
+    if (len >= sizeof(LibError))
+        len = sizeof(LibError) - 1;
+    memcpy(LibError, mesg, len);
+    LibError[len] = '\0';
+}
 
 
 /*
@@ -624,6 +1401,7 @@ initialize(void)
         error(SYS, "cannot open /proc/stat");
     IStat.no_cpus = sysconf(_SC_NPROCESSORS_ONLN);
     IStat.no_ticks = sysconf(_SC_CLK_TCK);
+    energy_init();
 }
 
 
@@ -720,6 +1498,7 @@ sig_urg(int signo, siginfo_t *siginfo, void *ucontext)
 }
 
 
+#ifndef LIBQPERF
 /*
  * Parse arguments.
  */
@@ -793,6 +1572,7 @@ do_loop(LOOP *loop, TEST *test)
         }
     }
 }
+#endif
 
 
 /*
@@ -852,9 +1632,43 @@ do_option(OPTION *option, char ***argvp)
     if (*t == 'S')
         ++t;
 
-    if (streq(t, "debug")) {
+    if (streq(t, "affinity")) {
+        char *s = (*argvp)[1];
+        uint32_t v;
+
+        if (s && streq(s, "any")) {
+            v = 0;
+            *argvp += 2;
+        } else if (s && streq(s, "auto")) {
+            v = AFFINITY_AUTO;
+            *argvp += 2;
+        } else
+            v = arg_long(argvp);
+        setp_u32(option->name, option->arg1, v);
+        setp_u32(option->name, option->arg2, v);
+    } else if (streq(t, "cgd")) {
+        CgroupParent = arg_strn(argvp);
+    } else if (streq(t, "debug")) {
         Debug = 1;
         *argvp += 1;
+    } else if (streq(t, "hm")) {
+        HeatFile = arg_strn(argvp);
+    } else if (streq(t, "hmb")) {
+        HeatBin = arg_long(argvp);
+        if (HeatBin <= 0)
+            error(0, "heatmap interval must be positive: %d given", HeatBin);
+    } else if (streq(t, "fa")) {
+        FaultAt = arg_long(argvp);
+    } else if (streq(t, "fd")) {
+        FaultDev = arg_strn(argvp);
+    } else if (streq(t, "fk")) {
+        FaultKind = arg_strn(argvp);
+        if (!streq(FaultKind, "loss") && !streq(FaultKind, "migrate"))
+            error(0, "fault kind must be loss or migrate: %s given", FaultKind);
+    } else if (streq(t, "fl")) {
+        FaultLen = arg_long(argvp);
+    } else if (streq(t, "fp")) {
+        FaultLoss = arg_long(argvp);
     } else if (streq(t, "help")) {
         /* Help */
         char **usage;
@@ -882,12 +1696,34 @@ do_option(OPTION *option, char ***argvp)
         parse_loop(argvp);
     } else if (streq(t, "lp")) {
         ListenPort = arg_long(argvp);
+    } else if (streq(t, "nsec")) {
+        long v = arg_nsec(argvp);
+        setp_u32(option->name, option->arg1, v);
+        setp_u32(option->name, option->arg2, v);
+    } else if (streq(t, "pf")) {
+        Prefork = arg_long(argvp);
+    } else if (streq(t, "prf")) {
+        ProfileFile = arg_strn(argvp);
     } else if (streq(t, "precision")) {
         Precision = arg_long(argvp);
+    } else if (streq(t, "rails")) {
+        char *p;
+        long n = 1;
+
+        Rails = arg_strn(argvp);
+        for (p = Rails; *p; ++p)
+            if (*p == ',')
+                ++n;
+        if (n > RAILS_MAX)
+            error(0, "at most %d rails are supported", RAILS_MAX);
+        setp_u32(option->name, L_RAILS, n);
+        setp_u32(option->name, R_RAILS, n);
     } else if (streq(t, "set1")) {
         setp_u32(option->name, option->arg1, 1);
         setp_u32(option->name, option->arg2, 1);
         *argvp += 1;
+    } else if (streq(t, "sf")) {
+        SampleFile = arg_strn(argvp);
     } else if (streq(t, "size")) {
         long v = arg_size(argvp);
         setp_u32(option->name, option->arg1, v);
@@ -902,6 +1738,8 @@ do_option(OPTION *option, char ***argvp)
         char *s = arg_strn(argvp);
         setp_str(option->name, option->arg1, s);
         setp_str(option->name, option->arg2, s);
+    } else if (streq(t, "svf")) {
+        service_load(arg_strn(argvp));
     } else if (streq(t, "time")) {
         long v = arg_time(argvp);
         setp_u32(option->name, option->arg1, v);
@@ -1150,6 +1988,50 @@ str_size(char *str, char *arg)
 }
 
 
+/*
+ * Return the value of an argument giving a time in nanoseconds.
+ */
+static long
+arg_nsec(char ***argvp)
+{
+    char **argv = *argvp;
+
+    if (!argv[1])
+        error(0, "missing argument to %s", argv[0]);
+    *argvp += 2;
+    return str_nsec(argv[1], argv[0]);
+}
+
+
+/*
+ * Scan a time in nanoseconds from a string.  It may be followed by ns, us, ms
+ * or s.
+ */
+static long
+str_nsec(char *str, char *arg)
+{
+    char *p;
+    long m = 1;
+    long double d = strtold(str, &p);
+
+    if (p == str || d < 0)
+        error(0, "%s: bad time: %s", arg, str);
+    if (p[0] == '\0' || streq(p, "ns"))
+        m = 1;
+    else if (streq(p, "us"))
+        m = 1000;
+    else if (streq(p, "ms"))
+        m = 1000 * 1000;
+    else if (streq(p, "s"))
+        m = 1000 * 1000 * 1000;
+    else
+        error(0, "%s: bad time: %s", arg, str);
+    if (d * m > UINT_MAX)
+        error(0, "%s: time too large: %s", arg, str);
+    return d * m;
+}
+
+
 /*
  * Return the value of a string argument.
  */
@@ -1309,7 +2191,9 @@ par_info(PAR_INDEX index)
 
 /*
  * If any options were set but were not used, print out a warning message for
- * the user.
+ * the user.  Also reject --access_recv with --pipeline in the RDMA tests:
+ * those receive every message into the same buffer, so a worker would read
+ * data that later receives are overwriting.
  */
 void
 opt_check(void)
@@ -1318,6 +2202,9 @@ opt_check(void)
     PAR_INFO *q;
     PAR_INFO *r = endof(ParInfo);
 
+    if (is_rdma_test() && ((Req.pipeline && Req.access_recv) ||
+                           (RReq.pipeline && RReq.access_recv)))
+        error(0, "--access_recv cannot be used with --pipeline in RDMA tests");
     for (p = ParInfo; p < r; ++p) {
         if (p->used || !p->set)
             continue;
@@ -1330,6 +2217,7 @@ opt_check(void)
 }
 
 
+#ifndef LIBQPERF
 /*
  * Server.
  */
@@ -1337,11 +2225,10 @@ static void
 server(void)
 {
     server_listen();
+    if (Prefork)
+        server_prefork();
     for (;;) {
-        REQ req;
         pid_t pid;
-        TEST *test;
-        int s = offset(REQ, req_index);
 
         debug("ready for requests");
         if (!server_recv_request())
@@ -1356,57 +2243,148 @@ server(void)
             waitpid(pid, 0, 0);
             continue;
         }
-        remotefd_setup();
-
-        recv_mesg(&req, s, "request version");
-        dec_init(&req);
-        dec_req_version(&Req);
-        if (Req.ver_maj != VER_MAJ || Req.ver_min != VER_MIN)
-            version_error();
-        recv_mesg(&req.req_index, sizeof(req)-s, "request data");
-        dec_req_data(&Req);
-        if (Req.req_index >= cardof(Tests))
-            error(0, "bad request index: %d", Req.req_index);
-
-        test = &Tests[Req.req_index];
-        TestName = test->name;
-        debug("received request: %s", TestName);
-        init_lstat();
-        set_affinity();
-        (test->server)();
-        exit(0);
+        server_request();
     }
     close(ListenFD);
 }
 
 
 /*
- * If there is a version mismatch of qperf between the client and server, tell
- * the user which needs to be upgraded.
+ * Keep a pool of Prefork workers waiting for requests so that the cost of
+ * forking and faulting in memory is paid before a request arrives rather than
+ * after.  Each worker serves a single request and exits; we replace it as soon
+ * as it does.  As with the default server, only one test runs at a time: the
+ * workers take turns on a lock in an unlinked file, see server_worker.
  */
 static void
-version_error(void)
+server_prefork(void)
 {
-    int hi_maj = Req.ver_maj;
-    int hi_min = Req.ver_min;
-    int hi_inc = Req.ver_inc;
-    int lo_maj = VER_MAJ;
-    int lo_min = VER_MIN;
-    int lo_inc = VER_INC;
-    char *msg = "upgrade qperf on %s from %d.%d.%d to %d.%d.%d";
-    char *low = "server";
-
-    if (lo_maj > hi_maj || (lo_maj == hi_maj && lo_min > hi_min)) {
-        hi_maj = VER_MAJ;
-        hi_min = VER_MIN;
-        hi_inc = VER_INC;
-        lo_maj = Req.ver_maj;
-        lo_min = Req.ver_min;
-        lo_inc = Req.ver_inc;
-        low   = "client";
-    }
-    error(0, msg, low, lo_maj, lo_min, lo_inc, hi_maj, hi_min, hi_inc);
-}
+    int n = 0;
+    FILE *fp = tmpfile();
+
+    if (!fp)
+        error(SYS, "failed to create prefork lock file");
+    PreforkFD = fileno(fp);
+    for (;;) {
+        while (n < Prefork) {
+            pid_t pid = fork();
+
+            if (pid < 0) {
+                error(SYS|RET, "fork failed");
+                break;
+            }
+            if (pid == 0)
+                server_worker();
+            ++n;
+        }
+        if (n == 0) {
+            sleep(1);
+            continue;
+        }
+        if (wait(0) < 0) {
+            if (errno == EINTR)
+                continue;
+            error(SYS, "wait failed");
+        }
+        --n;
+    }
+}
+
+
+/*
+ * A prefork worker.  Warm up and then wait for a request on the shared listen
+ * socket.  Only the worker holding the lock accepts, and it holds it until it
+ * exits, so tests from different clients cannot run at once and distort each
+ * other.  A record lock belongs to the process, so it is dropped however the
+ * worker exits.  If the parent goes away, so do we.
+ */
+static void
+server_worker(void)
+{
+    struct flock lock ={
+        .l_type   = F_WRLCK,
+        .l_whence = SEEK_SET
+    };
+
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    if (getppid() == 1)
+        exit(0);
+    prefault_heap(PREFAULT_SIZE);
+    while (fcntl(PreforkFD, F_SETLKW, &lock) < 0)
+        if (errno != EINTR)
+            error(SYS, "failed to lock prefork lock file");
+    debug("worker %d ready for requests", getpid());
+    while (!server_recv_request())
+        ;
+    server_request();
+}
+
+
+/*
+ * Receive a request from a client and run the server side of the test.  We are
+ * a child process and exit when done.
+ */
+static void
+server_request(void)
+{
+    REQ req;
+    TEST *test;
+    int s = offset(REQ, req_index);
+
+    remotefd_setup();
+    recv_mesg(&req, s, "request version");
+    dec_init(&req);
+    dec_req_version(&Req);
+    if (Req.ver_maj != VER_MAJ || Req.ver_min != VER_MIN)
+        version_error();
+    recv_mesg(&req.req_index, sizeof(req)-s, "request data");
+    dec_req_data(&Req);
+    if (Req.req_index >= cardof(Tests))
+        error(0, "bad request index: %d", Req.req_index);
+
+    test = &Tests[Req.req_index];
+    TestName = test->name;
+    debug("received request: %s", TestName);
+    init_lstat();
+    set_affinity();
+    set_low_latency();
+    cgroup_enter();
+    sample_init();
+    profile_init();
+    service_init();
+    debug("ready for %s in %.0f us", TestName, (get_seconds()-ReqTime)*1E6);
+    (test->server)();
+    exit(0);
+}
+
+
+/*
+ * If there is a version mismatch of qperf between the client and server, tell
+ * the user which needs to be upgraded.
+ */
+static void
+version_error(void)
+{
+    int hi_maj = Req.ver_maj;
+    int hi_min = Req.ver_min;
+    int hi_inc = Req.ver_inc;
+    int lo_maj = VER_MAJ;
+    int lo_min = VER_MIN;
+    int lo_inc = VER_INC;
+    char *msg = "upgrade qperf on %s from %d.%d.%d to %d.%d.%d";
+    char *low = "server";
+
+    if (lo_maj > hi_maj || (lo_maj == hi_maj && lo_min > hi_min)) {
+        hi_maj = VER_MAJ;
+        hi_min = VER_MIN;
+        hi_inc = VER_INC;
+        lo_maj = Req.ver_maj;
+        lo_min = Req.ver_min;
+        lo_inc = Req.ver_inc;
+        low   = "client";
+    }
+    error(0, msg, low, lo_maj, lo_min, lo_inc, hi_maj, hi_min, hi_inc);
+}
 
 
 /*
@@ -1456,8 +2434,10 @@ server_recv_request(void)
     RemoteFD = accept(ListenFD, (struct sockaddr *)&clientAddr, &clientLen);
     if (RemoteFD < 0)
         return error(SYS|RET, "accept failed");
+    ReqTime = get_seconds();
     return 1;
 }
+#endif
 
 
 /*
@@ -1478,10 +2458,25 @@ client(TEST *test)
     setp_u32(0, R_TIMEOUT, DEF_TIMEOUT);
     par_use(L_AFFINITY);
     par_use(R_AFFINITY);
+    par_use(L_CGROUP_CPU);
+    par_use(R_CGROUP_CPU);
+    par_use(L_CGROUP_CPUSET);
+    par_use(R_CGROUP_CPUSET);
+    par_use(L_CGROUP_MEM);
+    par_use(R_CGROUP_MEM);
+    par_use(L_LOW_LATENCY);
+    par_use(R_LOW_LATENCY);
+    par_use(L_PROFILE);
+    par_use(R_PROFILE);
     par_use(L_TIME);
     par_use(R_TIME);
+    if (SampleFile) {
+        if (!par_isset(L_SAMPLES))
+            setv_u32(L_SAMPLES, DEF_SAMPLES);
+        if (!par_isset(R_SAMPLES))
+            setv_u32(R_SAMPLES, DEF_SAMPLES);
+    }
 
-    set_affinity();
     RReq.ver_maj = VER_MAJ;
     RReq.ver_min = VER_MIN;
     RReq.ver_inc = VER_INC;
@@ -1489,8 +2484,15 @@ client(TEST *test)
     TestName = test->name;
     debug("sending request: %s", TestName);
     init_lstat();
-    printf("%s:\n", TestName);
+    set_affinity();
+    set_low_latency();
+    cgroup_enter();
+    sample_init();
+    profile_init();
+    if (!Library)
+        printf("%s:\n", TestName);
     (*test->client)();
+    cgroup_leave();
     remotefd_close();
     place_show();
 }
@@ -1583,16 +2585,28 @@ exchange_results(void)
 {
     STAT stat;
 
+    stage_calc();
     if (is_client()) {
         recv_mesg(&stat, sizeof(stat), "results");
         dec_init(&stat);
         dec_stat(&RStat);
         send_sync("synchronization after test");
+        sample_merge();
+        heat_write();
+        if (ProfileFile) {
+            char path[PATH_MAX];
+
+            test_path(path, sizeof(path), ProfileFile);
+            profile_recv(RReq.profile, path);
+        } else
+            profile_recv(RReq.profile, 0);
     } else {
         enc_init(&stat);
         enc_stat(&LStat);
         send_mesg(&stat, sizeof(stat), "results");
         recv_sync("synchronization after test");
+        sample_send();
+        profile_send();
     }
 }
 
@@ -1604,6 +2618,9 @@ static void
 init_lstat(void)
 {
     memcpy(&LStat, &IStat, sizeof(LStat));
+    memset(StageHist, 0, sizeof(StageHist));
+    memset(StageSum, 0, sizeof(StageSum));
+    memset(StageMsgs, 0, sizeof(StageMsgs));
 }
 
 
@@ -1795,6 +2812,8 @@ sync_test(void)
 {
     synchronize("synchronization before test");
     start_test_timer(Req.time);
+    if (Req.time)
+        fault_start();
 }
 
 
@@ -1808,6 +2827,10 @@ start_test_timer(int seconds)
 
     Finished = 0;
     get_times(LStat.time_s);
+    energy_start();
+    cgroup_start();
+    SampleBase = get_nsecs();
+    profile_start();
     setitimer(ITIMER_REAL, &itimerval, 0);
     if (!seconds)
         return;
@@ -1841,6 +2864,7 @@ stop_test_timer(void)
 
     set_finished();
     setitimer(ITIMER_REAL, &itimerval, 0);
+    fault_stop();
     Finished = 0;
     debug("stopping timer");
 }
@@ -1852,8 +2876,12 @@ stop_test_timer(void)
 void
 set_finished(void)
 {
-    if (Finished++ == 0)
+    if (Finished++ == 0) {
+        profile_stop();
         get_times(LStat.time_e);
+        energy_end();
+        cgroup_stop();
+    }
 }
 
 
@@ -1889,8 +2917,24 @@ calc_results(void)
     calc_node(&Res.l, &LStat);
     calc_node(&Res.r, &RStat);
     no_msgs = LStat.r.no_msgs + RStat.r.no_msgs;
-    if (no_msgs)
-        Res.latency = Res.l.time_real / no_msgs;
+    if (no_msgs) {
+        double flush = (LStat.flush_ns + RStat.flush_ns) / 1E9;
+
+        Res.latency = (Res.l.time_real - flush) / no_msgs;
+        Res.flush_time = flush / no_msgs;
+    }
+
+    /* Calculate energy per GB and per message */
+    {
+        double bytes = LStat.r.no_bytes + RStat.r.no_bytes;
+        double joules = (LStat.energy_pkg + LStat.energy_dram +
+                         RStat.energy_pkg + RStat.energy_dram) / 1E6;
+
+        if (bytes)
+            Res.energy_gb = joules * gB / bytes;
+        if (no_msgs)
+            Res.energy_msg = joules / no_msgs;
+    }
 
     locTime = Res.l.time_real;
     remTime = Res.r.time_real;
@@ -1923,15 +2967,38 @@ calc_results(void)
     else
         Res.recv_bw = (LStat.r.no_bytes + RStat.r.no_bytes) / midTime;
 
+    /* Calculate link utilization */
+    {
+        STAT *stat = LStat.link_speed ? &LStat : &RStat;
+        uint32_t speed = stat->link_speed;
+        int duplex = (LStat.s.no_bytes && RStat.s.no_bytes) ? 2 : 1;
+
+        if (RStat.link_speed && RStat.link_speed < speed)
+            speed = RStat.link_speed;
+        if (speed && stat->link_wire) {
+            Res.link_rate = speed * 1E6 / 8;
+            Res.link_max_bw = Res.link_rate * stat->link_payload
+                                            / stat->link_wire;
+            Res.link_util = Res.recv_bw / (duplex * Res.link_rate);
+            Res.link_max_util = Res.recv_bw / (duplex * Res.link_max_bw);
+        }
+    }
+
     /* Calculate costs */
-    if (LStat.s.no_bytes && !LStat.r.no_bytes && !RStat.s.no_bytes)
+    if (LStat.s.no_bytes && !LStat.r.no_bytes && !RStat.s.no_bytes) {
         Res.send_cost = Res.l.time_cpu*gB / LStat.s.no_bytes;
-    else if (RStat.s.no_bytes && !RStat.r.no_bytes && !LStat.s.no_bytes)
+        Res.send_msg_cost = Res.l.time_cpu / LStat.s.no_msgs;
+    } else if (RStat.s.no_bytes && !RStat.r.no_bytes && !LStat.s.no_bytes) {
         Res.send_cost = Res.r.time_cpu*gB / RStat.s.no_bytes;
-    if (RStat.r.no_bytes && !RStat.s.no_bytes && !LStat.r.no_bytes)
+        Res.send_msg_cost = Res.r.time_cpu / RStat.s.no_msgs;
+    }
+    if (RStat.r.no_bytes && !RStat.s.no_bytes && !LStat.r.no_bytes) {
         Res.recv_cost = Res.r.time_cpu*gB / RStat.r.no_bytes;
-    else if (LStat.r.no_bytes && !LStat.s.no_bytes && !RStat.r.no_bytes)
+        Res.recv_msg_cost = Res.r.time_cpu / RStat.r.no_msgs;
+    } else if (LStat.r.no_bytes && !LStat.s.no_bytes && !RStat.r.no_bytes) {
         Res.recv_cost = Res.l.time_cpu*gB / LStat.r.no_bytes;
+        Res.recv_msg_cost = Res.l.time_cpu / LStat.r.no_msgs;
+    }
 }
 
 
@@ -2006,6 +3073,9 @@ calc_node(RESN *resn, STAT *stat)
 
     resn->cpu_total = resn->cpu_user + resn->cpu_intr
                     + resn->cpu_kernel + resn->cpu_io_wait;
+
+    resn->watts_pkg  = stat->energy_pkg  / 1E6 / resn->time_real;
+    resn->watts_dram = stat->energy_dram / 1E6 / resn->time_real;
 }
 
 
@@ -2015,9 +3085,14 @@ calc_node(RESN *resn, STAT *stat)
 static void
 show_info(MEASURE measure)
 {
+    int cost;
+
     if (measure == LATENCY) {
         view_time('a', "", "latency", Res.latency);
-        view_rate('s', "", "msg_rate", Res.msg_rate);
+        if (Res.flush_time)
+            view_time('a', "", "flush_time", Res.flush_time);
+        view_rate(RStat.ep_cqs ? 'a' : 's', "", "msg_rate", Res.msg_rate);
+        show_stages();
     } else if (measure == MSG_RATE) {
         view_rate('a', "", "msg_rate", Res.msg_rate);
     } else if (measure == BANDWIDTH) {
@@ -2026,17 +3101,367 @@ show_info(MEASURE measure)
     } else if (measure == BANDWIDTH_SR) {
         view_band('a', "", "send_bw", Res.send_bw);
         view_band('a', "", "recv_bw", Res.recv_bw);
-        view_rate('s', "", "msg_rate", Res.msg_rate);
+        view_rate(LStat.ah_count || RStat.ep_cqs ? 'a' : 's', "",
+                  "msg_rate", Res.msg_rate);
+    }
+    if (measure == BANDWIDTH || measure == BANDWIDTH_SR) {
+        if (Res.link_rate) {
+            view_pcnt('a', "", "link_util", Res.link_util);
+            view_pcnt('s', "", "link_max_util", Res.link_max_util);
+        }
+        view_band('s', "", "link_rate", Res.link_rate);
+        view_band('s', "", "link_max_bw", Res.link_max_bw);
+        show_rails();
+        show_compress();
     }
+    show_ud_dests();
+    show_ud_cqs();
+    show_qos();
+    show_fault();
     show_used();
-    view_cost('t', "", "send_cost", Res.send_cost);
-    view_cost('t', "", "recv_cost", Res.recv_cost);
+    show_affinity("loc_", &LStat);
+    show_affinity("rem_", &RStat);
+    show_low_latency("loc_", Req.low_latency, &LStat);
+    show_low_latency("rem_", RReq.low_latency, &RStat);
+    show_pipeline("loc_", &LStat);
+    show_pipeline("rem_", &RStat);
+    show_cgroup("loc_", &Req, &LStat);
+    show_cgroup("rem_", &RReq, &RStat);
+    show_zerocopy("loc_", &Req, &LStat);
+    show_zerocopy("rem_", &RReq, &RStat);
+    if (LStat.xdp_mode[0]) {
+        view_strn('a', "loc_", "xdp_mode", LStat.xdp_mode);
+        view_strn('a', "rem_", "xdp_mode", RStat.xdp_mode);
+    }
+    cost = 't';
+    if (measure != LATENCY &&
+        (Req.compress[0] || Req.zerocopy_recv || LStat.xdp_mode[0]))
+        cost = 'a';
+    view_cost(cost, "", "send_cost", Res.send_cost);
+    view_cost(cost, "", "recv_cost", Res.recv_cost);
+    view_time(cost, "", "send_msg_cost", Res.send_msg_cost);
+    view_time(cost, "", "recv_msg_cost", Res.recv_msg_cost);
+    view_energy_gb('t', "", "energy_per_gb", Res.energy_gb);
+    view_energy_msg('t', "", "energy_per_msg", Res.energy_msg);
+    show_profile();
     show_rest();
     if (Debug)
         show_debug();
 }
 
 
+/*
+ * Show the bandwidth on the wire and the compression ratio of a test run with
+ * --compress.  The bandwidth shown as bw is of the data before compression.
+ * Both are taken from the receiver, which knows both sizes.
+ */
+static void
+show_compress(void)
+{
+    STAT *stat = LStat.r.no_bytes ? &LStat : &RStat;
+    char buf[32];
+
+    if (!Req.compress[0] || !stat->comp_bytes)
+        return;
+    view_band('a', "", "wire_bw",
+              Res.recv_bw * stat->comp_bytes / stat->r.no_bytes);
+    snprintf(buf, sizeof(buf), "%.2f", (double)stat->r.no_bytes /
+                                                stat->comp_bytes);
+    view_strn('a', "", "compress_ratio", buf);
+}
+
+
+/*
+ * Show how a server run with --ud_cqs fared waiting on its completion queues
+ * with epoll.  Few events per wakeup means each message costs the server a
+ * trip through epoll_wait.
+ */
+static void
+show_ud_cqs(void)
+{
+    char buf[32];
+
+    if (!RStat.ep_cqs)
+        return;
+    view_long('a', "", "ud_cqs", RStat.ep_cqs);
+    if (!RStat.ep_wakeups)
+        return;
+    snprintf(buf, sizeof(buf), "%.2f",
+             (double)RStat.ep_events / RStat.ep_wakeups);
+    view_strn('a', "", "events_per_wakeup", buf);
+    view_long('s', "", "wakeups", RStat.ep_wakeups);
+}
+
+
+/*
+ * Show what it cost to create the address handles of a UD test that fans out
+ * to --ud_dests destinations.  With the message rate, which is shown with
+ * the bandwidth, this shows how the adapter copes as the number grows.
+ */
+static void
+show_ud_dests(void)
+{
+    if (!LStat.ah_count)
+        return;
+    view_long('a', "", "ud_dests", LStat.ah_count);
+    view_time('a', "", "ah_create_cost",
+                       LStat.ah_create_ns / 1E9 / LStat.ah_count);
+    view_time('s', "", "ah_create_time", LStat.ah_create_ns / 1E9);
+}
+
+
+/*
+ * Show how much of what a node received with --zerocopy_recv had its pages
+ * mapped rather than copied.  Only data that fills whole pages can be mapped,
+ * so this depends on the message size and how the sender's segments line up.
+ * If the node could not map at all and copied instead, show why.
+ */
+static void
+show_zerocopy(char *pref, REQ *req, STAT *stat)
+{
+    char buf[STRSIZE];
+
+    if (!req->zerocopy_recv || !stat->r.no_bytes)
+        return;
+    if (stat->zc_error) {
+        snprintf(buf, sizeof(buf), "copied: %s", strerror(stat->zc_error));
+        view_strn('a', pref, "zerocopy", buf);
+    } else
+        view_pcnt('a', pref, "zerocopy", (double)stat->zc_bytes /
+                                                 stat->r.no_bytes);
+}
+
+
+/*
+ * Show how much a node was throttled by the CPU quota of its cgroup: the
+ * number of enforcement periods in which it ran out of quota out of those it
+ * ran in and the time it spent waiting for more.
+ */
+static void
+show_cgroup(char *pref, REQ *req, STAT *stat)
+{
+    if (!req->cgroup_cpu[0])
+        return;
+    view_long('a', pref, "throttled_periods", stat->cg_throttled);
+    view_long('s', pref, "cfs_periods", stat->cg_periods);
+    view_time('a', pref, "throttled_time", stat->cg_throttled_us / 1E6);
+}
+
+
+/*
+ * Show what the receive pipeline workers of a node measured: the mean and
+ * maximum time from the receive thread handing off a message to a worker
+ * picking it up, the rate the workers could have sustained had they never
+ * waited for messages and the number of times the receive thread found the
+ * pipeline full.
+ */
+static void
+show_pipeline(char *pref, STAT *stat)
+{
+    if (!stat->pipe_msgs)
+        return;
+    view_time('a', pref, "handoff", stat->pipe_lat_avg / 1E9);
+    view_time('a', pref, "handoff_max", stat->pipe_lat_max / 1E9);
+    view_rate('a', pref, "handoff_rate", stat->pipe_rate);
+    view_long('a', pref, "handoff_stalls", stat->pipe_stalls);
+}
+
+
+/*
+ * Show how the test recovered from a fault injected with --fault_len or a
+ * forced path migration.  For a migration, we show how long after it each
+ * side saw the path migrated event.  The remote time is only as good as the
+ * synchronization at the start of the test.
+ */
+static void
+show_fault(void)
+{
+    int migrate = FaultKind && streq(FaultKind, "migrate");
+
+    if (FaultRes.state <= 0)
+        return;
+    if (FaultRes.recovered)
+        view_time('a', "", "fault_recovery", FaultRes.recovery / 1E9);
+    else
+        view_strn('a', "", "fault_recovery", "none");
+    view_time('a', "", "fault_stall", FaultRes.stall / 1E9);
+    if (FaultRes.lat_max)
+        view_time('a', "", "fault_lat_max", FaultRes.lat_max / 1E9);
+    if (!migrate)
+        view_long('a', "", "fault_retrans", FaultRes.retrans);
+    view_long('a', "", "fault_errors", FaultRes.errors);
+    if (!migrate)
+        return;
+    if (LStat.path_mig)
+        view_time('a', "loc_", "path_mig", path_mig_delay(LStat.path_mig));
+    if (RStat.path_mig)
+        view_time('a', "rem_", "path_mig", path_mig_delay(RStat.path_mig));
+    if (!LStat.path_mig && !RStat.path_mig)
+        view_strn('a', "", "path_mig", "none");
+}
+
+
+/*
+ * Return how long after the migration was forced a path migrated event was
+ * seen in seconds.
+ */
+static double
+path_mig_delay(uint64_t when)
+{
+    return when > FaultRes.at ? (when - FaultRes.at) / 1E9 : 0;
+}
+
+
+/*
+ * Show the round trip times of the two probes of a QoS test: one in the same
+ * class as the bulk traffic and one in its own class.
+ */
+static void
+show_qos(void)
+{
+    if (!LStat.stage_avg[S_PROBE] || !LStat.stage_avg[S_PROBE_QOS])
+        return;
+    view_time('a', "", "probe_rtt", LStat.stage_avg[S_PROBE] / 1E9);
+    view_time('s', "", "probe_rtt_p50", LStat.stage_p50[S_PROBE] / 1E9);
+    view_time('a', "", "probe_rtt_p99", LStat.stage_p99[S_PROBE] / 1E9);
+    view_time('a', "", "qos_probe_rtt", LStat.stage_avg[S_PROBE_QOS] / 1E9);
+    view_time('s', "", "qos_probe_rtt_p50",
+                                        LStat.stage_p50[S_PROBE_QOS] / 1E9);
+    view_time('a', "", "qos_probe_rtt_p99",
+                                        LStat.stage_p99[S_PROBE_QOS] / 1E9);
+}
+
+
+/*
+ * Show the bandwidth of each rail of a stream test striped with --rails as
+ * seen by the receiver.
+ */
+static void
+show_rails(void)
+{
+    int i;
+    STAT *stat = &RStat;
+    double time = Res.r.time_real;
+    static char *names[RAILS_MAX] ={
+        "rail0_bw", "rail1_bw", "rail2_bw", "rail3_bw",
+        "rail4_bw", "rail5_bw", "rail6_bw", "rail7_bw",
+    };
+
+    if (Req.rails < 2)
+        return;
+    if (!RStat.rail_bytes[0]) {
+        stat = &LStat;
+        time = Res.l.time_real;
+    }
+    if (!stat->rail_bytes[0] || !time)
+        return;
+    for (i = 0; i < Req.rails; ++i)
+        view_band('a', "", names[i], stat->rail_bytes[i] / time);
+}
+
+
+/*
+ * Show the stages of a message measured with --breakdown in the order that a
+ * message and its reply pass through them.  Stages that were not measured are
+ * left out.  What is left of the round trip is put down to the network, which
+ * includes the drivers, devices and loopback.
+ */
+static void
+show_stages(void)
+{
+    int i;
+    double network;
+    static struct {
+        char  *pref;
+        char  *name;
+        char  *p50;
+        char  *p99;
+        STAT  *stat;
+        STAGE  stage;
+    } tab[] ={
+        { "loc_", "syscall",    "syscall_p50",    "syscall_p99",
+                                                    &LStat, S_SYSCALL    },
+        { "loc_", "send_stack", "send_stack_p50", "send_stack_p99",
+                                                    &LStat, S_SEND_STACK },
+        { "loc_", "send_qdisc", "send_qdisc_p50", "send_qdisc_p99",
+                                                    &LStat, S_SEND_QDISC },
+        { "rem_", "recv_stack", "recv_stack_p50", "recv_stack_p99",
+                                                    &RStat, S_RECV_STACK },
+        { "rem_", "wakeup",     "wakeup_p50",     "wakeup_p99",
+                                                    &RStat, S_WAKEUP     },
+        { "rem_", "syscall",    "syscall_p50",    "syscall_p99",
+                                                    &RStat, S_SYSCALL    },
+        { "rem_", "reply",      "reply_p50",      "reply_p99",
+                                                    &RStat, S_CYCLE      },
+        { "rem_", "send_stack", "send_stack_p50", "send_stack_p99",
+                                                    &RStat, S_SEND_STACK },
+        { "rem_", "send_qdisc", "send_qdisc_p50", "send_qdisc_p99",
+                                                    &RStat, S_SEND_QDISC },
+        { "loc_", "recv_stack", "recv_stack_p50", "recv_stack_p99",
+                                                    &LStat, S_RECV_STACK },
+        { "loc_", "wakeup",     "wakeup_p50",     "wakeup_p99",
+                                                    &LStat, S_WAKEUP     },
+    };
+
+    if (!LStat.stage_msgs)
+        return;
+    view_time('a', "", "round_trip", LStat.stage_avg[S_CYCLE] / 1E9);
+    network = LStat.stage_avg[S_CYCLE];
+    for (i = 0; i < cardof(tab); ++i) {
+        STAT *stat = tab[i].stat;
+        STAGE s = tab[i].stage;
+
+        if (!(stat->stage_mask & (1 << s)))
+            continue;
+        view_time('a', tab[i].pref, tab[i].name, stat->stage_avg[s] / 1E9);
+        network -= stat->stage_avg[s];
+    }
+    if (network < 0)
+        network = 0;
+    view_time('a', "", "network", network / 1E9);
+
+    view_time('T', "", "round_trip_p50", LStat.stage_p50[S_CYCLE] / 1E9);
+    view_time('T', "", "round_trip_p99", LStat.stage_p99[S_CYCLE] / 1E9);
+    for (i = 0; i < cardof(tab); ++i) {
+        STAT *stat = tab[i].stat;
+        STAGE s = tab[i].stage;
+
+        if (!(stat->stage_mask & (1 << s)))
+            continue;
+        view_time('T', tab[i].pref, tab[i].p50, stat->stage_p50[s] / 1E9);
+        view_time('T', tab[i].pref, tab[i].p99, stat->stage_p99[s] / 1E9);
+    }
+}
+
+
+/*
+ * Show the symbols in which each node spent the most time with --profile.
+ */
+static void
+show_profile(void)
+{
+    int i;
+    int n;
+    static char *pref[] ={ "loc_", "rem_" };
+    static char *name[PROFILE_TOP] ={
+        "profile_1", "profile_2", "profile_3", "profile_4", "profile_5"
+    };
+
+    for (n = 0; n < 2; ++n) {
+        if (!(n ? RReq.profile : Req.profile))
+            continue;
+        for (i = 0; i < PROFILE_TOP; ++i) {
+            char *s = profile_top(n, i);
+
+            if (!s)
+                break;
+            view_strn('a', pref[n], name[i], s);
+        }
+        view_long('a', pref[n], "profile_lost", profile_lost(n));
+    }
+}
+
+
 /*
  * Show parameters the user set.
  */
@@ -2056,7 +3481,16 @@ show_used(void)
             continue;
         if (VerboseUsed < 2 && !l->set & !r->set)
             continue;
-        if (l->type == 'l') {
+        if (l->type == 'a') {
+            uint32_t lv = *(uint32_t *)l->ptr;
+            uint32_t rv = *(uint32_t *)r->ptr;
+            if (lv == rv)
+                view_affinity('u', "", p->name, lv);
+            else {
+                view_affinity('u', "loc_", p->name, lv);
+                view_affinity('u', "rem_", p->name, rv);
+            }
+        } else if (l->type == 'l') {
             uint32_t lv = *(uint32_t *)l->ptr;
             uint32_t rv = *(uint32_t *)r->ptr;
             if (lv == rv)
@@ -2136,6 +3570,8 @@ show_rest(void)
         view_cpus('T', "", "send_cpus_iowait", resnS->cpu_io_wait);
         view_time('T', "", "send_real_time",   resnS->time_real);
         view_time('T', "", "send_cpu_time",    resnS->time_cpu);
+        view_watt('t', "", "send_watts",       resnS->watts_pkg);
+        view_watt('T', "", "send_watts_dram",  resnS->watts_dram);
         view_long('S', "", "send_errors",      statS->s.no_errs);
         view_size('S', "", "send_bytes",       statS->s.no_bytes);
         view_long('S', "", "send_msgs",        statS->s.no_msgs);
@@ -2148,6 +3584,8 @@ show_rest(void)
         view_cpus('T', "", "recv_cpus_iowait", resnR->cpu_io_wait);
         view_time('T', "", "recv_real_time",   resnR->time_real);
         view_time('T', "", "recv_cpu_time",    resnR->time_cpu);
+        view_watt('t', "", "recv_watts",       resnR->watts_pkg);
+        view_watt('T', "", "recv_watts_dram",  resnR->watts_dram);
         view_long('S', "", "recv_errors",      statR->r.no_errs);
         view_size('S', "", "recv_bytes",       statR->r.no_bytes);
         view_long('S', "", "recv_msgs",        statR->r.no_msgs);
@@ -2160,6 +3598,8 @@ show_rest(void)
         view_cpus('T', "", "loc_cpus_iowait",  Res.l.cpu_io_wait);
         view_time('T', "", "loc_real_time",    Res.l.time_real);
         view_time('T', "", "loc_cpu_time",     Res.l.time_cpu);
+        view_watt('t', "", "loc_watts",        Res.l.watts_pkg);
+        view_watt('T', "", "loc_watts_dram",   Res.l.watts_dram);
         view_long('S', "", "loc_send_errors",  LStat.s.no_errs);
         view_long('S', "", "loc_recv_errors",  LStat.r.no_errs);
         view_size('S', "", "loc_send_bytes",   LStat.s.no_bytes);
@@ -2175,6 +3615,8 @@ show_rest(void)
         view_cpus('T', "", "rem_cpus_iowait",  Res.r.cpu_io_wait);
         view_time('T', "", "rem_real_time",    Res.r.time_real);
         view_time('T', "", "rem_cpu_time",     Res.r.time_cpu);
+        view_watt('t', "", "rem_watts",        Res.r.watts_pkg);
+        view_watt('T', "", "rem_watts_dram",   Res.r.watts_dram);
         view_long('S', "", "rem_send_errors",  RStat.s.no_errs);
         view_long('S', "", "rem_recv_errors",  RStat.r.no_errs);
         view_size('S', "", "rem_send_bytes",   RStat.s.no_bytes);
@@ -2186,6 +3628,47 @@ show_rest(void)
 }
 
 
+/*
+ * If the processor was chosen automatically, show which one and why.
+ */
+static void
+show_affinity(char *pref, STAT *stat)
+{
+    char *data;
+
+    if (!stat->auto_cpu)
+        return;
+    if (stat->auto_node)
+        data = qasprintf("cpu %d (%s on node %d)", stat->auto_cpu-1,
+                                        stat->auto_nic, stat->auto_node-1);
+    else if (stat->auto_nic[0])
+        data = qasprintf("cpu %d (%s)", stat->auto_cpu-1, stat->auto_nic);
+    else
+        data = qasprintf("cpu %d", stat->auto_cpu-1);
+    place_any(pref, "auto_affinity", 0, data, 0);
+}
+
+
+/*
+ * If a low latency profile was requested, show which controls were applied.
+ */
+static void
+show_low_latency(char *pref, uint32_t level, STAT *stat)
+{
+    char buf[BUFSIZE];
+    uint32_t l = stat->low_latency;
+
+    if (!level)
+        return;
+    snprintf(buf, sizeof(buf), "%s%s%s%s",
+             (l & LL_DMA_LATENCY) ? " dma_latency" : "",
+             (l & LL_FIFO)        ? " fifo"        : "",
+             (l & LL_MLOCK)       ? " mlock"       : "",
+             (l & LL_NO_THP)      ? " no_thp"      : "");
+    view_strn('a', pref, "low_latency", buf[0] ? &buf[1] : "none");
+}
+
+
 /*
  * Show all values.
  */
@@ -2287,6 +3770,19 @@ show_debug(void)
 }
 
 
+/*
+ * Show a processor affinity.
+ */
+static void
+view_affinity(int type, char *pref, char *name, uint32_t value)
+{
+    if (value == AFFINITY_AUTO)
+        view_strn(type, pref, name, "auto");
+    else
+        view_long(type, pref, name, value);
+}
+
+
 /*
  * Show a cost in terms of seconds per gigabyte.
  */
@@ -2310,13 +3806,69 @@ view_cost(int type, char *pref, char *name, double value)
 
 
 /*
- * Show the number of cpus.
+ * Show an energy in terms of joules per gigabyte.
  */
 static void
-view_cpus(int type, char *pref, char *name, double value)
+view_energy_gb(int type, char *pref, char *name, double value)
 {
-    value *= 100;
-    if (!verbose(type, value))
+    int n = 0;
+    char *tab[] ={ "nJ/GB", "uJ/GB", "mJ/GB", "J/GB", "kJ/GB" };
+
+    value *= 1E9;
+    if (!verbose(type, value))
+        return;
+    if (!UnifyUnits) {
+        while (value >= 1000 && n < (int)cardof(tab)-1) {
+            value /= 1000;
+            ++n;
+        }
+    }
+    place_val(pref, name, tab[n], value);
+}
+
+
+/*
+ * Show an energy in terms of joules per message.
+ */
+static void
+view_energy_msg(int type, char *pref, char *name, double value)
+{
+    int n = 0;
+    char *tab[] ={ "nJ/msg", "uJ/msg", "mJ/msg", "J/msg" };
+
+    value *= 1E9;
+    if (!verbose(type, value))
+        return;
+    if (!UnifyUnits) {
+        while (value >= 1000 && n < (int)cardof(tab)-1) {
+            value /= 1000;
+            ++n;
+        }
+    }
+    place_val(pref, name, tab[n], value);
+}
+
+
+/*
+ * Show power in watts.
+ */
+static void
+view_watt(int type, char *pref, char *name, double value)
+{
+    if (!verbose(type, value))
+        return;
+    place_val(pref, name, "W", value);
+}
+
+
+/*
+ * Show the number of cpus.
+ */
+static void
+view_cpus(int type, char *pref, char *name, double value)
+{
+    value *= 100;
+    if (!verbose(type, value))
         return;
     place_val(pref, name, "% cpus", value);
 }
@@ -2365,6 +3917,19 @@ view_long(int type, char *pref, char *name, long long value)
 }
 
 
+/*
+ * Show a fraction as a percentage.
+ */
+static void
+view_pcnt(int type, char *pref, char *name, double value)
+{
+    value *= 100;
+    if (!verbose(type, value))
+        return;
+    place_val(pref, name, "%", value);
+}
+
+
 /*
  * Show a bandwidth value.
  */
@@ -2589,20 +4154,22 @@ place_show(void)
         int n = 0;
         SHOW *show = &ShowTable[i];
 
-        printf("    ");
-        if (show->pref) {
-            n = strlen(show->pref);
-            printf("%s", show->pref);
+        if (!Library) {
+            printf("    ");
+            if (show->pref) {
+                n = strlen(show->pref);
+                printf("%s", show->pref);
+            }
+            printf("%-*s", nameLen-n, show->name);
+            if (show->unit) {
+                printf("  =  %*s", dataLen, show->data);
+                printf(" %s", show->unit);
+            } else
+                printf("  =  %s", show->data);
+            if (show->altn)
+                printf(" (%s)", show->altn);
+            printf("\n");
         }
-        printf("%-*s", nameLen-n, show->name);
-        if (show->unit) {
-            printf("  =  %*s", dataLen, show->data);
-            printf(" %s", show->unit);
-        } else
-            printf("  =  %s", show->data);
-        if (show->altn)
-            printf(" (%s)", show->altn);
-        printf("\n");
         free(show->data);
         free(show->altn);
     }
@@ -2617,10 +4184,14 @@ static void
 set_affinity(void)
 {
     cpu_set_t set;
-    int a = Req.affinity;
+    uint32_t a = Req.affinity;
 
     if (!a)
         return;
+    if (a == AFFINITY_AUTO) {
+        set_affinity_auto();
+        return;
+    }
     CPU_ZERO(&set);
     CPU_SET(a-1, &set);
     if (sched_setaffinity(0, sizeof(set), &set) < 0)
@@ -2628,12 +4199,400 @@ set_affinity(void)
 }
 
 
+/*
+ * Apply or remove the low latency profile.  Level 1 holds the cpu DMA latency
+ * at 0 to keep processors out of deep C-states, runs us under SCHED_FIFO and
+ * locks our memory, prefaulting the heap so that buffers allocated later are
+ * already resident.  Level 2 also disables transparent huge pages so that the
+ * test does not stall on compaction.  A control that cannot be applied only
+ * produces a warning; the controls that were applied are recorded in LStat.
+ * The client runs several tests in one process, so when a later test does not
+ * ask for the profile, we undo it.
+ */
+static void
+set_low_latency(void)
+{
+    static uint32_t applied;
+    int level = Req.low_latency;
+
+    if (!level) {
+        if (applied & LL_DMA_LATENCY) {
+            close(DmaLatencyFD);
+            DmaLatencyFD = -1;
+        }
+        if (applied & LL_FIFO) {
+            struct sched_param param ={ .sched_priority = 0 };
+            sched_setscheduler(0, SCHED_OTHER, &param);
+        }
+        if (applied & LL_MLOCK)
+            munlockall();
+        if (applied & LL_NO_THP)
+            prctl(PR_SET_THP_DISABLE, 0, 0, 0, 0);
+        applied = 0;
+        return;
+    }
+
+    if (!(applied & LL_DMA_LATENCY)) {
+        int32_t zero = 0;
+
+        DmaLatencyFD = open("/dev/cpu_dma_latency", O_WRONLY);
+        if (DmaLatencyFD < 0)
+            error(SYS|RET, "warning: cannot open /dev/cpu_dma_latency");
+        else if (write(DmaLatencyFD, &zero, sizeof(zero)) != sizeof(zero)) {
+            error(SYS|RET, "warning: cannot set cpu dma latency");
+            close(DmaLatencyFD);
+            DmaLatencyFD = -1;
+        } else
+            applied |= LL_DMA_LATENCY;
+    }
+
+    if (!(applied & LL_FIFO)) {
+        struct sched_param param ={ .sched_priority = FIFO_PRIORITY };
+
+        if (sched_setscheduler(0, SCHED_FIFO, &param) < 0)
+            error(SYS|RET, "warning: cannot set SCHED_FIFO scheduling");
+        else
+            applied |= LL_FIFO;
+    }
+
+    if (!(applied & LL_MLOCK)) {
+        if (mlockall(MCL_CURRENT|MCL_FUTURE) < 0)
+            error(SYS|RET, "warning: cannot lock memory");
+        else {
+            prefault_heap(PREFAULT_SIZE);
+            applied |= LL_MLOCK;
+        }
+    }
+
+    if (level >= 2 && !(applied & LL_NO_THP)) {
+        if (prctl(PR_SET_THP_DISABLE, 1, 0, 0, 0) < 0)
+            error(SYS|RET, "warning: cannot disable transparent huge pages");
+        else
+            applied |= LL_NO_THP;
+    } else if (level < 2 && (applied & LL_NO_THP)) {
+        prctl(PR_SET_THP_DISABLE, 0, 0, 0, 0);
+        applied &= ~LL_NO_THP;
+    }
+
+    LStat.low_latency = applied;
+    debug("low latency controls applied: %#x", applied);
+}
+
+
+/*
+ * Choose a processor automatically.  We prefer processors on the same NUMA
+ * node as the NIC carrying the test and, among those, ones that are neither
+ * servicing the NIC's interrupts nor sharing a core with one that is.  Ties go
+ * to the lowest processor on the client and the highest on the server so that
+ * a loopback test does not put both ends on the same processor.
+ */
+static void
+set_affinity_auto(void)
+{
+    int cpu;
+    int node = -1;
+    int best = -1;
+    int bestScore = 0;
+    char buf[BUFSIZE];
+    char path[BUFSIZE];
+    cpu_set_t allowed;
+    cpu_set_t local;
+    cpu_set_t irqs;
+    cpu_set_t set;
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0)
+        error(SYS, "cannot get processor affinity");
+    CPU_ZERO(&irqs);
+    if (nic_device(path, sizeof(path), LStat.auto_nic)) {
+        if (read_line(buf, sizeof(buf), "%s/numa_node", path))
+            node = atoi(buf);
+        nic_irqs(path, &irqs);
+    }
+    if (node >= 0 && read_line(buf, sizeof(buf),
+                        "/sys/devices/system/node/node%d/cpulist", node))
+        cpu_list(buf, &local);
+    else {
+        node = -1;
+        local = allowed;
+    }
+
+    for (cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        int score = 0;
+
+        if (!CPU_ISSET(cpu, &allowed))
+            continue;
+        if (!CPU_ISSET(cpu, &local))
+            score += 4;
+        if (CPU_ISSET(cpu, &irqs))
+            score += 2;
+        else if (read_line(buf, sizeof(buf),
+                "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list",
+                                                                        cpu)) {
+            cpu_list(buf, &set);
+            CPU_AND(&set, &set, &irqs);
+            if (CPU_COUNT(&set))
+                score += 1;
+        }
+        if (best < 0 || score < bestScore ||
+                                    (score == bestScore && !is_client())) {
+            best = cpu;
+            bestScore = score;
+        }
+    }
+    if (best < 0)
+        error(0, "auto affinity: no processors available");
+
+    debug("auto affinity: nic %s, node %d, %d irq cpus: cpu %d (score %d)",
+          LStat.auto_nic[0] ? LStat.auto_nic : "unknown", node,
+          CPU_COUNT(&irqs), best, bestScore);
+    CPU_ZERO(&set);
+    CPU_SET(best, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) < 0)
+        error(SYS, "cannot set processor affinity (cpu %d)", best);
+    LStat.auto_cpu = best + 1;
+    LStat.auto_node = node + 1;
+}
+
+
+/*
+ * Find the NIC that carries the test.  For RDMA tests, this is the device
+ * named by --id or else the first device; for socket tests, it is the
+ * interface that routes to the other node.  The NIC name is returned in name
+ * and its sysfs device directory in path.  Return 1 if the device directory
+ * exists.
+ */
+static int
+nic_device(char *path, int len, char *name)
+{
+    name[0] = '\0';
+    if (is_rdma_test()) {
+        char *p;
+
+        strncopy(name, Req.id, STRSIZE);
+        p = strchr(name, ':');
+        if (p)
+            *p = '\0';
+        if (!name[0]) {
+            struct dirent *d;
+            DIR *dir = opendir("/sys/class/infiniband");
+
+            if (!dir)
+                return 0;
+            while ((d = readdir(dir)) != 0) {
+                if (d->d_name[0] == '.')
+                    continue;
+                if (!name[0] || strcmp(d->d_name, name) < 0)
+                    strncopy(name, d->d_name, STRSIZE);
+            }
+            closedir(dir);
+            if (!name[0])
+                return 0;
+        }
+        snprintf(path, len, "/sys/class/infiniband/%s/device", name);
+    } else {
+        if (!nic_ifname(name, STRSIZE))
+            return 0;
+        snprintf(path, len, "/sys/class/net/%s/device", name);
+    }
+    return access(path, F_OK) == SUCCESS0;
+}
+
+
+/*
+ * Determine if the current test uses RDMA devices.
+ */
+static int
+is_rdma_test(void)
+{
+    char *s = TestName;
+
+    return strncmp(s, "rc_",  3) == 0 || strncmp(s, "uc_",  3) == 0 ||
+           strncmp(s, "ud_",  3) == 0 || strncmp(s, "xrc_", 4) == 0 ||
+           strncmp(s, "ver_", 4) == 0;
+}
+
+
+/*
+ * Find the name of the interface that routes to the other node.  Connecting a
+ * UDP socket selects a route without sending anything; the local address it
+ * is given identifies the interface.
+ */
+int
+nic_ifname(char *name, int len)
+{
+    int fd;
+    int found = 0;
+    SS peer;
+    SS self;
+    socklen_t peerLen = sizeof(peer);
+    socklen_t selfLen = sizeof(self);
+    struct ifaddrs *ifa;
+    struct ifaddrs *ifap;
+
+    if (is_client()) {
+        AI hints ={
+            .ai_family   = AF_UNSPEC,
+            .ai_socktype = SOCK_DGRAM
+        };
+        AI *ai = getaddrinfo_port(ServerName, ListenPort, &hints);
+
+        peerLen = ai->ai_addrlen;
+        memcpy(&peer, ai->ai_addr, peerLen);
+        freeaddrinfo(ai);
+    } else if (getpeername(RemoteFD, (SA *)&peer, &peerLen) < 0)
+        return 0;
+
+    fd = socket(peer.ss_family, SOCK_DGRAM, 0);
+    if (fd < 0)
+        return 0;
+    if (connect(fd, (SA *)&peer, peerLen) < 0 ||
+        getsockname(fd, (SA *)&self, &selfLen) < 0) {
+        close(fd);
+        return 0;
+    }
+    close(fd);
+
+    if (getifaddrs(&ifap) < 0)
+        return 0;
+    for (ifa = ifap; ifa; ifa = ifa->ifa_next) {
+        if (ifa->ifa_addr && same_addr(ifa->ifa_addr, (SA *)&self)) {
+            strncopy(name, ifa->ifa_name, len);
+            found = 1;
+            break;
+        }
+    }
+    freeifaddrs(ifap);
+    return found;
+}
+
+
+/*
+ * Determine if two socket addresses refer to the same host address.  An IPv4
+ * mapped IPv6 address matches the corresponding IPv4 address.
+ */
+static int
+same_addr(SA *a, SA *b)
+{
+    int i;
+    SA *ab[2] = {a, b};
+    struct in_addr v4[2];
+    int isv4[2];
+
+    for (i = 0; i < 2; ++i) {
+        struct sockaddr_in6 *s6 = (struct sockaddr_in6 *)ab[i];
+
+        isv4[i] = 1;
+        if (ab[i]->sa_family == AF_INET)
+            v4[i] = ((struct sockaddr_in *)ab[i])->sin_addr;
+        else if (ab[i]->sa_family == AF_INET6 &&
+                 IN6_IS_ADDR_V4MAPPED(&s6->sin6_addr))
+            memcpy(&v4[i], &s6->sin6_addr.s6_addr[12], sizeof(v4[i]));
+        else
+            isv4[i] = 0;
+    }
+    if (isv4[0] && isv4[1])
+        return v4[0].s_addr == v4[1].s_addr;
+    if (isv4[0] || isv4[1])
+        return 0;
+    if (a->sa_family != AF_INET6 || b->sa_family != AF_INET6)
+        return 0;
+    return IN6_ARE_ADDR_EQUAL(&((struct sockaddr_in6 *)a)->sin6_addr,
+                              &((struct sockaddr_in6 *)b)->sin6_addr);
+}
+
+
+/*
+ * Add the processors that service the interrupts of a NIC to a set.  We use
+ * the effective affinity of each interrupt if the kernel reports it and the
+ * requested affinity (smp_affinity) otherwise.
+ */
+static void
+nic_irqs(char *path, cpu_set_t *set)
+{
+    struct dirent *d;
+    char buf[BUFSIZE];
+    char *name = qasprintf("%s/msi_irqs", path);
+    DIR *dir = opendir(name);
+
+    free(name);
+    if (!dir) {
+        if (read_line(buf, sizeof(buf), "%s/irq", path) && atoi(buf) > 0)
+            irq_cpus(buf, set);
+        return;
+    }
+    while ((d = readdir(dir)) != 0)
+        if (isdigit(d->d_name[0]))
+            irq_cpus(d->d_name, set);
+    closedir(dir);
+}
+
+
+/*
+ * Add the processors that service an interrupt to a set.
+ */
+static void
+irq_cpus(char *irq, cpu_set_t *set)
+{
+    char buf[BUFSIZE];
+
+    if (read_line(buf, sizeof(buf), "/proc/irq/%s/effective_affinity", irq) ||
+        read_line(buf, sizeof(buf), "/proc/irq/%s/smp_affinity", irq))
+        cpu_mask(buf, set);
+}
+
+
+/*
+ * Convert a list of processors such as 0-3,8-11 to a set.
+ */
+static void
+cpu_list(char *s, cpu_set_t *set)
+{
+    CPU_ZERO(set);
+    while (isdigit(*s)) {
+        long lo = strtol(s, &s, 10);
+        long hi = lo;
+
+        if (*s == '-')
+            hi = strtol(s+1, &s, 10);
+        for (; lo <= hi && lo < CPU_SETSIZE; ++lo)
+            CPU_SET(lo, set);
+        if (*s++ != ',')
+            break;
+    }
+}
+
+
+/*
+ * Add the processors in a hexadecimal mask such as ff,00000000 to a set.
+ */
+static void
+cpu_mask(char *s, cpu_set_t *set)
+{
+    int i;
+    int bit = 0;
+    char *p = &s[strlen(s)];
+
+    while (p-- > s) {
+        int v;
+
+        if (!isxdigit(*p))
+            continue;
+        v = isdigit(*p) ? *p - '0' : tolower(*p) - 'a' + 10;
+        for (i = 0; i < 4; ++i, ++bit)
+            if (v & (1 << i) && bit < CPU_SETSIZE)
+                CPU_SET(bit, set);
+    }
+}
+
+
 /*
  * Encode a REQ structure into a data stream.
  */
 static void
 enc_req(REQ *host)
 {
+    int i;
+
     enc_int(host->ver_maj,       sizeof(host->ver_maj));
     enc_int(host->ver_min,       sizeof(host->ver_min));
     enc_int(host->ver_inc,       sizeof(host->ver_inc));
@@ -2641,24 +4600,51 @@ enc_req(REQ *host)
     enc_int(host->access_recv,   sizeof(host->access_recv));
     enc_int(host->affinity,      sizeof(host->affinity));
     enc_int(host->alt_port,      sizeof(host->alt_port));
+    enc_int(host->breakdown,     sizeof(host->breakdown));
+    enc_int(host->cold_cache,    sizeof(host->cold_cache));
+    enc_int(host->compress_level, sizeof(host->compress_level));
+    enc_int(host->compress_pct,  sizeof(host->compress_pct));
     enc_int(host->flip,          sizeof(host->flip));
+    enc_int(host->low_latency,   sizeof(host->low_latency));
     enc_int(host->msg_size,      sizeof(host->msg_size));
     enc_int(host->mtu_size,      sizeof(host->mtu_size));
     enc_int(host->no_msgs,       sizeof(host->no_msgs));
+    enc_int(host->pipeline,      sizeof(host->pipeline));
     enc_int(host->poll_mode,     sizeof(host->poll_mode));
     enc_int(host->port,          sizeof(host->port));
+    enc_int(host->profile,       sizeof(host->profile));
+    enc_int(host->qos_dscp,      sizeof(host->qos_dscp));
+    enc_int(host->qos_priority,  sizeof(host->qos_priority));
+    enc_int(host->rails,         sizeof(host->rails));
     enc_int(host->rd_atomic,     sizeof(host->rd_atomic));
+    enc_int(host->samples,       sizeof(host->samples));
+    enc_int(host->service_time,  sizeof(host->service_time));
+    enc_int(host->service_touch, sizeof(host->service_touch));
     enc_int(host->sl,            sizeof(host->sl));
     enc_int(host->sock_buf_size, sizeof(host->sock_buf_size));
     enc_int(host->src_path_bits, sizeof(host->src_path_bits));
     enc_int(host->time,          sizeof(host->time));
     enc_int(host->timeout,       sizeof(host->timeout));
+    enc_int(host->ud_cqs,        sizeof(host->ud_cqs));
+    enc_int(host->ud_dests,      sizeof(host->ud_dests));
+    enc_int(host->ud_random,     sizeof(host->ud_random));
     enc_int(host->use_cm,        sizeof(host->use_cm));
+    enc_int(host->zerocopy_recv, sizeof(host->zerocopy_recv));
+    enc_str(host->cgroup_cpu,    sizeof(host->cgroup_cpu));
+    enc_str(host->cgroup_cpuset, sizeof(host->cgroup_cpuset));
+    enc_str(host->cgroup_mem,    sizeof(host->cgroup_mem));
+    enc_str(host->compress,      sizeof(host->compress));
     enc_str(host->id,            sizeof(host->id));
+    enc_str(host->pipeline_mode, sizeof(host->pipeline_mode));
+    enc_str(host->service_dist,  sizeof(host->service_dist));
     enc_str(host->static_rate,   sizeof(host->static_rate));
+    enc_str(host->xdp_mode,      sizeof(host->xdp_mode));
+    for (i = 0; i < SERVICE_QUANTS; ++i)
+        enc_int(host->service_table[i], sizeof(host->service_table[i]));
 }
 
 
+#ifndef LIBQPERF
 /*
  * Decode the version part of a REQ structure from a data stream.  To decode
  * the entire REQ structure, call dec_req_version and dec_req_data in
@@ -2679,26 +4665,58 @@ dec_req_version(REQ *host)
 static void
 dec_req_data(REQ *host)
 {
+    int i;
+
     host->req_index     = dec_int(sizeof(host->req_index));
     host->access_recv   = dec_int(sizeof(host->access_recv));
     host->affinity      = dec_int(sizeof(host->affinity));
     host->alt_port      = dec_int(sizeof(host->alt_port));
+    host->breakdown     = dec_int(sizeof(host->breakdown));
+    host->cold_cache    = dec_int(sizeof(host->cold_cache));
+    host->compress_level = dec_int(sizeof(host->compress_level));
+    host->compress_pct  = dec_int(sizeof(host->compress_pct));
     host->flip          = dec_int(sizeof(host->flip));
+    host->low_latency   = dec_int(sizeof(host->low_latency));
     host->msg_size      = dec_int(sizeof(host->msg_size));
     host->mtu_size      = dec_int(sizeof(host->mtu_size));
     host->no_msgs       = dec_int(sizeof(host->no_msgs));
+    host->pipeline      = dec_int(sizeof(host->pipeline));
     host->poll_mode     = dec_int(sizeof(host->poll_mode));
     host->port          = dec_int(sizeof(host->port));
+    host->profile       = dec_int(sizeof(host->profile));
+    host->qos_dscp      = dec_int(sizeof(host->qos_dscp));
+    host->qos_priority  = dec_int(sizeof(host->qos_priority));
+    host->rails         = dec_int(sizeof(host->rails));
     host->rd_atomic     = dec_int(sizeof(host->rd_atomic));
+    host->samples       = dec_int(sizeof(host->samples));
+    host->service_time  = dec_int(sizeof(host->service_time));
+    host->service_touch = dec_int(sizeof(host->service_touch));
     host->sl            = dec_int(sizeof(host->sl));
     host->sock_buf_size = dec_int(sizeof(host->sock_buf_size));
     host->src_path_bits = dec_int(sizeof(host->src_path_bits));
     host->time          = dec_int(sizeof(host->time));
     host->timeout       = dec_int(sizeof(host->timeout));
+    host->ud_cqs        = dec_int(sizeof(host->ud_cqs));
+    host->ud_dests      = dec_int(sizeof(host->ud_dests));
+    host->ud_random     = dec_int(sizeof(host->ud_random));
     host->use_cm        = dec_int(sizeof(host->use_cm));
+    host->zerocopy_recv = dec_int(sizeof(host->zerocopy_recv));
+                          dec_str(host->cgroup_cpu, sizeof(host->cgroup_cpu));
+                          dec_str(host->cgroup_cpuset,
+                                  sizeof(host->cgroup_cpuset));
+                          dec_str(host->cgroup_mem, sizeof(host->cgroup_mem));
+                          dec_str(host->compress, sizeof(host->compress));
                           dec_str(host->id, sizeof(host->id));
+                          dec_str(host->pipeline_mode,
+                                  sizeof(host->pipeline_mode));
+                          dec_str(host->service_dist,
+                                  sizeof(host->service_dist));
                           dec_str(host->static_rate,sizeof(host->static_rate));
+                          dec_str(host->xdp_mode, sizeof(host->xdp_mode));
+    for (i = 0; i < SERVICE_QUANTS; ++i)
+        host->service_table[i] = dec_int(sizeof(host->service_table[i]));
 }
+#endif
 
 
 /*
@@ -2712,6 +4730,44 @@ enc_stat(STAT *host)
     enc_int(host->no_cpus,  sizeof(host->no_cpus));
     enc_int(host->no_ticks, sizeof(host->no_ticks));
     enc_int(host->max_cqes, sizeof(host->max_cqes));
+    enc_int(host->auto_cpu, sizeof(host->auto_cpu));
+    enc_int(host->auto_node, sizeof(host->auto_node));
+    enc_str(host->auto_nic, sizeof(host->auto_nic));
+    enc_int(host->low_latency, sizeof(host->low_latency));
+    enc_int(host->flush_ns, sizeof(host->flush_ns));
+    enc_int(host->energy_pkg, sizeof(host->energy_pkg));
+    enc_int(host->energy_dram, sizeof(host->energy_dram));
+    enc_int(host->link_speed, sizeof(host->link_speed));
+    enc_int(host->link_payload, sizeof(host->link_payload));
+    enc_int(host->link_wire, sizeof(host->link_wire));
+    enc_int(host->stage_msgs, sizeof(host->stage_msgs));
+    enc_int(host->stage_mask, sizeof(host->stage_mask));
+    for (i = 0; i < S_N; ++i)
+        enc_int(host->stage_avg[i], sizeof(host->stage_avg[i]));
+    for (i = 0; i < S_N; ++i)
+        enc_int(host->stage_p50[i], sizeof(host->stage_p50[i]));
+    for (i = 0; i < S_N; ++i)
+        enc_int(host->stage_p99[i], sizeof(host->stage_p99[i]));
+    enc_int(host->pipe_msgs, sizeof(host->pipe_msgs));
+    enc_int(host->pipe_stalls, sizeof(host->pipe_stalls));
+    enc_int(host->pipe_lat_avg, sizeof(host->pipe_lat_avg));
+    enc_int(host->pipe_lat_max, sizeof(host->pipe_lat_max));
+    enc_int(host->pipe_rate, sizeof(host->pipe_rate));
+    for (i = 0; i < RAILS_MAX; ++i)
+        enc_int(host->rail_bytes[i], sizeof(host->rail_bytes[i]));
+    enc_int(host->path_mig, sizeof(host->path_mig));
+    enc_int(host->cg_periods, sizeof(host->cg_periods));
+    enc_int(host->cg_throttled, sizeof(host->cg_throttled));
+    enc_int(host->cg_throttled_us, sizeof(host->cg_throttled_us));
+    enc_int(host->comp_bytes, sizeof(host->comp_bytes));
+    enc_int(host->zc_bytes, sizeof(host->zc_bytes));
+    enc_int(host->zc_error, sizeof(host->zc_error));
+    enc_str(host->xdp_mode, sizeof(host->xdp_mode));
+    enc_int(host->ah_count, sizeof(host->ah_count));
+    enc_int(host->ah_create_ns, sizeof(host->ah_create_ns));
+    enc_int(host->ep_cqs, sizeof(host->ep_cqs));
+    enc_int(host->ep_wakeups, sizeof(host->ep_wakeups));
+    enc_int(host->ep_events, sizeof(host->ep_events));
     for (i = 0; i < T_N; ++i)
         enc_int(host->time_s[i], sizeof(host->time_s[i]));
     for (i = 0; i < T_N; ++i)
@@ -2734,6 +4790,44 @@ dec_stat(STAT *host)
     host->no_cpus  = dec_int(sizeof(host->no_cpus));
     host->no_ticks = dec_int(sizeof(host->no_ticks));
     host->max_cqes = dec_int(sizeof(host->max_cqes));
+    host->auto_cpu = dec_int(sizeof(host->auto_cpu));
+    host->auto_node = dec_int(sizeof(host->auto_node));
+                     dec_str(host->auto_nic, sizeof(host->auto_nic));
+    host->low_latency = dec_int(sizeof(host->low_latency));
+    host->flush_ns = dec_int(sizeof(host->flush_ns));
+    host->energy_pkg = dec_int(sizeof(host->energy_pkg));
+    host->energy_dram = dec_int(sizeof(host->energy_dram));
+    host->link_speed = dec_int(sizeof(host->link_speed));
+    host->link_payload = dec_int(sizeof(host->link_payload));
+    host->link_wire = dec_int(sizeof(host->link_wire));
+    host->stage_msgs = dec_int(sizeof(host->stage_msgs));
+    host->stage_mask = dec_int(sizeof(host->stage_mask));
+    for (i = 0; i < S_N; ++i)
+        host->stage_avg[i] = dec_int(sizeof(host->stage_avg[i]));
+    for (i = 0; i < S_N; ++i)
+        host->stage_p50[i] = dec_int(sizeof(host->stage_p50[i]));
+    for (i = 0; i < S_N; ++i)
+        host->stage_p99[i] = dec_int(sizeof(host->stage_p99[i]));
+    host->pipe_msgs = dec_int(sizeof(host->pipe_msgs));
+    host->pipe_stalls = dec_int(sizeof(host->pipe_stalls));
+    host->pipe_lat_avg = dec_int(sizeof(host->pipe_lat_avg));
+    host->pipe_lat_max = dec_int(sizeof(host->pipe_lat_max));
+    host->pipe_rate = dec_int(sizeof(host->pipe_rate));
+    for (i = 0; i < RAILS_MAX; ++i)
+        host->rail_bytes[i] = dec_int(sizeof(host->rail_bytes[i]));
+    host->path_mig = dec_int(sizeof(host->path_mig));
+    host->cg_periods = dec_int(sizeof(host->cg_periods));
+    host->cg_throttled = dec_int(sizeof(host->cg_throttled));
+    host->cg_throttled_us = dec_int(sizeof(host->cg_throttled_us));
+    host->comp_bytes = dec_int(sizeof(host->comp_bytes));
+    host->zc_bytes = dec_int(sizeof(host->zc_bytes));
+    host->zc_error = dec_int(sizeof(host->zc_error));
+                     dec_str(host->xdp_mode, sizeof(host->xdp_mode));
+    host->ah_count = dec_int(sizeof(host->ah_count));
+    host->ah_create_ns = dec_int(sizeof(host->ah_create_ns));
+    host->ep_cqs = dec_int(sizeof(host->ep_cqs));
+    host->ep_wakeups = dec_int(sizeof(host->ep_wakeups));
+    host->ep_events = dec_int(sizeof(host->ep_events));
     for (i = 0; i < T_N; ++i)
         host->time_s[i] = dec_int(sizeof(host->time_s[i]));
     for (i = 0; i < T_N; ++i)
@@ -2807,6 +4901,565 @@ get_times(CLOCK timex[T_N])
 }
 
 
+/*
+ * Find the energy counters.  We use the package and DRAM domains of RAPL as
+ * exported by powercap (on Intel and on AMD processors supported by the same
+ * driver) and fall back to the per-socket counters of the amd_energy hwmon
+ * driver.  Reading the counters usually requires root privileges; if none can
+ * be read, energy is simply not reported.
+ */
+static void
+energy_init(void)
+{
+    DIR *dir;
+    struct dirent *d;
+    char buf[BUFSIZE];
+
+    dir = opendir("/sys/class/powercap");
+    if (dir) {
+        while ((d = readdir(dir)) != 0) {
+            char *zone = d->d_name;
+            char *base = qasprintf("/sys/class/powercap/%s", zone);
+
+            if (strncmp(zone, "intel-rapl:", 11) == 0 &&
+                read_line(buf, sizeof(buf), "%s/name", base)) {
+                int dram = streq(buf, "dram");
+
+                if (dram || strncmp(buf, "package-", 8) == 0) {
+                    uint64_t range = 0;
+
+                    if (read_line(buf, sizeof(buf), "%s/max_energy_range_uj",
+                                                                        base))
+                        range = strtoull(buf, 0, 10);
+                    energy_add(base, "energy_uj", dram, range);
+                }
+            }
+            free(base);
+        }
+        closedir(dir);
+    }
+    if (EnergyN)
+        return;
+
+    dir = opendir("/sys/class/hwmon");
+    if (!dir)
+        return;
+    while ((d = readdir(dir)) != 0) {
+        int i;
+        char *base = qasprintf("/sys/class/hwmon/%s", d->d_name);
+
+        if (d->d_name[0] != '.' &&
+            read_line(buf, sizeof(buf), "%s/name", base) &&
+            streq(buf, "amd_energy")) {
+            for (i = 1; read_line(buf, sizeof(buf), "%s/energy%d_label",
+                                                            base, i); ++i) {
+                if (strncmp(buf, "Esocket", 7) == 0) {
+                    char file[STRSIZE];
+
+                    snprintf(file, sizeof(file), "energy%d_input", i);
+                    energy_add(base, file, 0, 0);
+                }
+            }
+        }
+        free(base);
+    }
+    closedir(dir);
+}
+
+
+/*
+ * Add an energy counter if we can read it.
+ */
+static void
+energy_add(char *dir, char *file, int dram, uint64_t range)
+{
+    ENERGY *e = &Energy[EnergyN];
+    char *path = qasprintf("%s/%s", dir, file);
+    uint64_t value;
+
+    if (EnergyN < ENERGY_MAX) {
+        e->fd = open(path, O_RDONLY);
+        if (e->fd >= 0) {
+            if (energy_read(e, &value)) {
+                e->dram = dram;
+                e->range = range;
+                EnergyN++;
+                debug("energy counter %s", path);
+            } else
+                close(e->fd);
+        }
+    }
+    free(path);
+}
+
+
+/*
+ * Note the energy counters at the start of a test.
+ */
+static void
+energy_start(void)
+{
+    int i;
+
+    LStat.energy_pkg = 0;
+    LStat.energy_dram = 0;
+    for (i = 0; i < EnergyN; ++i)
+        energy_read(&Energy[i], &Energy[i].start);
+}
+
+
+/*
+ * Accumulate the energy used since the start of the test.  A counter that
+ * has wrapped is corrected using its range.  This may be called from a signal
+ * handler.
+ */
+static void
+energy_end(void)
+{
+    int i;
+
+    for (i = 0; i < EnergyN; ++i) {
+        uint64_t used;
+        uint64_t value;
+        ENERGY *e = &Energy[i];
+
+        if (!energy_read(e, &value))
+            continue;
+        if (value >= e->start)
+            used = value - e->start;
+        else if (e->range)
+            used = value + e->range - e->start;
+        else
+            continue;
+        if (e->dram)
+            LStat.energy_dram += used;
+        else
+            LStat.energy_pkg += used;
+    }
+}
+
+
+/*
+ * Read an energy counter.
+ */
+static int
+energy_read(ENERGY *e, uint64_t *value)
+{
+    char buf[32];
+    int n = pread(e->fd, buf, sizeof(buf)-1, 0);
+
+    if (n <= 0)
+        return 0;
+    buf[n] = '\0';
+    *value = strtoull(buf, 0, 10);
+    return 1;
+}
+
+
+/*
+ * Map the file that per message samples are recorded into.  The client maps
+ * the sample file with room for the samples of both nodes; the server maps an
+ * unlinked temporary file.  The file is allocated and the mapping populated
+ * up front so that recording a sample in a test loop is only a few stores.
+ */
+static void
+sample_init(void)
+{
+    int fd;
+    size_t len;
+    SAMPLE_HDR *hdr;
+    char path[PATH_MAX];
+
+    SampleN = 0;
+    SampleMax = Req.samples;
+    if (is_client()) {
+        heat_init();
+        if (!SampleFile) {
+            if (Req.samples || RReq.samples)
+                error(0, "--samples requires --sample_file");
+            return;
+        }
+        test_path(path, sizeof(path), SampleFile);
+        fd = open(path, O_RDWR|O_CREAT|O_TRUNC, 0644);
+        len = (size_t)Req.samples + RReq.samples;
+    } else {
+        char *dir = getenv("TMPDIR");
+
+        if (!SampleMax)
+            return;
+        snprintf(path, sizeof(path), "%s/qperf.XXXXXX", dir ? dir : "/tmp");
+        fd = mkstemp(path);
+        if (fd >= 0)
+            unlink(path);
+        len = SampleMax;
+    }
+    if (fd < 0)
+        error(SYS, "cannot create %s", path);
+
+    len = sizeof(SAMPLE_HDR) + len * sizeof(SAMPLE);
+    if (posix_fallocate(fd, 0, len) != SUCCESS0 && ftruncate(fd, len) < 0)
+        error(SYS, "cannot extend %s", path);
+    SampleMap = mmap(0, len, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+                     fd, 0);
+    if (SampleMap == MAP_FAILED)
+        error(SYS, "cannot map %s", path);
+    SampleFD = fd;
+    SampleLen = len;
+
+    hdr = SampleMap;
+    memset(hdr, 0, sizeof(*hdr));
+    memcpy(hdr->magic, SAMPLE_MAGIC, sizeof(hdr->magic));
+    hdr->version = SAMPLE_VER;
+    hdr->size = sizeof(SAMPLE);
+    strncopy(hdr->test, TestName, sizeof(hdr->test));
+    Samples = (SAMPLE *)(hdr + 1);
+    debug("recording up to %u samples in %s", SampleMax, path);
+}
+
+
+/*
+ * Get the name of an output file.  A %s in the name is replaced by the name of
+ * the test so that each test of a run can have its own file.
+ */
+static void
+test_path(char *path, int len, char *file)
+{
+    char *p = strstr(file, "%s");
+
+    if (p)
+        snprintf(path, len, "%.*s%s%s", (int)(p-file), file, TestName, p+2);
+    else
+        snprintf(path, len, "%s", file);
+}
+
+
+/*
+ * Return the time to start a sample or 0 if we are not recording samples.
+ */
+uint64_t
+sample_time(void)
+{
+    return (SampleMax || Heat || LatHist || FaultRes.on) ? get_nsecs() : 0;
+}
+
+
+/*
+ * Return how long the test has been running in nanoseconds.
+ */
+uint64_t
+test_nsecs(void)
+{
+    return get_nsecs() - SampleBase;
+}
+
+
+/*
+ * Record a sample that was started at the given time.  This is called in the
+ * test loops and so must not format anything or make system calls.
+ */
+void
+sample_add(uint64_t time, int size, int status)
+{
+    SAMPLE *s;
+    uint64_t now;
+
+    if (!time)
+        return;
+    now = get_nsecs();
+    if (Heat && !status)
+        heat_add(time - SampleBase, now - time);
+    if (LatHist && !status)
+        LatHist[heat_bucket(now - time)]++;
+    if (FaultRes.state >= 1 && !FaultRes.recovered &&
+        now - time > FaultRes.lat_max)
+        FaultRes.lat_max = now - time;
+    if (SampleN >= SampleMax)
+        return;
+    s = &Samples[SampleN++];
+    s->latency = now - time;
+    s->time = time - SampleBase;
+    s->size = size;
+    s->status = status;
+    s->node = !is_client();
+}
+
+
+/*
+ * Send the samples the server recorded to the client.
+ */
+static void
+sample_send(void)
+{
+    uint32_t i;
+    uint8_t *buf;
+    uint8_t count[4];
+    long len = (long)SampleN * SAMPLE_WIRE;
+
+    if (!Req.samples)
+        return;
+    enc_init(count);
+    enc_int(SampleN, sizeof(count));
+    send_mesg(count, sizeof(count), "sample count");
+    if (SampleN) {
+        buf = qmalloc(len);
+        enc_init(buf);
+        for (i = 0; i < SampleN; ++i) {
+            SAMPLE *s = &Samples[i];
+
+            enc_int(s->time, sizeof(s->time));
+            enc_int(s->latency, sizeof(s->latency));
+            enc_int(s->size, sizeof(s->size));
+            enc_int(s->status, sizeof(s->status));
+        }
+        send_mesg(buf, len, "samples");
+        free(buf);
+    }
+    munmap(SampleMap, SampleLen);
+    close(SampleFD);
+    SampleMap = 0;
+    SampleMax = 0;
+}
+
+
+/*
+ * Receive the samples the server recorded and merge them with ours in order of
+ * time.  Both sets are already in order.  The times are from the start of the
+ * test on each node, which differ by no more than the time to synchronize.
+ */
+static void
+sample_merge(void)
+{
+    uint32_t i;
+    uint32_t l;
+    uint32_t r;
+    uint32_t rn = 0;
+    SAMPLE *loc = 0;
+    SAMPLE *rem = 0;
+    SAMPLE_HDR *hdr = SampleMap;
+
+    if (!SampleMap)
+        return;
+    if (RReq.samples) {
+        uint8_t count[4];
+
+        recv_mesg(count, sizeof(count), "sample count");
+        dec_init(count);
+        rn = dec_int(sizeof(count));
+        if (rn > RReq.samples)
+            error(0, "server sent %u samples; at most %u expected",
+                                                        rn, RReq.samples);
+    }
+    if (rn) {
+        long len = (long)rn * SAMPLE_WIRE;
+        uint8_t *buf = qmalloc(len);
+
+        recv_mesg(buf, len, "samples");
+        rem = qmalloc(rn * sizeof(SAMPLE));
+        dec_init(buf);
+        for (i = 0; i < rn; ++i) {
+            SAMPLE *s = &rem[i];
+
+            s->time = dec_int(sizeof(s->time));
+            s->latency = dec_int(sizeof(s->latency));
+            s->size = dec_int(sizeof(s->size));
+            s->status = dec_int(sizeof(s->status));
+            s->node = 1;
+        }
+        free(buf);
+    }
+    if (SampleN) {
+        loc = qmalloc(SampleN * sizeof(SAMPLE));
+        memcpy(loc, Samples, SampleN * sizeof(SAMPLE));
+    }
+
+    l = r = 0;
+    for (i = 0; i < SampleN + rn; ++i) {
+        if (r == rn || (l < SampleN && loc[l].time <= rem[r].time))
+            Samples[i] = loc[l++];
+        else
+            Samples[i] = rem[r++];
+    }
+    hdr->count[0] = SampleN;
+    hdr->count[1] = rn;
+    free(loc);
+    free(rem);
+
+    munmap(SampleMap, SampleLen);
+    if (ftruncate(SampleFD, sizeof(SAMPLE_HDR) + i * sizeof(SAMPLE)) < 0)
+        error(SYS|RET, "cannot truncate sample file");
+    close(SampleFD);
+    SampleMap = 0;
+    SampleMax = 0;
+}
+
+
+/*
+ * Allocate the heatmap, a histogram of latency for each HeatBin ms of the
+ * test.  We allocate enough rows for the test time so that a test loop only
+ * has to increment a count.
+ */
+static void
+heat_init(void)
+{
+    free(Heat);
+    Heat = 0;
+    HeatUsed = 0;
+    if (!HeatFile)
+        return;
+    HeatRows = (uint64_t)Req.time * 1000 / HeatBin + HEAT_ROWS;
+    Heat = calloc((size_t)HeatRows * HEAT_BUCKETS, sizeof(*Heat));
+    if (!Heat)
+        error(0, "out of space");
+}
+
+
+/*
+ * Add a latency to the heatmap.  If the test runs longer than expected, as it
+ * may when the number of messages is given, we add more rows.
+ */
+static void
+heat_add(uint64_t time, uint64_t latency)
+{
+    uint64_t row = time / (HeatBin * 1000000ULL);
+
+    if (row >= HeatRows) {
+        int rows = row + HEAT_ROWS;
+        uint32_t *heat = realloc(Heat, (size_t)rows*HEAT_BUCKETS*sizeof(*Heat));
+
+        if (!heat)
+            return;
+        memset(&heat[(size_t)HeatRows * HEAT_BUCKETS], 0,
+               (size_t)(rows-HeatRows) * HEAT_BUCKETS * sizeof(*Heat));
+        Heat = heat;
+        HeatRows = rows;
+    }
+    if (row >= HeatUsed)
+        HeatUsed = row + 1;
+    Heat[row * HEAT_BUCKETS + heat_bucket(latency)]++;
+}
+
+
+/*
+ * Find the heatmap bucket of a latency in ns.  There are four buckets for each
+ * power of two from 64 ns; the last bucket also counts anything longer.
+ */
+static int
+heat_bucket(uint64_t latency)
+{
+    int b;
+    int lg;
+
+    if (latency < 64)
+        return 0;
+    lg = 63 - __builtin_clzll(latency);
+    b = (lg-6) * 4 + ((latency >> (lg-2)) & 3);
+    return b < HEAT_BUCKETS ? b : HEAT_BUCKETS-1;
+}
+
+
+/*
+ * Return the lowest latency in ns of a heatmap bucket.
+ */
+static uint64_t
+heat_floor(int bucket)
+{
+    return (4ULL + bucket%4) << (bucket/4 + 4);
+}
+
+
+/*
+ * Write the heatmap as a gnuplot nonuniform matrix.  The first row has the
+ * number of buckets followed by the lowest latency in ns of each bucket; each
+ * following row has the start of an interval in ms followed by the count of
+ * messages in each bucket.
+ */
+static void
+heat_write(void)
+{
+    int b;
+    int r;
+    FILE *fp;
+    char path[PATH_MAX];
+
+    if (!Heat)
+        return;
+    if (!HeatUsed) {
+        free(Heat);
+        Heat = 0;
+        return;
+    }
+    test_path(path, sizeof(path), HeatFile);
+    fp = fopen(path, "w");
+    if (!fp) {
+        error(SYS|RET, "cannot create %s", path);
+        return;
+    }
+    fprintf(fp, "%d", HEAT_BUCKETS);
+    for (b = 0; b < HEAT_BUCKETS; ++b)
+        fprintf(fp, " %llu", (unsigned long long)heat_floor(b));
+    fprintf(fp, "\n");
+    for (r = 0; r < HeatUsed; ++r) {
+        uint32_t *row = &Heat[r * HEAT_BUCKETS];
+
+        fprintf(fp, "%d", r * HeatBin);
+        for (b = 0; b < HEAT_BUCKETS; ++b)
+            fprintf(fp, " %u", row[b]);
+        fprintf(fp, "\n");
+    }
+    if (fclose(fp) != SUCCESS0)
+        error(SYS|RET, "cannot write %s", path);
+    free(Heat);
+    Heat = 0;
+}
+
+
+/*
+ * Add the time taken by a stage of a message.  Times may come from different
+ * clocks, so ignore any that are negative.
+ */
+void
+stage_add(STAGE stage, int64_t time)
+{
+    if (time < 0)
+        return;
+    StageHist[stage][heat_bucket(time)]++;
+    StageSum[stage] += time;
+    StageMsgs[stage]++;
+}
+
+
+/*
+ * Summarize the time taken by each stage as the mean, median and 99th
+ * percentile.  The percentiles are the lowest time of their bucket.
+ */
+static void
+stage_calc(void)
+{
+    int b;
+    int i;
+
+    LStat.stage_msgs = StageMsgs[S_CYCLE];
+    for (i = 0; i < S_N; ++i) {
+        uint32_t n = 0;
+        uint32_t msgs = StageMsgs[i];
+
+        if (!msgs)
+            continue;
+        LStat.stage_mask |= 1 << i;
+        LStat.stage_avg[i] = StageSum[i] / msgs;
+        for (b = 0; b < HEAT_BUCKETS; ++b) {
+            n += StageHist[i][b];
+            if (!LStat.stage_p50[i] && 2 * n >= msgs)
+                LStat.stage_p50[i] = heat_floor(b);
+            if (100ULL * n >= 99ULL * msgs) {
+                LStat.stage_p99[i] = heat_floor(b);
+                break;
+            }
+        }
+    }
+}
+
+
 /*
  * Insert commas within a number for readability.
  */
@@ -2866,3 +5519,172 @@ strncopy(char *d, char *s, int n)
     strncpy(d, s, n);
     d[n-1] = '\0';
 }
+
+
+/*
+ * Load the service times in ns, one to a line, from a file for
+ * --service_file.  We send the server the times at SERVICE_QUANTS evenly
+ * spaced quantiles.
+ */
+static void
+service_load(char *file)
+{
+    int i;
+    char line[256];
+    long n = 0;
+    long max = 0;
+    uint32_t *times = 0;
+    FILE *fp = fopen(file, "r");
+
+    if (!fp)
+        error(SYS, "cannot open %s", file);
+    while (fgets(line, sizeof(line), fp)) {
+        char *p = line + strspn(line, " \t");
+
+        if (*p == '\n' || *p == '\0' || *p == '#')
+            continue;
+        p[strcspn(p, "\r\n")] = '\0';
+        if (n == max) {
+            max = max ? max * 2 : 1024;
+            times = realloc(times, max * sizeof(*times));
+            if (!times)
+                error(0, "out of space");
+        }
+        times[n++] = str_nsec(p, file);
+    }
+    fclose(fp);
+    if (!n)
+        error(0, "%s: no service times", file);
+
+    qsort(times, n, sizeof(*times), service_cmp);
+    for (i = 0; i < SERVICE_QUANTS; ++i)
+        RReq.service_table[i] = times[(n-1) * i / (SERVICE_QUANTS-1)];
+    free(times);
+    setp_str("--service_file", R_SERVICE_DIST, "empirical");
+}
+
+
+/*
+ * Compare two service times for qsort.
+ */
+static int
+service_cmp(const void *a, const void *b)
+{
+    uint32_t x = *(uint32_t *)a;
+    uint32_t y = *(uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+
+#ifndef LIBQPERF
+/*
+ * Set up the service time of a request on the server.  Distributions are:
+ *   fixed            every request takes service_time
+ *   exp              exponentially distributed with mean service_time
+ *   bimodal:Pct:Time Pct percent of requests take Time, the rest service_time
+ *   empirical        drawn from the table sent with --service_file
+ */
+static void
+service_init(void)
+{
+    char *dist = Req.service_dist;
+
+    ServiceOn = 0;
+    if (dist[0] == '\0' || streq(dist, "fixed"))
+        ServiceDist = SD_FIXED;
+    else if (streq(dist, "exp"))
+        ServiceDist = SD_EXP;
+    else if (streq(dist, "empirical"))
+        ServiceDist = SD_EMPIRICAL;
+    else if (strncmp(dist, "bimodal:", 8) == 0) {
+        char *p;
+
+        ServicePct = strtoul(dist+8, &p, 10);
+        if (*p != ':' || ServicePct > 100)
+            error(0, "bad service distribution: %s", dist);
+        ServiceAlt = str_nsec(p+1, "service_dist");
+        ServiceDist = SD_BIMODAL;
+    } else
+        error(0, "bad service distribution: %s", dist);
+
+    if (Req.service_touch) {
+        ServiceBuf = qmalloc(Req.service_touch);
+        memset(ServiceBuf, 0, Req.service_touch);
+    }
+    ServiceSeed = get_nsecs() | 1;
+    ServiceOn = Req.service_time || Req.service_touch ||
+                ServiceDist == SD_BIMODAL || ServiceDist == SD_EMPIRICAL;
+}
+#endif
+
+
+/*
+ * Serve a request: touch --service_touch bytes of memory and then spin until
+ * the service time has passed since we started.  This is called by the server
+ * between receiving a request and sending the reply.
+ */
+void
+service_wait(void)
+{
+    uint64_t end;
+
+    if (!ServiceOn)
+        return;
+    end = get_nsecs() + service_next();
+    if (ServiceBuf) {
+        uint32_t i;
+
+        for (i = 0; i < Req.service_touch; i += 64)
+            ServiceBuf[i]++;
+    }
+    while (get_nsecs() < end && !Finished)
+        ;
+}
+
+
+/*
+ * Return the service time of the next request in ns.  An empirical time is
+ * interpolated between two adjacent quantiles.
+ */
+static uint64_t
+service_next(void)
+{
+    int i;
+    double u;
+    uint64_t f;
+    uint32_t *t = Req.service_table;
+
+    switch (ServiceDist) {
+    case SD_EXP:
+        u = (service_rand() >> 11) * (1.0 / (1ULL << 53));
+        return -log(1.0 - u) * Req.service_time;
+    case SD_BIMODAL:
+        if (service_rand() % 100 < ServicePct)
+            return ServiceAlt;
+        return Req.service_time;
+    case SD_EMPIRICAL:
+        f = (service_rand() >> 32) * (SERVICE_QUANTS-1);
+        i = f >> 32;
+        f &= 0xffffffff;
+        return t[i] + (((uint64_t)(t[i+1] - t[i]) * f) >> 32);
+    default:
+        return Req.service_time;
+    }
+}
+
+
+/*
+ * A fast pseudo-random number generator (xorshift64*).
+ */
+static uint64_t
+service_rand(void)
+{
+    uint64_t x = ServiceSeed;
+
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    ServiceSeed = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
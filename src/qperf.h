@@ -40,6 +40,9 @@
  * Parameters.
  */
 #define STRSIZE 64
+#define PROFILE_TOP 5                   /* Symbols shown by --profile */
+#define SERVICE_QUANTS 64               /* Quantiles of --service_file */
+#define RAILS_MAX 8                     /* Streams striped with --rails */
 
 
 /*
@@ -88,6 +91,25 @@ typedef enum {
 } TIME_INDEX;
 
 
+/*
+ * Stages of a message measured by --breakdown.  S_CYCLE is the round trip on
+ * the client and the time to reply on the server.  S_SYSCALL and S_WAKEUP are
+ * only measured with tracepoints and S_SEND_QDISC only with timestamps.  The
+ * round trips of the two probes of the QoS tests are kept alongside.
+ */
+typedef enum {
+    S_CYCLE,
+    S_SYSCALL,
+    S_SEND_STACK,
+    S_SEND_QDISC,
+    S_RECV_STACK,
+    S_WAKEUP,
+    S_PROBE,
+    S_PROBE_QOS,
+    S_N
+} STAGE;
+
+
 /*
  * Parameter indices.  P_NULL must be 0.
  */
@@ -99,22 +121,60 @@ typedef enum {
     R_AFFINITY,
     L_ALT_PORT,
     R_ALT_PORT,
+    L_BREAKDOWN,
+    R_BREAKDOWN,
+    L_CGROUP_CPU,
+    R_CGROUP_CPU,
+    L_CGROUP_CPUSET,
+    R_CGROUP_CPUSET,
+    L_CGROUP_MEM,
+    R_CGROUP_MEM,
+    L_COLD_CACHE,
+    R_COLD_CACHE,
+    L_COMPRESS,
+    R_COMPRESS,
+    L_COMPRESS_LEVEL,
+    R_COMPRESS_LEVEL,
+    L_COMPRESS_PCT,
+    R_COMPRESS_PCT,
     L_FLIP,
     R_FLIP,
     L_ID,
     R_ID,
+    L_LOW_LATENCY,
+    R_LOW_LATENCY,
     L_MSG_SIZE,
     R_MSG_SIZE,
     L_MTU_SIZE,
     R_MTU_SIZE,
     L_NO_MSGS,
     R_NO_MSGS,
+    L_PIPELINE,
+    R_PIPELINE,
+    L_PIPELINE_MODE,
+    R_PIPELINE_MODE,
     L_POLL_MODE,
     R_POLL_MODE,
     L_PORT,
     R_PORT,
+    L_PROFILE,
+    R_PROFILE,
+    L_QOS_DSCP,
+    R_QOS_DSCP,
+    L_QOS_PRIORITY,
+    R_QOS_PRIORITY,
+    L_RAILS,
+    R_RAILS,
     L_RD_ATOMIC,
     R_RD_ATOMIC,
+    L_SAMPLES,
+    R_SAMPLES,
+    L_SERVICE_DIST,
+    R_SERVICE_DIST,
+    L_SERVICE_TIME,
+    R_SERVICE_TIME,
+    L_SERVICE_TOUCH,
+    R_SERVICE_TOUCH,
     L_SL,
     R_SL,
     L_SOCK_BUF_SIZE,
@@ -127,8 +187,18 @@ typedef enum {
     R_TIME,
     L_TIMEOUT,
     R_TIMEOUT,
+    L_UD_CQS,
+    R_UD_CQS,
+    L_UD_DESTS,
+    R_UD_DESTS,
+    L_UD_RANDOM,
+    R_UD_RANDOM,
     L_USE_CM,
     R_USE_CM,
+    L_XDP_MODE,
+    R_XDP_MODE,
+    L_ZEROCOPY_RECV,
+    R_ZEROCOPY_RECV,
     P_N
 } PAR_INDEX;
 
@@ -144,6 +214,24 @@ typedef enum {
 } MEASURE;
 
 
+/*
+ * What was measured around a fault injected with --fault_len or a path
+ * migration forced with --fault_kind migrate.  State is 0 before the fault, 1
+ * during it, 2 after it and -1 if it could not be injected.
+ */
+typedef struct FAULT_RES {
+    int         on;                     /* Watching this test */
+    int         state;                  /* Where we are */
+    int         recovered;              /* Rate got back to normal */
+    uint64_t    at;                     /* When the fault began, ns into test */
+    uint64_t    recovery;               /* Time to recover after fault in ns */
+    uint64_t    stall;                  /* Longest time without progress */
+    uint64_t    retrans;                /* TCP segments retransmitted */
+    uint64_t    errors;                 /* Errors during the test */
+    uint64_t    lat_max;                /* Worst latency until recovery */
+} FAULT_RES;
+
+
 /*
  * Request to the server.  Note that most of these must be of type uint32_t
  * because of the way options are set.  The minor version must be changed if
@@ -158,24 +246,63 @@ typedef struct REQ {
     uint32_t    access_recv;            /* Access data after receiving */
     uint32_t    affinity;               /* Processor affinity */
     uint32_t    alt_port;               /* Alternate path port number */
+    uint32_t    breakdown;              /* Break latency into stages */
+    uint32_t    cold_cache;             /* Flush caches between messages */
+    uint32_t    compress_level;         /* Compression level */
+    uint32_t    compress_pct;           /* Compressibility of data sent */
     uint32_t    flip;                   /* Flip sender/receiver */
+    uint32_t    low_latency;            /* Low latency profile */
     uint32_t    msg_size;               /* Message Size */
     uint32_t    mtu_size;               /* MTU Size */
     uint32_t    no_msgs;                /* Number of messages */
+    uint32_t    pipeline;               /* Receive pipeline workers */
     uint32_t    poll_mode;              /* Poll mode */
     uint32_t    port;                   /* Port number requested */
+    uint32_t    profile;                /* Sample our call stacks */
+    uint32_t    qos_dscp;               /* DSCP of the QoS probe */
+    uint32_t    qos_priority;           /* Socket priority of the QoS probe */
+    uint32_t    rails;                  /* Streams striped across rails */
     uint32_t    rd_atomic;              /* Number of pending RDMA or atomics */
+    uint32_t    samples;                /* Maximum per message samples */
+    uint32_t    service_time;           /* Time to serve a request in ns */
+    uint32_t    service_touch;          /* Bytes touched serving a request */
     uint32_t    sl;                     /* Service level */
     uint32_t    sock_buf_size;          /* Socket buffer size */
     uint32_t    src_path_bits;          /* Source path bits */
     uint32_t    time;                   /* Duration in seconds */
     uint32_t    timeout;                /* Timeout for messages */
+    uint32_t    ud_cqs;                 /* CQs to spread UD receives over */
+    uint32_t    ud_dests;               /* UD destinations to fan out to */
+    uint32_t    ud_random;              /* Pick UD destinations at random */
     uint32_t    use_cm;                 /* Use Connection Manager */
+    uint32_t    zerocopy_recv;          /* Map received pages, not copy */
+    char        cgroup_cpu[STRSIZE];    /* Cgroup cpu.max as Quota/Period */
+    char        cgroup_cpuset[STRSIZE]; /* Cgroup cpuset.cpus */
+    char        cgroup_mem[STRSIZE];    /* Cgroup memory.max */
+    char        compress[STRSIZE];      /* Compress messages with this */
     char        id[STRSIZE];            /* Identifier */
+    char        pipeline_mode[STRSIZE]; /* Receive pipeline mode */
+    char        service_dist[STRSIZE];  /* Service time distribution */
     char        static_rate[STRSIZE];   /* Static rate */
+    char        xdp_mode[STRSIZE];      /* AF_XDP mode: skb, copy or zc */
+    uint32_t    service_table[SERVICE_QUANTS];  /* Empirical service times */
 } REQ;
 
 
+/*
+ * A per message sample recorded with --sample_file.  On the client, a sample
+ * runs from sending a message to receiving the reply; on the server, from
+ * receiving a message to sending the reply.
+ */
+typedef struct SAMPLE {
+    uint64_t    time;                   /* Nanoseconds since start of test */
+    uint32_t    latency;                /* Nanoseconds */
+    uint32_t    size;                   /* Bytes received */
+    uint32_t    status;                 /* 0 or error status */
+    uint32_t    node;                   /* 0 for client, 1 for server */
+} SAMPLE;
+
+
 /*
  * Transfer statistics.
  */
@@ -193,6 +320,40 @@ typedef struct STAT {
     uint32_t    no_cpus;                /* Number of processors */
     uint32_t    no_ticks;               /* Ticks per second */
     uint32_t    max_cqes;               /* Maximum CQ entries */
+    uint32_t    auto_cpu;               /* Cpu chosen by auto affinity + 1 */
+    uint32_t    auto_node;              /* NUMA node of the NIC + 1 */
+    char        auto_nic[STRSIZE];      /* NIC used by auto affinity */
+    uint32_t    low_latency;            /* Low latency controls applied */
+    uint64_t    flush_ns;               /* Time spent flushing caches */
+    uint64_t    energy_pkg;             /* Package energy used in uJ */
+    uint64_t    energy_dram;            /* DRAM energy used in uJ */
+    uint32_t    link_speed;             /* Link speed in Mb/s */
+    uint32_t    link_payload;           /* Payload bytes per packet */
+    uint32_t    link_wire;              /* Wire bytes per packet */
+    uint32_t    stage_msgs;             /* Messages broken into stages */
+    uint32_t    stage_mask;             /* Stages that were measured */
+    uint32_t    stage_avg[S_N];         /* Mean time of each stage in ns */
+    uint32_t    stage_p50[S_N];         /* Median time of each stage */
+    uint32_t    stage_p99[S_N];         /* 99th percentile of each stage */
+    uint64_t    pipe_msgs;              /* Messages handed to workers */
+    uint64_t    pipe_stalls;            /* Times the pipeline was full */
+    uint32_t    pipe_lat_avg;           /* Mean handoff latency in ns */
+    uint32_t    pipe_lat_max;           /* Maximum handoff latency in ns */
+    uint32_t    pipe_rate;              /* Messages/sec workers can sustain */
+    uint64_t    rail_bytes[RAILS_MAX];  /* Bytes received on each rail */
+    uint64_t    path_mig;               /* Path migrated event, ns into test */
+    uint64_t    cg_periods;             /* Cgroup CPU enforcement periods */
+    uint64_t    cg_throttled;           /* Cgroup periods throttled */
+    uint64_t    cg_throttled_us;        /* Cgroup time throttled in us */
+    uint64_t    comp_bytes;             /* Compressed bytes on the wire */
+    uint64_t    zc_bytes;               /* Bytes received by mapping pages */
+    uint32_t    zc_error;               /* Why zerocopy receive fell back */
+    char        xdp_mode[STRSIZE];      /* AF_XDP mode in use */
+    uint32_t    ah_count;               /* Address handles created */
+    uint64_t    ah_create_ns;           /* Time taken to create them */
+    uint32_t    ep_cqs;                 /* CQs waited on with epoll */
+    uint64_t    ep_wakeups;             /* Times epoll_wait returned */
+    uint64_t    ep_events;              /* CQ events those returned */
     CLOCK       time_s[T_N];            /* Start times */
     CLOCK       time_e[T_N];            /* End times */
     USTAT       s;                      /* Send statistics */
@@ -214,6 +375,8 @@ typedef struct RESN {
     double      cpu_idle;               /* Idle time (fraction of cpu) */
     double      cpu_kernel;             /* Kernel time (fraction of cpu) */
     double      cpu_io_wait;            /* IO wait time (fraction of cpu) */
+    double      watts_pkg;              /* Package power in watts */
+    double      watts_dram;             /* DRAM power in watts */
 } RESN;
 
 
@@ -228,7 +391,16 @@ typedef struct RES {
     double      msg_rate;               /* Messaging rate */
     double      send_cost;              /* Send cost */
     double      recv_cost;              /* Receive cost */
+    double      send_msg_cost;          /* Send cost per message */
+    double      recv_msg_cost;          /* Receive cost per message */
     double      latency;                /* Latency */
+    double      flush_time;             /* Flush time excluded from latency */
+    double      energy_gb;              /* Energy in joules per GB */
+    double      energy_msg;             /* Energy in joules per message */
+    double      link_rate;              /* Link rate in bytes/sec */
+    double      link_max_bw;            /* Link rate less protocol overhead */
+    double      link_util;              /* Bandwidth as fraction of link rate */
+    double      link_max_util;          /* Bandwidth as fraction of max_bw */
 } RES;
 
 
@@ -238,17 +410,25 @@ typedef struct RES {
 void        client_send_request(void);
 void        exchange_results(void);
 int         left_to_send(long *sentp, int room);
+void        lib_die(void);
+void        lib_error(char *mesg, int len);
+int         nic_ifname(char *name, int len);
 void        opt_check(void);
 void        par_use(PAR_INDEX index);
 int         recv_mesg(void *ptr, int len, char *item);
+void        sample_add(uint64_t time, int size, int status);
+uint64_t    sample_time(void);
+void        service_wait(void);
 int         send_mesg(void *ptr, int len, char *item);
 void        set_finished(void);
 void        setp_u32(char *name, PAR_INDEX index, uint32_t l);
 void        setp_str(char *name, PAR_INDEX index, char *s);
 void        setv_u32(PAR_INDEX index, uint32_t l);
 void        show_results(MEASURE measure);
+void        stage_add(STAGE stage, int64_t time);
 void        stop_test_timer(void);
 void        sync_test(void);
+uint64_t    test_nsecs(void);
 
 
 /*
@@ -266,9 +446,14 @@ void        enc_int(int64_t l, int n);
 void        enc_str(char *s, int n);
 void        encode_uint32(uint32_t *p, uint32_t v);
 int         error(int actions, char *fmt, ...);
+void        flush_data(void *p, int n);
 AI         *getaddrinfo_port(char *node, int port, AI *hints);
+uint64_t    get_nsecs(void);
+double      get_seconds(void);
+void        prefault_heap(long size);
 char       *qasprintf(char *fmt, ...);
 void       *qmalloc(long n);
+int         read_line(char *buf, int len, char *fmt, ...);
 void        recv_sync(char *msg);
 void        send_sync(char *msg);
 void        setsockopt_one(int fd, int optname);
@@ -277,6 +462,64 @@ void        touch_data(void *p, int n);
 void        urgent(void);
 
 
+/*
+ * Functions prototypes in cgroup.c.
+ */
+void        cgroup_enter(void);
+void        cgroup_leave(void);
+void        cgroup_start(void);
+void        cgroup_stop(void);
+
+
+/*
+ * Functions prototypes in compress.c.
+ */
+int         compress_bound(int len);
+int         compress_data(void *dst, int dlen, void *src, int len);
+void        compress_end(void);
+void        compress_fill(void *buf, int len);
+void        compress_init(void);
+int         decompress_data(void *dst, int dlen, void *src, int len);
+
+
+/*
+ * Functions prototypes in fault.c.
+ */
+void        fault_sockets(int *fds, int n);
+void        fault_start(void);
+void        fault_stop(void);
+
+
+/*
+ * Functions prototypes in pipeline.c.
+ */
+void       *pipeline_buf(void);
+void        pipeline_init(void);
+void        pipeline_push(void *data, int len);
+void        pipeline_stop(void);
+
+
+/*
+ * Functions prototypes in profile.c.
+ */
+void        profile_init(void);
+uint64_t    profile_lost(int node);
+void        profile_recv(int remote, char *file);
+void        profile_send(void);
+void        profile_start(void);
+void        profile_stop(void);
+void        profile_thread(void);
+char       *profile_top(int node, int i);
+
+
+/*
+ * Functions prototypes in trace.c.
+ */
+void        trace_end(void);
+int         trace_init(void);
+void        trace_round(uint64_t sent, uint64_t done);
+
+
 /*
  * Socket tests in socket.c.
  */
@@ -296,12 +539,29 @@ void    run_client_tcp_bw(void);
 void    run_server_tcp_bw(void);
 void    run_client_tcp_lat(void);
 void    run_server_tcp_lat(void);
+void    run_client_tcp_qos(void);
+void    run_server_tcp_qos(void);
 void    run_client_udp_bw(void);
 void    run_server_udp_bw(void);
 void    run_client_udp_lat(void);
 void    run_server_udp_lat(void);
 
 
+/*
+ * Function prototypes in xdp.c.
+ */
+void    run_client_xdp_bw(void);
+void    run_server_xdp_bw(void);
+void    run_client_xdp_lat(void);
+void    run_server_xdp_lat(void);
+
+
+/*
+ * Functions prototypes in rdma.c.
+ */
+int         rd_migrate(void);
+
+
 /*
  * RDMA tests in rdma.c.
  */
@@ -317,6 +577,8 @@ void    run_client_rc_fetch_add_mr(void);
 void    run_server_rc_fetch_add_mr(void);
 void    run_client_rc_lat(void);
 void    run_server_rc_lat(void);
+void    run_client_rc_qos(void);
+void    run_server_rc_qos(void);
 void    run_client_rc_rdma_read_bw(void);
 void    run_server_rc_rdma_read_bw(void);
 void    run_client_rc_rdma_read_lat(void);
@@ -365,9 +627,18 @@ extern REQ          Req;
 extern STAT         LStat;
 extern char        *Usage[];
 extern char        *TestName;
+extern char        *Rails;
+extern char        *CgroupParent;
+extern long         FaultAt;
+extern long         FaultLen;
+extern long         FaultLoss;
+extern char        *FaultDev;
+extern char        *FaultKind;
+extern FAULT_RES    FaultRes;
 extern char        *ServerName;
 extern SS           ServerAddr;
 extern int          ServerAddrLen;
 extern int          RemoteFD;
 extern int          Debug;
+extern int          Library;
 extern volatile int Finished;
@@ -35,14 +35,19 @@
 #define _GNU_SOURCE
 #include <fcntl.h>
 #include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/epoll.h>
 #include <netinet/in.h>
 #include <rdma/rdma_cma.h>
 #include <infiniband/verbs.h>
 #include "qperf.h"
+#include "xport.h"
 
 
 /*
@@ -50,12 +55,14 @@
  */
 #define QKEY                0x11111111  /* Q_Key */
 #define NCQE                1024        /* Number of CQ entries */
+#define NPOST               64          /* Work requests posted at once */
 #define GRH_SIZE            40          /* InfiniBand GRH size */
 #define MTU_SIZE            2048        /* Default MTU Size */
 #define RETRY_CNT           7           /* RC retry count */
 #define RNR_RETRY_CNT       7           /* RC RNR retry count */
 #define MIN_RNR_TIMER       12          /* RC Minimum RNR timer */
 #define LOCAL_ACK_TIMEOUT   14          /* RC local ACK timeout */
+#define ASYNC_POLL          100         /* Async event wait in ms */
 
 
 /*
@@ -146,6 +153,7 @@ typedef struct DEVICE {
     CMINFO           cm;                /* Connection Manager information */
     uint32_t         qkey;              /* Q Key for UD */
     int              trans;             /* QP transport */
+    int              sl;                /* Service level */
     int              msg_size;          /* Message size */
     int              buf_size;          /* Buffer size */
     int              max_send_wr;       /* Maximum send work requests */
@@ -160,6 +168,25 @@ typedef struct DEVICE {
     struct ibv_ah   *ah;                /* Address handle */
     struct ibv_srq  *srq;               /* Shared receive queue */
     ibv_xrc         *xrc;               /* XRC domain */
+    struct ibv_sge   send_sge;          /* Buffer of prebuilt sends */
+    struct ibv_sge   recv_sge;          /* Buffer of prebuilt receives */
+    struct ibv_send_wr send_wr[NPOST];  /* Prebuilt chain of sends */
+    struct ibv_recv_wr recv_wr[NPOST];  /* Prebuilt chain of receives */
+    uint32_t         fan_n;             /* Number of UD destinations */
+    uint32_t         fan_next;          /* Next destination or random state */
+    uint32_t        *fan_qpn;           /* QP number of each destination */
+    struct ibv_ah  **fan_ah;            /* Address handle of each destination */
+    struct ibv_qp  **fan_qp;            /* Our QPs as destinations */
+    uint32_t         ep_n;              /* Number of CQs they complete on */
+    uint32_t         ep_nready;         /* CQs that may hold completions */
+    uint32_t        *ep_ready;          /* Indices of those CQs */
+    int              ep_fd;             /* Epoll descriptor */
+    struct epoll_event *ep_events;      /* Events returned by epoll_wait */
+    struct ibv_cq  **ep_cq;             /* Their CQs followed by ours */
+    ibv_cc         **ep_cc;             /* Completion channel of each */
+    pthread_t        async_thread;      /* Thread watching async events */
+    volatile int     async_on;          /* Async thread should keep running */
+    struct DEVICE   *async_next;        /* Next device being watched */
 } DEVICE;
 
 
@@ -184,6 +211,9 @@ typedef struct RATES {
 /*
  * Function prototypes.
  */
+static void    *async_monitor(void *arg);
+static void     async_start(DEVICE *dev);
+static void     async_stop(DEVICE *dev);
 static void     atomic_seq(ATOMIC atomic, int i,
                                             uint64_t *value, uint64_t *args);
 static void     cm_ack_event(DEVICE *dev);
@@ -203,32 +233,48 @@ static void     ib_client_atomic(ATOMIC atomic);
 static void     ib_client_verify_atomic(ATOMIC atomic);
 static void     ib_close1(DEVICE *dev);
 static void     ib_close2(DEVICE *dev);
-static void     ib_migrate(DEVICE *dev);
+static int      ib_migrate(DEVICE *dev);
 static void     ib_open(DEVICE *dev);
 static void     ib_post_atomic(DEVICE *dev, ATOMIC atomic, int wrid,
                             int offset, uint64_t compare_add, uint64_t swap);
 static void     ib_prep(DEVICE *dev);
 static void     rd_bi_bw(int transport);
-static void     rd_client_bw(int transport);
+static void     rd_client_bw(int transport, MEASURE measure);
 static void     rd_client_rdma_bw(int transport, ibv_op opcode);
 static void     rd_client_rdma_read_lat(int transport);
 static void     rd_close(DEVICE *dev);
+static void     rd_fanout(DEVICE *dev);
+static void     rd_fanout_close(DEVICE *dev);
+static void     rd_fanout_cqs(DEVICE *dev, int n);
+static void     rd_fanout_qp(DEVICE *dev, int i);
+static void     rd_fanout_wr(DEVICE *dev, int n);
+static void     rd_link_info(DEVICE *dev);
 static void     rd_mralloc(DEVICE *dev, int size);
 static void     rd_mrfree(DEVICE *dev);
 static void     rd_open(DEVICE *dev, int trans, int max_send_wr, int max_recv_wr);
+static void     rd_open_dev(DEVICE *dev, int trans, int max_send_wr,
+                            int max_recv_wr);
 static void     rd_params(int transport, long msg_size, int poll, int atomic);
 static int      rd_poll(DEVICE *dev, struct ibv_wc *wc, int nwc);
+static int      rd_poll_epoll(DEVICE *dev, struct ibv_wc *wc, int nwc);
 static void     rd_post_rdma_std(DEVICE *dev, ibv_op opcode, int n);
 static void     rd_post_recv_std(DEVICE *dev, int n);
-static void     rd_post_send(DEVICE *dev, int off, int len,
-                                                int inc, int rep, int stat);
 static void     rd_post_send_std(DEVICE *dev, int n);
 static void     rd_pp_lat(int transport, IOMODE iomode);
-static void     rd_pp_lat_loop(DEVICE *dev, IOMODE iomode);
 static void     rd_prep(DEVICE *dev, int size);
+static void     rd_prep_wr(DEVICE *dev);
+static void     rd_qos(int transport);
+static void     rd_qos_connect(XPORT *x);
 static void     rd_rdma_write_poll_lat(int transport);
 static void     rd_server_def(int transport);
 static void     rd_server_nop(int transport, int size);
+static void     rd_xclose(XPORT *x);
+static void     rd_xconnect(XPORT *x);
+static int      rd_xpoll(XPORT *x, XCOMP *c, int n);
+static int      rd_xreap(DEVICE *dev, int ep, XCOMP *c, int n);
+static void     rd_xpost_recv(XPORT *x, int ep, void *buf, int len, int n);
+static void     rd_xpost_send(XPORT *x, int ep, void *buf, int len, int n);
+static void     rd_xpost_write(XPORT *x, int ep, void *buf, int len, int n);
 static int      maybe(int val, char *msg);
 static char    *opcode_name(int opcode);
 static void     show_node_info(DEVICE *dev);
@@ -326,15 +372,41 @@ RATES Rates[] ={
 
 
 /*
- * This routine is never called and is solely to avoid compiler warnings for
- * functions that are not currently being used.
+ * Transport operations for the tests that send and receive messages.  The
+ * work requests are the chains built by rd_prep_wr on the registered buffer,
+ * so the buffers the loops pass are not used.  In the RDMA write latency
+ * tests, sends are RDMA writes with immediate data, which complete as
+ * receives on the other side.
  */
-void
-rdma_not_called(void)
-{
-    if (0)
-        ib_migrate(NULL);
-}
+static const XPORT_OPS RdOps ={
+    .connect   = rd_xconnect,
+    .post_send = rd_xpost_send,
+    .post_recv = rd_xpost_recv,
+    .poll      = rd_xpoll,
+    .close     = rd_xclose,
+};
+
+static const XPORT_OPS RdWriteOps ={
+    .connect   = rd_xconnect,
+    .post_send = rd_xpost_write,
+    .post_recv = rd_xpost_recv,
+    .poll      = rd_xpoll,
+    .close     = rd_xclose,
+};
+
+static const XPORT_OPS RdQosOps ={
+    .connect   = rd_qos_connect,
+    .post_send = rd_xpost_send,
+    .post_recv = rd_xpost_recv,
+    .poll      = rd_xpoll,
+    .close     = rd_xclose,
+};
+
+
+/*
+ * Static variables.
+ */
+static DEVICE   *AsyncList;
 
 
 /*
@@ -369,11 +441,14 @@ run_client_rc_bw(void)
 {
     par_use(L_ACCESS_RECV);
     par_use(R_ACCESS_RECV);
+    par_use(L_PIPELINE);
+    par_use(R_PIPELINE);
+    par_use(L_PIPELINE_MODE);
+    par_use(R_PIPELINE_MODE);
     par_use(L_NO_MSGS);
     par_use(R_NO_MSGS);
     rd_params(IBV_QPT_RC, K64, 1, 0);
-    rd_client_bw(IBV_QPT_RC);
-    show_results(BANDWIDTH);
+    rd_client_bw(IBV_QPT_RC, BANDWIDTH);
 }
 
 
@@ -433,6 +508,13 @@ run_server_rc_fetch_add_mr(void)
 void
 run_client_rc_lat(void)
 {
+    par_use(L_COLD_CACHE);
+    par_use(R_COLD_CACHE);
+    par_use(L_SAMPLES);
+    par_use(R_SAMPLES);
+    par_use(R_SERVICE_DIST);
+    par_use(R_SERVICE_TIME);
+    par_use(R_SERVICE_TOUCH);
     rd_params(IBV_QPT_RC, 1, 1, 0);
     rd_pp_lat(IBV_QPT_RC, IO_SR);
 }
@@ -448,6 +530,34 @@ run_server_rc_lat(void)
 }
 
 
+/*
+ * Measure RC latency under a bulk load with and without a service level
+ * (client side).  Each QP has its own CQ, which we poll in turn.
+ */
+void
+run_client_rc_qos(void)
+{
+    setv_u32(L_POLL_MODE, 1);
+    setv_u32(R_POLL_MODE, 1);
+    rd_params(IBV_QPT_RC, 1, 0, 0);
+    if (Req.use_cm)
+        error(0, "rc_qos sets the service level of each QP; "
+                 "it cannot use --use_cm");
+    rd_qos(IBV_QPT_RC);
+}
+
+
+/*
+ * Measure RC latency under a bulk load with and without a service level
+ * (server side).
+ */
+void
+run_server_rc_qos(void)
+{
+    rd_qos(IBV_QPT_RC);
+}
+
+
 /*
  * Measure RC RDMA read bandwidth (client side).
  */
@@ -480,6 +590,8 @@ run_server_rc_rdma_read_bw(void)
 void
 run_client_rc_rdma_read_lat(void)
 {
+    par_use(L_SAMPLES);
+    par_use(R_SAMPLES);
     rd_params(IBV_QPT_RC, 1, 1, 0);
     rd_client_rdma_read_lat(IBV_QPT_RC);
 }
@@ -523,6 +635,13 @@ run_server_rc_rdma_write_bw(void)
 void
 run_client_rc_rdma_write_lat(void)
 {
+    par_use(L_COLD_CACHE);
+    par_use(R_COLD_CACHE);
+    par_use(L_SAMPLES);
+    par_use(R_SAMPLES);
+    par_use(R_SERVICE_DIST);
+    par_use(R_SERVICE_TIME);
+    par_use(R_SERVICE_TOUCH);
     rd_params(IBV_QPT_RC, 1, 1, 0);
     rd_pp_lat(IBV_QPT_RC, IO_RDMA);
 }
@@ -592,11 +711,14 @@ run_client_uc_bw(void)
 {
     par_use(L_ACCESS_RECV);
     par_use(R_ACCESS_RECV);
+    par_use(L_PIPELINE);
+    par_use(R_PIPELINE);
+    par_use(L_PIPELINE_MODE);
+    par_use(R_PIPELINE_MODE);
     par_use(L_NO_MSGS);
     par_use(R_NO_MSGS);
     rd_params(IBV_QPT_UC, K64, 1, 0);
-    rd_client_bw(IBV_QPT_UC);
-    show_results(BANDWIDTH_SR);
+    rd_client_bw(IBV_QPT_UC, BANDWIDTH_SR);
 }
 
 
@@ -616,6 +738,13 @@ run_server_uc_bw(void)
 void
 run_client_uc_lat(void)
 {
+    par_use(L_COLD_CACHE);
+    par_use(R_COLD_CACHE);
+    par_use(L_SAMPLES);
+    par_use(R_SAMPLES);
+    par_use(R_SERVICE_DIST);
+    par_use(R_SERVICE_TIME);
+    par_use(R_SERVICE_TOUCH);
     rd_params(IBV_QPT_UC, 1, 1, 0);
     rd_pp_lat(IBV_QPT_UC, IO_SR);
 }
@@ -659,6 +788,13 @@ run_server_uc_rdma_write_bw(void)
 void
 run_client_uc_rdma_write_lat(void)
 {
+    par_use(L_COLD_CACHE);
+    par_use(R_COLD_CACHE);
+    par_use(L_SAMPLES);
+    par_use(R_SAMPLES);
+    par_use(R_SERVICE_DIST);
+    par_use(R_SERVICE_TIME);
+    par_use(R_SERVICE_TOUCH);
     rd_params(IBV_QPT_UC, 1, 1, 0);
     rd_pp_lat(IBV_QPT_UC, IO_RDMA);
 }
@@ -728,11 +864,20 @@ run_client_ud_bw(void)
 {
     par_use(L_ACCESS_RECV);
     par_use(R_ACCESS_RECV);
+    par_use(L_PIPELINE);
+    par_use(R_PIPELINE);
+    par_use(L_PIPELINE_MODE);
+    par_use(R_PIPELINE_MODE);
     par_use(L_NO_MSGS);
     par_use(R_NO_MSGS);
+    par_use(L_UD_CQS);
+    par_use(R_UD_CQS);
+    par_use(L_UD_DESTS);
+    par_use(R_UD_DESTS);
+    par_use(L_UD_RANDOM);
+    par_use(R_UD_RANDOM);
     rd_params(IBV_QPT_UD, K2, 1, 0);
-    rd_client_bw(IBV_QPT_UD);
-    show_results(BANDWIDTH_SR);
+    rd_client_bw(IBV_QPT_UD, BANDWIDTH_SR);
 }
 
 
@@ -752,6 +897,19 @@ run_server_ud_bw(void)
 void
 run_client_ud_lat(void)
 {
+    par_use(L_COLD_CACHE);
+    par_use(R_COLD_CACHE);
+    par_use(L_SAMPLES);
+    par_use(R_SAMPLES);
+    par_use(R_SERVICE_DIST);
+    par_use(R_SERVICE_TIME);
+    par_use(R_SERVICE_TOUCH);
+    par_use(L_UD_CQS);
+    par_use(R_UD_CQS);
+    par_use(L_UD_DESTS);
+    par_use(R_UD_DESTS);
+    par_use(L_UD_RANDOM);
+    par_use(R_UD_RANDOM);
     rd_params(IBV_QPT_UD, 1, 1, 0);
     rd_pp_lat(IBV_QPT_UD, IO_SR);
 }
@@ -800,11 +958,14 @@ run_client_xrc_bw(void)
 {
     par_use(L_ACCESS_RECV);
     par_use(R_ACCESS_RECV);
+    par_use(L_PIPELINE);
+    par_use(R_PIPELINE);
+    par_use(L_PIPELINE_MODE);
+    par_use(R_PIPELINE_MODE);
     par_use(L_NO_MSGS);
     par_use(R_NO_MSGS);
     rd_params(IBV_QPT_XRC, K64, 1, 0);
-    rd_client_bw(IBV_QPT_XRC);
-    show_results(BANDWIDTH);
+    rd_client_bw(IBV_QPT_XRC, BANDWIDTH);
 }
 
 
@@ -824,6 +985,13 @@ run_server_xrc_bw(void)
 void
 run_client_xrc_lat(void)
 {
+    par_use(L_COLD_CACHE);
+    par_use(R_COLD_CACHE);
+    par_use(L_SAMPLES);
+    par_use(R_SAMPLES);
+    par_use(R_SERVICE_DIST);
+    par_use(R_SERVICE_TIME);
+    par_use(R_SERVICE_TOUCH);
     rd_params(IBV_QPT_XRC, 1, 1, 0);
     rd_pp_lat(IBV_QPT_XRC, IO_SR);
 }
@@ -883,89 +1051,29 @@ run_server_ver_rc_fetch_add(void)
  * Measure RDMA bandwidth (client side).
  */
 static void
-rd_client_bw(int transport)
+rd_client_bw(int transport, MEASURE measure)
 {
     DEVICE dev;
-    long sent = 0;
-
-    rd_open(&dev, transport, NCQE, 0);
-    rd_prep(&dev, 0);
-    sync_test();
-    rd_post_send_std(&dev, left_to_send(&sent, NCQE));
-    sent = NCQE;
-    while (!Finished) {
-        int i;
-        struct ibv_wc wc[NCQE];
-        int n = rd_poll(&dev, wc, cardof(wc));
+    XPORT x ={ .n = 1, .depth = NCQE, .kind = transport, .dev = &dev };
 
-        if (n > LStat.max_cqes)
-            LStat.max_cqes = n;
-        if (Finished)
-            break;
-        for (i = 0; i < n; ++i) {
-            int id = wc[i].wr_id;
-            int status = wc[i].status;
-
-            if (id != WRID_SEND)
-                debug("bad WR ID %d", id);
-            else if (status != IBV_WC_SUCCESS)
-                do_error(status, &LStat.s.no_errs);
-        }
-        if (Req.no_msgs) {
-            if (LStat.s.no_msgs + LStat.s.no_errs >= Req.no_msgs)
-                break;
-            n = left_to_send(&sent, n);
-        }
-        rd_post_send_std(&dev, n);
-        sent += n;
-    }
-    stop_test_timer();
-    exchange_results();
-    rd_close(&dev);
+    xport_client_bw(&RdOps, &x, 0, measure);
 }
 
 
 /*
  * Default action for the server is to post receive buffers and whenever it
- * gets a completion entry, compute statistics and post more buffers.
+ * gets a completion entry, compute statistics and post more buffers.  Each
+ * receive is posted on dev->buffer and reposted as soon as it completes, so
+ * with --pipeline, workers only see the length; opt_check rejects
+ * --access_recv there since the data may already be overwritten.
  */
 static void
 rd_server_def(int transport)
 {
     DEVICE dev;
+    XPORT x ={ .n = 1, .depth = NCQE, .kind = transport, .dev = &dev };
 
-    rd_open(&dev, transport, 0, NCQE);
-    rd_prep(&dev, 0);
-    rd_post_recv_std(&dev, NCQE);
-    sync_test();
-    while (!Finished) {
-        int i;
-        struct ibv_wc wc[NCQE];
-        int n = rd_poll(&dev, wc, cardof(wc));
-
-        if (Finished)
-            break;
-        if (n > LStat.max_cqes)
-            LStat.max_cqes = n;
-        for (i = 0; i < n; ++i) {
-            int status = wc[i].status;
-
-            if (status == IBV_WC_SUCCESS) {
-                LStat.r.no_bytes += dev.msg_size;
-                LStat.r.no_msgs++;
-                if (Req.access_recv)
-                    touch_data(dev.buffer, dev.msg_size);
-            } else
-                do_error(status, &LStat.r.no_errs);
-        }
-        if (Req.no_msgs)
-            if (LStat.r.no_msgs + LStat.r.no_errs >= Req.no_msgs)
-                break;
-        rd_post_recv_std(&dev, n);
-    }
-    stop_test_timer();
-    exchange_results();
-    rd_close(&dev);
+    xport_server_bw(&RdOps, &x, 0);
 }
 
 
@@ -976,55 +1084,26 @@ static void
 rd_bi_bw(int transport)
 {
     DEVICE dev;
+    XPORT x ={ .n = 1, .depth = NCQE, .kind = transport, .dev = &dev };
 
-    rd_open(&dev, transport, NCQE, NCQE);
-    rd_prep(&dev, 0);
-    rd_post_recv_std(&dev, NCQE);
-    sync_test();
-    rd_post_send_std(&dev, NCQE);
-    while (!Finished) {
-        int i;
-        struct ibv_wc wc[NCQE];
-        int numSent = 0;
-        int numRecv = 0;
-        int n = rd_poll(&dev, wc, cardof(wc));
+    xport_bi_bw(&RdOps, &x, 0);
+}
 
-        if (Finished)
-            break;
-        if (n > LStat.max_cqes)
-            LStat.max_cqes = n;
-        for (i = 0; i < n; ++i) {
-            int id = wc[i].wr_id;
-            int status = wc[i].status;
 
-            switch (id) {
-            case WRID_SEND:
-                if (status != IBV_WC_SUCCESS)
-                    do_error(status, &LStat.s.no_errs);
-                ++numSent;
-                break;
-            case WRID_RECV:
-                if (status == IBV_WC_SUCCESS) {
-                    LStat.r.no_bytes += dev.msg_size;
-                    LStat.r.no_msgs++;
-                    if (Req.access_recv)
-                        touch_data(dev.buffer, dev.msg_size);
-                } else
-                    do_error(status, &LStat.r.no_errs);
-                ++numRecv;
-                break;
-            default:
-                debug("bad WR ID %d", id);
-            }
-        }
-        if (numRecv)
-            rd_post_recv_std(&dev, numRecv);
-        if (numSent)
-            rd_post_send_std(&dev, numSent);
-    }
-    stop_test_timer();
-    exchange_results();
-    rd_close(&dev);
+/*
+ * Time probes under a bulk load, one QP each for the load, a probe on its
+ * service level and a probe on --service_level (client and server side).
+ */
+static void
+rd_qos(int transport)
+{
+    DEVICE dev[3];
+    XPORT x ={ .n = 3, .depth = NCQE, .kind = transport, .dev = dev };
+
+    if (is_client())
+        xport_client_qos(&RdQosOps, &x);
+    else
+        xport_server_qos(&RdQosOps, &x);
 }
 
 
@@ -1035,77 +1114,157 @@ static void
 rd_pp_lat(int transport, IOMODE iomode)
 {
     DEVICE dev;
+    XPORT x ={ .n = 1, .depth = 1, .kind = transport, .dev = &dev };
 
-    rd_open(&dev, transport, 1, 1);
-    rd_prep(&dev, 0);
-    rd_pp_lat_loop(&dev, iomode);
-    stop_test_timer();
-    exchange_results();
-    rd_close(&dev);
-    if (is_client())
-        show_results(LATENCY);
+    if (is_client()) {
+        if (iomode == IO_SR)
+            xport_client_lat(&RdOps, &x, 0);
+        else
+            xport_client_lat(&RdWriteOps, &x, 0);
+    } else {
+        if (iomode == IO_SR)
+            xport_server_lat(&RdOps, &x, 0);
+        else
+            xport_server_lat(&RdWriteOps, &x, 0);
+    }
 }
 
 
 /*
- * Loop sending packets back and forth to measure ping-pong latency.
+ * Open and prepare a device for the transport operations.  Each side posts
+ * up to x->depth sends and receives.
  */
 static void
-rd_pp_lat_loop(DEVICE *dev, IOMODE iomode)
+rd_xconnect(XPORT *x)
 {
-    int done = 1;
+    DEVICE *dev = x->dev;
 
-    rd_post_recv_std(dev, 1);
-    sync_test();
-    if (is_client()) {
-        if (iomode == IO_SR)
-            rd_post_send_std(dev, 1);
+    rd_open(dev, x->kind, x->depth, x->depth);
+    rd_prep(dev, 0);
+    if (x->kind == IBV_QPT_UD && (Req.ud_dests || Req.ud_cqs))
+        rd_fanout(dev);
+}
+
+
+/*
+ * Open a device for the bulk load of a QoS test and one for each of its
+ * probes.  The load and the first probe use service level 0 and the second
+ * probe the one given by --service_level.
+ */
+static void
+rd_qos_connect(XPORT *x)
+{
+    int i;
+    DEVICE *dev = x->dev;
+
+    for (i = 0; i < x->n; ++i) {
+        int depth = i ? 1 : x->depth;
+
+        if (i == 0)
+            rd_open(&dev[i], x->kind, depth, depth);
         else
-            rd_post_rdma_std(dev, IBV_WR_RDMA_WRITE_WITH_IMM, 1);
-        done = 0;
+            rd_open_dev(&dev[i], x->kind, depth, depth);
+        dev[i].sl = i == 2 ? Req.sl : 0;
+        dev[i].msg_size = i ? Req.msg_size : XPORT_BULK;
+        rd_prep(&dev[i], dev[i].msg_size);
     }
+}
 
-    while (!Finished) {
-        int i;
-        struct ibv_wc wc[2];
-        int n = rd_poll(dev, wc, cardof(wc));
 
-        if (Finished)
-            break;
-        for (i = 0; i < n; ++i) {
-            int id = wc[i].wr_id;
-            int status = wc[i].status;
+/*
+ * Close the devices of a transport.
+ */
+static void
+rd_xclose(XPORT *x)
+{
+    int i;
+    DEVICE *dev = x->dev;
 
-            switch (id) {
-            case WRID_SEND:
-            case WRID_RDMA:
-                if (status != IBV_WC_SUCCESS)
-                    do_error(status, &LStat.s.no_errs);
-                done |= 1;
-                continue;
-            case WRID_RECV:
-                if (status == IBV_WC_SUCCESS) {
-                    LStat.r.no_bytes += dev->msg_size;
-                    LStat.r.no_msgs++;
-                    rd_post_recv_std(dev, 1);
-                } else
-                    do_error(status, &LStat.r.no_errs);
-                done |= 2;
-                continue;
-            default:
-                debug("bad WR ID %d", id);
-                continue;
-            }
-            break;
-        }
-        if (done == 3) {
-            if (iomode == IO_SR)
-                rd_post_send_std(dev, 1);
-            else
-                rd_post_rdma_std(dev, IBV_WR_RDMA_WRITE_WITH_IMM, 1);
-            done = 0;
+    for (i = 0; i < x->n; ++i)
+        rd_close(&dev[i]);
+}
+
+
+/*
+ * Post n sends.
+ */
+static void
+rd_xpost_send(XPORT *x, int ep, void *buf, int len, int n)
+{
+    rd_post_send_std((DEVICE *)x->dev + ep, n);
+}
+
+
+/*
+ * Post n RDMA writes with immediate data.
+ */
+static void
+rd_xpost_write(XPORT *x, int ep, void *buf, int len, int n)
+{
+    rd_post_rdma_std((DEVICE *)x->dev + ep, IBV_WR_RDMA_WRITE_WITH_IMM, n);
+}
+
+
+/*
+ * Post n receives.
+ */
+static void
+rd_xpost_recv(XPORT *x, int ep, void *buf, int len, int n)
+{
+    rd_post_recv_std((DEVICE *)x->dev + ep, n);
+}
+
+
+/*
+ * Poll the device of each endpoint in turn.  With more than one, only
+ * polling mode keeps a quiet device from holding up the others.
+ */
+static int
+rd_xpoll(XPORT *x, XCOMP *c, int n)
+{
+    int i;
+    int k = 0;
+    DEVICE *dev = x->dev;
+
+    for (i = 0; i < x->n && k < n; ++i)
+        k += rd_xreap(&dev[i], i, c+k, n-k);
+    return k;
+}
+
+
+/*
+ * Poll the completion queue of a device and turn what we find into
+ * completions on endpoint ep.  A work request that failed ends the test.
+ */
+static int
+rd_xreap(DEVICE *dev, int ep, XCOMP *c, int n)
+{
+    int i;
+    int k = 0;
+    struct ibv_wc wc[XPORT_POLL];
+    int m = rd_poll(dev, wc, n < XPORT_POLL ? n : XPORT_POLL);
+
+    if (m > LStat.max_cqes)
+        LStat.max_cqes = m;
+    for (i = 0; i < m; ++i) {
+        int id = wc[i].wr_id;
+        int status = wc[i].status;
+
+        if (id != WRID_SEND && id != WRID_RECV && id != WRID_RDMA) {
+            debug("bad WR ID %d", id);
+            continue;
         }
+        if (status != IBV_WC_SUCCESS)
+            do_error(status, id == WRID_RECV ? &LStat.r.no_errs
+                                             : &LStat.s.no_errs);
+        c[k++] = (XCOMP) {
+            .ep   = ep,
+            .op   = id == WRID_RECV ? X_RECV : X_SEND,
+            .len  = dev->msg_size,
+            .data = dev->buffer
+        };
     }
+    return k;
 }
 
 
@@ -1180,10 +1339,12 @@ static void
 rd_client_rdma_read_lat(int transport)
 {
     DEVICE dev;
+    uint64_t t;
 
     rd_open(&dev, transport, 1, 0);
     rd_prep(&dev, 0);
     sync_test();
+    t = sample_time();
     rd_post_rdma_std(&dev, IBV_WR_RDMA_READ, 1);
     while (!Finished) {
         struct ibv_wc wc;
@@ -1202,8 +1363,12 @@ rd_client_rdma_read_lat(int transport)
             LStat.r.no_msgs++;
             LStat.rem_s.no_bytes += dev.msg_size;
             LStat.rem_s.no_msgs++;
-        } else
+            sample_add(t, dev.msg_size, 0);
+        } else {
             do_error(wc.status, &LStat.s.no_errs);
+            sample_add(t, 0, wc.status);
+        }
+        t = sample_time();
         rd_post_rdma_std(&dev, IBV_WR_RDMA_READ, 1);
     }
     stop_test_timer();
@@ -1475,11 +1640,23 @@ rd_open(DEVICE *dev, int trans, int max_send_wr, int max_recv_wr)
     if (is_client())
         client_send_request();
 
+    rd_open_dev(dev, trans, max_send_wr, max_recv_wr);
+}
+
+
+/*
+ * Open a RDMA device once the request has been sent.  Tests using more than
+ * one device call this for the others.
+ */
+static void
+rd_open_dev(DEVICE *dev, int trans, int max_send_wr, int max_recv_wr)
+{
     /* Clear structure */
     memset(dev, 0, sizeof(*dev));
 
-    /* Set transport type and maximum work request parameters */
+    /* Set transport type, service level and maximum work request parameters */
     dev->trans = trans;
+    dev->sl = Req.sl;
     dev->max_send_wr = max_send_wr;
     dev->max_recv_wr = max_recv_wr;
 
@@ -1498,6 +1675,68 @@ rd_open(DEVICE *dev, int trans, int max_send_wr, int max_recv_wr)
             error(SYS, "query QP failed");
         dev->max_inline = qp_attr.cap.max_inline_data;
     }
+
+    /* Note the link speed */
+    rd_link_info(dev);
+
+    /* Watch for the path migrating */
+    async_start(dev);
+}
+
+
+/*
+ * Note the speed of the link and estimate the payload and wire bytes of each
+ * packet so that bandwidth can be compared with the wire rate.  Lane speeds
+ * are data rates after encoding.  Per packet overhead is LRH, BTH, ICRC and
+ * VCRC on InfiniBand and Ethernet framing, IP, UDP, BTH and ICRC on RoCE v2;
+ * UD adds a DETH.
+ */
+static void
+rd_link_info(DEVICE *dev)
+{
+    int lane;
+    int width;
+    int mtu;
+    int overhead;
+    struct ibv_port_attr attr;
+    int port = Req.use_cm ? dev->cm.id->port_num : dev->ib.port;
+
+    if (ibv_query_port(dev->qp->context, port, &attr) != SUCCESS0)
+        return;
+    switch (attr.active_speed) {
+    case 1:   lane =   2000; break;
+    case 2:   lane =   4000; break;
+    case 4:   lane =   8000; break;
+    case 8:   lane =  10000; break;
+    case 16:  lane =  13636; break;
+    case 32:  lane =  25000; break;
+    case 64:  lane =  50000; break;
+    case 128: lane = 100000; break;
+    default:  return;
+    }
+    switch (attr.active_width) {
+    case 1:  width =  1; break;
+    case 2:  width =  4; break;
+    case 4:  width =  8; break;
+    case 8:  width = 12; break;
+    case 16: width =  2; break;
+    default: return;
+    }
+
+    mtu = 128 << attr.active_mtu;
+    if (!Req.use_cm && Req.mtu_size < mtu)
+        mtu = Req.mtu_size;
+    if (attr.link_layer == IBV_LINK_LAYER_ETHERNET)
+        overhead = 38 + 20 + 8 + 12 + 4;
+    else
+        overhead = 8 + 12 + 4 + 2;
+    if (dev->trans == IBV_QPT_UD)
+        overhead += 8;
+
+    LStat.link_speed = lane * width;
+    LStat.link_payload = mtu;
+    LStat.link_wire = mtu + overhead;
+    debug("link speed %d Mb/s, mtu %d", LStat.link_speed, mtu);
 }
 
 
@@ -1542,11 +1781,308 @@ rd_prep(DEVICE *dev, int size)
             error(SYS, "failed to request CQ notification");
     }
 
+    /* Build the work requests used by most tests */
+    rd_prep_wr(dev);
+
     /* Show node information if debugging */
     show_node_info(dev);
 }
 
 
+/*
+ * Build chains of the send and receive work requests that most of the tests
+ * post so that posting them only needs to end the chain at the right place.
+ */
+static void
+rd_prep_wr(DEVICE *dev)
+{
+    int i;
+    int flags = IBV_SEND_SIGNALED;
+
+    if (dev->msg_size <= dev->max_inline)
+        flags |= IBV_SEND_INLINE;
+    dev->send_sge = (struct ibv_sge) {
+        .addr   = (uintptr_t) dev->buffer,
+        .length = dev->msg_size,
+        .lkey   = dev->mr->lkey
+    };
+    dev->recv_sge = (struct ibv_sge) {
+        .addr   = (uintptr_t) dev->buffer,
+        .length = dev->buf_size,
+        .lkey   = dev->mr->lkey
+    };
+    for (i = 0; i < NPOST; ++i) {
+        struct ibv_send_wr *s = &dev->send_wr[i];
+        struct ibv_recv_wr *r = &dev->recv_wr[i];
+
+        *s = (struct ibv_send_wr) {
+            .wr_id      = WRID_SEND,
+            .next       = i < NPOST-1 ? s+1 : 0,
+            .sg_list    = &dev->send_sge,
+            .num_sge    = 1,
+            .opcode     = IBV_WR_SEND,
+            .send_flags = flags,
+        };
+        if (dev->trans == IBV_QPT_UD) {
+            s->wr.ud.ah          = dev->ah;
+            s->wr.ud.remote_qpn  = dev->rnode.qpn;
+            s->wr.ud.remote_qkey = dev->qkey;
+        }
+#ifdef HAS_XRC
+        else if (dev->trans == IBV_QPT_XRC)
+            s->xrc_remote_srq_num = dev->rnode.srqn;
+#endif
+        *r = (struct ibv_recv_wr) {
+            .wr_id      = WRID_RECV,
+            .next       = i < NPOST-1 ? r+1 : 0,
+            .sg_list    = &dev->recv_sge,
+            .num_sge    = 1,
+        };
+    }
+}
+
+
+/*
+ * Set up a UD test that fans out to Req.ud_dests destinations or, if that is
+ * not set, to Req.ud_cqs.  The server creates that many UD QPs, all receiving
+ * from one shared receive queue, and tells the client their numbers.  The
+ * client creates an address handle for each, as a protocol talking to that
+ * many peers would, and notes how long that took.  The QP we opened with is
+ * not sent to.
+ */
+static void
+rd_fanout(DEVICE *dev)
+{
+    uint32_t i;
+    uint32_t n = Req.ud_dests ? Req.ud_dests : Req.ud_cqs;
+    uint32_t *qpns = qmalloc(n * sizeof(*qpns));
+
+    dev->fan_n = n;
+    if (is_client()) {
+        uint64_t t;
+        struct ibv_ah_attr ah_attr ={
+            .dlid          = dev->rnode.lid,
+            .port_num      = dev->ib.port,
+            .static_rate   = dev->ib.rate,
+            .src_path_bits = Req.src_path_bits,
+            .sl            = dev->sl
+        };
+
+        dev->fan_qpn = qpns;
+        dev->fan_ah = qmalloc(n * sizeof(*dev->fan_ah));
+        memset(dev->fan_ah, 0, n * sizeof(*dev->fan_ah));
+        recv_mesg(qpns, n * sizeof(*qpns), "UD destinations");
+        for (i = 0; i < n; ++i)
+            qpns[i] = decode_uint32(&qpns[i]);
+        t = get_nsecs();
+        for (i = 0; i < n; ++i) {
+            dev->fan_ah[i] = ibv_create_ah(dev->pd, &ah_attr);
+            if (!dev->fan_ah[i])
+                error(SYS, "failed to create address handle %d of %d",
+                           i+1, n);
+        }
+        LStat.ah_create_ns = get_nsecs() - t;
+        LStat.ah_count = n;
+        dev->fan_next = Req.ud_random ? lrand48() | 1 : 0;
+    } else {
+        struct ibv_srq_init_attr srq_attr ={
+            .attr ={
+                .max_wr  = NCQE,
+                .max_sge = 1
+            }
+        };
+
+        dev->srq = ibv_create_srq(dev->pd, &srq_attr);
+        if (!dev->srq)
+            error(SYS, "failed to create SRQ");
+        if (Req.ud_cqs) {
+            if (Req.ud_cqs > n)
+                error(0, "cannot spread %d destinations over %d CQs",
+                         n, Req.ud_cqs);
+            rd_fanout_cqs(dev, Req.ud_cqs);
+        }
+        dev->fan_qp = qmalloc(n * sizeof(*dev->fan_qp));
+        memset(dev->fan_qp, 0, n * sizeof(*dev->fan_qp));
+        for (i = 0; i < n; ++i) {
+            rd_fanout_qp(dev, i);
+            encode_uint32(&qpns[i], dev->fan_qp[i]->qp_num);
+        }
+        send_mesg(qpns, n * sizeof(*qpns), "UD destinations");
+        free(qpns);
+    }
+}
+
+
+/*
+ * Give the server's destination QPs n completion queues of their own, each
+ * with its own completion channel, and gather the channels along with the one
+ * for our own CQ into an epoll set.  That is how a server handling many peers
+ * from one thread would wait for them; see rd_poll_epoll.
+ */
+static void
+rd_fanout_cqs(DEVICE *dev, int n)
+{
+    int i;
+    struct ibv_context *context = dev->pd->context;
+
+    dev->ep_n = n;
+    dev->ep_cq = qmalloc((n+1) * sizeof(*dev->ep_cq));
+    dev->ep_cc = qmalloc((n+1) * sizeof(*dev->ep_cc));
+    dev->ep_ready = qmalloc((n+1) * sizeof(*dev->ep_ready));
+    dev->ep_events = qmalloc((n+1) * sizeof(*dev->ep_events));
+    memset(dev->ep_cq, 0, (n+1) * sizeof(*dev->ep_cq));
+    memset(dev->ep_cc, 0, (n+1) * sizeof(*dev->ep_cc));
+    dev->ep_fd = epoll_create1(0);
+    if (dev->ep_fd < 0)
+        error(SYS, "epoll_create1 failed");
+
+    for (i = 0; i <= n; ++i) {
+        struct epoll_event event ={
+            .events = EPOLLIN,
+            .data.u32 = i
+        };
+
+        if (i < n) {
+            dev->ep_cc[i] = ibv_create_comp_channel(context);
+            if (!dev->ep_cc[i])
+                error(SYS, "failed to create completion channel");
+            dev->ep_cq[i] = ibv_create_cq(context, NCQE+1, 0, dev->ep_cc[i], 0);
+            if (!dev->ep_cq[i])
+                error(SYS, "failed to create completion queue");
+            if (!Req.poll_mode && ibv_req_notify_cq(dev->ep_cq[i], 0) != 0)
+                error(SYS, "failed to request CQ notification");
+        } else {
+            dev->ep_cc[i] = dev->channel;
+            dev->ep_cq[i] = dev->cq;
+        }
+        if (epoll_ctl(dev->ep_fd, EPOLL_CTL_ADD, dev->ep_cc[i]->fd, &event) < 0)
+            error(SYS, "epoll_ctl failed");
+    }
+    LStat.ep_cqs = n;
+}
+
+
+/*
+ * Create one of the UD QPs the server receives on when fanning out and bring
+ * it to RTS.
+ */
+static void
+rd_fanout_qp(DEVICE *dev, int i)
+{
+    struct ibv_qp *qp;
+    struct ibv_cq *cq = dev->ep_n ? dev->ep_cq[i % dev->ep_n] : dev->cq;
+    struct ibv_qp_init_attr qp_attr ={
+        .send_cq = cq,
+        .recv_cq = cq,
+        .srq     = dev->srq,
+        .cap     ={
+            .max_send_wr  = 1,
+            .max_send_sge = 1,
+        },
+        .qp_type = IBV_QPT_UD
+    };
+    struct ibv_qp_attr attr ={
+        .qp_state   = IBV_QPS_INIT,
+        .pkey_index = 0,
+        .port_num   = dev->ib.port,
+        .qkey       = dev->qkey
+    };
+
+    qp = ibv_create_qp(dev->pd, &qp_attr);
+    if (!qp)
+        error(SYS, "failed to create UD QP %d of %d", i+1, dev->fan_n);
+    dev->fan_qp[i] = qp;
+    if (ibv_modify_qp(qp, &attr, IBV_QP_STATE | IBV_QP_PKEY_INDEX |
+                                 IBV_QP_PORT | IBV_QP_QKEY) != SUCCESS0)
+        error(SYS, "failed to modify QP to INIT state");
+    attr.qp_state = IBV_QPS_RTR;
+    if (ibv_modify_qp(qp, &attr, IBV_QP_STATE) != SUCCESS0)
+        error(SYS, "failed to modify QP to RTR");
+    attr.qp_state = IBV_QPS_RTS;
+    attr.sq_psn = 0;
+    if (ibv_modify_qp(qp, &attr, IBV_QP_STATE | IBV_QP_SQ_PSN) != SUCCESS0)
+        error(SYS, "failed to modify QP to RTS");
+}
+
+
+/*
+ * Point the next n sends at the next destinations, in turn or, with
+ * --ud_random, at random.  A xorshift generator keeps picking cheap
+ * compared with posting.
+ */
+static void
+rd_fanout_wr(DEVICE *dev, int n)
+{
+    int i;
+
+    for (i = 0; i < n; ++i) {
+        struct ibv_send_wr *s = &dev->send_wr[i];
+        uint32_t d;
+
+        if (Req.ud_random) {
+            uint32_t x = dev->fan_next;
+
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            dev->fan_next = x;
+            d = x % dev->fan_n;
+        } else {
+            d = dev->fan_next++;
+            if (dev->fan_next == dev->fan_n)
+                dev->fan_next = 0;
+        }
+        s->wr.ud.ah = dev->fan_ah[d];
+        s->wr.ud.remote_qpn = dev->fan_qpn[d];
+    }
+}
+
+
+/*
+ * Destroy what we created to fan out.  The server's QPs must go before the
+ * shared receive queue and completion queues they use.  The last CQ and
+ * channel in the epoll set are our own and are left to rd_close.
+ */
+static void
+rd_fanout_close(DEVICE *dev)
+{
+    uint32_t i;
+
+    for (i = 0; i < dev->fan_n; ++i) {
+        if (dev->fan_ah && dev->fan_ah[i])
+            ibv_destroy_ah(dev->fan_ah[i]);
+        if (dev->fan_qp && dev->fan_qp[i])
+            ibv_destroy_qp(dev->fan_qp[i]);
+    }
+    free(dev->fan_ah);
+    free(dev->fan_qp);
+    free(dev->fan_qpn);
+    dev->fan_ah = 0;
+    dev->fan_qp = 0;
+    dev->fan_qpn = 0;
+    dev->fan_n = 0;
+
+    if (!dev->ep_n)
+        return;
+    close(dev->ep_fd);
+    for (i = 0; i < dev->ep_n; ++i) {
+        if (dev->ep_cq[i])
+            ibv_destroy_cq(dev->ep_cq[i]);
+        if (dev->ep_cc[i])
+            ibv_destroy_comp_channel(dev->ep_cc[i]);
+    }
+    free(dev->ep_cq);
+    free(dev->ep_cc);
+    free(dev->ep_ready);
+    free(dev->ep_events);
+    dev->ep_cq = 0;
+    dev->ep_cc = 0;
+    dev->ep_ready = 0;
+    dev->ep_events = 0;
+    dev->ep_n = 0;
+}
+
+
 /*
  * Show node information when debugging.
  */
@@ -1598,6 +2134,8 @@ show_node_info(DEVICE *dev)
 static void
 rd_close(DEVICE *dev)
 {
+    async_stop(dev);
+    rd_fanout_close(dev);
     if (Req.use_cm)
         cm_close(dev);
     else
@@ -1620,6 +2158,116 @@ rd_close(DEVICE *dev)
 }
 
 
+/*
+ * Force the connections onto their alternate paths.  This is called from the
+ * thread injecting faults and only migrates once.  Return 1 if every device
+ * with an alternate path migrated.
+ */
+int
+rd_migrate(void)
+{
+    int n = 0;
+    int ok = 0;
+    DEVICE *dev;
+
+    if (!Req.alt_port)
+        return 0;
+    for (dev = AsyncList; dev; dev = dev->async_next) {
+        ++n;
+        ok += ib_migrate(dev);
+    }
+    Req.alt_port = 0;
+    return n && ok == n;
+}
+
+
+/*
+ * If an alternate path is armed, start a thread that watches asynchronous
+ * events so that we can note when the path migrates.  The responder sees the
+ * event when the first packet arrives on the new path.  Each device has its
+ * own thread and is added to AsyncList so that rd_migrate can find it.
+ */
+static void
+async_start(DEVICE *dev)
+{
+    int flags;
+    int fd;
+    sigset_t all;
+    sigset_t old;
+
+    if (Req.use_cm || !dev->rnode.alt_lid)
+        return;
+    if (dev->trans != IBV_QPT_RC && dev->trans != IBV_QPT_UC)
+        return;
+    fd = dev->ib.context->async_fd;
+    flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+        error(SYS, "failed to make async events non-blocking");
+
+    dev->async_on = 1;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+    errno = pthread_create(&dev->async_thread, 0, async_monitor, dev);
+    pthread_sigmask(SIG_SETMASK, &old, 0);
+    if (errno) {
+        dev->async_on = 0;
+        error(SYS, "failed to create async event thread");
+    }
+    dev->async_next = AsyncList;
+    AsyncList = dev;
+}
+
+
+/*
+ * Stop watching asynchronous events on a device.
+ */
+static void
+async_stop(DEVICE *dev)
+{
+    DEVICE **p;
+
+    if (!dev->async_on)
+        return;
+    for (p = &AsyncList; *p; p = &(*p)->async_next) {
+        if (*p == dev) {
+            *p = dev->async_next;
+            break;
+        }
+    }
+    dev->async_on = 0;
+    pthread_join(dev->async_thread, 0);
+}
+
+
+/*
+ * Note when the path migrates.  We wake up every so often to see if we should
+ * stop.
+ */
+static void *
+async_monitor(void *arg)
+{
+    DEVICE *dev = arg;
+    struct pollfd pollfd ={
+        .fd     = dev->ib.context->async_fd,
+        .events = POLLIN
+    };
+
+    while (dev->async_on) {
+        struct ibv_async_event event;
+
+        if (poll(&pollfd, 1, ASYNC_POLL) <= 0)
+            continue;
+        if (ibv_get_async_event(dev->ib.context, &event) != SUCCESS0)
+            continue;
+        if (event.event_type == IBV_EVENT_PATH_MIG && !LStat.path_mig)
+            LStat.path_mig = test_nsecs();
+        debug("async event: %s", ibv_event_type_str(event.event_type));
+        ibv_ack_async_event(&event);
+    }
+    return 0;
+}
+
+
 /*
  * Create a queue pair.
  */
@@ -2019,14 +2667,13 @@ ib_open(DEVICE *dev)
             error(0, "bad MTU: %d; must be 256/512/1K/2K/4K", mtu);
     }
 
-    /* Determine port */
+    /* Determine port; Req.id is left as is for any other device we open */
     {
         int port = 1;
         char *p = index(Req.id, ':');
 
         if (p) {
-            *p++ = '\0';
-            port = atoi(p);
+            port = atoi(p+1);
             if (port < 1)
                 error(0, "bad IB port: %d; must be at least 1", port);
         }
@@ -2054,18 +2701,22 @@ ib_open(DEVICE *dev)
     /* Open device */
     {
         struct ibv_device *device;
-        char *name = Req.id[0] ? Req.id : 0;
+        char *p = index(Req.id, ':');
+        int len = p ? p - Req.id : strlen(Req.id);
 
         dev->ib.devlist = ibv_get_device_list(0);
         if (!dev->ib.devlist)
             error(SYS, "failed to find any InfiniBand devices");
-        if (!name)
+        if (!len)
             device = *dev->ib.devlist;
         else {
             struct ibv_device **d = dev->ib.devlist;
-            while ((device = *d++))
-                if (streq(ibv_get_device_name(device), name))
+            while ((device = *d++)) {
+                const char *name = ibv_get_device_name(device);
+
+                if (strlen(name) == len && !strncmp(name, Req.id, len))
                     break;
+            }
         }
         if (!device)
             error(SYS, "failed to find InfiniBand device");
@@ -2165,7 +2816,7 @@ ib_prep(DEVICE *dev)
             .port_num       = dev->ib.port,
             .static_rate    = dev->ib.rate,
 	    .src_path_bits  = Req.src_path_bits,
-            .sl             = Req.sl
+            .sl             = dev->sl
         }
     };
     struct ibv_qp_attr rts_attr ={
@@ -2182,7 +2833,7 @@ ib_prep(DEVICE *dev)
             .port_num      = Req.alt_port,
             .static_rate   = dev->ib.rate,
 	    .src_path_bits = Req.src_path_bits,
-            .sl            = Req.sl
+            .sl            = dev->sl
         }
     };
     struct ibv_ah_attr ah_attr ={
@@ -2190,7 +2841,7 @@ ib_prep(DEVICE *dev)
         .port_num      = dev->ib.port,
         .static_rate   = dev->ib.rate,
 	.src_path_bits = Req.src_path_bits,
-        .sl            = Req.sl
+        .sl            = dev->sl
     };
 
     if (dev->trans == IBV_QPT_UD) {
@@ -2287,17 +2938,16 @@ ib_close2(DEVICE *dev)
 
 
 /*
- * Cause a path migration to happen.
+ * Cause a path migration to happen.  Return 1 on success.  Since we may be
+ * called from another thread, we do not exit on failure.
  */
-static void
+static int
 ib_migrate(DEVICE *dev)
 {
-    if (!Req.alt_port)
-        return;
-    /* Only migrate once. */
-    Req.alt_port = 0;
+    if (!dev->rnode.alt_lid)
+        return 0;
     if (dev->trans != IBV_QPT_RC && dev->trans != IBV_QPT_UC)
-        return;
+        return 0;
 
     {
         struct ibv_qp_attr attr ={
@@ -2305,8 +2955,9 @@ ib_migrate(DEVICE *dev)
         };
 
         if (ibv_modify_qp(dev->qp, &attr, IBV_QP_PATH_MIG_STATE) != SUCCESS0)
-            error(SYS, "failed to modify QP to Migrated state");
+            return 0;
     }
+    return 1;
 }
 
 
@@ -2364,103 +3015,70 @@ ib_post_atomic(DEVICE *dev, ATOMIC atomic, int wrid,
 
 /*
  * The standard version to post sends that most of the test routines call.
- * Post n sends.
+ * Post n sends from the chain built by rd_prep_wr, up to NPOST at a time.
+ * They are counted as they complete.
  */
 static void
 rd_post_send_std(DEVICE *dev, int n)
 {
-    rd_post_send(dev, 0, dev->msg_size, 0, n, 1);
-}
-
-
-/*
- * Post one or more sends.
- */
-static void
-rd_post_send(DEVICE *dev, int off, int len, int inc, int rep, int stat)
-{
-    struct ibv_sge sge ={
-        .addr   = (uintptr_t) &dev->buffer[off],
-        .length = len,
-        .lkey   = dev->mr->lkey
-    };
-    struct ibv_send_wr wr ={
-        .wr_id      = WRID_SEND,
-        .sg_list    = &sge,
-        .num_sge    = 1,
-        .opcode     = IBV_WR_SEND,
-        .send_flags = IBV_SEND_SIGNALED,
-    };
     struct ibv_send_wr *badwr;
 
-    if (dev->trans == IBV_QPT_UD) {
-        wr.wr.ud.ah          = dev->ah;
-        wr.wr.ud.remote_qpn  = dev->rnode.qpn;
-        wr.wr.ud.remote_qkey = dev->qkey;
-    }
-#ifdef HAS_XRC
-    else if (dev->trans == IBV_QPT_XRC)
-        wr.xrc_remote_srq_num = dev->rnode.srqn;
-#endif
-
-    if (dev->msg_size <= dev->max_inline)
-        wr.send_flags |= IBV_SEND_INLINE;
-
     errno = 0;
-    while (!Finished && rep-- > 0) {
-        if (ibv_post_send(dev->qp, &wr, &badwr) != SUCCESS0) {
+    while (!Finished && n > 0) {
+        int stat;
+        int k = n < NPOST ? n : NPOST;
+        struct ibv_send_wr *last = &dev->send_wr[k-1];
+        struct ibv_send_wr *next = last->next;
+
+        last->next = 0;
+        if (dev->fan_ah)
+            rd_fanout_wr(dev, k);
+        stat = ibv_post_send(dev->qp, dev->send_wr, &badwr);
+        last->next = next;
+        if (stat != SUCCESS0) {
             if (Finished && errno == EINTR)
                 return;
             error(SYS, "failed to post send");
         }
-        sge.addr += inc;
-        sge.length += inc;
-        if (stat) {
-            LStat.s.no_bytes += dev->msg_size;
-            LStat.s.no_msgs++;
-        }
+        n -= k;
     }
 }
 
 
 /*
- * Post n receives.
+ * Post n receives from the chain built by rd_prep_wr, up to NPOST at a time.
  */
 static void
 rd_post_recv_std(DEVICE *dev, int n)
 {
-    struct ibv_sge sge ={
-        .addr   = (uintptr_t) dev->buffer,
-        .length = dev->buf_size,
-        .lkey   = dev->mr->lkey
-    };
-    struct ibv_recv_wr wr ={
-        .wr_id      = WRID_RECV,
-        .sg_list    = &sge,
-        .num_sge    = 1,
-    };
     struct ibv_recv_wr *badwr;
 
     errno = 0;
-    while (!Finished && n-- > 0) {
+    while (!Finished && n > 0) {
         int stat;
+        int k = n < NPOST ? n : NPOST;
+        struct ibv_recv_wr *last = &dev->recv_wr[k-1];
+        struct ibv_recv_wr *next = last->next;
 
+        last->next = 0;
         if (dev->srq)
-            stat = ibv_post_srq_recv(dev->srq, &wr, &badwr);
+            stat = ibv_post_srq_recv(dev->srq, dev->recv_wr, &badwr);
         else
-            stat = ibv_post_recv(dev->qp, &wr, &badwr);
-
+            stat = ibv_post_recv(dev->qp, dev->recv_wr, &badwr);
+        last->next = next;
         if (stat != SUCCESS0) {
             if (Finished && errno == EINTR)
                 return;
             error(SYS, "failed to post receive");
         }
+        n -= k;
     }
 }
 
 
 /*
- * Post n RDMA requests.
+ * Post n RDMA requests.  RDMA writes are counted as they are posted; writes
+ * with immediate data are counted by the loops as they complete.
  */
 static void
 rd_post_rdma_std(DEVICE *dev, ibv_op opcode, int n)
@@ -2494,7 +3112,7 @@ rd_post_rdma_std(DEVICE *dev, ibv_op opcode, int n)
                 return;
             error(SYS, "failed to post %s", opcode_name(wr.opcode));
         }
-        if (opcode != IBV_WR_RDMA_READ) {
+        if (opcode == IBV_WR_RDMA_WRITE) {
             LStat.s.no_bytes += dev->msg_size;
             LStat.s.no_msgs++;
         }
@@ -2510,6 +3128,8 @@ rd_poll(DEVICE *dev, struct ibv_wc *wc, int nwc)
 {
     int n;
 
+    if (dev->ep_n)
+        return rd_poll_epoll(dev, wc, nwc);
     if (!Req.poll_mode && !Finished) {
         void *ectx;
         struct ibv_cq *ecq;
@@ -2529,6 +3149,68 @@ rd_poll(DEVICE *dev, struct ibv_wc *wc, int nwc)
 }
 
 
+/*
+ * Poll the completion queues of a server run with --ud_cqs.  When polling,
+ * we just go through them in turn.  Otherwise we wait on their channels with
+ * epoll, re-arm each CQ that has an event and drain them until they are
+ * empty, remembering those we have not finished with for the next call.
+ */
+static int
+rd_poll_epoll(DEVICE *dev, struct ibv_wc *wc, int nwc)
+{
+    int n = 0;
+
+    if (Req.poll_mode) {
+        uint32_t i;
+
+        for (i = 0; i <= dev->ep_n && n < nwc; ++i) {
+            int k = ibv_poll_cq(dev->ep_cq[i], nwc-n, wc+n);
+
+            if (k < 0)
+                return maybe(0, "CQ poll failed");
+            n += k;
+        }
+        return n;
+    }
+
+    if (!dev->ep_nready && !Finished) {
+        int i;
+        int k = epoll_wait(dev->ep_fd, dev->ep_events, dev->ep_n+1, -1);
+
+        if (k < 0)
+            return maybe(0, "epoll_wait failed");
+        LStat.ep_wakeups++;
+        LStat.ep_events += k;
+        for (i = 0; i < k; ++i) {
+            void *ectx;
+            struct ibv_cq *ecq;
+            uint32_t c = dev->ep_events[i].data.u32;
+
+            if (ibv_get_cq_event(dev->ep_cc[c], &ecq, &ectx) != SUCCESS0)
+                return maybe(0, "failed to get CQ event");
+            if (ecq != dev->ep_cq[c])
+                error(0, "CQ event for unknown CQ");
+            if (ibv_req_notify_cq(ecq, 0) != SUCCESS0)
+                return maybe(0, "failed to request CQ notification");
+            ibv_ack_cq_events(ecq, 1);
+            dev->ep_ready[dev->ep_nready++] = c;
+        }
+    }
+
+    while (dev->ep_nready && n < nwc) {
+        uint32_t c = dev->ep_ready[dev->ep_nready-1];
+        int k = ibv_poll_cq(dev->ep_cq[c], nwc-n, wc+n);
+
+        if (k < 0)
+            return maybe(0, "CQ poll failed");
+        n += k;
+        if (n < nwc)
+            dev->ep_nready--;
+    }
+    return n;
+}
+
+
 /*
  * We encountered an error in a system call which might simply have been
  * interrupted by the alarm that signaled completion of the test.  Generate the
@@ -45,6 +45,7 @@
 #include <netinet/in.h>
 #include <stdbool.h>
 #include "qperf.h"
+#include "xport.h"
 
 /*
  * Parameters.
@@ -99,21 +100,30 @@ static void     connect_tcp(char *server, char *port, SS *addr,
                                                     socklen_t *len, int *fd);
 static void     get_socket_ip(SA *saptr, int salen, char *ip, int n);
 static int      get_socket_port(int fd);
-static int      init(void);
+static void     init(XPORT *x);
+static void     rds_close(XPORT *x);
 static void     qgetnameinfo(SA *sa, socklen_t salen, char *host,
                     size_t hostlen, char *serv, size_t servlen, int flags);
 static int      rds_socket(char *host, int port);
 static void     rds_makeaddr(SS *addr, socklen_t *len, char *host, int port);
+static int      rds_poll(XPORT *x, XCOMP *c, int n);
+static void     rds_post_send(XPORT *x, int ep, void *buf, int len, int n);
+static int      rds_recv(XEP *e, void *buf, int len);
 static void     set_parameters(long msgSize);
 static void     server_get_hosts(char *lhost, char *rhost);
 static void     set_socket_buffer_size(int fd);
 static inline bool  ipv6_addr_v4mapped(const struct in6_addr *a);
 
 /*
- * Static variables.
+ * Transport operations.
  */
-static SS        RAddr;
-static socklen_t RLen;
+static const XPORT_OPS RdsOps ={
+    .connect   = init,
+    .post_send = rds_post_send,
+    .post_recv = xport_post_recv,
+    .poll      = rds_poll,
+    .close     = rds_close,
+};
 
 
 /*
@@ -122,33 +132,17 @@ static socklen_t RLen;
 void
 run_client_rds_bw(void)
 {
-    char *buf;
-    int sockfd;
+    XPORT x ={ .n = 1, .depth = 1 };
 
     par_use(L_ACCESS_RECV);
     par_use(R_ACCESS_RECV);
+    par_use(L_PIPELINE);
+    par_use(R_PIPELINE);
+    par_use(L_PIPELINE_MODE);
+    par_use(R_PIPELINE_MODE);
     set_parameters(8*1024);
     client_send_request();
-    sockfd = init();
-    buf = qmalloc(Req.msg_size);
-    sync_test();
-    while (!Finished) {
-        int n = sendto(sockfd, buf, Req.msg_size, 0, (SA *)&RAddr, RLen);
-
-        if (Finished)
-            break;
-        if (n != Req.msg_size) {
-            LStat.s.no_errs++;
-            continue;
-        }
-        LStat.s.no_bytes += n;
-        LStat.s.no_msgs++;
-    }
-    stop_test_timer();
-    exchange_results();
-    free(buf);
-    close(sockfd);
-    show_results(BANDWIDTH);
+    xport_client_bw(&RdsOps, &x, 0, BANDWIDTH);
 }
 
 
@@ -158,29 +152,9 @@ run_client_rds_bw(void)
 void
 run_server_rds_bw(void)
 {
-    char *buf;
-    int sockfd;
+    XPORT x ={ .n = 1, .depth = 1 };
 
-    sockfd = init();
-    sync_test();
-    buf = qmalloc(Req.msg_size);
-    while (!Finished) {
-        int n = read(sockfd, buf, Req.msg_size);
-        if (Finished)
-            break;
-        if (n != Req.msg_size) {
-            LStat.r.no_errs++;
-            continue;
-        }
-        LStat.r.no_bytes += n;
-        LStat.r.no_msgs++;
-        if (Req.access_recv)
-            touch_data(buf, Req.msg_size);
-    }
-    stop_test_timer();
-    exchange_results();
-    free(buf);
-    close(sockfd);
+    xport_server_bw(&RdsOps, &x, 0);
 }
 
 
@@ -190,41 +164,18 @@ run_server_rds_bw(void)
 void
 run_client_rds_lat(void)
 {
-    char *buf;
-    int sockfd;
-
+    XPORT x ={ .n = 1, .depth = 1 };
+
+    par_use(L_COLD_CACHE);
+    par_use(R_COLD_CACHE);
+    par_use(L_SAMPLES);
+    par_use(R_SAMPLES);
+    par_use(R_SERVICE_DIST);
+    par_use(R_SERVICE_TIME);
+    par_use(R_SERVICE_TOUCH);
     set_parameters(1);
     client_send_request();
-    sockfd = init();
-    buf = qmalloc(Req.msg_size);
-    sync_test();
-    while (!Finished) {
-        int n = sendto(sockfd, buf, Req.msg_size, 0, (SA *)&RAddr, RLen);
-
-        if (Finished)
-            break;
-        if (n != Req.msg_size) {
-            LStat.s.no_errs++;
-            continue;
-        }
-        LStat.s.no_bytes += n;
-        LStat.s.no_msgs++;
-
-        n = read(sockfd, buf, Req.msg_size);
-        if (Finished)
-            break;
-        if (n != Req.msg_size) {
-            LStat.r.no_errs++;
-            continue;
-        }
-        LStat.r.no_bytes += n;
-        LStat.r.no_msgs++;
-    }
-    stop_test_timer();
-    exchange_results();
-    free(buf);
-    close(sockfd);
-    show_results(LATENCY);
+    xport_client_lat(&RdsOps, &x, 0);
 }
 
 
@@ -234,40 +185,52 @@ run_client_rds_lat(void)
 void
 run_server_rds_lat(void)
 {
-    char *buf;
-    int sockfd;
+    XPORT x ={ .n = 1, .depth = 1 };
 
-    sockfd = init();
-    sync_test();
-    buf = qmalloc(Req.msg_size);
-    while (!Finished) {
-        SS raddr;
-        socklen_t rlen = sizeof(raddr);
-        int n = recvfrom(sockfd, buf, Req.msg_size, 0, (SA *)&raddr, &rlen);
+    xport_server_lat(&RdsOps, &x, 0);
+}
 
-        if (Finished)
-            break;
-        if (n != Req.msg_size) {
-            LStat.r.no_errs++;
-            continue;
-        }
-        LStat.r.no_bytes += n;
-        LStat.r.no_msgs++;
 
-        n = sendto(sockfd, buf, Req.msg_size, 0, (SA *)&raddr, rlen);
-        if (Finished)
-            break;
-        if (n != Req.msg_size) {
-            LStat.s.no_errs++;
-            continue;
-        }
-        LStat.s.no_bytes += n;
-        LStat.s.no_msgs++;
+/*
+ * Send a message to our peer.  A partial message is an error.
+ */
+static void
+rds_post_send(XPORT *x, int ep, void *buf, int len, int n)
+{
+    XEP *e = &x->ep[ep];
+
+    n = sendto(e->fd, buf, len, 0, (SA *)&e->addr, e->addrLen);
+    if (n >= 0 && n != len) {
+        errno = EIO;
+        n = -1;
+    }
+    xport_sent(x, ep, buf, len, n);
+}
+
+
+/*
+ * Poll our socket.
+ */
+static int
+rds_poll(XPORT *x, XCOMP *c, int n)
+{
+    return xport_poll_sync(x, c, rds_recv);
+}
+
+
+/*
+ * Receive a message from our peer.  A partial message is an error.
+ */
+static int
+rds_recv(XEP *e, void *buf, int len)
+{
+    int n = read(e->fd, buf, len);
+
+    if (n >= 0 && n != len) {
+        errno = EIO;
+        return -1;
     }
-    stop_test_timer();
-    exchange_results();
-    free(buf);
-    close(sockfd);
+    return n;
 }
 
 
@@ -288,12 +251,11 @@ set_parameters(long msgSize)
 
 
 /*
- * Initialize and return open socket.
+ * Open a socket and exchange addresses with our peer.
  */
-static int
-init(void)
+static void
+init(XPORT *x)
 {
-    int sockfd;
     uint32_t lport;
     uint32_t rport;
     char lhost[NI_MAXHOST];
@@ -303,14 +265,23 @@ init(void)
         client_get_hosts(lhost, rhost);
     else
         server_get_hosts(lhost, rhost);
-    sockfd = rds_socket(lhost, Req.port);
-    lport = get_socket_port(sockfd);
+    x->ep[0].fd = rds_socket(lhost, Req.port);
+    lport = get_socket_port(x->ep[0].fd);
     encode_uint32(&lport, lport);
     send_mesg(&lport, sizeof(lport), "RDS port");
     recv_mesg(&rport, sizeof(rport), "RDS port");
     rport = decode_uint32(&rport);
-    rds_makeaddr(&RAddr, &RLen, rhost, rport);
-    return sockfd;
+    rds_makeaddr(&x->ep[0].addr, &x->ep[0].addrLen, rhost, rport);
+}
+
+
+/*
+ * Close our socket.
+ */
+static void
+rds_close(XPORT *x)
+{
+    close(x->ep[0].fd);
 }
 
 
@@ -34,17 +34,32 @@
  */
 #define _GNU_SOURCE
 #include <errno.h>
+#include <fcntl.h>
 #include <netdb.h>
+#include <poll.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
+#include <net/if.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/errqueue.h>
+#include <linux/ethtool.h>
+#include <linux/net_tstamp.h>
+#include <linux/sockios.h>
 #include "qperf.h"
+#include "xport.h"
 
 
 /*
  * Parameters.
  */
 #define AF_INET_SDP 27                  /* Family for SDP */
+#define ETH_OVERHEAD 38                 /* Ethernet header, FCS, preamble, gap */
+#define ETH_MIN_FRAME 84                /* Minimum frame with preamble, gap */
+#define DEF_COMPRESS_PCT 50             /* Compressibility with --compress */
 
 
 /*
@@ -63,24 +78,143 @@ char *Kinds[] ={ "SCTP", "SDP", "TCP", "UDP", };
 /*
  * Function prototypes.
  */
-static void     client_init(int *fd, KIND kind);
+static int      client_connect(int rail, KIND kind, int rport);
+static void     client_init(int *fds, int n, KIND kind);
+static void     compress_close(XPORT *x);
+static void     compress_connect(XPORT *x);
+static void     compress_parameters(void);
+static int      compress_poll(XPORT *x, XCOMP *c, int n);
+static void     compress_post_send(XPORT *x, int ep, void *buf, int len,
+                                   int n);
 static void     datagram_client_bw(KIND kind);
 static void     datagram_client_lat(KIND kind);
+static void     datagram_connect(XPORT *x);
+static int      datagram_poll_read(XPORT *x, XCOMP *c, int n);
+static int      datagram_poll_recvfrom(XPORT *x, XCOMP *c, int n);
+static void     datagram_post_sendto(XPORT *x, int ep, void *buf, int len,
+                                     int n);
+static void     datagram_post_write(XPORT *x, int ep, void *buf, int len,
+                                    int n);
+static int      datagram_read(XEP *e, void *buf, int len);
+static int      datagram_recvfrom(XEP *e, void *buf, int len);
 static void     datagram_server_bw(KIND kind);
 static void     datagram_server_init(int *fd, KIND kind);
 static void     datagram_server_lat(KIND kind);
+static int      ethtool_speed(int fd, struct ifreq *ifr);
+static void     get_link_info(KIND kind);
 static void     get_socket_port(int fd, uint32_t *port);
-static AI      *getaddrinfo_kind(int serverflag, KIND kind, int port);
+static AI      *getaddrinfo_kind(int serverflag, char *host, KIND kind,
+                                  int port);
 static void     ip_parameters(long msgSize);
 static char    *kind_name(KIND kind);
+static void     qos_connect(XPORT *x);
+static void     qos_set(int fd);
+static socklen_t rail_addr(char *local, SS *addr);
+static void     rail_connect(XPORT *x);
+static int      rail_poll(XPORT *x, XCOMP *c, int n);
+static void     rail_post_send(XPORT *x, int ep, void *buf, int len, int n);
+static int      rail_progress(XPORT *x, XCOMP *c, int n,
+                              struct pollfd *pfd);
+static void     rail_spec(int rail, char *local, char *remote, int len);
+static void     rail_write(XEP *e);
 static int      recv_full(int fd, void *ptr, int len);
 static int      send_full(int fd, void *ptr, int len);
 static void     set_socket_buffer_size(int fd);
+static void     socket_close(XPORT *x);
+static void     stamp_lat(int fd, KIND kind);
+static int      stamp_recv(int fd, void *buf, int len, int full, SS *addr,
+                           socklen_t *addrLen, uint64_t *recv);
+static void     stamp_sent(int fd, uint64_t sent);
+static uint64_t stamp_time(void);
 static void     stream_client_bw(KIND kind);
 static void     stream_client_lat(KIND kind);
+static void     stream_client_qos(KIND kind);
+static void     stream_connect(XPORT *x);
+static int      stream_poll(XPORT *x, XCOMP *c, int n);
+static void     stream_post_send(XPORT *x, int ep, void *buf, int len, int n);
+static int      stream_recv(XEP *e, void *buf, int len);
+static int      stream_recv_z(XEP *e, void *buf, int len);
+static int      stream_recv_zc(XEP *e, void *buf, int len);
+static int      stream_send_z(XEP *e, void *buf, int len);
 static void     stream_server_bw(KIND kind);
-static void     stream_server_init(int *fd, KIND kind);
+static void     stream_server_init(int *fds, int n, KIND kind);
 static void     stream_server_lat(KIND kind);
+static void     stream_server_qos(KIND kind);
+static void     zerocopy_close(XPORT *x);
+static void     zerocopy_connect(XPORT *x);
+static void     zerocopy_end(void);
+static void     zerocopy_init(int fd);
+static int      zerocopy_poll(XPORT *x, XCOMP *c, int n);
+
+
+/*
+ * Transport operations.
+ */
+static const XPORT_OPS StreamOps ={
+    .connect   = stream_connect,
+    .post_send = stream_post_send,
+    .post_recv = xport_post_recv,
+    .poll      = stream_poll,
+    .close     = socket_close,
+};
+
+static const XPORT_OPS RailOps ={
+    .connect   = rail_connect,
+    .post_send = rail_post_send,
+    .post_recv = xport_post_recv,
+    .poll      = rail_poll,
+    .close     = socket_close,
+};
+
+static const XPORT_OPS QosOps ={
+    .connect   = qos_connect,
+    .post_send = rail_post_send,
+    .post_recv = xport_post_recv,
+    .poll      = rail_poll,
+    .close     = socket_close,
+};
+
+static const XPORT_OPS DatagramClientOps ={
+    .connect   = datagram_connect,
+    .post_send = datagram_post_write,
+    .post_recv = xport_post_recv,
+    .poll      = datagram_poll_read,
+    .close     = socket_close,
+};
+
+static const XPORT_OPS DatagramServerOps ={
+    .connect   = datagram_connect,
+    .post_send = datagram_post_sendto,
+    .post_recv = xport_post_recv,
+    .poll      = datagram_poll_recvfrom,
+    .close     = socket_close,
+};
+
+static const XPORT_OPS CompressOps ={
+    .connect   = compress_connect,
+    .post_send = compress_post_send,
+    .post_recv = xport_post_recv,
+    .poll      = compress_poll,
+    .close     = compress_close,
+};
+
+static const XPORT_OPS ZeroCopyOps ={
+    .connect   = zerocopy_connect,
+    .post_send = stream_post_send,
+    .post_recv = xport_post_recv,
+    .poll      = zerocopy_poll,
+    .close     = zerocopy_close,
+};
+
+
+/*
+ * Static variables.
+ */
+static char    *ZBuf;
+static int      ZBufLen;
+static char    *ZcMap;
+static int      ZcLen;
+static int      ZcPage;
 
 
 /*
@@ -91,6 +225,13 @@ run_client_sctp_bw(void)
 {
     par_use(L_ACCESS_RECV);
     par_use(R_ACCESS_RECV);
+    par_use(L_PIPELINE);
+    par_use(R_PIPELINE);
+    par_use(L_PIPELINE_MODE);
+    par_use(R_PIPELINE_MODE);
+    par_use(L_RAILS);
+    par_use(R_RAILS);
+    compress_parameters();
     ip_parameters(32*1024);
     stream_client_bw(K_SCTP);
 }
@@ -112,6 +253,15 @@ run_server_sctp_bw(void)
 void
 run_client_sctp_lat(void)
 {
+    par_use(L_COLD_CACHE);
+    par_use(R_COLD_CACHE);
+    par_use(L_SAMPLES);
+    par_use(R_SAMPLES);
+    par_use(R_SERVICE_DIST);
+    par_use(R_SERVICE_TIME);
+    par_use(R_SERVICE_TOUCH);
+    par_use(L_RAILS);
+    par_use(R_RAILS);
     ip_parameters(1);
     stream_client_lat(K_SCTP);
 }
@@ -135,6 +285,13 @@ run_client_sdp_bw(void)
 {
     par_use(L_ACCESS_RECV);
     par_use(R_ACCESS_RECV);
+    par_use(L_PIPELINE);
+    par_use(R_PIPELINE);
+    par_use(L_PIPELINE_MODE);
+    par_use(R_PIPELINE_MODE);
+    par_use(L_RAILS);
+    par_use(R_RAILS);
+    compress_parameters();
     ip_parameters(64*1024);
     stream_client_bw(K_SDP);
 }
@@ -156,6 +313,15 @@ run_server_sdp_bw(void)
 void
 run_client_sdp_lat(void)
 {
+    par_use(L_COLD_CACHE);
+    par_use(R_COLD_CACHE);
+    par_use(L_SAMPLES);
+    par_use(R_SAMPLES);
+    par_use(R_SERVICE_DIST);
+    par_use(R_SERVICE_TIME);
+    par_use(R_SERVICE_TOUCH);
+    par_use(L_RAILS);
+    par_use(R_RAILS);
     ip_parameters(1);
     stream_client_lat(K_SDP);
 }
@@ -179,6 +345,15 @@ run_client_tcp_bw(void)
 {
     par_use(L_ACCESS_RECV);
     par_use(R_ACCESS_RECV);
+    par_use(L_PIPELINE);
+    par_use(R_PIPELINE);
+    par_use(L_PIPELINE_MODE);
+    par_use(R_PIPELINE_MODE);
+    par_use(L_RAILS);
+    par_use(R_RAILS);
+    par_use(L_ZEROCOPY_RECV);
+    par_use(R_ZEROCOPY_RECV);
+    compress_parameters();
     ip_parameters(64*1024);
     stream_client_bw(K_TCP);
 }
@@ -200,6 +375,17 @@ run_server_tcp_bw(void)
 void
 run_client_tcp_lat(void)
 {
+    par_use(L_COLD_CACHE);
+    par_use(R_COLD_CACHE);
+    par_use(L_SAMPLES);
+    par_use(R_SAMPLES);
+    par_use(R_SERVICE_DIST);
+    par_use(R_SERVICE_TIME);
+    par_use(R_SERVICE_TOUCH);
+    par_use(L_BREAKDOWN);
+    par_use(R_BREAKDOWN);
+    par_use(L_RAILS);
+    par_use(R_RAILS);
     ip_parameters(1);
     stream_client_lat(K_TCP);
 }
@@ -215,6 +401,33 @@ run_server_tcp_lat(void)
 }
 
 
+/*
+ * Measure TCP latency under a bulk load with and without a class of service
+ * (client side).
+ */
+void
+run_client_tcp_qos(void)
+{
+    par_use(L_QOS_DSCP);
+    par_use(R_QOS_DSCP);
+    par_use(L_QOS_PRIORITY);
+    par_use(R_QOS_PRIORITY);
+    ip_parameters(1);
+    stream_client_qos(K_TCP);
+}
+
+
+/*
+ * Measure TCP latency under a bulk load with and without a class of service
+ * (server side).
+ */
+void
+run_server_tcp_qos(void)
+{
+    stream_server_qos(K_TCP);
+}
+
+
 /*
  * Measure UDP bandwidth (client side).
  */
@@ -223,6 +436,12 @@ run_client_udp_bw(void)
 {
     par_use(L_ACCESS_RECV);
     par_use(R_ACCESS_RECV);
+    par_use(L_PIPELINE);
+    par_use(R_PIPELINE);
+    par_use(L_PIPELINE_MODE);
+    par_use(R_PIPELINE_MODE);
+    par_use(L_RAILS);
+    par_use(R_RAILS);
     ip_parameters(32*1024);
     datagram_client_bw(K_UDP);
 }
@@ -244,6 +463,17 @@ run_server_udp_bw(void)
 void
 run_client_udp_lat(void)
 {
+    par_use(L_COLD_CACHE);
+    par_use(R_COLD_CACHE);
+    par_use(L_SAMPLES);
+    par_use(R_SAMPLES);
+    par_use(R_SERVICE_DIST);
+    par_use(R_SERVICE_TIME);
+    par_use(R_SERVICE_TOUCH);
+    par_use(L_BREAKDOWN);
+    par_use(R_BREAKDOWN);
+    par_use(L_RAILS);
+    par_use(R_RAILS);
     ip_parameters(1);
     datagram_client_lat(K_UDP);
 }
@@ -265,29 +495,19 @@ run_server_udp_lat(void)
 static void
 stream_client_bw(KIND kind)
 {
-    char *buf;
-    int sockFD;
+    XPORT x ={ .n = 1, .depth = 1, .kind = kind };
 
-    client_init(&sockFD, kind);
-    buf = qmalloc(Req.msg_size);
-    sync_test();
-    while (!Finished) {
-        int n = send_full(sockFD, buf, Req.msg_size);
-
-        if (Finished)
-            break;
-        if (n < 0) {
-            LStat.s.no_errs++;
-            continue;
-        }
-        LStat.s.no_bytes += n;
-        LStat.s.no_msgs++;
+    if (Req.rails > 1) {
+        if (Req.compress[0] || Req.pipeline)
+            error(0, "--compress and --pipeline cannot be used with --rails");
+        x.n = Req.rails;
+        xport_client_bw(&RailOps, &x, X_RAILS, BANDWIDTH);
+        return;
     }
-    stop_test_timer();
-    exchange_results();
-    free(buf);
-    close(sockFD);
-    show_results(BANDWIDTH);
+    if (Req.compress[0])
+        xport_client_bw(&CompressOps, &x, X_FILL, BANDWIDTH);
+    else
+        xport_client_bw(&StreamOps, &x, 0, BANDWIDTH);
 }
 
 
@@ -297,31 +517,26 @@ stream_client_bw(KIND kind)
 static void
 stream_server_bw(KIND kind)
 {
-    int sockFD = -1;
-    char *buf = 0;
-
-    stream_server_init(&sockFD, kind);
-    sync_test();
-    buf = qmalloc(Req.msg_size);
-    while (!Finished) {
-        int n = recv_full(sockFD, buf, Req.msg_size);
+    XPORT x ={ .n = 1, .depth = 1, .kind = kind };
 
-        if (Finished)
-            break;
-        if (n < 0) {
-            LStat.r.no_errs++;
-            continue;
-        }
-        LStat.r.no_bytes += n;
-        LStat.r.no_msgs++;
-        if (Req.access_recv)
-            touch_data(buf, Req.msg_size);
+    if (Req.zerocopy_recv && kind == K_TCP) {
+        if (Req.rails > 1 || Req.compress[0] || Req.pipeline)
+            error(0, "--zerocopy_recv cannot be used with --rails, "
+                     "--compress or --pipeline");
+        xport_server_bw(&ZeroCopyOps, &x, 0);
+        return;
     }
-    stop_test_timer();
-    exchange_results();
-    free(buf);
-    if (sockFD >= 0)
-        close(sockFD);
+    if (Req.rails > 1) {
+        if (Req.compress[0] || Req.pipeline)
+            error(0, "--compress and --pipeline cannot be used with --rails");
+        x.n = Req.rails;
+        xport_server_bw(&RailOps, &x, X_RAILS);
+        return;
+    }
+    if (Req.compress[0])
+        xport_server_bw(&CompressOps, &x, 0);
+    else
+        xport_server_bw(&StreamOps, &x, 0);
 }
 
 
@@ -331,39 +546,18 @@ stream_server_bw(KIND kind)
 static void
 stream_client_lat(KIND kind)
 {
-    char *buf;
-    int sockFD;
-
-    client_init(&sockFD, kind);
-    buf = qmalloc(Req.msg_size);
-    sync_test();
-    while (!Finished) {
-        int n = send_full(sockFD, buf, Req.msg_size);
+    XPORT x ={ .n = 1, .depth = 1, .kind = kind };
 
-        if (Finished)
-            break;
-        if (n < 0) {
-            LStat.s.no_errs++;
-            continue;
-        }
-        LStat.s.no_bytes += n;
-        LStat.s.no_msgs++;
+    if (Req.breakdown && kind == K_TCP) {
+        int fd;
 
-        n = recv_full(sockFD, buf, Req.msg_size);
-        if (Finished)
-            break;
-        if (n < 0) {
-            LStat.r.no_errs++;
-            continue;
-        }
-        LStat.r.no_bytes += n;
-        LStat.r.no_msgs++;
+        client_init(&fd, 1, kind);
+        stamp_lat(fd, kind);
+        close(fd);
+        show_results(LATENCY);
+        return;
     }
-    stop_test_timer();
-    exchange_results();
-    free(buf);
-    close(sockFD);
-    show_results(LATENCY);
+    xport_client_lat(&StreamOps, &x, 0);
 }
 
 
@@ -373,38 +567,73 @@ stream_client_lat(KIND kind)
 static void
 stream_server_lat(KIND kind)
 {
-    int sockFD = -1;
-    char *buf = 0;
+    XPORT x ={ .n = 1, .depth = 1, .kind = kind };
 
-    stream_server_init(&sockFD, kind);
-    sync_test();
-    buf = qmalloc(Req.msg_size);
-    while (!Finished) {
-        int n = recv_full(sockFD, buf, Req.msg_size);
+    if (Req.breakdown && kind == K_TCP) {
+        int fd;
 
-        if (Finished)
-            break;
-        if (n < 0) {
-            LStat.r.no_errs++;
-            continue;
-        }
-        LStat.r.no_bytes += n;
-        LStat.r.no_msgs++;
+        stream_server_init(&fd, 1, kind);
+        stamp_lat(fd, kind);
+        close(fd);
+        return;
+    }
+    xport_server_lat(&StreamOps, &x, 0);
+}
 
-        n = send_full(sockFD, buf, Req.msg_size);
-        if (Finished)
-            break;
-        if (n < 0) {
-            LStat.s.no_errs++;
-            continue;
-        }
-        LStat.s.no_bytes += n;
-        LStat.s.no_msgs++;
+
+/*
+ * Measure the round trip of two probes while a bulk stream loads the path
+ * (client side).  The first probe is in the same class as the bulk stream
+ * and the second in the class set by --qos_dscp and --qos_priority.
+ */
+static void
+stream_client_qos(KIND kind)
+{
+    XPORT x ={ .n = 3, .depth = 1, .kind = kind };
+
+    xport_client_qos(&QosOps, &x);
+}
+
+
+/*
+ * Drain the bulk stream and echo the probes (server side).
+ */
+static void
+stream_server_qos(KIND kind)
+{
+    XPORT x ={ .n = 3, .depth = 1, .kind = kind };
+
+    xport_server_qos(&QosOps, &x);
+}
+
+
+/*
+ * Put a socket in the class of service given by --qos_dscp and
+ * --qos_priority.  An IPv6 socket may carry IPv4 traffic, so we set both the
+ * traffic class and the type of service.
+ */
+static void
+qos_set(int fd)
+{
+    SS addr;
+    socklen_t addrLen = sizeof(addr);
+    int tos = Req.qos_dscp << 2;
+    int prio = Req.qos_priority;
+
+    if (Req.qos_dscp > 63)
+        error(0, "DSCP must be between 0 and 63: %d given", Req.qos_dscp);
+    if (Req.qos_dscp) {
+        if (getsockname(fd, (SA *)&addr, &addrLen) < 0)
+            error(SYS, "getsockname failed");
+        if (addr.ss_family == AF_INET6 &&
+            setsockopt(fd, IPPROTO_IPV6, IPV6_TCLASS, &tos, sizeof(tos)) < 0)
+            error(SYS, "failed to set traffic class");
+        if (setsockopt(fd, IPPROTO_IP, IP_TOS, &tos, sizeof(tos)) < 0 &&
+            addr.ss_family == AF_INET)
+            error(SYS, "failed to set type of service");
     }
-    stop_test_timer();
-    exchange_results();
-    free(buf);
-    close(sockFD);
+    if (prio && setsockopt(fd, SOL_SOCKET, SO_PRIORITY, &prio, sizeof(prio)) < 0)
+        error(SYS, "failed to set socket priority");
 }
 
 
@@ -414,29 +643,9 @@ stream_server_lat(KIND kind)
 static void
 datagram_client_bw(KIND kind)
 {
-    char *buf;
-    int sockFD;
-
-    client_init(&sockFD, kind);
-    buf = qmalloc(Req.msg_size);
-    sync_test();
-    while (!Finished) {
-        int n = write(sockFD, buf, Req.msg_size);
+    XPORT x ={ .n = 1, .depth = 1, .kind = kind };
 
-        if (Finished)
-            break;
-        if (n < 0) {
-            LStat.s.no_errs++;
-            continue;
-        }
-        LStat.s.no_bytes += n;
-        LStat.s.no_msgs++;
-    }
-    stop_test_timer();
-    exchange_results();
-    free(buf);
-    close(sockFD);
-    show_results(BANDWIDTH_SR);
+    xport_client_bw(&DatagramClientOps, &x, 0, BANDWIDTH_SR);
 }
 
 
@@ -446,30 +655,9 @@ datagram_client_bw(KIND kind)
 static void
 datagram_server_bw(KIND kind)
 {
-    int sockFD;
-    char *buf = 0;
-
-    datagram_server_init(&sockFD, kind);
-    sync_test();
-    buf = qmalloc(Req.msg_size);
-    while (!Finished) {
-        int n = recv(sockFD, buf, Req.msg_size, 0);
+    XPORT x ={ .n = 1, .depth = 1, .kind = kind };
 
-        if (Finished)
-            break;
-        if (n < 0) {
-            LStat.r.no_errs++;
-            continue;
-        }
-        LStat.r.no_bytes += n;
-        LStat.r.no_msgs++;
-        if (Req.access_recv)
-            touch_data(buf, Req.msg_size);
-    }
-    stop_test_timer();
-    exchange_results();
-    free(buf);
-    close(sockFD);
+    xport_server_bw(&DatagramServerOps, &x, 0);
 }
 
 
@@ -479,39 +667,18 @@ datagram_server_bw(KIND kind)
 static void
 datagram_client_lat(KIND kind)
 {
-    char *buf;
-    int sockFD;
-
-    client_init(&sockFD, kind);
-    buf = qmalloc(Req.msg_size);
-    sync_test();
-    while (!Finished) {
-        int n = write(sockFD, buf, Req.msg_size);
+    XPORT x ={ .n = 1, .depth = 1, .kind = kind };
 
-        if (Finished)
-            break;
-        if (n < 0) {
-            LStat.s.no_errs++;
-            continue;
-        }
-        LStat.s.no_bytes += n;
-        LStat.s.no_msgs++;
+    if (Req.breakdown && kind == K_UDP) {
+        int fd;
 
-        n = read(sockFD, buf, Req.msg_size);
-        if (Finished)
-            break;
-        if (n < 0) {
-            LStat.r.no_errs++;
-            continue;
-        }
-        LStat.r.no_bytes += n;
-        LStat.r.no_msgs++;
+        client_init(&fd, 1, kind);
+        stamp_lat(fd, kind);
+        close(fd);
+        show_results(LATENCY);
+        return;
     }
-    stop_test_timer();
-    exchange_results();
-    free(buf);
-    close(sockFD);
-    show_results(LATENCY);
+    xport_client_lat(&DatagramClientOps, &x, 0);
 }
 
 
@@ -521,132 +688,979 @@ datagram_client_lat(KIND kind)
 static void
 datagram_server_lat(KIND kind)
 {
-    int sockfd;
-    char *buf = 0;
-
-    datagram_server_init(&sockfd, kind);
-    sync_test();
-    buf = qmalloc(Req.msg_size);
-    while (!Finished) {
-        SS clientAddr;
-        socklen_t clientLen = sizeof(clientAddr);
-        int n = recvfrom(sockfd, buf, Req.msg_size, 0,
-                         (SA *)&clientAddr, &clientLen);
+    XPORT x ={ .n = 1, .depth = 1, .kind = kind };
 
-        if (Finished)
-            break;
-        if (n < 0) {
-            LStat.r.no_errs++;
-            continue;
-        }
-        LStat.r.no_bytes += n;
-        LStat.r.no_msgs++;
+    if (Req.breakdown && kind == K_UDP) {
+        int fd;
 
-        n = sendto(sockfd, buf, Req.msg_size, 0, (SA *)&clientAddr, clientLen);
-        if (Finished)
-            break;
-        if (n < 0) {
-            LStat.s.no_errs++;
-            continue;
-        }
-        LStat.s.no_bytes += n;
-        LStat.s.no_msgs++;
+        datagram_server_init(&fd, kind);
+        stamp_lat(fd, kind);
+        close(fd);
+        return;
     }
-    stop_test_timer();
-    exchange_results();
-    free(buf);
-    close(sockfd);
+    xport_server_lat(&DatagramServerOps, &x, 0);
 }
 
 
 /*
- * Set default IP parameters and ensure that any that are set are being used.
+ * Make the connections of a stream transport.
  */
 static void
-ip_parameters(long msgSize)
+stream_connect(XPORT *x)
 {
-    setp_u32(0, L_MSG_SIZE, msgSize);
-    setp_u32(0, R_MSG_SIZE, msgSize);
-    par_use(L_PORT);
-    par_use(R_PORT);
-    par_use(L_SOCK_BUF_SIZE);
-    par_use(R_SOCK_BUF_SIZE);
-    opt_check();
+    int i;
+    int fds[XPORT_EPS];
+
+    if (x->n > XPORT_EPS)
+        error(0, "at most %d connections are supported", XPORT_EPS);
+    if (is_client())
+        client_init(fds, x->n, x->kind);
+    else
+        stream_server_init(fds, x->n, x->kind);
+    for (i = 0; i < x->n; ++i)
+        x->ep[i].fd = fds[i];
 }
 
 
 /*
- * Socket client initialization.
+ * Make the connections of a stream transport striped across rails.  They are
+ * non-blocking so that poll can keep whichever have room busy.
  */
 static void
-client_init(int *fd, KIND kind)
+rail_connect(XPORT *x)
 {
-    uint32_t rport;
-    AI *ai, *ailist;
+    int i;
 
-    client_send_request();
-    recv_mesg(&rport, sizeof(rport), "port");
-    rport = decode_uint32(&rport);
-    ailist = getaddrinfo_kind(0, kind, rport);
-    for (ai = ailist; ai; ai = ai->ai_next) {
-        if (!ai->ai_family)
-            continue;
-        *fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
-	setsockopt_one(*fd, SO_REUSEADDR);
-        if (connect(*fd, ai->ai_addr, ai->ai_addrlen) == SUCCESS0)
-            break;
-        close(*fd);
-    }
-    freeaddrinfo(ailist);
-    if (!ai)
-        error(0, "could not make %s connection to server", kind_name(kind));
-    if (Debug) {
-        uint32_t lport;
-        get_socket_port(*fd, &lport);
-        debug("sending from %s port %d to %d", kind_name(kind), lport, rport);
+    stream_connect(x);
+    for (i = 0; i < x->n; ++i) {
+        int fd = x->ep[i].fd;
+
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
     }
 }
 
 
 /*
- * Socket server initialization.
+ * Make the bulk and probe connections of a QoS test.  The third is put in
+ * the class of service under test.
  */
 static void
-stream_server_init(int *fd, KIND kind)
+qos_connect(XPORT *x)
 {
-    uint32_t port;
-    AI *ai;
-    int listenFD = -1;
+    rail_connect(x);
+    qos_set(x->ep[2].fd);
+}
 
-    AI *ailist = getaddrinfo_kind(1, kind,  Req.port);
-    for (ai = ailist; ai; ai = ai->ai_next) {
-        if (!ai->ai_family)
-            continue;
-        listenFD = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
-        if (listenFD < 0)
-            continue;
-        setsockopt_one(listenFD, SO_REUSEADDR);
-        if (bind(listenFD, ai->ai_addr, ai->ai_addrlen) == SUCCESS0)
-            break;
-        close(listenFD);
-        listenFD = -1;
+
+/*
+ * Set up a datagram socket.
+ */
+static void
+datagram_connect(XPORT *x)
+{
+    if (is_client())
+        client_init(&x->ep[0].fd, 1, x->kind);
+    else
+        datagram_server_init(&x->ep[0].fd, x->kind);
+}
+
+
+/*
+ * Close the sockets of a transport.
+ */
+static void
+socket_close(XPORT *x)
+{
+    int i;
+
+    for (i = 0; i < x->n; ++i)
+        if (x->ep[i].fd >= 0)
+            close(x->ep[i].fd);
+}
+
+
+/*
+ * Set up a stream that carries compressed messages.
+ */
+static void
+compress_connect(XPORT *x)
+{
+    compress_init();
+    ZBufLen = sizeof(uint32_t) + compress_bound(Req.msg_size);
+    ZBuf = qmalloc(ZBufLen);
+    stream_connect(x);
+}
+
+
+/*
+ * Close a stream that carries compressed messages.
+ */
+static void
+compress_close(XPORT *x)
+{
+    socket_close(x);
+    free(ZBuf);
+    compress_end();
+}
+
+
+/*
+ * Set up a TCP stream we receive from with zerocopy.
+ */
+static void
+zerocopy_connect(XPORT *x)
+{
+    stream_connect(x);
+    zerocopy_init(x->ep[0].fd);
+}
+
+
+/*
+ * Close a TCP stream we receive from with zerocopy.
+ */
+static void
+zerocopy_close(XPORT *x)
+{
+    zerocopy_end();
+    socket_close(x);
+}
+
+
+/*
+ * Send a message on a stream.
+ */
+static void
+stream_post_send(XPORT *x, int ep, void *buf, int len, int n)
+{
+    xport_sent(x, ep, buf, len, send_full(x->ep[ep].fd, buf, len));
+}
+
+
+/*
+ * Post a message to send on a rail and write what the rail has room for.
+ * Poll writes the rest.
+ */
+static void
+rail_post_send(XPORT *x, int ep, void *buf, int len, int n)
+{
+    XEP *e = &x->ep[ep];
+
+    e->sbuf = buf;
+    e->slen = len;
+    e->sdone = 0;
+    rail_write(e);
+}
+
+
+/*
+ * Write as much of the message posted on a rail as it has room for.
+ */
+static void
+rail_write(XEP *e)
+{
+    int m = write(e->fd, e->sbuf + e->sdone, e->slen - e->sdone);
+
+    if (m >= 0)
+        e->sdone += m;
+    else if (errno != EAGAIN) {
+        e->sdone = -1;
+        e->serr = errno;
+    }
+}
+
+
+/*
+ * Send a compressed message on a stream.
+ */
+static void
+compress_post_send(XPORT *x, int ep, void *buf, int len, int n)
+{
+    xport_sent(x, ep, buf, len, stream_send_z(&x->ep[ep], buf, len));
+}
+
+
+/*
+ * Send a datagram on a connected socket.
+ */
+static void
+datagram_post_write(XPORT *x, int ep, void *buf, int len, int n)
+{
+    xport_sent(x, ep, buf, len, write(x->ep[ep].fd, buf, len));
+}
+
+
+/*
+ * Send a datagram to the peer we last received from.
+ */
+static void
+datagram_post_sendto(XPORT *x, int ep, void *buf, int len, int n)
+{
+    XEP *e = &x->ep[ep];
+
+    xport_sent(x, ep, buf, len,
+               sendto(e->fd, buf, len, 0, (SA *)&e->addr, e->addrLen));
+}
+
+
+/*
+ * Poll a stream.
+ */
+static int
+stream_poll(XPORT *x, XCOMP *c, int n)
+{
+    return xport_poll_sync(x, c, stream_recv);
+}
+
+
+/*
+ * Poll the rails of a stream transport.  A send that finished as it was
+ * posted completes without waiting.
+ */
+static int
+rail_poll(XPORT *x, XCOMP *c, int n)
+{
+    int i;
+    int k = 0;
+    struct pollfd pfd[XPORT_EPS];
+
+    while (!k && !Finished) {
+        int wait = -1;
+
+        for (i = 0; i < x->n; ++i) {
+            XEP *e = &x->ep[i];
+
+            pfd[i].fd = e->fd;
+            pfd[i].events = e->rlen ? POLLIN : 0;
+            if (!e->slen)
+                continue;
+            if (e->sdone < 0 || e->sdone == e->slen)
+                wait = 0;
+            else
+                pfd[i].events |= POLLOUT;
+        }
+        if (poll(pfd, x->n, wait) < 0)
+            break;
+        k = rail_progress(x, c, n, pfd);
+    }
+    return k;
+}
+
+
+/*
+ * Write and read whatever the messages posted on the rails still need once
+ * poll finds them ready.  A message completes once all of it has been written
+ * or read.  We go from the last endpoint to the first so that the probes of a
+ * QoS test are not kept waiting behind the bulk load.
+ */
+static int
+rail_progress(XPORT *x, XCOMP *c, int n, struct pollfd *pfd)
+{
+    int i;
+    int k = 0;
+
+    for (i = x->n-1; i >= 0 && k < n; --i) {
+        int m;
+        XEP *e = &x->ep[i];
+        int ready = pfd[i].revents;
+
+        if (e->slen) {
+            if (ready && e->sdone >= 0 && e->sdone < e->slen)
+                rail_write(e);
+            if (e->sdone < 0 || e->sdone == e->slen) {
+                c[k++] = (XCOMP) {
+                    .ep   = i,
+                    .op   = X_SEND,
+                    .len  = e->sdone < 0 ? -1 : e->slen,
+                    .err  = e->sdone < 0 ? e->serr : 0,
+                    .data = e->sbuf
+                };
+                e->slen = 0;
+            }
+        }
+        if (ready && e->rlen && k < n) {
+            m = read(e->fd, e->rbuf + e->rdone, e->rlen - e->rdone);
+            if (m == 0) {
+                set_finished();
+                break;
+            }
+            if (m < 0 && errno == EAGAIN)
+                ;
+            else if (m < 0 || (e->rdone += m) == e->rlen) {
+                c[k++] = (XCOMP) {
+                    .ep   = i,
+                    .op   = X_RECV,
+                    .len  = m < 0 ? -1 : e->rlen,
+                    .err  = m < 0 ? errno : 0,
+                    .data = e->rbuf
+                };
+                e->rlen = 0;
+            }
+        }
+    }
+    return k;
+}
+
+
+/*
+ * Poll a stream that carries compressed messages.
+ */
+static int
+compress_poll(XPORT *x, XCOMP *c, int n)
+{
+    return xport_poll_sync(x, c, stream_recv_z);
+}
+
+
+/*
+ * Poll a TCP stream we receive from with zerocopy.
+ */
+static int
+zerocopy_poll(XPORT *x, XCOMP *c, int n)
+{
+    return xport_poll_sync(x, c, stream_recv_zc);
+}
+
+
+/*
+ * Poll a connected datagram socket.
+ */
+static int
+datagram_poll_read(XPORT *x, XCOMP *c, int n)
+{
+    return xport_poll_sync(x, c, datagram_read);
+}
+
+
+/*
+ * Poll a datagram socket, noting who each datagram came from.
+ */
+static int
+datagram_poll_recvfrom(XPORT *x, XCOMP *c, int n)
+{
+    return xport_poll_sync(x, c, datagram_recvfrom);
+}
+
+
+/*
+ * Receive a message on a stream.
+ */
+static int
+stream_recv(XEP *e, void *buf, int len)
+{
+    return recv_full(e->fd, buf, len);
+}
+
+
+/*
+ * Compress a message and send it on a stream preceded by its compressed size.
+ * We return the size before compression so that the bandwidth is that of the
+ * data the application sent.
+ */
+static int
+stream_send_z(XEP *e, void *buf, int len)
+{
+    uint32_t *hdr = (uint32_t *)ZBuf;
+    int n = compress_data(&hdr[1], ZBufLen-sizeof(*hdr), buf, len);
+
+    if (n < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    *hdr = htonl(n);
+    n = send_full(e->fd, ZBuf, sizeof(*hdr) + n);
+    if (n < 0)
+        return n;
+    LStat.comp_bytes += n;
+    return len;
+}
+
+
+/*
+ * Receive a compressed message on a stream and decompress it.
+ */
+static int
+stream_recv_z(XEP *e, void *buf, int len)
+{
+    uint32_t hdr;
+    int n = recv_full(e->fd, &hdr, sizeof(hdr));
+
+    if (n < (int)sizeof(hdr))
+        return n;
+    n = ntohl(hdr);
+    if (n > ZBufLen)
+        error(0, "compressed message too large: %d bytes", n);
+    if (recv_full(e->fd, ZBuf, n) < n)
+        return -1;
+    LStat.comp_bytes += sizeof(hdr) + n;
+    n = decompress_data(buf, len, ZBuf, n);
+    if (n < 0)
+        errno = EINVAL;
+    return n;
+}
+
+
+/*
+ * Set up to receive on a TCP socket by having the kernel map the pages
+ * holding the data into a region of our address space rather than copying
+ * them.  If the socket cannot be mapped, we note why and copy instead.
+ */
+static void
+zerocopy_init(int fd)
+{
+#ifdef TCP_ZEROCOPY_RECEIVE
+    void *p;
+
+    ZcPage = sysconf(_SC_PAGESIZE);
+    ZcLen = (Req.msg_size + ZcPage - 1) & ~(ZcPage - 1);
+    p = mmap(0, ZcLen, PROT_READ, MAP_SHARED, fd, 0);
+    if (p != MAP_FAILED) {
+        ZcMap = p;
+        return;
+    }
+    LStat.zc_error = errno;
+#else
+    LStat.zc_error = EOPNOTSUPP;
+#endif
+    debug("zerocopy receive unavailable: %s", strerror(LStat.zc_error));
+}
+
+
+/*
+ * Release the region zerocopy receive mapped pages into.
+ */
+static void
+zerocopy_end(void)
+{
+    if (!ZcMap)
+        return;
+    munmap(ZcMap, ZcLen);
+    ZcMap = 0;
+}
+
+
+/*
+ * Receive a message on a TCP stream, mapping as much of it as fills whole
+ * pages and copying the rest.  Once we are done with the mapped pages, we
+ * drop them so the kernel can recycle them rather than have them pinned
+ * until the next receive.  If the kernel refuses to map, we fall back to
+ * copying for the rest of the test.
+ */
+static int
+stream_recv_zc(XEP *e, void *buf, int len)
+{
+#ifdef TCP_ZEROCOPY_RECEIVE
+    int n = 0;
+    int waited = 0;
+
+    while (!Finished && n < len && ZcMap) {
+        struct tcp_zerocopy_receive zc ={
+            .address = (uintptr_t) ZcMap,
+            .length  = (len - n) & ~(ZcPage - 1),
+        };
+        socklen_t zcLen = sizeof(zc);
+        int want;
+
+        if (zc.length) {
+            if (getsockopt(e->fd, IPPROTO_TCP, TCP_ZEROCOPY_RECEIVE,
+                           &zc, &zcLen) < 0) {
+                if (errno == EINTR)
+                    continue;
+                LStat.zc_error = errno;
+                debug("zerocopy receive failed: %s", strerror(errno));
+                zerocopy_end();
+                break;
+            }
+            if (zc.length) {
+                if (Req.access_recv)
+                    touch_data(ZcMap, zc.length);
+                madvise(ZcMap, zc.length, MADV_DONTNEED);
+                LStat.zc_bytes += zc.length;
+                n += zc.length;
+                waited = 0;
+                continue;
+            }
+        }
+        if (zc.recv_skip_hint)
+            want = zc.recv_skip_hint;
+        else if (len - n >= ZcPage && !waited) {
+            struct pollfd pfd ={ .fd = e->fd, .events = POLLIN };
+
+            poll(&pfd, 1, -1);
+            waited = 1;
+            continue;
+        } else
+            want = len - n;
+        if (want > len - n)
+            want = len - n;
+        want = read(e->fd, buf + n, want);
+        if (want < 0)
+            return want;
+        if (want == 0)
+            set_finished();
+        n += want;
+        waited = 0;
+    }
+    return n + recv_full(e->fd, buf + n, len - n);
+#else
+    return recv_full(e->fd, buf, len);
+#endif
+}
+
+
+/*
+ * Receive a datagram on a connected socket.
+ */
+static int
+datagram_read(XEP *e, void *buf, int len)
+{
+    return read(e->fd, buf, len);
+}
+
+
+/*
+ * Receive a datagram and note who it came from.
+ */
+static int
+datagram_recvfrom(XEP *e, void *buf, int len)
+{
+    e->addrLen = sizeof(e->addr);
+    return recvfrom(e->fd, buf, len, 0, (SA *)&e->addr, &e->addrLen);
+}
+
+
+/*
+ * Measure latency, breaking the time of each message into stages.  If we may
+ * open the kernel tracepoints, trace_round splits the time in the kernel into
+ * system call crossings, send stack, receive stack and wakeup.  Otherwise we
+ * fall back to kernel software timestamps.  Transmit timestamps on the error
+ * queue give the time from a send call until the packet reaches the queueing
+ * discipline and from there until it is handed to the driver.  The receive
+ * timestamp gives the time from the packet arriving at the stack until the
+ * receive call returns, which includes waking us up.  We read the error queue
+ * after a message arrives, which adds a system call to each round trip.
+ */
+static void
+stamp_lat(int fd, KIND kind)
+{
+    char *buf;
+    uint64_t sent = 0;
+    int client = is_client();
+    int stream = (kind == K_TCP);
+    int trace = trace_init();
+    int flags = SOF_TIMESTAMPING_TX_SCHED | SOF_TIMESTAMPING_TX_SOFTWARE |
+                SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE |
+                SOF_TIMESTAMPING_OPT_TSONLY;
+
+    if (!trace &&
+        setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) < 0)
+        error(SYS, "failed to enable timestamps");
+    debug("breaking down latency with %s",
+          trace ? "tracepoints" : "timestamps");
+    buf = qmalloc(Req.msg_size);
+    sync_test();
+    while (!Finished) {
+        int n;
+        uint64_t t = 0;
+        uint64_t now;
+        uint64_t recv;
+        SS addr;
+        socklen_t addrLen = sizeof(addr);
+
+        if (client) {
+            if (Req.cold_cache)
+                flush_data(buf, Req.msg_size);
+            t = sample_time();
+            sent = trace ? get_nsecs() : stamp_time();
+            if (stream)
+                n = send_full(fd, buf, Req.msg_size);
+            else
+                n = write(fd, buf, Req.msg_size);
+            if (Finished)
+                break;
+            if (n < 0) {
+                LStat.s.no_errs++;
+                sample_add(t, 0, errno);
+                continue;
+            }
+            LStat.s.no_bytes += n;
+            LStat.s.no_msgs++;
+        }
+
+        if (Req.cold_cache)
+            flush_data(buf, Req.msg_size);
+        n = stamp_recv(fd, buf, Req.msg_size, stream, &addr, &addrLen, &recv);
+        now = trace ? get_nsecs() : stamp_time();
+        if (Finished)
+            break;
+        if (n < 0) {
+            LStat.r.no_errs++;
+            if (client)
+                sample_add(t, 0, errno);
+            continue;
+        }
+        LStat.r.no_bytes += n;
+        LStat.r.no_msgs++;
+        if (trace)
+            trace_round(sent, now);
+        else {
+            if (recv)
+                stage_add(S_RECV_STACK, now - recv);
+            if (sent)
+                stamp_sent(fd, sent);
+        }
+        if (client) {
+            stage_add(S_CYCLE, now - sent);
+            sample_add(t, n, 0);
+            continue;
+        }
+
+        t = sample_time();
+        service_wait();
+        if (Req.cold_cache)
+            flush_data(buf, Req.msg_size);
+        sent = trace ? get_nsecs() : stamp_time();
+        stage_add(S_CYCLE, sent - now);
+        if (stream)
+            n = send_full(fd, buf, Req.msg_size);
+        else
+            n = sendto(fd, buf, Req.msg_size, 0, (SA *)&addr, addrLen);
+        if (Finished)
+            break;
+        if (n < 0) {
+            LStat.s.no_errs++;
+            sample_add(t, 0, errno);
+            continue;
+        }
+        LStat.s.no_bytes += n;
+        LStat.s.no_msgs++;
+        sample_add(t, Req.msg_size, 0);
+    }
+    stop_test_timer();
+    exchange_results();
+    if (trace)
+        trace_end();
+    free(buf);
+}
+
+
+/*
+ * Receive a message noting when its first packet arrived at the stack.  If
+ * full is set, keep reading until we have the whole message.
+ */
+static int
+stamp_recv(int fd, void *buf, int len, int full, SS *addr, socklen_t *addrLen,
+           uint64_t *recv)
+{
+    int n = 0;
+
+    *recv = 0;
+    while (!Finished) {
+        int i;
+        char ctrl[256];
+        struct cmsghdr *cmsg;
+        struct iovec iov ={
+            .iov_base = buf + n,
+            .iov_len  = len - n
+        };
+        struct msghdr msg ={
+            .msg_name       = addr,
+            .msg_namelen    = *addrLen,
+            .msg_iov        = &iov,
+            .msg_iovlen     = 1,
+            .msg_control    = ctrl,
+            .msg_controllen = sizeof(ctrl)
+        };
+
+        i = recvmsg(fd, &msg, 0);
+        if (i < 0)
+            return i;
+        if (i == 0) {
+            set_finished();
+            break;
+        }
+        *addrLen = msg.msg_namelen;
+        for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            struct scm_timestamping *ts = (void *)CMSG_DATA(cmsg);
+
+            if (cmsg->cmsg_level != SOL_SOCKET ||
+                cmsg->cmsg_type != SCM_TIMESTAMPING || *recv)
+                continue;
+            *recv = ts->ts[0].tv_sec * 1000000000ULL + ts->ts[0].tv_nsec;
+        }
+        n += i;
+        if (!full || n == len)
+            break;
+    }
+    return n;
+}
+
+
+/*
+ * Read the transmit timestamps of the message we last sent, which was started
+ * at time sent, from the error queue.
+ */
+static void
+stamp_sent(int fd, uint64_t sent)
+{
+    uint64_t sched = 0;
+    uint64_t snd = 0;
+
+    for (;;) {
+        char ctrl[256];
+        uint64_t time = 0;
+        int type = -1;
+        struct cmsghdr *cmsg;
+        struct msghdr msg ={
+            .msg_control    = ctrl,
+            .msg_controllen = sizeof(ctrl)
+        };
+
+        if (recvmsg(fd, &msg, MSG_ERRQUEUE|MSG_DONTWAIT) < 0)
+            break;
+        for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET &&
+                cmsg->cmsg_type == SCM_TIMESTAMPING) {
+                struct scm_timestamping *ts = (void *)CMSG_DATA(cmsg);
+
+                time = ts->ts[0].tv_sec * 1000000000ULL + ts->ts[0].tv_nsec;
+            } else if ((cmsg->cmsg_level == IPPROTO_IP &&
+                        cmsg->cmsg_type == IP_RECVERR) ||
+                       (cmsg->cmsg_level == IPPROTO_IPV6 &&
+                        cmsg->cmsg_type == IPV6_RECVERR)) {
+                struct sock_extended_err *err = (void *)CMSG_DATA(cmsg);
+
+                if (err->ee_origin == SO_EE_ORIGIN_TIMESTAMPING)
+                    type = err->ee_info;
+            }
+        }
+        if (type == SCM_TSTAMP_SCHED)
+            sched = time;
+        else if (type == SCM_TSTAMP_SND)
+            snd = time;
+    }
+    if (sched)
+        stage_add(S_SEND_STACK, sched - sent);
+    if (sched && snd)
+        stage_add(S_SEND_QDISC, snd - sched);
+}
+
+
+/*
+ * Get the time in ns from the clock used by the kernel for timestamps.
+ */
+static uint64_t
+stamp_time(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+/*
+ * Note that the compression parameters are used in a stream bandwidth test
+ * and set the default compressibility of the data sent.
+ */
+static void
+compress_parameters(void)
+{
+    par_use(L_COMPRESS);
+    par_use(R_COMPRESS);
+    par_use(L_COMPRESS_LEVEL);
+    par_use(R_COMPRESS_LEVEL);
+    setp_u32(0, L_COMPRESS_PCT, DEF_COMPRESS_PCT);
+    setp_u32(0, R_COMPRESS_PCT, DEF_COMPRESS_PCT);
+}
+
+
+/*
+ * Set default IP parameters and ensure that any that are set are being used.
+ */
+static void
+ip_parameters(long msgSize)
+{
+    setp_u32(0, L_MSG_SIZE, msgSize);
+    setp_u32(0, R_MSG_SIZE, msgSize);
+    par_use(L_PORT);
+    par_use(R_PORT);
+    par_use(L_SOCK_BUF_SIZE);
+    par_use(R_SOCK_BUF_SIZE);
+    opt_check();
+}
+
+
+/*
+ * Socket client initialization.  We make n connections to the server, each
+ * over the corresponding rail if --rails was given.
+ */
+static void
+client_init(int *fds, int n, KIND kind)
+{
+    int i;
+    uint32_t rport;
+
+    client_send_request();
+    recv_mesg(&rport, sizeof(rport), "port");
+    rport = decode_uint32(&rport);
+    for (i = 0; i < n; ++i)
+        fds[i] = client_connect(i, kind, rport);
+    fault_sockets(fds, kind == K_TCP ? n : 0);
+    get_link_info(kind);
+}
+
+
+/*
+ * Connect to the server over a rail.  A rail is given as Local/Remote where
+ * Local is an address or interface to send from and Remote is the address of
+ * the server on that path.  Either may be omitted.
+ */
+static int
+client_connect(int rail, KIND kind, int rport)
+{
+    int fd = -1;
+    AI *ai, *ailist;
+    SS addr;
+    socklen_t addrLen = 0;
+    char local[STRSIZE] = "";
+    char remote[STRSIZE] = "";
+
+    if (Rails && rail < Req.rails) {
+        rail_spec(rail, local, remote, STRSIZE);
+        addrLen = rail_addr(local, &addr);
+    }
+    ailist = getaddrinfo_kind(0, remote[0] ? remote : ServerName, kind, rport);
+    for (ai = ailist; ai; ai = ai->ai_next) {
+        if (!ai->ai_family)
+            continue;
+        if (addrLen && kind != K_SDP && ai->ai_family != addr.ss_family)
+            continue;
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        setsockopt_one(fd, SO_REUSEADDR);
+        if (addrLen) {
+            if (bind(fd, (SA *)&addr, addrLen) < 0)
+                error(SYS, "cannot bind to %s", local);
+        } else if (local[0]) {
+            if (setsockopt(fd, SOL_SOCKET, SO_BINDTODEVICE,
+                           local, strlen(local)+1) < 0)
+                error(SYS, "cannot bind to device %s", local);
+        }
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == SUCCESS0)
+            break;
+        close(fd);
+    }
+    freeaddrinfo(ailist);
+    if (!ai) {
+        if (Rails && rail < Req.rails)
+            error(0, "could not make %s connection to server on rail %d",
+                                                        kind_name(kind), rail);
+        error(0, "could not make %s connection to server", kind_name(kind));
+    }
+    if (Debug) {
+        uint32_t lport;
+        get_socket_port(fd, &lport);
+        debug("sending from %s port %d to %d", kind_name(kind), lport, rport);
+    }
+    return fd;
+}
+
+
+/*
+ * Split a rail from --rails into its local and remote ends.
+ */
+static void
+rail_spec(int rail, char *local, char *remote, int len)
+{
+    int n;
+    char *p = Rails;
+    char *q;
+
+    while (rail-- > 0 && (p = strchr(p, ',')))
+        p++;
+    if (!p)
+        error(BUG, "missing rail");
+    n = strcspn(p, ",");
+    q = memchr(p, '/', n);
+    if (!q)
+        q = p + n;
+    if (q-p >= len || p+n-q > len)
+        error(0, "rail too long: %.*s", n, p);
+    memcpy(local, p, q-p);
+    local[q-p] = '\0';
+    if (q < p+n) {
+        memcpy(remote, q+1, p+n-q-1);
+        remote[p+n-q-1] = '\0';
+    }
+}
+
+
+/*
+ * If the local end of a rail is a numeric address, set addr to it and return
+ * its length; otherwise it is an interface and we return 0.
+ */
+static socklen_t
+rail_addr(char *local, SS *addr)
+{
+    AI *ai;
+    socklen_t len;
+    AI hints ={
+        .ai_flags    = AI_NUMERICHOST | AI_PASSIVE,
+        .ai_family   = AF_UNSPEC,
+        .ai_socktype = SOCK_STREAM
+    };
+
+    if (!local[0] || getaddrinfo(local, 0, &hints, &ai) != SUCCESS0)
+        return 0;
+    len = ai->ai_addrlen;
+    memcpy(addr, ai->ai_addr, len);
+    freeaddrinfo(ai);
+    return len;
+}
+
+
+/*
+ * Socket server initialization.  We accept n connections.
+ */
+static void
+stream_server_init(int *fds, int n, KIND kind)
+{
+    int i;
+    uint32_t port;
+    AI *ai;
+    int listenFD = -1;
+
+    AI *ailist = getaddrinfo_kind(1, 0, kind,  Req.port);
+    for (ai = ailist; ai; ai = ai->ai_next) {
+        if (!ai->ai_family)
+            continue;
+        listenFD = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (listenFD < 0)
+            continue;
+        setsockopt_one(listenFD, SO_REUSEADDR);
+        if (bind(listenFD, ai->ai_addr, ai->ai_addrlen) == SUCCESS0)
+            break;
+        close(listenFD);
+        listenFD = -1;
     }
     freeaddrinfo(ailist);
     if (!ai)
         error(0, "unable to make %s socket", kind_name(kind));
-    if (listen(listenFD, 1) < 0)
+    if (listen(listenFD, n) < 0)
         error(SYS, "listen failed");
 
     get_socket_port(listenFD, &port);
     encode_uint32(&port, port);
     send_mesg(&port, sizeof(port), "port");
-    *fd = accept(listenFD, 0, 0);
-    if (*fd < 0)
-        error(SYS, "accept failed");
-    debug("accepted %s connection", kind_name(kind));
-    set_socket_buffer_size(*fd);
+    for (i = 0; i < n; ++i) {
+        fds[i] = accept(listenFD, 0, 0);
+        if (fds[i] < 0)
+            error(SYS, "accept failed");
+        debug("accepted %s connection", kind_name(kind));
+        set_socket_buffer_size(fds[i]);
+    }
     close(listenFD);
     debug("receiving to %s port %d", kind_name(kind), port);
+    get_link_info(kind);
 }
 
 
@@ -660,7 +1674,7 @@ datagram_server_init(int *fd, KIND kind)
     AI *ai;
     int sockfd = -1;
 
-    AI *ailist = getaddrinfo_kind(1, kind, Req.port);
+    AI *ailist = getaddrinfo_kind(1, 0, kind, Req.port);
     for (ai = ailist; ai; ai = ai->ai_next) {
         if (!ai->ai_family)
             continue;
@@ -682,15 +1696,110 @@ datagram_server_init(int *fd, KIND kind)
     encode_uint32(&port, port);
     send_mesg(&port, sizeof(port), "port");
     *fd = sockfd;
+    get_link_info(kind);
+}
+
+
+/*
+ * Note the speed of the Ethernet link that carries the test and estimate the
+ * payload and wire bytes of each packet so that bandwidth can be compared with
+ * the wire rate.  For TCP, we assume full sized segments with timestamps; for
+ * UDP, one message per packet.  SDP does not use the Ethernet framing, so it
+ * is not estimated.
+ */
+static void
+get_link_info(KIND kind)
+{
+    int fd;
+    int mtu;
+    int speed;
+    int ip = 20;
+    int l4;
+    int payload;
+    int wire;
+    SS addr;
+    socklen_t addrLen = sizeof(addr);
+    struct ifreq ifr;
+
+    if (kind == K_SDP)
+        return;
+    memset(&ifr, 0, sizeof(ifr));
+    if (!nic_ifname(ifr.ifr_name, sizeof(ifr.ifr_name)))
+        return;
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+        return;
+    speed = ethtool_speed(fd, &ifr);
+    mtu = (ioctl(fd, SIOCGIFMTU, &ifr) == SUCCESS0) ? ifr.ifr_mtu : 0;
+    close(fd);
+    debug("link %s: speed %d Mb/s, mtu %d", ifr.ifr_name, speed, mtu);
+    if (speed <= 0 || mtu <= 0)
+        return;
+
+    if (getsockname(RemoteFD, (SA *)&addr, &addrLen) == SUCCESS0 &&
+        addr.ss_family == AF_INET6 &&
+        !IN6_IS_ADDR_V4MAPPED(&((struct sockaddr_in6 *)&addr)->sin6_addr))
+        ip = 40;
+    if (kind == K_TCP)
+        l4 = 32;
+    else if (kind == K_SCTP)
+        l4 = 28;
+    else
+        l4 = 8;
+    payload = mtu - ip - l4;
+    if (kind == K_UDP && Req.msg_size < payload)
+        payload = Req.msg_size;
+    wire = payload + ip + l4 + ETH_OVERHEAD;
+    if (wire < ETH_MIN_FRAME)
+        wire = ETH_MIN_FRAME;
+
+    LStat.link_speed = speed;
+    LStat.link_payload = payload;
+    LStat.link_wire = wire;
+}
+
+
+/*
+ * Get the speed of an Ethernet interface in Mb/s or 0 if it is not known.  We
+ * use ETHTOOL_GLINKSETTINGS, whose first call tells us the size of the link
+ * mode masks, and fall back to ETHTOOL_GSET on older kernels.
+ */
+static int
+ethtool_speed(int fd, struct ifreq *ifr)
+{
+    struct {
+        struct ethtool_link_settings req;
+        uint32_t                     maps[3 * 127];
+    } ecmd;
+    struct ethtool_cmd cmd;
+
+    memset(&ecmd, 0, sizeof(ecmd));
+    ecmd.req.cmd = ETHTOOL_GLINKSETTINGS;
+    ifr->ifr_data = (void *)&ecmd;
+    if (ioctl(fd, SIOCETHTOOL, ifr) == SUCCESS0 &&
+                                    ecmd.req.link_mode_masks_nwords < 0) {
+        ecmd.req.cmd = ETHTOOL_GLINKSETTINGS;
+        ecmd.req.link_mode_masks_nwords = -ecmd.req.link_mode_masks_nwords;
+        if (ioctl(fd, SIOCETHTOOL, ifr) == SUCCESS0)
+            return (int)ecmd.req.speed > 0 ? (int)ecmd.req.speed : 0;
+    }
+
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.cmd = ETHTOOL_GSET;
+    ifr->ifr_data = (void *)&cmd;
+    if (ioctl(fd, SIOCETHTOOL, ifr) == SUCCESS0)
+        return (int)ethtool_cmd_speed(&cmd) > 0 ? (int)ethtool_cmd_speed(&cmd)
+                                                : 0;
+    return 0;
 }
 
 
 /*
  * A version of getaddrinfo that takes a numeric port and prints out an error
- * on failure.
+ * on failure.  A client looks up host.
  */
 static AI *
-getaddrinfo_kind(int serverflag, KIND kind, int port)
+getaddrinfo_kind(int serverflag, char *host, KIND kind, int port)
 {
     AI *aip, *ailist;
     AI hints ={
@@ -706,7 +1815,7 @@ getaddrinfo_kind(int serverflag, KIND kind, int port)
     if (kind == K_UDP)
         hints.ai_socktype = SOCK_DGRAM;
 
-    ailist = getaddrinfo_port(serverflag ? 0 : ServerName, port, &hints);
+    ailist = getaddrinfo_port(serverflag ? 0 : host, port, &hints);
     for (aip = ailist; aip; aip = aip->ai_next) {
         if (kind == K_SDP) {
             if (aip->ai_family == AF_INET || aip->ai_family == AF_INET6)
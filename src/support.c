@@ -35,12 +35,15 @@
  */
 #define _GNU_SOURCE
 #include <errno.h>
+#include <fcntl.h>
 #include <netdb.h>
+#include <malloc.h>
 #include <stdio.h>
 #include <signal.h>
 #include <string.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/time.h>
 #include "qperf.h"
@@ -50,6 +53,8 @@
  * Configurable parameters.
  */
 #define ERROR_TIMEOUT   3               /* Error timeout in seconds */
+#define CACHE_LINE      64              /* Cache line size for flushing */
+#define EVICT_SIZE      (64*1024*1024)  /* Eviction buffer size */
 
 
 /*
@@ -63,7 +68,6 @@ typedef void (SIGFUNC)(int signo, siginfo_t *siginfo, void *ucontext);
  */
 static void     buf_app(char **pp, char *end, char *str);
 static void     buf_end(char **pp, char *end);
-static double   get_seconds(void);
 static void     remote_failure_error(void);
 static char    *remote_name(void);
 static int      send_recv_mesg(int sr, char *item, int fd, char *buf, int len);
@@ -206,6 +210,23 @@ qasprintf(char *fmt, ...)
 }
 
 
+/*
+ * Fault in a region of the heap and keep it so that later allocations of up to
+ * size bytes are satisfied from memory that is already mapped.
+ */
+void
+prefault_heap(long size)
+{
+    char *p;
+
+    mallopt(M_MMAP_THRESHOLD, size);
+    mallopt(M_TRIM_THRESHOLD, 2*size);
+    p = qmalloc(size);
+    memset(p, 0, size);
+    free(p);
+}
+
+
 /*
  * Touch data.
  */
@@ -228,6 +249,54 @@ touch_data(void *p, int n)
 }
 
 
+/*
+ * Evict data from the processor caches so that the next access to it misses.
+ * On x86 and ARM64, we flush each cache line; elsewhere we read through an
+ * eviction buffer larger than the caches.  The time taken is added to
+ * LStat.flush_ns so that it can be excluded from the results.
+ */
+void
+flush_data(void *p, int n)
+{
+    struct timespec s;
+    struct timespec e;
+
+    clock_gettime(CLOCK_MONOTONIC, &s);
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+    {
+        char *c = (char *)((unsigned long)p & ~(unsigned long)(CACHE_LINE-1));
+        char *l = (char *)p + n;
+
+        for (; c < l; c += CACHE_LINE) {
+#if defined(__aarch64__)
+            __asm__ __volatile__("dc civac, %0" : : "r" (c) : "memory");
+#else
+            __asm__ __volatile__("clflush %0" : "+m" (*(volatile char *)c));
+#endif
+        }
+#if defined(__aarch64__)
+        __asm__ __volatile__("dsb ish" : : : "memory");
+#else
+        __asm__ __volatile__("mfence" : : : "memory");
+#endif
+    }
+#else
+    {
+        static uint8_t *evict;
+
+        if (!evict) {
+            evict = qmalloc(EVICT_SIZE);
+            memset(evict, 0, EVICT_SIZE);
+        }
+        touch_data(evict, EVICT_SIZE);
+    }
+#endif
+    clock_gettime(CLOCK_MONOTONIC, &e);
+    LStat.flush_ns += (e.tv_sec - s.tv_sec) * 1000000000LL
+                    + (e.tv_nsec - s.tv_nsec);
+}
+
+
 /*
  * Synchronize the client and server.
  */
@@ -362,10 +431,24 @@ send_recv_mesg(int sr, char *item, int fd, char *buf, int len)
 }
 
 
+/*
+ * Get the monotonic time in nanoseconds.  This is read through the vDSO and
+ * does not make a system call.
+ */
+uint64_t
+get_nsecs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
 /*
  * Get the time of day in seconds as a floating point number.
  */
-static double
+double
 get_seconds(void)
 {
     struct timeval timeval;
@@ -410,6 +493,38 @@ setsockopt_one(int fd, int optname)
 }
 
 
+/*
+ * Read the first line of a file, typically in /proc or /sys, whose name is
+ * given by a format.  The trailing newline is removed.  Return 1 on success
+ * and 0 if the file cannot be read.
+ */
+int
+read_line(char *buf, int len, char *fmt, ...)
+{
+    int fd;
+    int n;
+    char *p;
+    char path[256];
+    va_list alist;
+
+    va_start(alist, fmt);
+    vsnprintf(path, sizeof(path), fmt, alist);
+    va_end(alist);
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 0;
+    n = read(fd, buf, len-1);
+    close(fd);
+    if (n <= 0)
+        return 0;
+    buf[n] = '\0';
+    p = strchr(buf, '\n');
+    if (p)
+        *p = '\0';
+    return 1;
+}
+
+
 /*
  * This is called when a SIGURG signal is received indicating that TCP
  * out-of-band data has arrived.  This is used by the remote end to indicate
@@ -482,7 +597,10 @@ urgent(void)
     timeout_end();
 
     buf_end(&p, q);
-    (void) write(2, buffer, p+1-buffer);
+    if (Library)
+        lib_error(buffer, p-buffer);
+    else
+        (void) write(2, buffer, p+1-buffer);
     die();
 }
 
@@ -510,7 +628,10 @@ remote_failure_error(void)
     buf_app(&p, q, remote_name());
     buf_app(&p, q, " failure");
     buf_end(&p, q);
-    (void) write(2, buffer, p+1-buffer);
+    if (Library)
+        lib_error(buffer, p-buffer);
+    else
+        (void) write(2, buffer, p+1-buffer);
     die();
 }
 
@@ -551,7 +672,10 @@ error(int actions, char *fmt, ...)
         buf_app(&p, q, strerror(errno));
     }
     buf_end(&p, q);
-    fwrite(buffer, 1, p+1-buffer, stdout);
+    if (Library)
+        lib_error(buffer, p-buffer);
+    else
+        fwrite(buffer, 1, p+1-buffer, stdout);
     if ((actions & RET) != 0)
         return 0;
 
@@ -664,10 +788,13 @@ debug(char *fmt, ...)
 
 
 /*
- * Exit unsuccessfully.
+ * Exit unsuccessfully.  When used as a library, we return to the caller
+ * instead.
  */
 void
 die(void)
 {
+    if (Library)
+        lib_die();
     exit(1);
 }
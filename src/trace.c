@@ -0,0 +1,438 @@
+/*
+ * qperf - kernel tracepoints for the latency breakdown.
+ * Measure socket and RDMA performance.
+ *
+ * Copyright (c) 2002-2009 Johann George.  All rights reserved.
+ * Copyright (c) 2006-2009 QLogic Corporation.  All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "qperf.h"
+
+
+/*
+ * Configurable parameters.
+ */
+#define TRACE_PAGES     8               /* Pages in each ring buffer */
+#define TRACE_EVENTS    512             /* Events kept for each message */
+
+
+/*
+ * The tracepoints we use.
+ */
+typedef enum {
+    TP_ENTER,                            /* System call entry */
+    TP_EXIT,                             /* System call exit */
+    TP_XMIT,                             /* Packet handed to the driver */
+    TP_RECV,                             /* Packet handed to the stack */
+    TP_WAKEUP,                           /* We were woken */
+    TP_SWITCH,                           /* We were switched to */
+    TP_N
+} TRACE_POINT;
+
+
+/*
+ * An event read from a ring buffer.
+ */
+typedef struct EVENT {
+    uint64_t    time;                   /* Time in ns */
+    int         point;                  /* Tracepoint */
+} EVENT;
+
+
+/*
+ * A ring buffer for the events of one processor.
+ */
+typedef struct RING {
+    int         fd[TP_N];                /* Events; the first owns the buffer */
+    void       *map;                    /* Mapped buffer */
+} RING;
+
+
+/*
+ * Function prototypes.
+ */
+static int      event_cmp(const void *a, const void *b);
+static int      point_id(char *name);
+static void     ring_close(RING *ring);
+static int      ring_open(RING *ring, int cpu, int tid);
+static void     ring_read(RING *ring, EVENT *ev, int *n);
+
+
+/*
+ * Tracepoints, the filters that restrict them to our thread and the
+ * tracepoint identifiers found at run time.  The syscall and transmit events
+ * are in our context; the receive and wakeup events are in whatever context
+ * the packet arrived in, so we watch every processor.
+ */
+static struct {
+    char       *name;
+    char       *filter;
+    int         id;
+} Points[TP_N] ={
+    { "raw_syscalls/sys_enter", "common_pid == %d" },
+    { "raw_syscalls/sys_exit",  "common_pid == %d" },
+    { "net/net_dev_xmit",       "common_pid == %d" },
+    { "net/netif_receive_skb",  0                  },
+    { "sched/sched_wakeup",     "pid == %d"        },
+    { "sched/sched_switch",     "next_pid == %d"   },
+};
+
+
+/*
+ * Static variables.
+ */
+static EVENT   *Events;
+static size_t   RingLen;
+static int      RingN;
+static RING    *Rings;
+
+
+/*
+ * Open the tracepoints on every processor.  Times are taken from the same
+ * clock as get_nsecs so that we can compare them with our own.  Return 0 if
+ * we cannot trace, which normally means we are not privileged enough.
+ */
+int
+trace_init(void)
+{
+    int c;
+    int p;
+    int tid = syscall(SYS_gettid);
+    int ncpu = sysconf(_SC_NPROCESSORS_CONF);
+
+    for (p = 0; p < TP_N; ++p) {
+        Points[p].id = point_id(Points[p].name);
+        if (Points[p].id < 0) {
+            debug("cannot find tracepoint %s", Points[p].name);
+            return 0;
+        }
+    }
+
+    RingLen = (TRACE_PAGES+1) * sysconf(_SC_PAGESIZE);
+    Rings = qmalloc(ncpu * sizeof(*Rings));
+    Events = qmalloc(TRACE_EVENTS * sizeof(*Events));
+    RingN = 0;
+    for (c = 0; c < ncpu; ++c) {
+        if (ring_open(&Rings[RingN], c, tid) == 0)
+            RingN++;
+        else if (errno != ENODEV) {
+            debug("cannot trace cpu %d: %s", c, strerror(errno));
+            trace_end();
+            return 0;
+        }
+    }
+    if (!RingN) {
+        trace_end();
+        return 0;
+    }
+    trace_round(0, 0);
+    return 1;
+}
+
+
+/*
+ * Open the tracepoints on one processor.  All share one ring buffer.  Return
+ * -1 with errno set on failure.  A processor that is offline gives ENODEV.
+ */
+static int
+ring_open(RING *ring, int cpu, int tid)
+{
+    int p;
+
+    memset(ring, 0, sizeof(*ring));
+    for (p = 0; p < TP_N; ++p)
+        ring->fd[p] = -1;
+    for (p = 0; p < TP_N; ++p) {
+        int fd;
+        char filter[64];
+        struct perf_event_attr attr;
+
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_TRACEPOINT;
+        attr.config = Points[p].id;
+        attr.sample_period = 1;
+        attr.sample_type = PERF_SAMPLE_TIME | PERF_SAMPLE_RAW;
+        attr.use_clockid = 1;
+        attr.clockid = CLOCK_MONOTONIC;
+        fd = syscall(SYS_perf_event_open, &attr, -1, cpu, -1, 0);
+        if (fd < 0)
+            goto err;
+        ring->fd[p] = fd;
+        if (Points[p].filter) {
+            snprintf(filter, sizeof(filter), Points[p].filter, tid);
+            if (ioctl(fd, PERF_EVENT_IOC_SET_FILTER, filter) < 0)
+                goto err;
+        }
+        if (p == 0) {
+            ring->map = mmap(0, RingLen, PROT_READ|PROT_WRITE, MAP_SHARED,
+                             fd, 0);
+            if (ring->map == MAP_FAILED) {
+                ring->map = 0;
+                goto err;
+            }
+        } else if (ioctl(fd, PERF_EVENT_IOC_SET_OUTPUT, ring->fd[0]) < 0)
+            goto err;
+    }
+    return 0;
+
+err:
+    {
+        int e = errno;
+
+        ring_close(ring);
+        errno = e;
+    }
+    return -1;
+}
+
+
+/*
+ * Close the tracepoints of a processor.
+ */
+static void
+ring_close(RING *ring)
+{
+    int p;
+
+    if (ring->map)
+        munmap(ring->map, RingLen);
+    for (p = 0; p < TP_N; ++p)
+        if (ring->fd[p] >= 0)
+            close(ring->fd[p]);
+}
+
+
+/*
+ * Find the identifier of a tracepoint.
+ */
+static int
+point_id(char *name)
+{
+    int i;
+    static char *dirs[] ={
+        "/sys/kernel/tracing/events",
+        "/sys/kernel/debug/tracing/events",
+    };
+
+    for (i = 0; i < cardof(dirs); ++i) {
+        char buf[32];
+
+        if (read_line(buf, sizeof(buf), "%s/%s/id", dirs[i], name))
+            return atoi(buf);
+    }
+    return -1;
+}
+
+
+/*
+ * Close the tracepoints.
+ */
+void
+trace_end(void)
+{
+    int i;
+
+    for (i = 0; i < RingN; ++i)
+        ring_close(&Rings[i]);
+    free(Rings);
+    free(Events);
+    Rings = 0;
+    Events = 0;
+    RingN = 0;
+}
+
+
+/*
+ * Break down the time of a message that we started sending at time sent and
+ * of the reply that we finished receiving at time done.  On the server, the
+ * message is the reply we last sent and sent is 0 for the first request.  The
+ * events since the last call are, in order:
+ *
+ *   g  entry to the system call that sends
+ *   h  the packet being handed to the driver
+ *   a  the reply being handed to the stack
+ *   b  us being woken, if we slept
+ *   c  us being switched to
+ *   d  exit from the system call that receives
+ *
+ * The time from sent to g and from d to done is spent crossing into and out
+ * of the kernel, from g to h is the send stack, from a to b and c to d is the
+ * receive stack and from b to c is the wakeup.  Events that do not fit are
+ * left out, as are their stages.
+ */
+void
+trace_round(uint64_t sent, uint64_t done)
+{
+    int i;
+    int n = 0;
+    uint64_t floor;
+    uint64_t g = 0, h = 0, a = 0, b = 0, c = 0, d = 0, e = 0;
+
+    for (i = 0; i < RingN; ++i)
+        ring_read(&Rings[i], Events, &n);
+    if (!done)
+        return;
+    qsort(Events, n, sizeof(*Events), event_cmp);
+
+    for (i = 0; sent && i < n; ++i) {
+        EVENT *ev = &Events[i];
+
+        if (ev->time < sent || ev->time > done)
+            continue;
+        if (!g) {
+            if (ev->point == TP_ENTER)
+                g = ev->time;
+        } else if (ev->point == TP_XMIT) {
+            h = ev->time;
+            break;
+        } else if (ev->point == TP_EXIT)
+            break;
+    }
+
+    floor = h ? h : sent;
+    for (i = n-1; i >= 0; --i) {
+        EVENT *ev = &Events[i];
+
+        if (ev->time > done)
+            continue;
+        if (ev->time < floor)
+            break;
+        if (!d) {
+            if (ev->point == TP_EXIT)
+                d = ev->time;
+        } else if (ev->point == TP_ENTER && !e && !c)
+            e = ev->time;
+        else if (ev->point == TP_SWITCH && !c && !b)
+            c = ev->time;
+        else if (ev->point == TP_WAKEUP && c && !b)
+            b = ev->time;
+        else if (ev->point == TP_RECV && !a) {
+            a = ev->time;
+            break;
+        }
+    }
+
+    if (sent && g && d)
+        stage_add(S_SYSCALL, (g - sent) + (done - d));
+    if (g && h)
+        stage_add(S_SEND_STACK, h - g);
+    if (!a || !d)
+        return;
+    if (b && c) {
+        stage_add(S_RECV_STACK, (b - a) + (d - c));
+        stage_add(S_WAKEUP, c - b);
+    } else {
+        stage_add(S_RECV_STACK, d - (e > a ? e : a));
+        stage_add(S_WAKEUP, 0);
+    }
+}
+
+
+/*
+ * Read the events in a ring buffer, adding those that fit to ev.
+ */
+static void
+ring_read(RING *ring, EVENT *ev, int *n)
+{
+    uint64_t head;
+    uint64_t tail;
+    struct perf_event_mmap_page *page = ring->map;
+    long pagesize = sysconf(_SC_PAGESIZE);
+    uint8_t *data = (uint8_t *)ring->map + pagesize;
+    uint64_t size = RingLen - pagesize;
+
+    head = page->data_head;
+    __sync_synchronize();
+    for (tail = page->data_tail; tail < head;) {
+        uint64_t rec[8];
+        struct perf_event_header *hdr = (void *)rec;
+        uint64_t off = tail % size;
+        int rlen;
+
+        memcpy(hdr, &data[off], sizeof(*hdr));
+        rlen = hdr->size;
+        if (!rlen)
+            break;
+        tail += rlen;
+        if (hdr->type != PERF_RECORD_SAMPLE || *n >= TRACE_EVENTS)
+            continue;
+        if (rlen > sizeof(rec))
+            rlen = sizeof(rec);
+        if (off + rlen <= size)
+            memcpy(rec, &data[off], rlen);
+        else {
+            memcpy(rec, &data[off], size-off);
+            memcpy((uint8_t *)rec + size-off, data, rlen - (size-off));
+        }
+
+        /* Time, then the size of the raw data and the tracepoint id */
+        {
+            int p;
+            uint16_t id;
+
+            memcpy(&id, (uint8_t *)&rec[2] + sizeof(uint32_t), sizeof(id));
+            for (p = 0; p < TP_N; ++p)
+                if (Points[p].id == id)
+                    break;
+            if (p == TP_N)
+                continue;
+            ev[*n].time = rec[1];
+            ev[*n].point = p;
+            ++*n;
+        }
+    }
+    __sync_synchronize();
+    page->data_tail = head;
+}
+
+
+/*
+ * Compare two events by time.
+ */
+static int
+event_cmp(const void *a, const void *b)
+{
+    const EVENT *x = a;
+    const EVENT *y = b;
+
+    return (x->time > y->time) - (x->time < y->time);
+}
@@ -0,0 +1,1103 @@
+/*
+ * qperf - handle AF_XDP tests.
+ *
+ * Copyright (c) 2002-2009 Johann George.  All rights reserved.
+ * Copyright (c) 2006-2009 QLogic Corporation.  All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#ifdef HAVE_LINUX_IF_XDP_H
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+#endif
+#include "qperf.h"
+#include "xport.h"
+
+
+#ifdef HAVE_LINUX_IF_XDP_H
+/*
+ * Parameters.
+ */
+#define XDP_QUEUES  64                  /* Most receive queues we bind to */
+#define XDP_RX      1024                /* Frames to receive into per queue */
+#define XDP_TX      2048                /* Frames to send from on queue 0 */
+#define XDP_FRAME   4096                /* Size of a frame */
+#define XDP_RING    2048                /* Descriptors in each ring */
+#define XDP_BATCH   64                  /* Descriptors moved at a time */
+#define HDR_LEN     42                  /* Ethernet, IPv4 and UDP headers */
+#define DEF_BW_SIZE 64                  /* Default message size for xdp_bw */
+
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+
+/*
+ * Modes we can run in.  In skb (generic) mode, the XDP program runs after the
+ * kernel has built a socket buffer and frames are copied; it works with any
+ * interface.  The others need driver support for XDP and, for zc, for
+ * AF_XDP zero-copy.
+ */
+typedef enum {
+    XM_ZC,
+    XM_COPY,
+    XM_SKB,
+    XM_N
+} XDP_MODE;
+
+static char *XdpModes[] ={ "zc", "copy", "skb" };
+
+
+/*
+ * A ring shared with the kernel.
+ */
+typedef struct RING {
+    uint32_t   *prod;                   /* Producer index */
+    uint32_t   *cons;                   /* Consumer index */
+    uint32_t   *flags;                  /* Flags such as need wakeup */
+    void       *desc;                   /* Descriptors */
+    uint32_t    mask;                   /* Number of descriptors - 1 */
+    void       *map;                    /* Mapping */
+    size_t      mapLen;                 /* Size of mapping */
+} RING;
+
+
+/*
+ * An AF_XDP socket bound to one receive queue with a UMEM of its own.  The
+ * first XDP_RX frames of the UMEM are received into.  Only the socket on queue
+ * 0 sends, from XDP_TX more frames.
+ */
+typedef struct XSK {
+    int         fd;                     /* Socket */
+    char       *umem;                   /* UMEM */
+    size_t      umemLen;                /* Size of UMEM */
+    RING        rx;                     /* Receive ring */
+    RING        tx;                     /* Send ring */
+    RING        fill;                   /* Fill ring */
+    RING        comp;                   /* Completion ring */
+} XSK;
+
+
+/*
+ * The address of a node as it appears in the frames we build.  Every field
+ * is in network order so it can be sent to our peer as it is.
+ */
+typedef struct XDP_ADDR {
+    uint8_t     mac[ETH_ALEN];          /* Ethernet address */
+    uint8_t     ip[4];                  /* IPv4 address */
+    uint8_t     port[2];                /* UDP port */
+} XDP_ADDR;
+
+
+/*
+ * Function prototypes.
+ */
+static int      bpf(int cmd, union bpf_attr *attr);
+static void     frame_build(XDP_ADDR *self, XDP_ADDR *peer);
+static uint16_t ip_checksum(uint8_t *p, int n);
+static int      prog_attach(int ifindex, XDP_MODE mode);
+static int      prog_load(uint8_t *port);
+static int      queue_count(char *ifname);
+static void     ring_map(RING *ring, int fd, struct xdp_ring_offset *off,
+                         off_t pgoff, int size);
+static uint32_t ring_peek(RING *ring, uint32_t *idx, uint32_t max);
+static void     ring_release(RING *ring, uint32_t n);
+static uint32_t ring_reserve(RING *ring, uint32_t *idx, uint32_t max);
+static void     ring_submit(RING *ring, uint32_t n);
+static void     set_parameters(long msgSize);
+static void     socket_close(XSK *s);
+static void     xdp_close(XPORT *x);
+static void     xdp_complete(void);
+static void     xdp_connect(XPORT *x);
+static void     xdp_connect_tx(XPORT *x);
+static void     xdp_fill(XSK *s, uint64_t *addrs, uint32_t n);
+static void     xdp_init(int rx);
+static void     xdp_kick(void);
+static XSK     *xdp_peek(uint32_t *idx, uint32_t max, uint32_t *n);
+static int      xdp_poll(XPORT *x, XCOMP *c, int n);
+static void     xdp_post_copy(XPORT *x, int ep, void *buf, int len, int n);
+static void     xdp_post_recv(XPORT *x, int ep, void *buf, int len, int n);
+static void     xdp_post_send(XPORT *x, int ep, void *buf, int len, int n);
+static void     xdp_self(char *ifname, XDP_ADDR *self);
+static int      xdp_socket(XSK *s, int ifindex, int queue, XDP_MODE mode);
+static void     xdp_submit(void);
+static void     xdp_wait(void);
+
+
+/*
+ * Transport operations.  When we only send, as the client of xdp_bw does, the
+ * frames are built before the test starts so that posting a send only moves
+ * descriptors.  Otherwise each message is copied into a frame.
+ */
+static const XPORT_OPS XdpTxOps ={
+    .connect   = xdp_connect_tx,
+    .post_send = xdp_post_send,
+    .post_recv = xdp_post_recv,
+    .poll      = xdp_poll,
+    .close     = xdp_close,
+};
+
+static const XPORT_OPS XdpOps ={
+    .connect   = xdp_connect,
+    .post_send = xdp_post_copy,
+    .post_recv = xdp_post_recv,
+    .poll      = xdp_poll,
+    .close     = xdp_close,
+};
+
+
+/*
+ * Static variables.
+ */
+static int      XdpLink = -1;
+static int      XdpMap = -1;
+static int      XdpProg = -1;
+static int      XdpPortFd = -1;
+static XSK      Xsks[XDP_QUEUES];
+static int      XskN;
+static int      XskNext;
+static int      XdpRx;
+static uint64_t TxFree[XDP_TX];
+static int      TxFreeN;
+static int      TxOwed;
+static int      TxDone;
+static XSK     *RxSock;
+static uint64_t RxAddrs[XDP_BATCH];
+static int      RxN;
+static uint8_t  Header[HDR_LEN];
+
+
+/*
+ * Measure AF_XDP bandwidth (client side).
+ */
+void
+run_client_xdp_bw(void)
+{
+    XPORT x ={ .n = 1, .depth = XDP_TX };
+
+    par_use(L_ACCESS_RECV);
+    par_use(R_ACCESS_RECV);
+    set_parameters(DEF_BW_SIZE);
+    client_send_request();
+    xport_client_bw(&XdpTxOps, &x, 0, MSG_RATE);
+}
+
+
+/*
+ * Measure AF_XDP bandwidth (server side).  Frames are handed back to the fill
+ * ring as soon as they are counted; they are only read with --access_recv.
+ */
+void
+run_server_xdp_bw(void)
+{
+    XPORT x ={ .n = 1, .depth = 1 };
+
+    xport_server_bw(&XdpOps, &x, 0);
+}
+
+
+/*
+ * Measure AF_XDP latency (client side).
+ */
+void
+run_client_xdp_lat(void)
+{
+    XPORT x ={ .n = 1, .depth = 1 };
+
+    par_use(L_COLD_CACHE);
+    par_use(R_COLD_CACHE);
+    par_use(L_SAMPLES);
+    par_use(R_SAMPLES);
+    par_use(R_SERVICE_DIST);
+    par_use(R_SERVICE_TIME);
+    par_use(R_SERVICE_TOUCH);
+    set_parameters(1);
+    client_send_request();
+    xport_client_lat(&XdpOps, &x, 0);
+}
+
+
+/*
+ * Measure AF_XDP latency (server side).
+ */
+void
+run_server_xdp_lat(void)
+{
+    XPORT x ={ .n = 1, .depth = 1 };
+
+    xport_server_lat(&XdpOps, &x, 0);
+}
+
+
+/*
+ * Set default parameters and ensure that any that are set are being used.
+ */
+static void
+set_parameters(long msgSize)
+{
+    setp_u32(0, L_MSG_SIZE, msgSize);
+    setp_u32(0, R_MSG_SIZE, msgSize);
+    par_use(L_PORT);
+    par_use(R_PORT);
+    par_use(L_XDP_MODE);
+    par_use(R_XDP_MODE);
+    opt_check();
+}
+
+
+/*
+ * Open AF_XDP sockets on the interface that routes to our peer and exchange
+ * addresses with it.  If we only send, one socket on queue 0 is enough.  If we
+ * receive, we bind a socket to every receive queue, since RSS may put the
+ * test's packets on any of them, and attach a program that redirects the UDP
+ * port we reserved to the socket of the queue a packet arrived on and passes
+ * everything else, including our own connection to the peer, to the kernel.
+ * Without --xdp_mode, we try zero-copy, then driver copy mode and then skb
+ * mode.
+ */
+static void
+xdp_init(int rx)
+{
+    int i;
+    int q;
+    int err = 0;
+    int ifindex;
+    int queues = 1;
+    XDP_ADDR peer;
+    XDP_ADDR self;
+    XDP_MODE mode;
+    XDP_MODE first = 0;
+    XDP_MODE last = XM_N - 1;
+    char ifname[IFNAMSIZ];
+
+    if (Req.xdp_mode[0]) {
+        for (first = 0; first < XM_N; ++first)
+            if (streq(Req.xdp_mode, XdpModes[first]))
+                break;
+        if (first == XM_N)
+            error(0, "XDP mode must be skb, copy or zc: %s", Req.xdp_mode);
+        last = first;
+    }
+    if (!nic_ifname(ifname, sizeof(ifname)))
+        error(0, "cannot find the interface to use for AF_XDP");
+    ifindex = if_nametoindex(ifname);
+    if (!ifindex)
+        error(SYS, "%s: cannot find interface", ifname);
+    if (rx) {
+        queues = queue_count(ifname);
+        if (queues > XDP_QUEUES)
+            error(0, "%s: %d receive queues; at most %d are supported, "
+                     "reduce them with ethtool -L", ifname, queues, XDP_QUEUES);
+    }
+    for (q = 0; q < XDP_QUEUES; ++q)
+        Xsks[q].fd = -1;
+    xdp_self(ifname, &self);
+    send_mesg(&self, sizeof(self), "XDP address");
+    recv_mesg(&peer, sizeof(peer), "XDP address");
+    frame_build(&self, &peer);
+
+    if (rx) {
+        union bpf_attr attr ={
+            .map_type    = BPF_MAP_TYPE_XSKMAP,
+            .key_size    = sizeof(uint32_t),
+            .value_size  = sizeof(uint32_t),
+            .max_entries = queues,
+        };
+
+        XdpMap = bpf(BPF_MAP_CREATE, &attr);
+        if (XdpMap < 0)
+            error(SYS, "failed to create XSKMAP");
+        XdpProg = prog_load(self.port);
+    }
+    for (mode = first; mode <= last; ++mode) {
+        if (rx && (err = prog_attach(ifindex, mode)) != 0)
+            continue;
+        for (q = 0; q < queues; ++q)
+            if ((err = xdp_socket(&Xsks[q], ifindex, q, mode)) != 0)
+                break;
+        if (!err)
+            break;
+        while (q-- > 0)
+            socket_close(&Xsks[q]);
+        if (XdpLink >= 0) {
+            close(XdpLink);
+            XdpLink = -1;
+        }
+    }
+    if (err == EBUSY)
+        error(0, "%s: already in use by XDP; the nodes must not share it",
+                 ifname);
+    if (err) {
+        errno = err;
+        if (first == last)
+            error(SYS, "%s: cannot use AF_XDP in %s mode", ifname,
+                       XdpModes[first]);
+        error(SYS, "%s: cannot use AF_XDP", ifname);
+    }
+    XskN = queues;
+    XskNext = 0;
+    XdpRx = rx;
+    TxOwed = TxDone = RxN = 0;
+    debug("AF_XDP on %s queues 0-%d in %s mode", ifname, queues-1,
+                                                        XdpModes[mode]);
+    snprintf(LStat.xdp_mode, sizeof(LStat.xdp_mode), "%s", XdpModes[mode]);
+
+    for (q = 0; rx && q < queues; ++q) {
+        uint32_t key = q;
+        union bpf_attr attr ={
+            .map_fd = XdpMap,
+            .key    = (uintptr_t) &key,
+            .value  = (uintptr_t) &Xsks[q].fd,
+        };
+
+        if (bpf(BPF_MAP_UPDATE_ELEM, &attr) < 0)
+            error(SYS, "failed to add AF_XDP socket to XSKMAP");
+    }
+
+    for (i = 0; i < XDP_TX; ++i) {
+        uint64_t addr = (uint64_t)(XDP_RX + i) * XDP_FRAME;
+
+        memcpy(Xsks[0].umem + addr, Header, HDR_LEN);
+        TxFree[TxFreeN++] = addr;
+    }
+    for (q = 0; q < queues; ++q) {
+        for (i = 0; i < XDP_RX; i += XDP_BATCH) {
+            int j;
+            uint64_t addrs[XDP_BATCH];
+
+            for (j = 0; j < XDP_BATCH; ++j)
+                addrs[j] = (uint64_t)(i + j) * XDP_FRAME;
+            xdp_fill(&Xsks[q], addrs, XDP_BATCH);
+        }
+    }
+}
+
+
+/*
+ * Return the number of receive queues of an interface.
+ */
+static int
+queue_count(char *ifname)
+{
+    int n = 0;
+    struct dirent *d;
+    char path[PATH_MAX];
+    DIR *dir;
+
+    snprintf(path, sizeof(path), "/sys/class/net/%s/queues", ifname);
+    dir = opendir(path);
+    if (!dir)
+        return 1;
+    while ((d = readdir(dir)) != 0)
+        if (strncmp(d->d_name, "rx-", 3) == 0)
+            ++n;
+    closedir(dir);
+    return n ? n : 1;
+}
+
+
+/*
+ * Find the Ethernet and IPv4 addresses of an interface and reserve a UDP port
+ * on it so that no one else receives on the port our program redirects.
+ */
+static void
+xdp_self(char *ifname, XDP_ADDR *self)
+{
+    int fd;
+    struct ifreq ifr;
+    struct sockaddr_in sin ={
+        .sin_family = AF_INET,
+        .sin_port   = htons(is_client() ? 0 : Req.port),
+    };
+    socklen_t sinLen = sizeof(sin);
+
+    memset(self, 0, sizeof(*self));
+    memset(&ifr, 0, sizeof(ifr));
+    snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", ifname);
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+        error(SYS, "socket failed");
+    if (ioctl(fd, SIOCGIFMTU, &ifr) < 0)
+        error(SYS, "%s: cannot get MTU", ifname);
+    if (Req.msg_size + HDR_LEN - ETH_HLEN > (uint32_t)ifr.ifr_mtu ||
+        Req.msg_size + HDR_LEN > XDP_FRAME - XDP_PACKET_HEADROOM)
+        error(0, "message size %d too large for a frame on %s",
+                 Req.msg_size, ifname);
+    if (ioctl(fd, SIOCGIFHWADDR, &ifr) < 0)
+        error(SYS, "%s: cannot get Ethernet address", ifname);
+    memcpy(self->mac, ifr.ifr_hwaddr.sa_data, ETH_ALEN);
+    if (ioctl(fd, SIOCGIFADDR, &ifr) < 0)
+        error(SYS, "%s: AF_XDP tests need an IPv4 address", ifname);
+    memcpy(self->ip, &((struct sockaddr_in *)&ifr.ifr_addr)->sin_addr, 4);
+
+    if (bind(fd, (SA *)&sin, sizeof(sin)) < 0)
+        error(SYS, "bind UDP failed");
+    if (getsockname(fd, (SA *)&sin, &sinLen) < 0)
+        error(SYS, "getsockname failed");
+    memcpy(self->port, &sin.sin_port, 2);
+    XdpPortFd = fd;
+}
+
+
+/*
+ * Build the Ethernet, IPv4 and UDP headers of the frames we send.  The UDP
+ * checksum is optional for IPv4 and left as 0.
+ */
+static void
+frame_build(XDP_ADDR *self, XDP_ADDR *peer)
+{
+    uint8_t *h = Header;
+    int ipLen = HDR_LEN - ETH_HLEN + Req.msg_size;
+    int udpLen = ipLen - 20;
+    uint16_t sum;
+
+    memcpy(&h[0], peer->mac, ETH_ALEN);
+    memcpy(&h[6], self->mac, ETH_ALEN);
+    h[12] = ETH_P_IP >> 8;
+    h[13] = ETH_P_IP & 0xff;
+    h[14] = 0x45;
+    h[15] = 0;
+    h[16] = ipLen >> 8;
+    h[17] = ipLen & 0xff;
+    h[18] = h[19] = 0;
+    h[20] = 0x40;
+    h[21] = 0;
+    h[22] = 64;
+    h[23] = IPPROTO_UDP;
+    h[24] = h[25] = 0;
+    memcpy(&h[26], self->ip, 4);
+    memcpy(&h[30], peer->ip, 4);
+    sum = ip_checksum(&h[14], 20);
+    memcpy(&h[24], &sum, 2);
+    memcpy(&h[34], self->port, 2);
+    memcpy(&h[36], peer->port, 2);
+    h[38] = udpLen >> 8;
+    h[39] = udpLen & 0xff;
+    h[40] = h[41] = 0;
+}
+
+
+/*
+ * Compute an IP header checksum.  The result is in network order.
+ */
+static uint16_t
+ip_checksum(uint8_t *p, int n)
+{
+    uint32_t sum = 0;
+
+    for (; n > 1; n -= 2, p += 2)
+        sum += (p[0] << 8) | p[1];
+    while (sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+    return htons(~sum & 0xffff);
+}
+
+
+/*
+ * Load an XDP program that redirects IPv4 UDP packets sent to our port to the
+ * AF_XDP socket bound to the queue they arrived on and passes the rest.
+ */
+static int
+prog_load(uint8_t *port)
+{
+    int fd;
+    uint16_t dport;
+    char log[4096];
+#define INSN(c, d, s, o, i) \
+    ((struct bpf_insn){ .code = (c), .dst_reg = (d), .src_reg = (s), \
+                        .off = (o), .imm = (i) })
+    struct bpf_insn prog[] ={
+        /* r6 = ctx; r2 = data; r3 = data_end */
+        INSN(BPF_ALU64|BPF_MOV|BPF_X, 6, 1, 0, 0),
+        INSN(BPF_LDX|BPF_W|BPF_MEM, 2, 1,
+             offsetof(struct xdp_md, data), 0),
+        INSN(BPF_LDX|BPF_W|BPF_MEM, 3, 1,
+             offsetof(struct xdp_md, data_end), 0),
+        /* if data + HDR_LEN > data_end goto pass */
+        INSN(BPF_ALU64|BPF_MOV|BPF_X, 4, 2, 0, 0),
+        INSN(BPF_ALU64|BPF_ADD|BPF_K, 4, 0, 0, HDR_LEN),
+        INSN(BPF_JMP|BPF_JGT|BPF_X, 4, 3, 14, 0),
+        /* if not IPv4 with no options, UDP and our port goto pass */
+        INSN(BPF_LDX|BPF_H|BPF_MEM, 5, 2, 12, 0),
+        INSN(BPF_JMP|BPF_JNE|BPF_K, 5, 0, 12, htons(ETH_P_IP)),
+        INSN(BPF_LDX|BPF_B|BPF_MEM, 5, 2, 14, 0),
+        INSN(BPF_JMP|BPF_JNE|BPF_K, 5, 0, 10, 0x45),
+        INSN(BPF_LDX|BPF_B|BPF_MEM, 5, 2, 23, 0),
+        INSN(BPF_JMP|BPF_JNE|BPF_K, 5, 0, 8, IPPROTO_UDP),
+        INSN(BPF_LDX|BPF_H|BPF_MEM, 5, 2, 36, 0),
+        INSN(BPF_JMP|BPF_JNE|BPF_K, 5, 0, 6, 0),
+        /* return bpf_redirect_map(map, rx_queue_index, XDP_PASS) */
+        INSN(BPF_LDX|BPF_W|BPF_MEM, 2, 6,
+             offsetof(struct xdp_md, rx_queue_index), 0),
+        INSN(BPF_LD|BPF_DW|BPF_IMM, 1, BPF_PSEUDO_MAP_FD, 0, XdpMap),
+        INSN(0, 0, 0, 0, 0),
+        INSN(BPF_ALU64|BPF_MOV|BPF_K, 3, 0, 0, XDP_PASS),
+        INSN(BPF_JMP|BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map),
+        INSN(BPF_JMP|BPF_EXIT, 0, 0, 0, 0),
+        /* pass: return XDP_PASS */
+        INSN(BPF_ALU64|BPF_MOV|BPF_K, 0, 0, 0, XDP_PASS),
+        INSN(BPF_JMP|BPF_EXIT, 0, 0, 0, 0),
+    };
+#undef INSN
+    union bpf_attr attr ={
+        .prog_type = BPF_PROG_TYPE_XDP,
+        .insn_cnt  = cardof(prog),
+        .insns     = (uintptr_t) prog,
+        .license   = (uintptr_t) "Dual BSD/GPL",
+        .log_buf   = (uintptr_t) log,
+        .log_size  = sizeof(log),
+        .log_level = 1,
+    };
+
+    memcpy(&dport, port, sizeof(dport));
+    prog[13].imm = dport;
+    log[0] = '\0';
+    fd = bpf(BPF_PROG_LOAD, &attr);
+    if (fd < 0) {
+        debug("XDP verifier: %s", log);
+        error(SYS, "failed to load XDP program");
+    }
+    return fd;
+}
+
+
+/*
+ * Attach our XDP program to an interface in the given mode.  The attachment
+ * lasts as long as the link and so goes away when we exit for any reason.
+ * Return 0 or an errno.
+ */
+static int
+prog_attach(int ifindex, XDP_MODE mode)
+{
+    union bpf_attr attr ={
+        .link_create = {
+            .prog_fd        = XdpProg,
+            .target_ifindex = ifindex,
+            .attach_type    = BPF_XDP,
+            .flags          = (mode == XM_SKB) ? XDP_FLAGS_SKB_MODE
+                                               : XDP_FLAGS_DRV_MODE,
+        },
+    };
+
+    XdpLink = bpf(BPF_LINK_CREATE, &attr);
+    if (XdpLink < 0) {
+        debug("XDP %s mode attach failed: %s", XdpModes[mode],
+              strerror(errno));
+        return errno;
+    }
+    return 0;
+}
+
+
+/*
+ * Make a system call to bpf.
+ */
+static int
+bpf(int cmd, union bpf_attr *attr)
+{
+    return syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+
+/*
+ * Create an AF_XDP socket with its UMEM and rings and bind it to a queue of an
+ * interface.  Only the socket on queue 0 has frames and a ring to send with.
+ * Return 0 or an errno.
+ */
+static int
+xdp_socket(XSK *s, int ifindex, int queue, XDP_MODE mode)
+{
+    int n = XDP_RING;
+    int fd;
+    struct xdp_mmap_offsets off;
+    socklen_t offLen = sizeof(off);
+    struct xdp_umem_reg reg ={
+        .chunk_size = XDP_FRAME,
+    };
+    struct sockaddr_xdp sxdp ={
+        .sxdp_family   = AF_XDP,
+        .sxdp_ifindex  = ifindex,
+        .sxdp_queue_id = queue,
+        .sxdp_flags    = XDP_USE_NEED_WAKEUP |
+                         ((mode == XM_ZC) ? XDP_ZEROCOPY : XDP_COPY),
+    };
+
+    s->umemLen = (size_t)(queue ? XDP_RX : XDP_RX + XDP_TX) * XDP_FRAME;
+    s->umem = mmap(0, s->umemLen, PROT_READ|PROT_WRITE,
+                   MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (s->umem == MAP_FAILED) {
+        s->umem = 0;
+        error(SYS, "failed to allocate UMEM");
+    }
+    reg.addr = (uintptr_t) s->umem;
+    reg.len = s->umemLen;
+    fd = s->fd = socket(AF_XDP, SOCK_RAW, 0);
+    if (fd < 0)
+        error(SYS, "failed to create AF_XDP socket");
+    if (setsockopt(fd, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) < 0 ||
+        setsockopt(fd, SOL_XDP, XDP_UMEM_FILL_RING, &n, sizeof(n)) < 0 ||
+        setsockopt(fd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &n, sizeof(n)) < 0 ||
+        setsockopt(fd, SOL_XDP, XDP_RX_RING, &n, sizeof(n)) < 0 ||
+        (!queue && setsockopt(fd, SOL_XDP, XDP_TX_RING, &n, sizeof(n)) < 0) ||
+        getsockopt(fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &offLen) < 0)
+        error(SYS, "failed to set up AF_XDP socket");
+    ring_map(&s->rx, fd, &off.rx, XDP_PGOFF_RX_RING, sizeof(struct xdp_desc));
+    if (!queue)
+        ring_map(&s->tx, fd, &off.tx, XDP_PGOFF_TX_RING,
+                 sizeof(struct xdp_desc));
+    ring_map(&s->fill, fd, &off.fr, XDP_UMEM_PGOFF_FILL_RING,
+             sizeof(uint64_t));
+    ring_map(&s->comp, fd, &off.cr, XDP_UMEM_PGOFF_COMPLETION_RING,
+             sizeof(uint64_t));
+    if (bind(fd, (SA *)&sxdp, sizeof(sxdp)) == SUCCESS0)
+        return 0;
+
+    n = errno;
+    debug("AF_XDP %s mode bind to queue %d failed: %s", XdpModes[mode], queue,
+                                                                strerror(n));
+    socket_close(s);
+    return n;
+}
+
+
+/*
+ * Map one of the rings of an AF_XDP socket.
+ */
+static void
+ring_map(RING *ring, int fd, struct xdp_ring_offset *off, off_t pgoff,
+         int size)
+{
+    char *p;
+
+    ring->mapLen = off->desc + XDP_RING * size;
+    p = mmap(0, ring->mapLen, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+             fd, pgoff);
+    if (p == MAP_FAILED)
+        error(SYS, "failed to map AF_XDP ring");
+    ring->map = p;
+    ring->prod = (uint32_t *)(p + off->producer);
+    ring->cons = (uint32_t *)(p + off->consumer);
+    ring->flags = (uint32_t *)(p + off->flags);
+    ring->desc = p + off->desc;
+    ring->mask = XDP_RING - 1;
+}
+
+
+/*
+ * Close an AF_XDP socket and unmap its rings and UMEM.
+ */
+static void
+socket_close(XSK *s)
+{
+    RING *rings[] ={ &s->rx, &s->tx, &s->fill, &s->comp };
+    int i;
+
+    for (i = 0; i < (int)cardof(rings); ++i) {
+        if (rings[i]->map)
+            munmap(rings[i]->map, rings[i]->mapLen);
+        memset(rings[i], 0, sizeof(*rings[i]));
+    }
+    if (s->fd >= 0)
+        close(s->fd);
+    s->fd = -1;
+    if (s->umem)
+        munmap(s->umem, s->umemLen);
+    s->umem = 0;
+}
+
+
+/*
+ * Set up AF_XDP to send and receive.
+ */
+static void
+xdp_connect(XPORT *x)
+{
+    xdp_init(1);
+}
+
+
+/*
+ * Set up AF_XDP only to send.
+ */
+static void
+xdp_connect_tx(XPORT *x)
+{
+    xdp_init(0);
+}
+
+
+/*
+ * Close the AF_XDP sockets and release everything that goes with them.
+ */
+static void
+xdp_close(XPORT *x)
+{
+    int q;
+
+    for (q = 0; q < XskN; ++q)
+        socket_close(&Xsks[q]);
+    XskN = 0;
+    if (XdpLink >= 0)
+        close(XdpLink);
+    if (XdpProg >= 0)
+        close(XdpProg);
+    if (XdpMap >= 0)
+        close(XdpMap);
+    if (XdpPortFd >= 0)
+        close(XdpPortFd);
+    XdpLink = XdpProg = XdpMap = XdpPortFd = -1;
+    TxFreeN = 0;
+}
+
+
+/*
+ * Post n sends of the frames built by xdp_init.  Those we have no free frame
+ * or descriptor for yet are sent by a later call.
+ */
+static void
+xdp_post_send(XPORT *x, int ep, void *buf, int len, int n)
+{
+    TxOwed += n;
+    xdp_submit();
+}
+
+
+/*
+ * Send as many of the sends we owe as we can.
+ */
+static void
+xdp_submit(void)
+{
+    uint32_t i;
+    uint32_t idx;
+    uint32_t n;
+    RING *tx = &Xsks[0].tx;
+    struct xdp_desc *desc = tx->desc;
+
+    xdp_complete();
+    n = ring_reserve(tx, &idx, TxOwed < TxFreeN ? TxOwed : TxFreeN);
+    for (i = 0; i < n; ++i) {
+        struct xdp_desc *d = &desc[(idx + i) & tx->mask];
+
+        d->addr = TxFree[--TxFreeN];
+        d->len = HDR_LEN + Req.msg_size;
+        d->options = 0;
+    }
+    ring_submit(tx, n);
+    xdp_kick();
+    TxOwed -= n;
+    TxDone += n;
+}
+
+
+/*
+ * Send a message, copying it into a frame that already holds the headers.
+ */
+static void
+xdp_post_copy(XPORT *x, int ep, void *buf, int len, int n)
+{
+    XSK *s = &Xsks[0];
+
+    while (!Finished) {
+        uint32_t idx;
+
+        xdp_complete();
+        if (TxFreeN && ring_reserve(&s->tx, &idx, 1)) {
+            struct xdp_desc *d = (struct xdp_desc *)s->tx.desc +
+                                                    (idx & s->tx.mask);
+            uint64_t addr = TxFree[--TxFreeN];
+
+            memcpy(s->umem + addr + HDR_LEN, buf, len);
+            d->addr = addr;
+            d->len = HDR_LEN + len;
+            d->options = 0;
+            ring_submit(&s->tx, 1);
+            xdp_kick();
+            TxDone++;
+            return;
+        }
+        xdp_kick();
+    }
+}
+
+
+/*
+ * Hand the frames of the messages last received back to the fill ring.
+ */
+static void
+xdp_post_recv(XPORT *x, int ep, void *buf, int len, int n)
+{
+    if (!RxN)
+        return;
+    xdp_fill(RxSock, RxAddrs, RxN);
+    RxN = 0;
+}
+
+
+/*
+ * Return the sends made since the last poll and the messages received on
+ * whichever socket has some.  The data of a message stays in its frame until
+ * the next receive is posted.  If there is nothing and we are not still
+ * sending, we wait for something to arrive.
+ */
+static int
+xdp_poll(XPORT *x, XCOMP *c, int n)
+{
+    int i = 0;
+    uint32_t j;
+    uint32_t idx;
+    uint32_t got;
+    XSK *s;
+    struct xdp_desc *desc;
+
+    if (TxOwed)
+        xdp_submit();
+    for (; TxDone && i < n; --TxDone, ++i)
+        c[i] = (XCOMP) { .op = X_SEND, .len = Req.msg_size };
+    if (!XdpRx || i == n)
+        return i;
+    xdp_post_recv(x, 0, 0, 0, 0);
+    s = xdp_peek(&idx, n - i < XDP_BATCH ? n - i : XDP_BATCH, &got);
+    if (!s) {
+        if (!i && !TxOwed)
+            xdp_wait();
+        return i;
+    }
+    desc = s->rx.desc;
+    for (j = 0; j < got; ++j, ++i) {
+        struct xdp_desc *d = &desc[(idx + j) & s->rx.mask];
+
+        c[i] = (XCOMP) {
+            .op   = X_RECV,
+            .len  = d->len - HDR_LEN,
+            .data = s->umem + d->addr + HDR_LEN
+        };
+        RxAddrs[j] = d->addr;
+    }
+    ring_release(&s->rx, got);
+    RxSock = s;
+    RxN = got;
+    return i;
+}
+
+
+/*
+ * Find a socket with something to receive, starting with the one that last
+ * had something since a flow stays on one queue.  Return it with up to max
+ * entries of its receive ring in n or 0 if there are none.
+ */
+static XSK *
+xdp_peek(uint32_t *idx, uint32_t max, uint32_t *n)
+{
+    int i;
+
+    for (i = 0; i < XskN; ++i) {
+        XSK *s = &Xsks[(XskNext + i) % XskN];
+
+        *n = ring_peek(&s->rx, idx, max);
+        if (*n) {
+            XskNext = s - Xsks;
+            return s;
+        }
+    }
+    return 0;
+}
+
+
+/*
+ * Return the frames the kernel has finished sending to our free list.
+ */
+static void
+xdp_complete(void)
+{
+    uint32_t i;
+    uint32_t idx;
+    RING *ring = &Xsks[0].comp;
+    uint64_t *comp = ring->desc;
+    uint32_t n = ring_peek(ring, &idx, XDP_RING);
+
+    for (i = 0; i < n; ++i)
+        TxFree[TxFreeN++] = comp[(idx + i) & ring->mask];
+    ring_release(ring, n);
+}
+
+
+/*
+ * Give frames to the kernel to receive into on a socket.  The fill ring has
+ * room for every receive frame so this cannot fail.
+ */
+static void
+xdp_fill(XSK *s, uint64_t *addrs, uint32_t n)
+{
+    uint32_t i;
+    uint32_t idx;
+    uint64_t *fill = s->fill.desc;
+
+    if (ring_reserve(&s->fill, &idx, n) != n)
+        error(BUG, "AF_XDP fill ring full");
+    for (i = 0; i < n; ++i)
+        fill[(idx + i) & s->fill.mask] = addrs[i] & ~(uint64_t)(XDP_FRAME-1);
+    ring_submit(&s->fill, n);
+}
+
+
+/*
+ * Have the kernel send what we have queued if it needs to be told.  In copy
+ * and skb modes, it always does.
+ */
+static void
+xdp_kick(void)
+{
+    if (!(*Xsks[0].tx.flags & XDP_RING_NEED_WAKEUP))
+        return;
+    if (sendto(Xsks[0].fd, 0, 0, MSG_DONTWAIT, 0, 0) < 0 && errno != EAGAIN &&
+        errno != EBUSY && errno != ENOBUFS && errno != EINTR)
+        LStat.s.no_errs++;
+}
+
+
+/*
+ * Wait for something to receive on any of our sockets.  Polling also wakes the
+ * driver if it needs it.  We are interrupted when the test ends.
+ */
+static void
+xdp_wait(void)
+{
+    int q;
+    struct pollfd pfd[XDP_QUEUES];
+
+    for (q = 0; q < XskN; ++q) {
+        pfd[q].fd = Xsks[q].fd;
+        pfd[q].events = POLLIN;
+    }
+    poll(pfd, XskN, -1);
+}
+
+
+/*
+ * Return the number of entries, up to max, the kernel has produced on a ring
+ * and the index of the first.
+ */
+static uint32_t
+ring_peek(RING *ring, uint32_t *idx, uint32_t max)
+{
+    uint32_t n = __atomic_load_n(ring->prod, __ATOMIC_ACQUIRE) - *ring->cons;
+
+    *idx = *ring->cons;
+    return (n < max) ? n : max;
+}
+
+
+/*
+ * Tell the kernel we have consumed entries from a ring.
+ */
+static void
+ring_release(RING *ring, uint32_t n)
+{
+    __atomic_store_n(ring->cons, *ring->cons + n, __ATOMIC_RELEASE);
+}
+
+
+/*
+ * Return the number of entries, up to max, we may produce on a ring and the
+ * index of the first.
+ */
+static uint32_t
+ring_reserve(RING *ring, uint32_t *idx, uint32_t max)
+{
+    uint32_t n = XDP_RING - (*ring->prod -
+                             __atomic_load_n(ring->cons, __ATOMIC_ACQUIRE));
+
+    *idx = *ring->prod;
+    return (n < max) ? n : max;
+}
+
+
+/*
+ * Hand entries we have produced on a ring to the kernel.
+ */
+static void
+ring_submit(RING *ring, uint32_t n)
+{
+    __atomic_store_n(ring->prod, *ring->prod + n, __ATOMIC_RELEASE);
+}
+
+
+#else /* HAVE_LINUX_IF_XDP_H */
+
+
+/*
+ * Without the AF_XDP and BPF link headers, the tests only say so.
+ */
+void
+run_client_xdp_bw(void)
+{
+    error(0, "qperf was built without AF_XDP");
+}
+
+
+void
+run_server_xdp_bw(void)
+{
+    error(0, "qperf was built without AF_XDP");
+}
+
+
+void
+run_client_xdp_lat(void)
+{
+    error(0, "qperf was built without AF_XDP");
+}
+
+
+void
+run_server_xdp_lat(void)
+{
+    error(0, "qperf was built without AF_XDP");
+}
+#endif /* HAVE_LINUX_IF_XDP_H */
@@ -0,0 +1,696 @@
+/*
+ * qperf - transport operations and the test loops that use them.
+ *
+ * Copyright (c) 2002-2009 Johann George.  All rights reserved.
+ * Copyright (c) 2006-2009 QLogic Corporation.  All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * Limits.
+ */
+#define XPORT_EPS   RAILS_MAX           /* Most endpoints of a transport */
+#define XPORT_POLL  1024                /* Most completions reaped at once */
+#define XPORT_BULK  (64*1024)           /* Size of a bulk message in QoS tests */
+
+
+/*
+ * Features the loops are specialized on.  They are always passed as
+ * constants so that the code for those not in use drops out.
+ */
+#define X_ACCESS    0x01                /* Touch the data received */
+#define X_COLD      0x02                /* Flush the cache around each message */
+#define X_COUNT     0x04                /* Stop after Req.no_msgs messages */
+#define X_FILL      0x08                /* Send compressible data */
+#define X_PIPELINE  0x10                /* Hand messages to the pipeline */
+#define X_RAILS     0x20                /* Count the bytes of each endpoint */
+
+
+/*
+ * Kinds of completion.
+ */
+#define X_SEND      1                   /* A send */
+#define X_RECV      2                   /* A receive */
+
+
+/*
+ * An endpoint of a transport.  Socket transports keep the send and receive
+ * posted on it here until poll hands back or carries out each.  For
+ * datagrams, addr is the peer we send to or last received from.
+ */
+typedef struct XEP {
+    int         fd;                     /* Socket */
+    SS          addr;                   /* Peer address */
+    socklen_t   addrLen;                /* Length of addr */
+    char       *sbuf;                   /* Message posted to send */
+    int         slen;                   /* Its length; 0 if none */
+    int         sdone;                  /* Bytes of it sent or -1 */
+    int         serr;                   /* Error if sdone is -1 */
+    char       *rbuf;                   /* Buffer posted to receive into */
+    int         rlen;                   /* Its length; 0 if none */
+    int         rdone;                  /* Bytes of it received */
+} XEP;
+
+
+/*
+ * A transport.  The caller sets the number of endpoints, how many transfers
+ * each keeps posted, a transport specific kind and, for RDMA, the device
+ * before connecting.
+ */
+typedef struct XPORT {
+    int         n;                      /* Number of endpoints */
+    int         depth;                  /* Transfers posted on each endpoint */
+    int         kind;                   /* Socket kind or QP transport */
+    void       *dev;                    /* Device */
+    XEP         ep[XPORT_EPS];          /* Endpoints */
+} XPORT;
+
+
+/*
+ * A completed transfer.  Len is the number of bytes transferred or -1 with
+ * the reason in err.  For a receive, data is where the message landed.
+ */
+typedef struct XCOMP {
+    int         ep;                     /* Endpoint */
+    int         op;                     /* X_SEND or X_RECV */
+    int         len;                    /* Bytes transferred or -1 */
+    int         err;                    /* Error number or status */
+    void       *data;                   /* Data */
+} XCOMP;
+
+
+/*
+ * Transport operations.  Connect sets up the endpoints on either side and
+ * close tears them down.  Post_send and post_recv start n transfers of a
+ * message on an endpoint; a transport with registered buffers may ignore buf.
+ * Poll returns up to n completed transfers, waiting for at least one unless
+ * the test is finished.  The loops below are inlined into each transport with
+ * a constant table so that they make no indirect calls.
+ */
+typedef struct XPORT_OPS {
+    void (*connect)(XPORT *x);
+    void (*post_send)(XPORT *x, int ep, void *buf, int len, int n);
+    void (*post_recv)(XPORT *x, int ep, void *buf, int len, int n);
+    int  (*poll)(XPORT *x, XCOMP *c, int n);
+    void (*close)(XPORT *x);
+} XPORT_OPS;
+
+
+/*
+ * Note the result of a send made as it was posted by a transport whose sends
+ * block until done.  Poll hands it back.
+ */
+static inline void
+xport_sent(XPORT *x, int ep, void *buf, int len, int n)
+{
+    XEP *e = &x->ep[ep];
+
+    e->sbuf = buf;
+    e->slen = len;
+    e->sdone = n;
+    e->serr = errno;
+}
+
+
+/*
+ * Post a receive on a socket endpoint.
+ */
+static inline void
+xport_post_recv(XPORT *x, int ep, void *buf, int len, int n)
+{
+    XEP *e = &x->ep[ep];
+
+    e->rbuf = buf;
+    e->rlen = len;
+    e->rdone = 0;
+}
+
+
+/*
+ * Poll a transport with one endpoint whose sends are made when posted and
+ * whose receives block.  We hand back a send made since the last poll or,
+ * if there is none, make the receive that is posted.
+ */
+static inline __attribute__((always_inline)) int
+xport_poll_sync(XPORT *x, XCOMP *c, int (*recv)(XEP *e, void *buf, int len))
+{
+    XEP *e = &x->ep[0];
+
+    if (e->slen) {
+        *c = (XCOMP) {
+            .op   = X_SEND,
+            .len  = e->sdone,
+            .err  = e->serr,
+            .data = e->sbuf
+        };
+        e->slen = 0;
+        return 1;
+    }
+    if (e->rlen) {
+        int n = recv(e, e->rbuf, e->rlen);
+
+        *c = (XCOMP) {
+            .op   = X_RECV,
+            .len  = n,
+            .err  = errno,
+            .data = e->rbuf
+        };
+        e->rlen = 0;
+        return 1;
+    }
+    return 0;
+}
+
+
+/*
+ * Keep each endpoint sending until we are finished or, with X_COUNT, have
+ * sent Req.no_msgs messages.
+ */
+static inline __attribute__((always_inline)) void
+xport_client_bw_loop(const XPORT_OPS *ops, XPORT *x, int feat)
+{
+    int i;
+    long sent = 0;
+    XCOMP c[XPORT_POLL];
+    char *buf = qmalloc(Req.msg_size);
+
+    if (feat & X_FILL)
+        compress_fill(buf, Req.msg_size);
+    sync_test();
+    for (i = 0; i < x->n; ++i) {
+        int k = (feat & X_COUNT) ? left_to_send(&sent, x->depth) : x->depth;
+
+        ops->post_send(x, i, buf, Req.msg_size, k);
+        sent += k;
+    }
+    while (!Finished) {
+        int again[XPORT_EPS] ={0};
+        int n = ops->poll(x, c, cardof(c));
+
+        if (Finished)
+            break;
+        for (i = 0; i < n; ++i) {
+            if (c[i].len < 0)
+                LStat.s.no_errs++;
+            else {
+                LStat.s.no_bytes += c[i].len;
+                LStat.s.no_msgs++;
+                if (feat & X_RAILS)
+                    LStat.rail_bytes[c[i].ep] += c[i].len;
+            }
+            again[c[i].ep]++;
+        }
+        if (feat & X_COUNT)
+            if (LStat.s.no_msgs + LStat.s.no_errs >= Req.no_msgs)
+                break;
+        for (i = 0; i < x->n; ++i) {
+            int k = again[i];
+
+            if (feat & X_COUNT)
+                k = left_to_send(&sent, k);
+            if (k)
+                ops->post_send(x, i, buf, Req.msg_size, k);
+            sent += k;
+        }
+    }
+    free(buf);
+}
+
+
+/*
+ * Measure bandwidth (client side).  Feat holds the features the transport
+ * needs; we add the rest from the request.
+ */
+static inline __attribute__((always_inline)) void
+xport_client_bw(const XPORT_OPS *ops, XPORT *x, int feat, MEASURE measure)
+{
+    ops->connect(x);
+    if (Req.no_msgs)
+        xport_client_bw_loop(ops, x, feat | X_COUNT);
+    else
+        xport_client_bw_loop(ops, x, feat);
+    stop_test_timer();
+    exchange_results();
+    ops->close(x);
+    show_results(measure);
+}
+
+
+/*
+ * Keep each endpoint receiving until we are finished or, with X_COUNT, have
+ * received Req.no_msgs messages.  With X_PIPELINE, we receive into the
+ * pipeline's buffers and hand each message to a worker.
+ */
+static inline __attribute__((always_inline)) void
+xport_server_bw_loop(const XPORT_OPS *ops, XPORT *x, int feat)
+{
+    int i;
+    XCOMP c[XPORT_POLL];
+    char *buf = qmalloc(Req.msg_size);
+
+    pipeline_init();
+    for (i = 0; i < x->n; ++i)
+        ops->post_recv(x, i, (feat & X_PIPELINE) ? pipeline_buf() : buf,
+                       Req.msg_size, x->depth);
+    sync_test();
+    while (!Finished) {
+        int again[XPORT_EPS] ={0};
+        int n = ops->poll(x, c, cardof(c));
+
+        if (Finished)
+            break;
+        for (i = 0; i < n; ++i) {
+            if (c[i].len < 0)
+                LStat.r.no_errs++;
+            else {
+                LStat.r.no_bytes += c[i].len;
+                LStat.r.no_msgs++;
+                if (feat & X_RAILS)
+                    LStat.rail_bytes[c[i].ep] += c[i].len;
+                if (feat & X_PIPELINE)
+                    pipeline_push(c[i].data, c[i].len);
+                else if (feat & X_ACCESS)
+                    touch_data(c[i].data, c[i].len);
+            }
+            again[c[i].ep]++;
+        }
+        if (feat & X_COUNT)
+            if (LStat.r.no_msgs + LStat.r.no_errs >= Req.no_msgs)
+                break;
+        for (i = 0; i < x->n; ++i)
+            if (again[i])
+                ops->post_recv(x, i,
+                               (feat & X_PIPELINE) ? pipeline_buf() : buf,
+                               Req.msg_size, again[i]);
+    }
+    free(buf);
+}
+
+
+/*
+ * Measure bandwidth (server side).
+ */
+static inline __attribute__((always_inline)) void
+xport_server_bw(const XPORT_OPS *ops, XPORT *x, int feat)
+{
+    ops->connect(x);
+    if (Req.no_msgs) {
+        if (Req.pipeline)
+            xport_server_bw_loop(ops, x, feat | X_COUNT | X_PIPELINE);
+        else if (Req.access_recv)
+            xport_server_bw_loop(ops, x, feat | X_COUNT | X_ACCESS);
+        else
+            xport_server_bw_loop(ops, x, feat | X_COUNT);
+    } else {
+        if (Req.pipeline)
+            xport_server_bw_loop(ops, x, feat | X_PIPELINE);
+        else if (Req.access_recv)
+            xport_server_bw_loop(ops, x, feat | X_ACCESS);
+        else
+            xport_server_bw_loop(ops, x, feat);
+    }
+    stop_test_timer();
+    pipeline_stop();
+    exchange_results();
+    ops->close(x);
+}
+
+
+/*
+ * Keep each endpoint both sending and receiving until we are finished.
+ */
+static inline __attribute__((always_inline)) void
+xport_bi_bw_loop(const XPORT_OPS *ops, XPORT *x, int feat)
+{
+    int i;
+    XCOMP c[XPORT_POLL];
+    char *buf = qmalloc(Req.msg_size);
+
+    for (i = 0; i < x->n; ++i)
+        ops->post_recv(x, i, buf, Req.msg_size, x->depth);
+    sync_test();
+    for (i = 0; i < x->n; ++i)
+        ops->post_send(x, i, buf, Req.msg_size, x->depth);
+    while (!Finished) {
+        int sends[XPORT_EPS] ={0};
+        int recvs[XPORT_EPS] ={0};
+        int n = ops->poll(x, c, cardof(c));
+
+        if (Finished)
+            break;
+        for (i = 0; i < n; ++i) {
+            if (c[i].op == X_SEND) {
+                if (c[i].len < 0)
+                    LStat.s.no_errs++;
+                else {
+                    LStat.s.no_bytes += c[i].len;
+                    LStat.s.no_msgs++;
+                }
+                sends[c[i].ep]++;
+            } else {
+                if (c[i].len < 0)
+                    LStat.r.no_errs++;
+                else {
+                    LStat.r.no_bytes += c[i].len;
+                    LStat.r.no_msgs++;
+                    if (feat & X_ACCESS)
+                        touch_data(c[i].data, c[i].len);
+                }
+                recvs[c[i].ep]++;
+            }
+        }
+        for (i = 0; i < x->n; ++i) {
+            if (recvs[i])
+                ops->post_recv(x, i, buf, Req.msg_size, recvs[i]);
+            if (sends[i])
+                ops->post_send(x, i, buf, Req.msg_size, sends[i]);
+        }
+    }
+    free(buf);
+}
+
+
+/*
+ * Measure bi-directional bandwidth (client and server side).
+ */
+static inline __attribute__((always_inline)) void
+xport_bi_bw(const XPORT_OPS *ops, XPORT *x, int feat)
+{
+    ops->connect(x);
+    if (Req.access_recv)
+        xport_bi_bw_loop(ops, x, feat | X_ACCESS);
+    else
+        xport_bi_bw_loop(ops, x, feat);
+    stop_test_timer();
+    exchange_results();
+    ops->close(x);
+}
+
+
+/*
+ * Send a message on the first endpoint and wait for both it and the reply to
+ * complete before sending the next.  A failed send ends the round early; its
+ * receive stays posted.
+ */
+static inline __attribute__((always_inline)) void
+xport_client_lat_loop(const XPORT_OPS *ops, XPORT *x, int feat)
+{
+    XCOMP c[2];
+    char *buf = qmalloc(Req.msg_size);
+
+    ops->post_recv(x, 0, buf, Req.msg_size, 1);
+    sync_test();
+    while (!Finished) {
+        int done = 0;
+        uint64_t t;
+
+        if (feat & X_COLD)
+            flush_data(buf, Req.msg_size);
+        t = sample_time();
+        ops->post_send(x, 0, buf, Req.msg_size, 1);
+        while (done != 3 && !Finished) {
+            int i;
+            int n = ops->poll(x, c, cardof(c));
+
+            if (Finished)
+                break;
+            for (i = 0; i < n; ++i) {
+                if (c[i].op == X_SEND) {
+                    done |= 1;
+                    if (c[i].len >= 0) {
+                        LStat.s.no_bytes += c[i].len;
+                        LStat.s.no_msgs++;
+                    } else {
+                        LStat.s.no_errs++;
+                        sample_add(t, 0, c[i].err);
+                        done = 3;
+                    }
+                    continue;
+                }
+                done |= 2;
+                if (c[i].len >= 0) {
+                    LStat.r.no_bytes += c[i].len;
+                    LStat.r.no_msgs++;
+                    sample_add(t, c[i].len, 0);
+                } else {
+                    LStat.r.no_errs++;
+                    sample_add(t, 0, c[i].err);
+                }
+                if (feat & X_COLD)
+                    flush_data(buf, Req.msg_size);
+                ops->post_recv(x, 0, buf, Req.msg_size, 1);
+            }
+        }
+    }
+    free(buf);
+}
+
+
+/*
+ * Measure ping pong latency (client side).
+ */
+static inline __attribute__((always_inline)) void
+xport_client_lat(const XPORT_OPS *ops, XPORT *x, int feat)
+{
+    ops->connect(x);
+    if (Req.cold_cache)
+        xport_client_lat_loop(ops, x, feat | X_COLD);
+    else
+        xport_client_lat_loop(ops, x, feat);
+    stop_test_timer();
+    exchange_results();
+    ops->close(x);
+    show_results(LATENCY);
+}
+
+
+/*
+ * Reply to each message received on the first endpoint.  The sample is the
+ * time from the message arriving until the reply is posted.
+ */
+static inline __attribute__((always_inline)) void
+xport_server_lat_loop(const XPORT_OPS *ops, XPORT *x, int feat)
+{
+    XCOMP c[2];
+    char *buf = qmalloc(Req.msg_size);
+
+    ops->post_recv(x, 0, buf, Req.msg_size, 1);
+    sync_test();
+    while (!Finished) {
+        int i;
+        int n = ops->poll(x, c, cardof(c));
+
+        if (Finished)
+            break;
+        for (i = 0; i < n; ++i) {
+            uint64_t t;
+
+            if (c[i].op == X_SEND) {
+                if (c[i].len >= 0) {
+                    LStat.s.no_bytes += c[i].len;
+                    LStat.s.no_msgs++;
+                } else
+                    LStat.s.no_errs++;
+                continue;
+            }
+            if (c[i].len < 0) {
+                LStat.r.no_errs++;
+                ops->post_recv(x, 0, buf, Req.msg_size, 1);
+                continue;
+            }
+            LStat.r.no_bytes += c[i].len;
+            LStat.r.no_msgs++;
+            t = sample_time();
+            if (feat & X_COLD)
+                flush_data(buf, Req.msg_size);
+            ops->post_recv(x, 0, buf, Req.msg_size, 1);
+            service_wait();
+            ops->post_send(x, 0, buf, Req.msg_size, 1);
+            sample_add(t, Req.msg_size, 0);
+        }
+    }
+    free(buf);
+}
+
+
+/*
+ * Measure ping pong latency (server side).
+ */
+static inline __attribute__((always_inline)) void
+xport_server_lat(const XPORT_OPS *ops, XPORT *x, int feat)
+{
+    ops->connect(x);
+    if (Req.cold_cache)
+        xport_server_lat_loop(ops, x, feat | X_COLD);
+    else
+        xport_server_lat_loop(ops, x, feat);
+    stop_test_timer();
+    exchange_results();
+    ops->close(x);
+}
+
+
+/*
+ * Keep a bulk load flowing on the first endpoint while timing probes that
+ * take turns on the second and third.  The second endpoint shares the class
+ * of service of the bulk load and the third has the one under test.  Only one
+ * probe is outstanding so that both see the same load.  A probe whose send
+ * fails is skipped.
+ */
+static inline __attribute__((always_inline)) void
+xport_client_qos_loop(const XPORT_OPS *ops, XPORT *x)
+{
+    int probe = 1;
+    uint64_t sent;
+    XCOMP c[XPORT_POLL];
+    char *bulk = qmalloc(XPORT_BULK);
+    char *buf = qmalloc(Req.msg_size);
+
+    ops->post_recv(x, 1, buf, Req.msg_size, 1);
+    ops->post_recv(x, 2, buf, Req.msg_size, 1);
+    sync_test();
+    ops->post_send(x, 0, bulk, XPORT_BULK, x->depth);
+    sent = get_nsecs();
+    ops->post_send(x, probe, buf, Req.msg_size, 1);
+    while (!Finished) {
+        int i;
+        int again = 0;
+        int n = ops->poll(x, c, cardof(c));
+
+        if (Finished)
+            break;
+        for (i = 0; i < n; ++i) {
+            if (c[i].ep == 0) {
+                if (c[i].len < 0)
+                    LStat.s.no_errs++;
+                else {
+                    LStat.s.no_bytes += c[i].len;
+                    LStat.s.no_msgs++;
+                }
+                again++;
+                continue;
+            }
+            if (c[i].op == X_SEND && c[i].len >= 0)
+                continue;
+            if (c[i].op == X_RECV) {
+                if (c[i].len >= 0)
+                    stage_add(probe == 1 ? S_PROBE : S_PROBE_QOS,
+                              get_nsecs() - sent);
+                ops->post_recv(x, c[i].ep, buf, Req.msg_size, 1);
+            }
+            probe = 3 - probe;
+            sent = get_nsecs();
+            ops->post_send(x, probe, buf, Req.msg_size, 1);
+        }
+        if (again)
+            ops->post_send(x, 0, bulk, XPORT_BULK, again);
+    }
+    free(buf);
+    free(bulk);
+}
+
+
+/*
+ * Measure probe latency under a bulk load with and without a class of
+ * service (client side).
+ */
+static inline __attribute__((always_inline)) void
+xport_client_qos(const XPORT_OPS *ops, XPORT *x)
+{
+    ops->connect(x);
+    xport_client_qos_loop(ops, x);
+    stop_test_timer();
+    exchange_results();
+    ops->close(x);
+    show_results(BANDWIDTH);
+}
+
+
+/*
+ * Drain the bulk load on the first endpoint and echo the probes that arrive
+ * on the others.
+ */
+static inline __attribute__((always_inline)) void
+xport_server_qos_loop(const XPORT_OPS *ops, XPORT *x)
+{
+    XCOMP c[XPORT_POLL];
+    char *bulk = qmalloc(XPORT_BULK);
+    char *buf = qmalloc(Req.msg_size);
+
+    ops->post_recv(x, 0, bulk, XPORT_BULK, x->depth);
+    ops->post_recv(x, 1, buf, Req.msg_size, 1);
+    ops->post_recv(x, 2, buf, Req.msg_size, 1);
+    sync_test();
+    while (!Finished) {
+        int i;
+        int again = 0;
+        int n = ops->poll(x, c, cardof(c));
+
+        if (Finished)
+            break;
+        for (i = 0; i < n; ++i) {
+            if (c[i].ep == 0) {
+                if (c[i].len < 0)
+                    LStat.r.no_errs++;
+                else {
+                    LStat.r.no_bytes += c[i].len;
+                    LStat.r.no_msgs++;
+                }
+                again++;
+                continue;
+            }
+            if (c[i].op != X_RECV)
+                continue;
+            ops->post_recv(x, c[i].ep, buf, Req.msg_size, 1);
+            if (c[i].len >= 0)
+                ops->post_send(x, c[i].ep, buf, Req.msg_size, 1);
+        }
+        if (again)
+            ops->post_recv(x, 0, bulk, XPORT_BULK, again);
+    }
+    free(buf);
+    free(bulk);
+}
+
+
+/*
+ * Measure probe latency under a bulk load with and without a class of
+ * service (server side).
+ */
+static inline __attribute__((always_inline)) void
+xport_server_qos(const XPORT_OPS *ops, XPORT *x)
+{
+    ops->connect(x);
+    xport_server_qos_loop(ops, x);
+    stop_test_timer();
+    exchange_results();
+    ops->close(x);
+}